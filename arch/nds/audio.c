@@ -385,6 +385,16 @@ void audio_end_module(void)
   }
 }
 
+void audio_prefetch_module(const char *filename)
+{
+  // not implemented
+}
+
+int audio_get_module_prefetch(void)
+{
+  return 0;
+}
+
 void audio_spot_sample(int period, int which)
 {
   // not implemented
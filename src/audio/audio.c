@@ -102,7 +102,7 @@ int audio_get_real_frequency(int period)
   return freq_conversion / period;
 }
 
-static unsigned int volume_function(int input, int volume_setting)
+unsigned int audio_get_real_volume(int input, int volume_setting)
 {
   /* Adjust volume (0-255) exponentially according to a given setting (0-10).
    * 0 is no volume whatsoever and 10 is maximum volume. */
@@ -118,8 +118,87 @@ static unsigned int volume_function(int input, int volume_setting)
 // hardware mixing is utilized.
 #ifndef CONFIG_NDS
 
-void destruct_audio_stream(struct audio_stream *a_src)
+#ifndef PLATFORM_NO_THREADING
+#define AUDIO_PREFETCH
+#endif
+
+#ifdef AUDIO_PREFETCH
+
+#define MAX_PREFETCH_MODULES 16
+
+enum prefetch_state
+{
+  PREFETCH_EMPTY,
+  PREFETCH_QUEUED,
+  PREFETCH_LOADING,
+  PREFETCH_READY
+};
+
+struct prefetch_entry
+{
+  char filename[MAX_PATH];
+  struct audio_stream *a_src;
+  enum prefetch_state state;
+  unsigned int last_used;
+};
+
+/**
+ * Modules referenced by nearby boards are loaded on a background thread
+ * and kept in a small LRU cache. Streams constructed by the loader thread
+ * are not linked into the mixer until they are played, so playing a
+ * prefetched module only requires attaching the stream.
+ */
+static struct audio_prefetch
+{
+  struct prefetch_entry entries[MAX_PREFETCH_MODULES];
+  int num_entries;
+  unsigned int clock;
+  platform_mutex lock;
+  platform_cond cond;
+  platform_cond ready_cond;
+  platform_thread thread;
+  boolean running;
+  boolean quit;
+}
+prefetch;
+
+#endif /* AUDIO_PREFETCH */
+
+/**
+ * Remove a stream from the sample list. The audio lock must be held.
+ */
+static void audio_remove_sample(struct audio_stream *a_src)
+{
+  if(!a_src || !a_src->is_sample)
+    return;
+
+  if(a_src == audio.sample_list_base)
+    audio.sample_list_base = a_src->next_sample;
+
+  if(a_src == audio.sample_list_end)
+    audio.sample_list_end = a_src->previous_sample;
+
+  if(a_src->next_sample)
+    a_src->next_sample->previous_sample = a_src->previous_sample;
+
+  if(a_src->previous_sample)
+    a_src->previous_sample->next_sample = a_src->next_sample;
+
+  a_src->next_sample = NULL;
+  a_src->previous_sample = NULL;
+  a_src->is_sample = false;
+  audio.num_samples--;
+}
+
+/**
+ * Remove a stream from the mixer without freeing it. This is used by
+ * destruct_audio_stream and by streams that are allocated from a pool.
+ * The audio lock must be held if the stream is attached.
+ */
+void detach_audio_stream(struct audio_stream *a_src)
 {
+  audio_remove_sample(a_src);
+
   if(a_src == audio.stream_list_base)
     audio.stream_list_base = a_src->next;
 
@@ -132,9 +211,57 @@ void destruct_audio_stream(struct audio_stream *a_src)
   if(a_src->previous)
     a_src->previous->next = a_src->next;
 
+  a_src->next = NULL;
+  a_src->previous = NULL;
+}
+
+void destruct_audio_stream(struct audio_stream *a_src)
+{
+  detach_audio_stream(a_src);
   free(a_src);
 }
 
+/**
+ * Add a stream to the end of the mixer's stream list. Until it becomes the
+ * primary stream, it is also treated as the newest sample. Streams are not
+ * mixed until they are attached; the audio lock must not be held.
+ */
+void attach_audio_stream(struct audio_stream *a_src)
+{
+  LOCK();
+
+  if(audio.stream_list_base == NULL)
+  {
+    audio.stream_list_base = a_src;
+  }
+  else
+  {
+    audio.stream_list_end->next = a_src;
+  }
+
+  a_src->previous = audio.stream_list_end;
+  audio.stream_list_end = a_src;
+
+  if(a_src != audio.primary_stream && a_src != audio.pcs_stream)
+  {
+    if(audio.sample_list_base == NULL)
+    {
+      audio.sample_list_base = a_src;
+    }
+    else
+    {
+      audio.sample_list_end->next_sample = a_src;
+    }
+
+    a_src->previous_sample = audio.sample_list_end;
+    audio.sample_list_end = a_src;
+    a_src->is_sample = true;
+    audio.num_samples++;
+  }
+
+  UNLOCK();
+}
+
 void initialize_audio_stream(struct audio_stream *a_src,
  struct audio_stream_spec *a_spec, unsigned int volume, boolean repeat)
 {
@@ -162,40 +289,10 @@ void initialize_audio_stream(struct audio_stream *a_src,
     a_src->set_repeat(a_src, repeat);
 
   a_src->next = NULL;
-
-  LOCK();
-
-  if(audio.stream_list_base == NULL)
-  {
-    audio.stream_list_base = a_src;
-  }
-  else
-  {
-    audio.stream_list_end->next = a_src;
-  }
-
-  a_src->previous = audio.stream_list_end;
-  audio.stream_list_end = a_src;
-
-  UNLOCK();
-}
-
-static void clip_buffer(int16_t *dest, int32_t *src, size_t len)
-{
-  int32_t cur_sample;
-  size_t i;
-
-  for(i = 0; i < len; i++)
-  {
-    cur_sample = src[i];
-    if(cur_sample > 32767)
-      cur_sample = 32767;
-
-    if(cur_sample < -32768)
-      cur_sample = -32768;
-
-    dest[i] = cur_sample;
-  }
+  a_src->previous = NULL;
+  a_src->next_sample = NULL;
+  a_src->previous_sample = NULL;
+  a_src->is_sample = false;
 }
 
 /**
@@ -237,13 +334,177 @@ void audio_callback(int16_t *stream, size_t len)
       current_astream = next_astream;
     }
 
-    clip_buffer(stream, audio.mix_buffer, frames * 2);
+    sampled_clip_buffer(stream, audio.mix_buffer, frames * 2);
   }
 
   UNLOCK();
 }
 
-void init_audio(struct config_info *conf)
+#ifdef AUDIO_PREFETCH
+
+static struct prefetch_entry *audio_prefetch_find(const char *filename)
+{
+  int i;
+
+  for(i = 0; i < prefetch.num_entries; i++)
+  {
+    struct prefetch_entry *entry = &(prefetch.entries[i]);
+
+    if(entry->state != PREFETCH_EMPTY && !strcmp(entry->filename, filename))
+      return entry;
+  }
+  return NULL;
+}
+
+/**
+ * Get the oldest queued request. Requests are loaded in the order they
+ * were made.
+ */
+static struct prefetch_entry *audio_prefetch_next(void)
+{
+  struct prefetch_entry *next = NULL;
+  int i;
+
+  for(i = 0; i < prefetch.num_entries; i++)
+  {
+    struct prefetch_entry *entry = &(prefetch.entries[i]);
+
+    if(entry->state == PREFETCH_QUEUED &&
+     (!next || entry->last_used < next->last_used))
+      next = entry;
+  }
+  return next;
+}
+
+static THREAD_RES audio_prefetch_thread(void *opaque)
+{
+  platform_mutex_lock(&prefetch.lock);
+
+  while(!prefetch.quit)
+  {
+    struct prefetch_entry *entry = audio_prefetch_next();
+    struct audio_stream *a_src;
+
+    if(!entry)
+    {
+      platform_cond_wait(&prefetch.cond, &prefetch.lock);
+      continue;
+    }
+
+    // Loading entries are never evicted, so this is safe to use unlocked.
+    entry->state = PREFETCH_LOADING;
+    platform_mutex_unlock(&prefetch.lock);
+
+    // Prefetched modules are attached when they are played.
+    a_src = audio_ext_construct_stream_detached(entry->filename, 0, 255, true);
+
+    platform_mutex_lock(&prefetch.lock);
+    entry->a_src = a_src;
+    entry->state = PREFETCH_READY;
+    platform_cond_broadcast(&prefetch.ready_cond);
+  }
+
+  platform_mutex_unlock(&prefetch.lock);
+  THREAD_RETURN;
+}
+
+static void audio_prefetch_destroy(struct audio_stream *a_src)
+{
+  if(a_src)
+  {
+    LOCK();
+    a_src->destruct(a_src);
+    UNLOCK();
+  }
+}
+
+/**
+ * Remove a prefetched module from the cache if it exists. If the module is
+ * currently being loaded, this waits for it to finish. Returns `NULL` if the
+ * module needs to be loaded by the caller instead.
+ */
+static struct audio_stream *audio_prefetch_take(const char *filename)
+{
+  struct prefetch_entry *entry;
+  struct audio_stream *a_src = NULL;
+
+  if(!prefetch.running)
+    return NULL;
+
+  platform_mutex_lock(&prefetch.lock);
+
+  entry = audio_prefetch_find(filename);
+  if(entry)
+  {
+    while(entry->state == PREFETCH_LOADING)
+      platform_cond_wait(&prefetch.ready_cond, &prefetch.lock);
+
+    // Queued entries haven't been started; loading here is faster.
+    if(entry->state == PREFETCH_READY)
+      a_src = entry->a_src;
+
+    entry->a_src = NULL;
+    entry->state = PREFETCH_EMPTY;
+  }
+
+  platform_mutex_unlock(&prefetch.lock);
+  return a_src;
+}
+
+static void init_audio_prefetch(struct config_info *conf)
+{
+  memset(&prefetch, 0, sizeof(struct audio_prefetch));
+  prefetch.num_entries = MIN(conf->module_prefetch, MAX_PREFETCH_MODULES);
+
+  if(prefetch.num_entries > 0)
+  {
+    platform_mutex_init(&prefetch.lock);
+    platform_cond_init(&prefetch.cond);
+    platform_cond_init(&prefetch.ready_cond);
+
+    if(platform_thread_create(&prefetch.thread, audio_prefetch_thread, NULL))
+    {
+      prefetch.running = true;
+    }
+    else
+    {
+      warn("Failed to start module prefetch thread.\n");
+      platform_cond_destroy(&prefetch.ready_cond);
+      platform_cond_destroy(&prefetch.cond);
+      platform_mutex_destroy(&prefetch.lock);
+    }
+  }
+}
+
+static void quit_audio_prefetch(void)
+{
+  int i;
+
+  if(prefetch.running)
+  {
+    platform_mutex_lock(&prefetch.lock);
+    prefetch.quit = true;
+    platform_cond_signal(&prefetch.cond);
+    platform_mutex_unlock(&prefetch.lock);
+
+    platform_thread_join(&prefetch.thread);
+    prefetch.running = false;
+
+    for(i = 0; i < prefetch.num_entries; i++)
+      audio_prefetch_destroy(prefetch.entries[i].a_src);
+
+    platform_cond_destroy(&prefetch.ready_cond);
+    platform_cond_destroy(&prefetch.cond);
+    platform_mutex_destroy(&prefetch.lock);
+  }
+}
+
+#endif /* AUDIO_PREFETCH */
+
+// Set when the mixer is driven directly instead of by a platform device.
+static boolean audio_offline = false;
+
+static void init_audio_common(struct config_info *conf)
 {
   platform_mutex_init(&audio.audio_mutex);
   platform_mutex_init(&audio.audio_sfx_mutex);
@@ -294,21 +555,62 @@ void init_audio(struct config_info *conf)
 
   audio_set_pcs_volume(conf->pc_speaker_volume);
 
+#ifdef AUDIO_PREFETCH
+  init_audio_prefetch(conf);
+#endif
+}
+
+void init_audio(struct config_info *conf)
+{
+  init_audio_common(conf);
   init_audio_platform(conf);
 }
 
+/**
+ * Initialize audio without opening an audio device. The caller is
+ * responsible for driving the mixer by calling audio_callback with
+ * buffers of up to `audio_buffer_samples` frames.
+ */
+void init_audio_offline(struct config_info *conf)
+{
+  init_audio_common(conf);
+
+  audio.buffer_samples = conf->audio_buffer_samples;
+  audio.mix_buffer = (int32_t *)cmalloc(audio.buffer_samples * 2 *
+   sizeof(int32_t));
+  audio_offline = true;
+}
+
 void quit_audio(void)
 {
-  // Signal the audio thread to stop and wait for it to release the lock.
-  quit_audio_platform();
+  if(audio_offline)
+  {
+    free(audio.mix_buffer);
+    audio.mix_buffer = NULL;
+    audio_offline = false;
+  }
+  else
+  {
+    // Signal the audio thread to stop and wait for it to release the lock.
+    quit_audio_platform();
+  }
+
+#ifdef AUDIO_PREFETCH
+  quit_audio_prefetch();
+#endif
 
   LOCK();
 
   audio_ext_free_registry();
   free(audio.pcs_stream);
+  quit_wav();
 
   UNLOCK();
 
+#ifdef CONFIG_VORBIS
+  quit_vorbis();
+#endif
+
 #ifdef DEBUG
   platform_mutex_destroy(&audio.audio_debug_mutex);
 #endif
@@ -345,12 +647,25 @@ int audio_play_module(char *filename, boolean safely, int volume)
 
   audio_end_module();
 
-  real_volume = volume_function(volume, audio.music_volume);
-  a_src = audio_ext_construct_stream(filename, 0, real_volume, 1);
+  real_volume = audio_get_real_volume(volume, audio.music_volume);
+
+#ifdef AUDIO_PREFETCH
+  a_src = audio.music_on ? audio_prefetch_take(filename) : NULL;
+  if(a_src)
+  {
+    if(a_src->set_volume)
+      a_src->set_volume(a_src, real_volume);
+
+    attach_audio_stream(a_src);
+  }
+  else
+#endif
+    a_src = audio_ext_construct_stream(filename, 0, real_volume, 1);
 
   LOCK();
 
   audio.primary_stream = a_src;
+  audio_remove_sample(a_src);
 
   UNLOCK();
   return 1;
@@ -387,6 +702,73 @@ void audio_end_module(void)
   }
 }
 
+/**
+ * Request a module to be loaded in the background so it can be played
+ * without loading it on the game thread. The filename should already be
+ * translated. If the cache is full, the least recently requested module
+ * that isn't currently loading is discarded.
+ */
+void audio_prefetch_module(const char *filename)
+{
+#ifdef AUDIO_PREFETCH
+  struct prefetch_entry *entry;
+  struct audio_stream *old_src = NULL;
+  int i;
+
+  if(!prefetch.running || !audio.music_on || !filename[0])
+    return;
+
+  platform_mutex_lock(&prefetch.lock);
+
+  entry = audio_prefetch_find(filename);
+  if(!entry)
+  {
+    for(i = 0; i < prefetch.num_entries; i++)
+    {
+      struct prefetch_entry *current = &(prefetch.entries[i]);
+
+      if(current->state == PREFETCH_EMPTY)
+      {
+        entry = current;
+        break;
+      }
+
+      if(current->state != PREFETCH_LOADING &&
+       (!entry || current->last_used < entry->last_used))
+        entry = current;
+    }
+
+    if(entry)
+    {
+      old_src = entry->a_src;
+      snprintf(entry->filename, MAX_PATH, "%s", filename);
+      entry->a_src = NULL;
+      entry->state = PREFETCH_QUEUED;
+      platform_cond_signal(&prefetch.cond);
+    }
+  }
+
+  if(entry)
+    entry->last_used = ++prefetch.clock;
+
+  platform_mutex_unlock(&prefetch.lock);
+
+  audio_prefetch_destroy(old_src);
+#endif
+}
+
+/**
+ * Get the maximum number of modules that can be prefetched at once.
+ */
+int audio_get_module_prefetch(void)
+{
+#ifdef AUDIO_PREFETCH
+  if(prefetch.running)
+    return prefetch.num_entries;
+#endif
+  return 0;
+}
+
 void audio_set_max_samples(int max_samples)
 {
   // -1 is unlimited
@@ -399,6 +781,7 @@ void audio_set_max_samples(int max_samples)
   }
 
   audio.max_simultaneous_samples = max_samples;
+  wav_set_max_samples(max_samples);
 }
 
 int audio_get_max_samples(void)
@@ -408,48 +791,17 @@ int audio_get_max_samples(void)
 
 static void limit_samples(int max)
 {
-  int samples_playing = 0;
-  int cancel_num = 0;
-  struct audio_stream *current_astream;
-  struct audio_stream *next_astream;
-
   // Don't limit samples if the max samples setting is -1.
   if(max < 0)
     return;
 
   LOCK();
 
-  current_astream = audio.stream_list_base;
-  while(current_astream)
+  // Stop the oldest samples first.
+  while(audio.num_samples > max && audio.sample_list_base)
   {
-    next_astream = current_astream->next;
-
-    if((current_astream != audio.primary_stream) &&
-     (current_astream != (struct audio_stream *)(audio.pcs_stream)))
-    {
-      samples_playing++;
-    }
-
-    current_astream = next_astream;
-  }
-
-  cancel_num = samples_playing - max;
-  if(cancel_num > 0)
-  {
-    current_astream = audio.stream_list_base;
-    while(current_astream && cancel_num > 0)
-    {
-      next_astream = current_astream->next;
-
-      if((current_astream != audio.primary_stream) &&
-       (current_astream != (struct audio_stream *)(audio.pcs_stream)))
-      {
-        current_astream->destruct(current_astream);
-        cancel_num--;
-      }
-
-      current_astream = next_astream;
-    }
+    struct audio_stream *a_src = audio.sample_list_base;
+    a_src->destruct(a_src);
   }
 
   UNLOCK();
@@ -457,7 +809,7 @@ static void limit_samples(int max)
 
 void audio_play_sample(char *filename, boolean safely, int period)
 {
-  unsigned int vol = volume_function(255, audio.sound_volume);
+  unsigned int vol = audio_get_real_volume(255, audio.sound_volume);
   char translated_filename[MAX_PATH];
 
   if(safely)
@@ -501,7 +853,7 @@ void audio_spot_sample(int period, int which)
   // Play a sample from the current playing mod.
   // Currently only works with libxmp (and maybe only ever will).
 
-  unsigned int vol = volume_function(255, audio.sound_volume);
+  unsigned int vol = audio_get_real_volume(255, audio.sound_volume);
   struct wav_info wav;
   boolean ret = false;
 
@@ -523,7 +875,11 @@ void audio_spot_sample(int period, int which)
      */
     struct audio_stream *a_src = construct_wav_stream_direct(&wav,
      audio_get_real_frequency(period * 2), vol, !!(wav.loop_end));
-    a_src->is_spot_sample = true;
+    if(a_src)
+    {
+      a_src->is_spot_sample = true;
+      attach_audio_stream(a_src);
+    }
 
     limit_samples(audio.max_simultaneous_samples);
   }
@@ -532,26 +888,13 @@ void audio_spot_sample(int period, int which)
 void audio_end_sample(void)
 {
   // Destroy all samples - something is a sample if it's not a
-  // primary or PC speaker stream. This is a bit of a dirty way
-  // to do it though (might want to keep multiple lists instead)
-
-  struct audio_stream *current_astream;
-  struct audio_stream *next_astream;
-
+  // primary or PC speaker stream.
   LOCK();
 
-  current_astream = audio.stream_list_base;
-  while(current_astream)
+  while(audio.sample_list_base)
   {
-    next_astream = current_astream->next;
-
-    if((current_astream != audio.primary_stream) &&
-     (current_astream != (struct audio_stream *)(audio.pcs_stream)))
-    {
-      current_astream->destruct(current_astream);
-    }
-
-    current_astream = next_astream;
+    struct audio_stream *a_src = audio.sample_list_base;
+    a_src->destruct(a_src);
   }
 
   UNLOCK();
@@ -586,7 +929,7 @@ int audio_get_module_order(void)
 
 void audio_set_module_volume(int volume)
 {
-  int real_volume = volume_function(volume, audio.music_volume);
+  int real_volume = audio_get_real_volume(volume, audio.music_volume);
 
   LOCK();
 
@@ -786,7 +1129,7 @@ void audio_set_sound_volume(int volume)
   LOCK();
 
   audio.sound_volume = volume;
-  real_volume = volume_function(255, audio.sound_volume);
+  real_volume = audio_get_real_volume(255, audio.sound_volume);
 
   current_astream = audio.stream_list_base;
   while(current_astream)
@@ -810,7 +1153,7 @@ void audio_set_pcs_volume(int volume)
   LOCK();
 
   audio.pcs_volume = volume;
-  real_volume = volume_function(255, audio.pcs_volume);
+  real_volume = audio_get_real_volume(255, audio.pcs_volume);
 
   if(audio.pcs_stream)
     audio.pcs_stream->set_volume(audio.pcs_stream, real_volume);
@@ -39,9 +39,12 @@ struct audio_stream;
 struct audio_stream_spec;
 
 CORE_LIBSPEC void init_audio(struct config_info *conf);
+CORE_LIBSPEC void init_audio_offline(struct config_info *conf);
 CORE_LIBSPEC void quit_audio(void);
 CORE_LIBSPEC int audio_play_module(char *filename, boolean safely, int volume);
 CORE_LIBSPEC void audio_end_module(void);
+CORE_LIBSPEC void audio_prefetch_module(const char *filename);
+CORE_LIBSPEC int audio_get_module_prefetch(void);
 CORE_LIBSPEC void audio_play_sample(char *filename, boolean safely, int period);
 CORE_LIBSPEC void audio_spot_sample(int period, int which);
 
@@ -77,6 +80,9 @@ int audio_legacy_translate(const char *path, char *newpath, size_t buffer_len);
 
 // Internal functions
 int audio_get_real_frequency(int period);
+unsigned int audio_get_real_volume(int input, int volume_setting);
+void attach_audio_stream(struct audio_stream *a_src);
+void detach_audio_stream(struct audio_stream *a_src);
 void destruct_audio_stream(struct audio_stream *a_src);
 void initialize_audio_stream(struct audio_stream *a_src,
  struct audio_stream_spec *a_spec, unsigned int volume, boolean repeat);
@@ -93,6 +99,8 @@ static inline void quit_audio(void) {}
 static inline int audio_play_module(char *filename, boolean safely, int volume)
  { return 1; }
 static inline void audio_end_module(void) {}
+static inline void audio_prefetch_module(const char *filename) {}
+static inline int audio_get_module_prefetch(void) { return 0; }
 static inline void audio_play_sample(char *filename, boolean safely, int period)
  {}
 static inline void audio_spot_sample(int period, int which) {}
@@ -381,7 +381,7 @@ void init_mikmod(struct config_info *conf)
 
   if(MikMod_Init(NULL) == 0)
   {
-    audio_ext_register(NULL, construct_mikmod_stream);
+    audio_ext_register("mikmod", NULL, construct_mikmod_stream);
   }
   else
     warn("MikMod Init failed: %s\n", MikMod_strerror(MikMod_errno));
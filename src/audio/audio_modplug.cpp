@@ -281,5 +281,5 @@ static struct audio_stream *construct_modplug_stream(vfile *vf,
 
 void init_modplug(struct config_info *conf)
 {
-  audio_ext_register(NULL, construct_modplug_stream);
+  audio_ext_register("modplug", NULL, construct_modplug_stream);
 }
@@ -331,5 +331,6 @@ static boolean test_openmpt_stream(vfile *vf, const char *filename)
 
 void init_openmpt(struct config_info *conf)
 {
-  audio_ext_register(test_openmpt_stream, construct_openmpt_stream);
+  audio_ext_register("openmpt", test_openmpt_stream,
+   construct_openmpt_stream);
 }
@@ -192,4 +192,20 @@ static struct audio_stream *construct_pc_speaker_stream(void)
 void init_pc_speaker(struct config_info *conf)
 {
   audio.pcs_stream = construct_pc_speaker_stream();
+  attach_audio_stream(audio.pcs_stream);
+}
+
+/**
+ * Determine if the PC speaker is still producing sound. This includes the
+ * remainder of a note that has already been removed from the sfx queue.
+ */
+boolean audio_pcs_is_playing(void)
+{
+  struct pc_speaker_stream *pcs_stream =
+   (struct pc_speaker_stream *)audio.pcs_stream;
+
+  if(sfx_is_playing())
+    return true;
+
+  return pcs_stream && pcs_stream->last_playing && pcs_stream->last_duration;
 }
@@ -27,6 +27,7 @@
 __M_BEGIN_DECLS
 
 void init_pc_speaker(struct config_info *conf);
+boolean audio_pcs_is_playing(void);
 
 __M_END_DECLS
 
@@ -298,5 +298,5 @@ static boolean test_rad_stream(vfile *vf, const char *filename)
 
 void init_reality(struct config_info *conf)
 {
-  audio_ext_register(test_rad_stream, construct_rad_stream);
+  audio_ext_register("rad", test_rad_stream, construct_rad_stream);
 }
@@ -0,0 +1,383 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Offline audio renderer. This drives audio_callback in a loop without an
+ * audio device and writes the output to a 16-bit stereo WAV file as fast as
+ * the mixer can produce it. The time spent in each stream's mixer is tracked
+ * per audio engine so the engines and resampling modes can be benchmarked,
+ * and the CRC-32 of the output allows it to be compared against known-good
+ * renders.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+#include "audio.h"
+#include "audio_pcs.h"
+#include "audio_render.h"
+#include "audio_struct.h"
+#include "ext.h"
+#include "sfx.h"
+
+#include "../configure.h"
+#include "../platform.h"
+#include "../util.h"
+#include "../io/vio.h"
+
+#define MAX_RENDER_ENGINES 16
+
+// Keep the RIFF and data chunk lengths within 32 bits.
+#define MAX_RENDER_FRAMES ((UINT32_MAX - 36) / 4)
+
+typedef boolean (*mix_data_fn)(struct audio_stream *a_src,
+ int32_t * RESTRICT buffer, size_t dest_frames, unsigned int dest_channels);
+
+struct render_engine
+{
+  const char *name;
+  uint64_t mix_time;
+  unsigned int num_streams;
+};
+
+struct render_stream
+{
+  struct audio_stream *a_src;
+  mix_data_fn mix_data;
+  struct render_engine *engine;
+};
+
+static struct render_engine render_engines[MAX_RENDER_ENGINES];
+static struct render_stream *render_streams;
+static size_t num_render_engines;
+static size_t num_render_streams;
+static size_t render_streams_alloc;
+
+/**
+ * Get a monotonic timestamp in nanoseconds. get_ticks() only has millisecond
+ * precision, which is too coarse to time individual mixer calls.
+ */
+static uint64_t render_time(void)
+{
+#if !defined(_WIN32) && defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && \
+ defined(CLOCK_MONOTONIC)
+  struct timespec tp;
+
+  if(!clock_gettime(CLOCK_MONOTONIC, &tp))
+    return (uint64_t)tp.tv_sec * 1000000000 + tp.tv_nsec;
+#endif
+  return get_ticks() * 1000000;
+}
+
+static struct render_stream *render_find_stream(struct audio_stream *a_src)
+{
+  size_t i;
+
+  for(i = 0; i < num_render_streams; i++)
+    if(render_streams[i].a_src == a_src)
+      return &(render_streams[i]);
+
+  return NULL;
+}
+
+/**
+ * Replacement mix_data function for tracked streams that times the stream's
+ * real mixer and charges the time to its engine.
+ */
+static boolean render_mix_data(struct audio_stream *a_src,
+ int32_t * RESTRICT buffer, size_t dest_frames, unsigned int dest_channels)
+{
+  struct render_stream *rs = render_find_stream(a_src);
+  uint64_t start;
+  boolean ret;
+
+  assert(rs);
+  start = render_time();
+  ret = rs->mix_data(a_src, buffer, dest_frames, dest_channels);
+  rs->engine->mix_time += render_time() - start;
+  return ret;
+}
+
+static boolean render_track_stream(struct audio_stream *a_src,
+ const char *engine_name)
+{
+  struct render_engine *engine = NULL;
+  struct render_stream *rs;
+  size_t i;
+
+  for(i = 0; i < num_render_engines; i++)
+  {
+    if(!strcmp(render_engines[i].name, engine_name))
+    {
+      engine = &(render_engines[i]);
+      break;
+    }
+  }
+
+  if(!engine)
+  {
+    if(num_render_engines >= MAX_RENDER_ENGINES)
+      return false;
+
+    engine = &(render_engines[num_render_engines++]);
+    engine->name = engine_name;
+    engine->mix_time = 0;
+    engine->num_streams = 0;
+  }
+
+  if(num_render_streams >= render_streams_alloc)
+  {
+    size_t new_alloc = render_streams_alloc ? render_streams_alloc * 2 : 8;
+    struct render_stream *tmp = (struct render_stream *)realloc(
+     render_streams, new_alloc * sizeof(struct render_stream));
+
+    if(!tmp)
+      return false;
+
+    render_streams = tmp;
+    render_streams_alloc = new_alloc;
+  }
+
+  rs = &(render_streams[num_render_streams++]);
+  rs->a_src = a_src;
+  rs->mix_data = a_src->mix_data;
+  rs->engine = engine;
+  engine->num_streams++;
+
+  a_src->mix_data = render_mix_data;
+  return true;
+}
+
+static struct audio_stream *render_load(const char *filename,
+ unsigned int volume)
+{
+  struct audio_stream *a_src;
+  const char *engine_name = NULL;
+
+  // Streams never repeat so the render ends when their data runs out.
+  a_src = audio_ext_construct_stream_ext(filename, 0, volume, false,
+   &engine_name);
+
+  if(!a_src)
+  {
+    warn("Render: failed to load '%s'\n", filename);
+    return NULL;
+  }
+
+  if(!render_track_stream(a_src, engine_name))
+    warn("Render: failed to track '%s' (%s)\n", filename, engine_name);
+
+  return a_src;
+}
+
+static boolean render_is_playing(boolean sfx)
+{
+  struct audio_stream *a_src;
+
+  if(sfx && audio_pcs_is_playing())
+    return true;
+
+  for(a_src = audio.stream_list_base; a_src; a_src = a_src->next)
+    if(a_src != audio.pcs_stream)
+      return true;
+
+  return false;
+}
+
+static void render_write_header(vfile *vf, uint32_t frequency,
+ uint32_t data_length)
+{
+  vfwrite("RIFF", 4, 1, vf);
+  vfputd(data_length + 36, vf);
+  vfwrite("WAVE", 4, 1, vf);
+
+  vfwrite("fmt ", 4, 1, vf);
+  vfputd(16, vf);
+  vfputw(1, vf); // PCM
+  vfputw(2, vf); // channels
+  vfputd(frequency, vf);
+  vfputd(frequency * 4, vf);
+  vfputw(4, vf); // block align
+  vfputw(16, vf); // bits per sample
+
+  vfwrite("data", 4, 1, vf);
+  vfputd(data_length, vf);
+}
+
+/**
+ * Convert mixer output to little endian PCM. The CRC is calculated from the
+ * converted data so it is the same on every platform.
+ */
+static void render_convert(uint8_t *dest, const int16_t *src, size_t len)
+{
+  size_t i;
+
+  for(i = 0; i < len; i++)
+  {
+    uint16_t value = (uint16_t)src[i];
+    dest[0] = value & 0xFF;
+    dest[1] = value >> 8;
+    dest += 2;
+  }
+}
+
+static void render_report(uint64_t frames, uint64_t mix_time, uint32_t crc)
+{
+  double seconds = (double)frames / audio.output_frequency;
+  double mix_seconds = mix_time / 1000000000.0;
+  size_t i;
+
+  info("Render: %.2fs of audio mixed in %.3fs (%.1fx realtime)\n",
+   seconds, mix_seconds, mix_seconds > 0.0 ? seconds / mix_seconds : 0.0);
+
+  for(i = 0; i < num_render_engines; i++)
+  {
+    struct render_engine *engine = &(render_engines[i]);
+    double engine_seconds = engine->mix_time / 1000000000.0;
+
+    info("Render:   %-8s %u stream(s), %.3fs (%.1fx realtime)\n",
+     engine->name, engine->num_streams, engine_seconds,
+     engine_seconds > 0.0 ? seconds / engine_seconds : 0.0);
+  }
+
+  info("Render: CRC-32 %08x\n", (unsigned int)crc);
+}
+
+/**
+ * Render the module, samples, and/or sfx string in the configuration to
+ * the WAV file `audio_render_file`. Returns `false` on error.
+ */
+boolean audio_render(struct config_info *conf)
+{
+  boolean has_sfx = conf->audio_render_sfx[0] != '\0';
+  boolean ret = false;
+  uint64_t max_frames;
+  uint64_t total_frames = 0;
+  uint64_t mix_time = 0;
+  uint32_t crc = crc32(0L, Z_NULL, 0);
+  int16_t *buffer = NULL;
+  uint8_t *out = NULL;
+  vfile *vf;
+  size_t i;
+
+  // Decoding ahead on a separate thread would make the output depend on
+  // thread timing. Mixing everything in the render loop is deterministic.
+  conf->vorbis_decode_ahead = 0;
+
+  init_audio_offline(conf);
+
+  vf = vfopen_unsafe(conf->audio_render_file, "wb");
+  if(!vf)
+  {
+    warn("Render: failed to open '%s'\n", conf->audio_render_file);
+    goto err_quit;
+  }
+
+  buffer = (int16_t *)cmalloc(audio.buffer_samples * 2 * sizeof(int16_t));
+  out = (uint8_t *)cmalloc(audio.buffer_samples * 2 * sizeof(int16_t));
+
+  if(conf->audio_render_module[0])
+  {
+    struct audio_stream *a_src = render_load(conf->audio_render_module,
+     audio_get_real_volume(255, audio.music_volume));
+    if(!a_src)
+      goto err_close;
+
+    audio.primary_stream = a_src;
+  }
+
+  if(conf->audio_render_sample[0])
+  {
+    unsigned int volume = audio_get_real_volume(255, audio.sound_volume);
+
+    for(i = 0; i < (size_t)conf->audio_render_sample_count; i++)
+      if(!render_load(conf->audio_render_sample, volume))
+        goto err_close;
+  }
+
+  if(has_sfx)
+  {
+    play_string(conf->audio_render_sfx, 0);
+    render_track_stream(audio.pcs_stream, "pcs");
+  }
+
+  if(!render_is_playing(has_sfx))
+  {
+    warn("Render: nothing to render\n");
+    goto err_close;
+  }
+
+  max_frames = (uint64_t)conf->audio_render_length * audio.output_frequency;
+  max_frames = MIN(max_frames, MAX_RENDER_FRAMES);
+
+  // Reserve space for the header; it is written once the length is known.
+  render_write_header(vf, audio.output_frequency, 0);
+
+  while(total_frames < max_frames && render_is_playing(has_sfx))
+  {
+    size_t frames = MIN(audio.buffer_samples, max_frames - total_frames);
+    size_t bytes = frames * 2 * sizeof(int16_t);
+    uint64_t start = render_time();
+
+    audio_callback(buffer, bytes);
+    mix_time += render_time() - start;
+
+    render_convert(out, buffer, frames * 2);
+    crc = crc32(crc, out, bytes);
+
+    if(vfwrite(out, bytes, 1, vf) != 1)
+    {
+      warn("Render: failed to write '%s'\n", conf->audio_render_file);
+      goto err_close;
+    }
+    total_frames += frames;
+  }
+
+  vrewind(vf);
+  render_write_header(vf, audio.output_frequency,
+   (uint32_t)(total_frames * 2 * sizeof(int16_t)));
+
+  render_report(total_frames, mix_time, crc);
+  ret = true;
+
+err_close:
+  vfclose(vf);
+
+err_quit:
+  audio_end_module();
+  audio_end_sample();
+  sfx_clear_queue();
+  quit_audio();
+
+  free(buffer);
+  free(out);
+  free(render_streams);
+  render_streams = NULL;
+  num_render_streams = 0;
+  render_streams_alloc = 0;
+  num_render_engines = 0;
+  return ret;
+}
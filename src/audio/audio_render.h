@@ -0,0 +1,45 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __AUDIO_RENDER_H
+#define __AUDIO_RENDER_H
+
+#include "../compat.h"
+
+__M_BEGIN_DECLS
+
+struct config_info;
+
+// NDS uses hardware mixing and doesn't have a software mixer to drive.
+#if defined(CONFIG_AUDIO) && !defined(CONFIG_NDS)
+
+CORE_LIBSPEC boolean audio_render(struct config_info *conf);
+
+#else
+
+static inline boolean audio_render(struct config_info *conf)
+{
+  return false;
+}
+
+#endif
+
+__M_END_DECLS
+
+#endif /* __AUDIO_RENDER_H */
@@ -61,7 +61,10 @@ struct audio_stream
 {
   struct audio_stream *next;
   struct audio_stream *previous;
+  struct audio_stream *next_sample;
+  struct audio_stream *previous_sample;
   unsigned int volume;
+  boolean is_sample;
   boolean is_spot_sample;
   boolean repeat;
   boolean   (* mix_data)(struct audio_stream *a_src, int32_t * RESTRICT buffer,
@@ -117,6 +120,11 @@ struct audio
   struct audio_stream *stream_list_base;
   struct audio_stream *stream_list_end;
 
+  // Every stream that isn't the primary or PC speaker stream, oldest first.
+  struct audio_stream *sample_list_base;
+  struct audio_stream *sample_list_end;
+  int num_samples;
+
   platform_mutex audio_mutex;
   platform_mutex audio_sfx_mutex;
 #ifdef DEBUG
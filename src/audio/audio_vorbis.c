@@ -29,6 +29,7 @@
 #include "ext.h"
 #include "sampled_stream.h"
 
+#include "../util.h"
 #include "../io/vio.h"
 
 #ifdef CONFIG_TREMOR
@@ -52,88 +53,541 @@ static const int ENDIAN_PACKING = 0;
 #endif
 #endif // !CONFIG_TREMOR
 
+/**
+ * If threads are available, Vorbis streams are decoded ahead of time by a
+ * single background thread into a ring buffer per stream. The audio callback
+ * only copies PCM out of the ring, so slow decodes and file reads can't cause
+ * underruns. The ring is refilled to a watermark configured by the option
+ * vorbis_decode_ahead (in frames, 0 disables the decoder thread).
+ *
+ * Locking order: audio lock -> stream file_lock -> vorbis_decoder.lock.
+ * The decoder thread never takes the audio lock. The file lock protects the
+ * OggVorbis_File; the decoder lock protects the rings, the loop points and
+ * repeat flag of ring streams, and the decoder's list of streams.
+ *
+ * Seeking or changing the loop points or repeat flag of a ring stream only
+ * flushes its ring and leaves a pending seek for the decoder thread, and the
+ * position of a ring stream is taken from the ring. Callers hold the audio
+ * lock, so they must never wait for the file lock.
+ */
+#ifndef PLATFORM_NO_THREADING
+#define VORBIS_DECODE_AHEAD
+#endif
+
+#ifdef VORBIS_DECODE_AHEAD
+
+#define VORBIS_DECODE_CHUNK   4096
+#define VORBIS_MAX_SEGMENTS   64
+
+/**
+ * A contiguous run of decoded PCM in the ring, used to track the real playback
+ * position across loop points.
+ */
+struct vorbis_segment
+{
+  uint32_t pos;
+  uint32_t length;
+  uint32_t offset;
+};
+
+struct vorbis_ring
+{
+  char *data;
+  int64_t seek_pos;
+  int64_t play_pos;
+  unsigned int generation;
+  size_t size;
+  size_t watermark;
+  size_t read_pos;
+  size_t write_pos;
+  size_t fill;
+  struct vorbis_segment segments[VORBIS_MAX_SEGMENTS];
+  unsigned int segment_start;
+  unsigned int num_segments;
+  unsigned int zero_reads;
+  boolean is_decoding;
+  boolean is_eof;
+};
+
+static struct vorbis_decoder
+{
+  platform_mutex lock;
+  platform_cond cond;
+  platform_cond idle_cond;
+  platform_thread thread;
+  struct vorbis_stream *streams;
+  size_t decode_ahead;
+  boolean running;
+  boolean quit;
+} vorbis_decoder;
+
+#endif /* VORBIS_DECODE_AHEAD */
+
+struct vorbis_loop
+{
+  uint32_t start;
+  uint32_t end;
+  boolean repeat;
+};
+
 struct vorbis_stream
 {
   struct sampled_stream s;
   OggVorbis_File vorbis_file_handle;
   vorbis_info *vorbis_file_info;
   vfile *input_file;
+  uint32_t length;
   uint32_t loop_start;
   uint32_t loop_end;
+#ifdef VORBIS_DECODE_AHEAD
+  platform_mutex file_lock;
+  struct vorbis_ring ring;
+  struct vorbis_stream *next_decode;
+  boolean use_ring;
+#endif
 };
 
-static boolean vorbis_mix_data(struct audio_stream *a_src,
- int32_t * RESTRICT buffer, size_t frames, unsigned int channels)
+/**
+ * Decode a single contiguous run of PCM into the destination, handling loop
+ * points and repeat. If the end of a non-repeating stream is reached, is_eof
+ * will be set. If threaded decoding is enabled, the file lock must be held.
+ */
+static uint32_t vorbis_decode(struct vorbis_stream *v_stream, char *dest,
+ uint32_t wanted, const struct vorbis_loop *loop, uint32_t *start_pos,
+ boolean *is_eof)
 {
-  uint32_t read_len = 0;
-  struct vorbis_stream *v_stream = (struct vorbis_stream *)a_src;
-  uint32_t read_wanted = v_stream->s.allocated_data_length -
-   v_stream->s.stream_offset;
-  uint32_t pos = 0;
-  char *read_buffer = (char *)v_stream->s.output_data +
-   v_stream->s.stream_offset;
+  size_t frame_size = v_stream->s.channels * sizeof(int16_t);
+  uint32_t pos = (uint32_t)ov_pcm_tell(&v_stream->vorbis_file_handle);
   int current_section;
+  long read_len;
 
-  do
-  {
-    read_wanted -= read_len;
-
-    if(a_src->repeat && v_stream->loop_end)
-      pos = (uint32_t)ov_pcm_tell(&v_stream->vorbis_file_handle);
+  *start_pos = pos;
+  *is_eof = false;
 
 #ifdef CONFIG_TREMOR
-    read_len =
-     ov_read(&(v_stream->vorbis_file_handle), read_buffer,
-     read_wanted, &current_section);
+  read_len =
+   ov_read(&(v_stream->vorbis_file_handle), dest, wanted, &current_section);
 #else
-    read_len =
-     ov_read(&(v_stream->vorbis_file_handle), read_buffer,
-     read_wanted, ENDIAN_PACKING, sizeof(int16_t), 1, &current_section);
+  read_len =
+   ov_read(&(v_stream->vorbis_file_handle), dest,
+   wanted, ENDIAN_PACKING, sizeof(int16_t), 1, &current_section);
 #endif
 
-    if(a_src->repeat && (pos < v_stream->loop_end) &&
-     (pos + read_len / v_stream->s.channels / sizeof(int16_t) >= v_stream->loop_end))
+  if(read_len < 0)
+    read_len = 0;
+
+  if(loop->repeat && (pos < loop->end) &&
+   (pos + read_len / frame_size >= loop->end))
+  {
+    read_len = (loop->end - pos) * frame_size;
+    ov_pcm_seek(&(v_stream->vorbis_file_handle), loop->start);
+  }
+
+  // If it hit the end go back to the beginning if repeat is on
+  if(read_len == 0)
+  {
+    if(loop->repeat)
+      ov_raw_seek(&(v_stream->vorbis_file_handle), 0);
+    else
+      *is_eof = true;
+  }
+  return read_len;
+}
+
+/**
+ * Fill the destination directly from the decoder. Returns true if the stream
+ * has ended.
+ */
+static boolean vorbis_read_direct(struct vorbis_stream *v_stream,
+ char *dest, uint32_t wanted)
+{
+  struct vorbis_loop loop;
+  unsigned int zero_reads = 0;
+  uint32_t pos;
+  boolean is_eof;
+
+  loop.start = v_stream->loop_start;
+  loop.end = v_stream->loop_end;
+  loop.repeat = v_stream->s.a.repeat;
+
+  while(wanted)
+  {
+    uint32_t read_len = vorbis_decode(v_stream, dest, wanted, &loop, &pos,
+     &is_eof);
+    if(!read_len)
     {
-      read_len = (v_stream->loop_end - pos) * v_stream->s.channels * sizeof(int16_t);
-      ov_pcm_seek(&(v_stream->vorbis_file_handle), v_stream->loop_start);
+      // Stop if this is the end, or if a repeating stream is empty.
+      if(is_eof || ++zero_reads >= 2)
+      {
+        memset(dest, 0, wanted);
+        return true;
+      }
+      continue;
     }
+    zero_reads = 0;
+    dest += read_len;
+    wanted -= read_len;
+  }
+  return false;
+}
+
+#ifdef VORBIS_DECODE_AHEAD
+
+static void vorbis_ring_init(struct vorbis_stream *v_stream)
+{
+  struct vorbis_ring *ring = &(v_stream->ring);
+  size_t frame_size = v_stream->s.channels * sizeof(int16_t);
+  size_t watermark = vorbis_decoder.decode_ahead * frame_size;
+
+  // Always keep at least two mixes worth of data ahead.
+  if(watermark < v_stream->s.allocated_data_length * 2)
+    watermark = v_stream->s.allocated_data_length * 2;
+
+  memset(ring, 0, sizeof(struct vorbis_ring));
+  ring->seek_pos = -1;
+  ring->play_pos = -1;
+  ring->watermark = watermark;
+  ring->size = watermark + VORBIS_DECODE_CHUNK;
+  ring->size -= ring->size % frame_size;
+  ring->data = (char *)cmalloc(ring->size);
+}
+
+/**
+ * Determine how much data can be decoded into the ring in one step.
+ * The decoder lock must be held.
+ */
+static size_t vorbis_ring_space(struct vorbis_stream *v_stream)
+{
+  struct vorbis_ring *ring = &(v_stream->ring);
+  size_t frame_size = v_stream->s.channels * sizeof(int16_t);
+  size_t space;
+
+  if(ring->is_eof || ring->fill >= ring->watermark ||
+   ring->num_segments >= VORBIS_MAX_SEGMENTS)
+    return 0;
+
+  if(ring->fill && ring->write_pos <= ring->read_pos)
+    space = ring->read_pos - ring->write_pos;
+  else
+    space = ring->size - ring->write_pos;
+
+  if(space > VORBIS_DECODE_CHUNK)
+    space = VORBIS_DECODE_CHUNK;
+
+  return space - (space % frame_size);
+}
+
+/**
+ * Decode one chunk into the ring, performing any pending seek first. The file
+ * lock must be held and the decoder lock must not be held.
+ */
+static void vorbis_ring_decode(struct vorbis_stream *v_stream)
+{
+  struct vorbis_ring *ring = &(v_stream->ring);
+  size_t frame_size = v_stream->s.channels * sizeof(int16_t);
+  struct vorbis_loop loop;
+  unsigned int generation;
+  int64_t seek_pos;
+  uint32_t read_len;
+  uint32_t pos;
+  boolean is_eof;
+  size_t space;
+  char *dest;
+
+  platform_mutex_lock(&vorbis_decoder.lock);
+  seek_pos = ring->seek_pos;
+  ring->seek_pos = -1;
+  generation = ring->generation;
+  loop.start = v_stream->loop_start;
+  loop.end = v_stream->loop_end;
+  loop.repeat = v_stream->s.a.repeat;
+  space = vorbis_ring_space(v_stream);
+  dest = ring->data + ring->write_pos;
+  platform_mutex_unlock(&vorbis_decoder.lock);
+
+  if(seek_pos >= 0)
+    ov_pcm_seek(&(v_stream->vorbis_file_handle), (ogg_int64_t)seek_pos);
+
+  if(!space)
+    return;
+
+  // Only the free area of the ring is written to here, so this is safe.
+  read_len = vorbis_decode(v_stream, dest, space, &loop, &pos, &is_eof);
 
-    // If it hit the end go back to the beginning if repeat is on
+  platform_mutex_lock(&vorbis_decoder.lock);
+  if(generation != ring->generation)
+  {
+    // The ring was flushed while this was being decoded, so this data is
+    // stale. If the flush didn't pick a position, resume from this chunk.
+    if(ring->seek_pos < 0)
+      ring->seek_pos = pos;
+  }
+  else
 
-    if(read_len == 0)
+  if(read_len)
+  {
+    struct vorbis_segment *last = NULL;
+    if(ring->num_segments)
     {
-      if(a_src->repeat)
-      {
-        ov_raw_seek(&(v_stream->vorbis_file_handle), 0);
+      unsigned int last_idx =
+       (ring->segment_start + ring->num_segments - 1) % VORBIS_MAX_SEGMENTS;
+      last = &(ring->segments[last_idx]);
+    }
 
-        if(read_wanted)
-        {
-#ifdef CONFIG_TREMOR
-          read_len =
-           ov_read(&(v_stream->vorbis_file_handle), read_buffer,
-           read_wanted, &current_section);
-#else
-          read_len =
-           ov_read(&(v_stream->vorbis_file_handle), read_buffer,
-           read_wanted, ENDIAN_PACKING, sizeof(int16_t), 1, &current_section);
-#endif
-        }
-      }
-      else
-      {
-        memset(read_buffer, 0, read_wanted);
-      }
+    if(last && last->pos + (last->offset + last->length) / frame_size == pos)
+    {
+      last->length += read_len;
+    }
+    else
+    {
+      unsigned int idx =
+       (ring->segment_start + ring->num_segments) % VORBIS_MAX_SEGMENTS;
+      ring->segments[idx].pos = pos;
+      ring->segments[idx].length = read_len;
+      ring->segments[idx].offset = 0;
+      ring->num_segments++;
     }
 
-    read_buffer += read_len;
-  } while((read_len < read_wanted) && read_len);
+    ring->write_pos = (ring->write_pos + read_len) % ring->size;
+    ring->fill += read_len;
+    ring->zero_reads = 0;
+  }
+  else
 
-  sampled_mix_data((struct sampled_stream *)v_stream, buffer, frames, channels);
+  // Stop if this is the end, or if a repeating stream is empty.
+  if(is_eof || ++ring->zero_reads >= 2)
+    ring->is_eof = true;
 
-  if(read_len == 0)
-    return true;
+  platform_mutex_unlock(&vorbis_decoder.lock);
+}
 
-  return false;
+/**
+ * Synchronously decode enough data for the next mix. The file lock must be
+ * held and the decoder lock must not be held.
+ */
+static void vorbis_ring_prime(struct vorbis_stream *v_stream)
+{
+  struct vorbis_ring *ring = &(v_stream->ring);
+  size_t target = v_stream->s.allocated_data_length;
+  boolean done = false;
+
+  while(!done)
+  {
+    vorbis_ring_decode(v_stream);
+
+    platform_mutex_lock(&vorbis_decoder.lock);
+    if(ring->fill >= target || !vorbis_ring_space(v_stream))
+      done = true;
+    platform_mutex_unlock(&vorbis_decoder.lock);
+  }
+}
+
+/**
+ * Get the position of the next frame to be read out of the ring, or -1 if
+ * the ring is empty. The decoder lock must be held.
+ */
+static int64_t vorbis_ring_position(struct vorbis_stream *v_stream)
+{
+  struct vorbis_ring *ring = &(v_stream->ring);
+  size_t frame_size = v_stream->s.channels * sizeof(int16_t);
+
+  if(ring->num_segments)
+  {
+    struct vorbis_segment *seg = &(ring->segments[ring->segment_start]);
+    return seg->pos + seg->offset / frame_size;
+  }
+  return -1;
+}
+
+/**
+ * Discard all decoded data after a seek, loop point change, or repeat change,
+ * and have the decoder thread seek to seek_pos before it decodes anything
+ * else. If seek_pos is negative, the decoder resumes right after the last
+ * frame that was played. The decoder lock must be held.
+ */
+static void vorbis_ring_flush(struct vorbis_stream *v_stream, int64_t seek_pos)
+{
+  struct vorbis_ring *ring = &(v_stream->ring);
+
+  if(seek_pos < 0)
+    seek_pos = ring->play_pos;
+  if(seek_pos < 0)
+    seek_pos = vorbis_ring_position(v_stream);
+  if(seek_pos < 0)
+    seek_pos = ring->seek_pos;
+
+  ring->seek_pos = seek_pos;
+  ring->play_pos = seek_pos;
+  ring->generation++;
+  ring->read_pos = 0;
+  ring->write_pos = 0;
+  ring->fill = 0;
+  ring->segment_start = 0;
+  ring->num_segments = 0;
+  ring->zero_reads = 0;
+  ring->is_eof = false;
+  platform_cond_signal(&vorbis_decoder.cond);
+}
+
+/**
+ * Copy decoded data out of the ring. The decoder lock must be held.
+ */
+static size_t vorbis_ring_read(struct vorbis_stream *v_stream, char *dest,
+ size_t wanted)
+{
+  struct vorbis_ring *ring = &(v_stream->ring);
+  size_t frame_size = v_stream->s.channels * sizeof(int16_t);
+  size_t total = 0;
+
+  while(wanted && ring->num_segments)
+  {
+    struct vorbis_segment *seg = &(ring->segments[ring->segment_start]);
+    size_t count = seg->length;
+    size_t span = ring->size - ring->read_pos;
+
+    if(count > wanted)
+      count = wanted;
+    if(count > span)
+      count = span;
+
+    memcpy(dest, ring->data + ring->read_pos, count);
+    ring->read_pos = (ring->read_pos + count) % ring->size;
+    ring->fill -= count;
+    seg->offset += count;
+    seg->length -= count;
+    ring->play_pos = seg->pos + seg->offset / frame_size;
+    if(!seg->length)
+    {
+      ring->segment_start = (ring->segment_start + 1) % VORBIS_MAX_SEGMENTS;
+      ring->num_segments--;
+    }
+
+    dest += count;
+    wanted -= count;
+    total += count;
+  }
+  return total;
+}
+
+/**
+ * Select the stream with the least data buffered that needs more data.
+ * The decoder lock must be held.
+ */
+static struct vorbis_stream *vorbis_decoder_next(void)
+{
+  struct vorbis_stream *current = vorbis_decoder.streams;
+  struct vorbis_stream *best = NULL;
+
+  while(current)
+  {
+    if(vorbis_ring_space(current) &&
+     (!best || current->ring.fill < best->ring.fill))
+      best = current;
+
+    current = current->next_decode;
+  }
+  return best;
+}
+
+static THREAD_RES vorbis_decoder_thread(void *opaque)
+{
+  platform_mutex_lock(&vorbis_decoder.lock);
+
+  while(!vorbis_decoder.quit)
+  {
+    struct vorbis_stream *v_stream = vorbis_decoder_next();
+    if(!v_stream)
+    {
+      platform_cond_wait(&vorbis_decoder.cond, &vorbis_decoder.lock);
+      continue;
+    }
+
+    // Prevents the stream from being destroyed while it's being decoded.
+    v_stream->ring.is_decoding = true;
+    platform_mutex_unlock(&vorbis_decoder.lock);
+
+    platform_mutex_lock(&v_stream->file_lock);
+    vorbis_ring_decode(v_stream);
+    platform_mutex_unlock(&v_stream->file_lock);
+
+    platform_mutex_lock(&vorbis_decoder.lock);
+    v_stream->ring.is_decoding = false;
+    platform_cond_broadcast(&vorbis_decoder.idle_cond);
+  }
+
+  platform_mutex_unlock(&vorbis_decoder.lock);
+  THREAD_RETURN;
+}
+
+static void vorbis_decoder_add(struct vorbis_stream *v_stream)
+{
+  platform_mutex_lock(&vorbis_decoder.lock);
+  v_stream->next_decode = vorbis_decoder.streams;
+  vorbis_decoder.streams = v_stream;
+  platform_cond_signal(&vorbis_decoder.cond);
+  platform_mutex_unlock(&vorbis_decoder.lock);
+}
+
+static void vorbis_decoder_remove(struct vorbis_stream *v_stream)
+{
+  struct vorbis_stream **prev = &(vorbis_decoder.streams);
+
+  platform_mutex_lock(&vorbis_decoder.lock);
+
+  while(*prev)
+  {
+    if(*prev == v_stream)
+    {
+      *prev = v_stream->next_decode;
+      break;
+    }
+    prev = &((*prev)->next_decode);
+  }
+
+  while(v_stream->ring.is_decoding)
+    platform_cond_wait(&vorbis_decoder.idle_cond, &vorbis_decoder.lock);
+
+  platform_mutex_unlock(&vorbis_decoder.lock);
+}
+
+#endif /* VORBIS_DECODE_AHEAD */
+
+static boolean vorbis_mix_data(struct audio_stream *a_src,
+ int32_t * RESTRICT buffer, size_t frames, unsigned int channels)
+{
+  struct vorbis_stream *v_stream = (struct vorbis_stream *)a_src;
+  uint32_t read_wanted = v_stream->s.allocated_data_length -
+   v_stream->s.stream_offset;
+  char *read_buffer = (char *)v_stream->s.output_data +
+   v_stream->s.stream_offset;
+  boolean is_end;
+
+#ifdef VORBIS_DECODE_AHEAD
+  if(v_stream->use_ring)
+  {
+    struct vorbis_ring *ring = &(v_stream->ring);
+    size_t read_len;
+
+    platform_mutex_lock(&vorbis_decoder.lock);
+
+    read_len = vorbis_ring_read(v_stream, read_buffer, read_wanted);
+    is_end = ring->is_eof && !ring->fill;
+
+    if(!ring->is_eof && ring->fill < ring->watermark)
+      platform_cond_signal(&vorbis_decoder.cond);
+
+    platform_mutex_unlock(&vorbis_decoder.lock);
+
+    // On an underrun, play silence instead of waiting for the decoder.
+    if(read_len < read_wanted)
+      memset(read_buffer + read_len, 0, read_wanted - read_len);
+  }
+  else
+#endif
+    is_end = vorbis_read_direct(v_stream, read_buffer, read_wanted);
+
+  sampled_mix_data((struct sampled_stream *)v_stream, buffer, frames, channels);
+  return is_end;
 }
 
 static void vorbis_set_volume(struct audio_stream *a_src, unsigned int volume)
@@ -143,23 +597,83 @@ static void vorbis_set_volume(struct audio_stream *a_src, unsigned int volume)
 
 static void vorbis_set_repeat(struct audio_stream *a_src, boolean repeat)
 {
+#ifdef VORBIS_DECODE_AHEAD
+  struct vorbis_stream *v_stream = (struct vorbis_stream *)a_src;
+
+  if(v_stream->use_ring)
+  {
+    // Data already in the ring was decoded with the old setting.
+    platform_mutex_lock(&vorbis_decoder.lock);
+    if(a_src->repeat != repeat)
+    {
+      a_src->repeat = repeat;
+      vorbis_ring_flush(v_stream, -1);
+    }
+    platform_mutex_unlock(&vorbis_decoder.lock);
+    return;
+  }
+#endif
+
   a_src->repeat = repeat;
 }
 
 static void vorbis_set_position(struct audio_stream *a_src, uint32_t position)
 {
-  ov_pcm_seek(&(((struct vorbis_stream *)a_src)->vorbis_file_handle),
-   (ogg_int64_t)position);
+  struct vorbis_stream *v_stream = (struct vorbis_stream *)a_src;
+
+#ifdef VORBIS_DECODE_AHEAD
+  if(v_stream->use_ring)
+  {
+    platform_mutex_lock(&vorbis_decoder.lock);
+    vorbis_ring_flush(v_stream, position);
+    platform_mutex_unlock(&vorbis_decoder.lock);
+    return;
+  }
+#endif
+
+  ov_pcm_seek(&(v_stream->vorbis_file_handle), (ogg_int64_t)position);
 }
 
 static void vorbis_set_loop_start(struct audio_stream *a_src, uint32_t position)
 {
-  ((struct vorbis_stream *)a_src)->loop_start = position;
+  struct vorbis_stream *v_stream = (struct vorbis_stream *)a_src;
+
+#ifdef VORBIS_DECODE_AHEAD
+  if(v_stream->use_ring)
+  {
+    platform_mutex_lock(&vorbis_decoder.lock);
+    if(v_stream->loop_start != position)
+    {
+      v_stream->loop_start = position;
+      vorbis_ring_flush(v_stream, -1);
+    }
+    platform_mutex_unlock(&vorbis_decoder.lock);
+    return;
+  }
+#endif
+
+  v_stream->loop_start = position;
 }
 
 static void vorbis_set_loop_end(struct audio_stream *a_src, uint32_t position)
 {
-  ((struct vorbis_stream *)a_src)->loop_end = position;
+  struct vorbis_stream *v_stream = (struct vorbis_stream *)a_src;
+
+#ifdef VORBIS_DECODE_AHEAD
+  if(v_stream->use_ring)
+  {
+    platform_mutex_lock(&vorbis_decoder.lock);
+    if(v_stream->loop_end != position)
+    {
+      v_stream->loop_end = position;
+      vorbis_ring_flush(v_stream, -1);
+    }
+    platform_mutex_unlock(&vorbis_decoder.lock);
+    return;
+  }
+#endif
+
+  v_stream->loop_end = position;
 }
 
 static void vorbis_set_frequency(struct sampled_stream *s_src, uint32_t frequency)
@@ -175,13 +689,31 @@ static void vorbis_set_frequency(struct sampled_stream *s_src, uint32_t frequenc
 static uint32_t vorbis_get_position(struct audio_stream *a_src)
 {
   struct vorbis_stream *v = (struct vorbis_stream *)a_src;
+
+#ifdef VORBIS_DECODE_AHEAD
+  if(v->use_ring)
+  {
+    int64_t pos;
+
+    platform_mutex_lock(&vorbis_decoder.lock);
+    pos = vorbis_ring_position(v);
+    if(pos < 0)
+      pos = v->ring.play_pos;
+    platform_mutex_unlock(&vorbis_decoder.lock);
+
+    // Nothing has been decoded or played yet.
+    if(pos < 0)
+      pos = 0;
+    return pos;
+  }
+#endif
+
   return ov_pcm_tell(&v->vorbis_file_handle);
 }
 
 static uint32_t vorbis_get_length(struct audio_stream *a_src)
 {
-  struct vorbis_stream *v = (struct vorbis_stream *)a_src;
-  return ov_pcm_total(&v->vorbis_file_handle, -1);
+  return ((struct vorbis_stream *)a_src)->length;
 }
 
 static uint32_t vorbis_get_loop_start(struct audio_stream *a_src)
@@ -202,6 +734,16 @@ static uint32_t vorbis_get_frequency(struct sampled_stream *s_src)
 static void vorbis_destruct(struct audio_stream *a_src)
 {
   struct vorbis_stream *v_stream = (struct vorbis_stream *)a_src;
+
+#ifdef VORBIS_DECODE_AHEAD
+  if(v_stream->use_ring)
+  {
+    vorbis_decoder_remove(v_stream);
+    platform_mutex_destroy(&v_stream->file_lock);
+    free(v_stream->ring.data);
+  }
+#endif
+
   ov_clear(&(v_stream->vorbis_file_handle));
   vfclose(v_stream->input_file);
   sampled_destruct(a_src);
@@ -319,6 +861,7 @@ static struct audio_stream *construct_vorbis_stream(vfile *vf,
   v_stream->vorbis_file_handle = open_file;
   v_stream->vorbis_file_info = vorbis_file_info;
   v_stream->input_file = vf;
+  v_stream->length = ov_pcm_total(&(v_stream->vorbis_file_handle), -1);
 
   v_stream->loop_start = 0;
   v_stream->loop_end = 0;
@@ -344,9 +887,26 @@ static struct audio_stream *construct_vorbis_stream(vfile *vf,
   initialize_sampled_stream((struct sampled_stream *)v_stream, &s_spec,
    frequency, v_stream->vorbis_file_info->channels, true);
 
+#ifdef VORBIS_DECODE_AHEAD
+  v_stream->use_ring = vorbis_decoder.running;
+  if(v_stream->use_ring)
+  {
+    // Prime the ring before the stream is visible to the audio callback.
+    v_stream->s.a.repeat = repeat;
+    platform_mutex_init(&v_stream->file_lock);
+    vorbis_ring_init(v_stream);
+    vorbis_ring_prime(v_stream);
+  }
+#endif
+
   initialize_audio_stream((struct audio_stream *)v_stream, &a_spec,
    volume, repeat);
 
+#ifdef VORBIS_DECODE_AHEAD
+  if(v_stream->use_ring)
+    vorbis_decoder_add(v_stream);
+#endif
+
   return (struct audio_stream *)v_stream;
 }
 
@@ -361,5 +921,51 @@ static boolean test_vorbis_stream(vfile *vf, const char *filename)
 
 void init_vorbis(struct config_info *conf)
 {
-  audio_ext_register(test_vorbis_stream, construct_vorbis_stream);
+  audio_ext_register("vorbis", test_vorbis_stream,
+   construct_vorbis_stream);
+
+#ifdef VORBIS_DECODE_AHEAD
+  memset(&vorbis_decoder, 0, sizeof(struct vorbis_decoder));
+  vorbis_decoder.decode_ahead = conf->vorbis_decode_ahead;
+
+  if(vorbis_decoder.decode_ahead > 0)
+  {
+    platform_mutex_init(&vorbis_decoder.lock);
+    platform_cond_init(&vorbis_decoder.cond);
+    platform_cond_init(&vorbis_decoder.idle_cond);
+
+    if(platform_thread_create(&vorbis_decoder.thread,
+     vorbis_decoder_thread, NULL))
+    {
+      vorbis_decoder.running = true;
+    }
+    else
+    {
+      warn("Failed to start Vorbis decoder thread; decoding in callback.\n");
+      platform_cond_destroy(&vorbis_decoder.idle_cond);
+      platform_cond_destroy(&vorbis_decoder.cond);
+      platform_mutex_destroy(&vorbis_decoder.lock);
+    }
+  }
+#endif
+}
+
+void quit_vorbis(void)
+{
+#ifdef VORBIS_DECODE_AHEAD
+  if(vorbis_decoder.running)
+  {
+    platform_mutex_lock(&vorbis_decoder.lock);
+    vorbis_decoder.quit = true;
+    platform_cond_signal(&vorbis_decoder.cond);
+    platform_mutex_unlock(&vorbis_decoder.lock);
+
+    platform_thread_join(&vorbis_decoder.thread);
+
+    platform_cond_destroy(&vorbis_decoder.idle_cond);
+    platform_cond_destroy(&vorbis_decoder.cond);
+    platform_mutex_destroy(&vorbis_decoder.lock);
+    vorbis_decoder.running = false;
+  }
+#endif
 }
@@ -25,6 +25,7 @@
 __M_BEGIN_DECLS
 
 void init_vorbis(struct config_info *conf);
+void quit_vorbis(void);
 
 __M_END_DECLS
 
@@ -44,6 +44,10 @@
 // anticipated use big WAVs and it could get annoying for end users.)
 #define WARN_FILESIZE (1<<22)
 
+// Number of pooled WAV voices when the number of samples isn't limited.
+#define WAV_VOICE_POOL_DEFAULT 32
+#define WAV_VOICE_POOL_MAX 256
+
 struct wav_stream
 {
   struct sampled_stream s;
@@ -56,8 +60,112 @@ struct wav_stream
   uint32_t loop_start;
   uint32_t loop_end;
   enum wav_format format;
+  boolean pooled;
 };
 
+/**
+ * Pool of WAV voices, sized to the current sample limit. Released voices keep
+ * their output buffer, so playing a sample reuses both the stream and its
+ * buffer. If the pool is exhausted, voices are allocated normally.
+ */
+static struct wav_voice_pool
+{
+  struct wav_stream **free_voices;
+  int capacity;
+  int count;
+  int num_free;
+  platform_mutex lock;
+}
+voice_pool;
+
+static void wav_voice_free(struct wav_stream *w_stream)
+{
+  free(((struct sampled_stream *)w_stream)->output_data);
+  free(w_stream);
+}
+
+static struct wav_stream *wav_voice_alloc(void)
+{
+  struct wav_stream *w_stream = NULL;
+
+  platform_mutex_lock(&voice_pool.lock);
+  if(voice_pool.num_free > 0)
+    w_stream = voice_pool.free_voices[--voice_pool.num_free];
+  platform_mutex_unlock(&voice_pool.lock);
+
+  return w_stream;
+}
+
+static void wav_voice_release(struct wav_stream *w_stream)
+{
+  platform_mutex_lock(&voice_pool.lock);
+  if(voice_pool.count <= voice_pool.capacity)
+  {
+    voice_pool.free_voices[voice_pool.num_free++] = w_stream;
+    w_stream = NULL;
+  }
+  else
+    voice_pool.count--;
+
+  platform_mutex_unlock(&voice_pool.lock);
+
+  // The pool shrank while this voice was playing.
+  if(w_stream)
+    wav_voice_free(w_stream);
+}
+
+/**
+ * Grow or shrink the pool to a new number of voices. Voices that are playing
+ * are freed when they are released instead.
+ */
+static void wav_voice_pool_resize(int capacity)
+{
+  struct wav_stream **free_voices;
+  struct wav_stream *w_stream;
+
+  platform_mutex_lock(&voice_pool.lock);
+
+  if(capacity > voice_pool.capacity)
+  {
+    free_voices = (struct wav_stream **)realloc(voice_pool.free_voices,
+     capacity * sizeof(struct wav_stream *));
+    if(!free_voices)
+      goto err;
+
+    voice_pool.free_voices = free_voices;
+  }
+  voice_pool.capacity = capacity;
+
+  while(voice_pool.count < capacity)
+  {
+    w_stream = (struct wav_stream *)calloc(1, sizeof(struct wav_stream));
+    if(!w_stream)
+      break;
+
+    w_stream->pooled = true;
+    voice_pool.free_voices[voice_pool.num_free++] = w_stream;
+    voice_pool.count++;
+  }
+
+  while(voice_pool.count > capacity && voice_pool.num_free > 0)
+  {
+    wav_voice_free(voice_pool.free_voices[--voice_pool.num_free]);
+    voice_pool.count--;
+  }
+
+err:
+  platform_mutex_unlock(&voice_pool.lock);
+}
+
+static int wav_voice_pool_capacity(int max_samples)
+{
+  // One extra voice is needed for the sample started before limiting.
+  if(max_samples >= 0)
+    return MIN(max_samples + 1, WAV_VOICE_POOL_MAX);
+
+  return WAV_VOICE_POOL_DEFAULT;
+}
+
 static uint32_t wav_read_data(struct wav_stream *w_stream,
  uint8_t * RESTRICT buffer, uint32_t len, boolean repeat)
 {
@@ -262,6 +370,14 @@ static void wav_destruct(struct audio_stream *a_src)
 {
   struct wav_stream *w_stream = (struct wav_stream *)a_src;
   free(w_stream->wav_data);
+  w_stream->wav_data = NULL;
+
+  if(w_stream->pooled)
+  {
+    detach_audio_stream(a_src);
+    wav_voice_release(w_stream);
+    return;
+  }
   sampled_destruct(a_src);
 }
 
@@ -636,11 +752,17 @@ struct audio_stream *construct_wav_stream_direct(struct wav_info *w_info,
   struct sampled_stream_spec s_spec;
   struct audio_stream_spec a_spec;
 
-  w_stream = (struct wav_stream *)malloc(sizeof(struct wav_stream));
+  w_stream = wav_voice_alloc();
   if(!w_stream)
   {
-    free(w_info->wav_data);
-    return NULL;
+    w_stream = (struct wav_stream *)malloc(sizeof(struct wav_stream));
+    if(!w_stream)
+    {
+      free(w_info->wav_data);
+      return NULL;
+    }
+    ((struct sampled_stream *)w_stream)->output_data = NULL;
+    w_stream->pooled = false;
   }
 
   w_stream->wav_data = w_info->wav_data;
@@ -682,7 +804,7 @@ struct audio_stream *construct_wav_stream_direct(struct wav_info *w_info,
   s_spec.set_frequency = wav_set_frequency;
   s_spec.get_frequency = wav_get_frequency;
 
-  initialize_sampled_stream((struct sampled_stream *)w_stream, &s_spec,
+  reinitialize_sampled_stream((struct sampled_stream *)w_stream, &s_spec,
    frequency, w_info->channels, true);
 
   initialize_audio_stream((struct audio_stream *)w_stream, &a_spec,
@@ -754,6 +876,32 @@ static boolean test_sam_stream(vfile *vf, const char *filename)
 
 void init_wav(struct config_info *conf)
 {
-  audio_ext_register(test_sam_stream, construct_sam_stream);
-  audio_ext_register(test_wav_stream, construct_wav_stream);
+  audio_ext_register("sam", test_sam_stream, construct_sam_stream);
+  audio_ext_register("wav", test_wav_stream, construct_wav_stream);
+
+  memset(&voice_pool, 0, sizeof(struct wav_voice_pool));
+  platform_mutex_init(&voice_pool.lock);
+
+  wav_voice_pool_resize(
+   wav_voice_pool_capacity(conf->max_simultaneous_samples));
+}
+
+/**
+ * Resize the voice pool for a new sample limit.
+ */
+void wav_set_max_samples(int max_samples)
+{
+  wav_voice_pool_resize(wav_voice_pool_capacity(max_samples));
+}
+
+void quit_wav(void)
+{
+  int i;
+
+  for(i = 0; i < voice_pool.num_free; i++)
+    wav_voice_free(voice_pool.free_voices[i]);
+
+  free(voice_pool.free_voices);
+  platform_mutex_destroy(&voice_pool.lock);
+  memset(&voice_pool, 0, sizeof(struct wav_voice_pool));
 }
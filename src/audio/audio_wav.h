@@ -29,6 +29,8 @@ struct audio_stream *construct_wav_stream_direct(struct wav_info *w_info,
  uint32_t frequency, unsigned int volume, boolean repeat);
 
 void init_wav(struct config_info *conf);
+void wav_set_max_samples(int max_samples);
+void quit_wav(void);
 
 __M_END_DECLS
 
@@ -354,5 +354,5 @@ static struct audio_stream *construct_xmp_stream(vfile *vf,
 
 void init_xmp(struct config_info *conf)
 {
-  audio_ext_register(NULL, construct_xmp_stream);
+  audio_ext_register("xmp", NULL, construct_xmp_stream);
 }
@@ -33,6 +33,7 @@
 
 struct registry_entry
 {
+  const char *name;
   filter_stream_fn test;
   construct_stream_fn constructor;
 };
@@ -41,8 +42,10 @@ static struct registry_entry *registry = NULL;
 static size_t registry_size = 0;
 static size_t registry_alloc = 0;
 
-void audio_ext_register(filter_stream_fn test, construct_stream_fn constructor)
+void audio_ext_register(const char *name, filter_stream_fn test,
+ construct_stream_fn constructor)
 {
+  assert(name);
   assert(constructor);
   if(registry_alloc <= registry_size)
   {
@@ -63,6 +66,7 @@ void audio_ext_register(filter_stream_fn test, construct_stream_fn constructor)
     registry = tmp;
   }
 
+  registry[registry_size].name = name;
   registry[registry_size].test = test;
   registry[registry_size].constructor = constructor;
   registry_size++;
@@ -76,8 +80,13 @@ void audio_ext_free_registry(void)
   registry_alloc = 0;
 }
 
-struct audio_stream *audio_ext_construct_stream(const char *filename,
- uint32_t frequency, unsigned int volume, boolean repeat)
+/**
+ * Construct a stream for a file using the first registered engine that
+ * accepts it. If `engine` is provided, the name of the engine that created
+ * the stream will be written to it on success. The stream is not attached.
+ */
+static struct audio_stream *audio_ext_construct(const char *filename,
+ uint32_t frequency, unsigned int volume, boolean repeat, const char **engine)
 {
   struct audio_stream *a_return = NULL;
   vfile *vf;
@@ -105,7 +114,11 @@ struct audio_stream *audio_ext_construct_stream(const char *filename,
 
     a_return = constructor(vf, filename, frequency, volume, repeat);
     if(a_return)
+    {
+      if(engine)
+        *engine = registry[i].name;
       break;
+    }
 
     vrewind(vf);
   }
@@ -117,3 +130,32 @@ struct audio_stream *audio_ext_construct_stream(const char *filename,
 
   return a_return;
 }
+
+struct audio_stream *audio_ext_construct_stream_ext(const char *filename,
+ uint32_t frequency, unsigned int volume, boolean repeat, const char **engine)
+{
+  struct audio_stream *a_src =
+   audio_ext_construct(filename, frequency, volume, repeat, engine);
+
+  if(a_src)
+    attach_audio_stream(a_src);
+
+  return a_src;
+}
+
+struct audio_stream *audio_ext_construct_stream(const char *filename,
+ uint32_t frequency, unsigned int volume, boolean repeat)
+{
+  return audio_ext_construct_stream_ext(filename, frequency, volume, repeat,
+   NULL);
+}
+
+/**
+ * Construct a stream without adding it to the mixer. The caller is
+ * responsible for attaching or destroying it.
+ */
+struct audio_stream *audio_ext_construct_stream_detached(const char *filename,
+ uint32_t frequency, unsigned int volume, boolean repeat)
+{
+  return audio_ext_construct(filename, frequency, volume, repeat, NULL);
+}
@@ -33,11 +33,16 @@ typedef boolean (*filter_stream_fn)(vfile *vf, const char *filename);
 typedef struct audio_stream *(*construct_stream_fn)(vfile *vf, const char *,
  uint32_t frequency, unsigned int volume, boolean repeat);
 
-void audio_ext_register(filter_stream_fn test, construct_stream_fn constructor);
+void audio_ext_register(const char *name, filter_stream_fn test,
+ construct_stream_fn constructor);
 void audio_ext_free_registry(void);
 
 struct audio_stream *audio_ext_construct_stream(const char *filename,
  uint32_t frequency, unsigned int volume, boolean repeat);
+struct audio_stream *audio_ext_construct_stream_ext(const char *filename,
+ uint32_t frequency, unsigned int volume, boolean repeat, const char **engine);
+struct audio_stream *audio_ext_construct_stream_detached(const char *filename,
+ uint32_t frequency, unsigned int volume, boolean repeat);
 
 __M_END_DECLS
 
@@ -32,8 +32,22 @@
 #include "audio_struct.h"
 #include "sampled_stream.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+ (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIXER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIXER_NEON
+#endif
+
+#if defined(MIXER_SSE2) || defined(MIXER_NEON)
+#define MIXER_SIMD
+#endif
+
 #define FP_SHIFT      13
-#define FP_AND        ((1 << FP_SHIFT) - 1)
+#define FP_ONE        (1 << FP_SHIFT)
+#define FP_AND        (FP_ONE - 1)
 
 /**
  * This uses C++ templates to generate optimized mixer variants depending on
@@ -46,6 +60,16 @@
  * The cubic mixer currently works with values shifted by 2x FP_SHIFT when
  * computing its polynomial.
  *
+ * When SSE2 or NEON is available, the flat and linear mixers for both mono and
+ * stereo sources are replaced with vectorized variants. These must produce
+ * output that is bit-exact with the scalar mixers (see unit/audio). The
+ * linear mixer can do this with 16-bit multiplies because
+ *
+ *   l + ((r - l) * f >> FP_SHIFT) == (l * (FP_ONE - f) + r * f) >> FP_SHIFT
+ *
+ * and both weights fit in an int16_t. The cubic and nearest mixers are bound
+ * by 64-bit math and scattered loads respectively and remain scalar.
+ *
  * NOTE: FP_SHIFT values of 16 or 32 theoretically might help performance but
  *       some experimentation suggests it's not enough to be worth the effort.
  * TODO: FIR/Sinc-Lanczos resampler!!!!!111one
@@ -92,8 +116,8 @@ static int32_t volume_function(int32_t sample, int volume)
 }
 
 template<mixer_channels CHANNELS, mixer_volume VOLUME>
-static void flat_mix_loop(struct sampled_stream *s_src,
- int32_t * RESTRICT dest, size_t write_len, const int16_t *src, int volume)
+static void flat_mix_frames(int32_t * RESTRICT dest, size_t write_len,
+ const int16_t *src, int volume)
 {
   for(size_t i = 0; i < write_len; i += 2)
   {
@@ -109,6 +133,13 @@ static void flat_mix_loop(struct sampled_stream *s_src,
       *(dest++) += smpl;
     }
   }
+}
+
+template<mixer_channels CHANNELS, mixer_volume VOLUME>
+static void flat_mix_loop(struct sampled_stream *s_src,
+ int32_t * RESTRICT dest, size_t write_len, const int16_t *src, int volume)
+{
+  flat_mix_frames<CHANNELS, VOLUME>(dest, write_len, src, volume);
   s_src->sample_index = 0;
 }
 
@@ -159,12 +190,9 @@ int32_t cubic_mix(const int16_t *src_offset, ssize_t frac_index)
 }
 
 template<mixer_channels CHANNELS, mixer_volume VOLUME, mix_function MIX>
-static void resample_mix_loop(struct sampled_stream *s_src,
- int32_t * RESTRICT dest, size_t write_len, const int16_t *src, int volume)
+static int64_t resample_mix_frames(int32_t * RESTRICT dest, size_t write_len,
+ const int16_t *src, int volume, int64_t sample_index, int64_t delta)
 {
-  int64_t sample_index = s_src->sample_index;
-  int64_t delta = s_src->frequency_delta;
-
   for(size_t i = 0; i < write_len; i += 2, sample_index += delta)
   {
     ssize_t int_index = (sample_index >> FP_SHIFT) * CHANNELS;
@@ -185,9 +213,308 @@ static void resample_mix_loop(struct sampled_stream *s_src,
       *(dest++) += smpl;
     }
   }
+  return sample_index;
+}
+
+template<mixer_channels CHANNELS, mixer_volume VOLUME, mix_function MIX>
+static void resample_mix_loop(struct sampled_stream *s_src,
+ int32_t * RESTRICT dest, size_t write_len, const int16_t *src, int volume)
+{
+  int64_t sample_index = s_src->sample_index;
+  int64_t delta = s_src->frequency_delta;
+
+  sample_index = resample_mix_frames<CHANNELS, VOLUME, MIX>(dest, write_len,
+   src, volume, sample_index, delta);
+
+  update_sample_index(s_src, sample_index);
+}
+
+#ifdef MIXER_SIMD
+
+/**
+ * Vectorized mixers. Each of these handles as many whole vectors as it can
+ * and passes the remainder to the scalar mixer. The volume can only be applied
+ * with 16-bit multiplies, but stream volumes never exceed 256 in practice.
+ */
+
+#ifdef MIXER_SSE2
+
+/**
+ * Sign extend (and optionally apply volume to) 8 int16_t values.
+ */
+template<mixer_volume VOLUME>
+static inline void simd_widen(__m128i in, __m128i vol,
+ __m128i &lo, __m128i &hi)
+{
+  if(VOLUME)
+  {
+    __m128i prod_lo = _mm_mullo_epi16(in, vol);
+    __m128i prod_hi = _mm_mulhi_epi16(in, vol);
+    lo = _mm_srai_epi32(_mm_unpacklo_epi16(prod_lo, prod_hi), 8);
+    hi = _mm_srai_epi32(_mm_unpackhi_epi16(prod_lo, prod_hi), 8);
+  }
+  else
+  {
+    lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+    hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+  }
+}
+
+static inline void simd_add(int32_t *dest, __m128i value)
+{
+  __m128i *d = (__m128i *)dest;
+  _mm_storeu_si128(d, _mm_add_epi32(_mm_loadu_si128(d), value));
+}
+
+template<mixer_channels CHANNELS, mixer_volume VOLUME>
+static void flat_mix_loop_simd(struct sampled_stream *s_src,
+ int32_t * RESTRICT dest, size_t write_len, const int16_t *src, int volume)
+{
+  // 8 source samples per iteration.
+  size_t block_len = (CHANNELS >= STEREO) ? 8 : 16;
+  __m128i vol = _mm_set1_epi16(volume);
+  size_t i;
+
+  if(VOLUME && volume > 32767)
+    block_len = write_len + 1;
+
+  for(i = 0; i + block_len <= write_len; i += block_len)
+  {
+    __m128i in = _mm_loadu_si128((const __m128i *)src);
+    __m128i lo;
+    __m128i hi;
+    simd_widen<VOLUME>(in, vol, lo, hi);
+
+    if(CHANNELS >= STEREO)
+    {
+      simd_add(dest + 0, lo);
+      simd_add(dest + 4, hi);
+    }
+    else
+    {
+      simd_add(dest + 0, _mm_unpacklo_epi32(lo, lo));
+      simd_add(dest + 4, _mm_unpackhi_epi32(lo, lo));
+      simd_add(dest + 8, _mm_unpacklo_epi32(hi, hi));
+      simd_add(dest + 12, _mm_unpackhi_epi32(hi, hi));
+    }
+    dest += block_len;
+    src += 8;
+  }
+
+  flat_mix_frames<CHANNELS, VOLUME>(dest, write_len - i, src, volume);
+  s_src->sample_index = 0;
+}
+
+static inline int32_t simd_load_pair(const int16_t *src)
+{
+  int32_t pair;
+  memcpy(&pair, src, sizeof(int32_t));
+  return pair;
+}
+
+template<mixer_channels CHANNELS, mixer_volume VOLUME>
+static void linear_mix_loop_simd(struct sampled_stream *s_src,
+ int32_t * RESTRICT dest, size_t write_len, const int16_t *src, int volume)
+{
+  int64_t sample_index = s_src->sample_index;
+  int64_t delta = s_src->frequency_delta;
+  // 4 output samples per iteration.
+  size_t block_len = (CHANNELS >= STEREO) ? 4 : 8;
+  __m128i vol = _mm_set1_epi16(volume);
+  size_t i;
+
+  if(VOLUME && volume > 32767)
+    block_len = write_len + 1;
+
+  for(i = 0; i + block_len <= write_len; i += block_len)
+  {
+    __m128i lo;
+    __m128i hi;
+    __m128i in;
+    __m128i w;
+
+    if(CHANNELS >= STEREO)
+    {
+      ssize_t int_a = (sample_index >> FP_SHIFT) * CHANNELS;
+      int16_t frac_a = sample_index & FP_AND;
+      sample_index += delta;
+      ssize_t int_b = (sample_index >> FP_SHIFT) * CHANNELS;
+      int16_t frac_b = sample_index & FP_AND;
+      sample_index += delta;
+
+      // l0 r0 l1 r1 | l0 r0 l1 r1 -> l0 l1 r0 r1 | l0 l1 r0 r1
+      in = _mm_unpacklo_epi64(
+       _mm_loadl_epi64((const __m128i *)(src + int_a)),
+       _mm_loadl_epi64((const __m128i *)(src + int_b)));
+      in = _mm_shufflelo_epi16(in, _MM_SHUFFLE(3, 1, 2, 0));
+      in = _mm_shufflehi_epi16(in, _MM_SHUFFLE(3, 1, 2, 0));
+
+      w = _mm_set_epi16(
+       frac_b, FP_ONE - frac_b, frac_b, FP_ONE - frac_b,
+       frac_a, FP_ONE - frac_a, frac_a, FP_ONE - frac_a);
+    }
+    else
+    {
+      int32_t pairs[4];
+      int16_t fracs[4];
+      for(int j = 0; j < 4; j++, sample_index += delta)
+      {
+        pairs[j] = simd_load_pair(src + (sample_index >> FP_SHIFT));
+        fracs[j] = sample_index & FP_AND;
+      }
+
+      in = _mm_set_epi32(pairs[3], pairs[2], pairs[1], pairs[0]);
+      w = _mm_set_epi16(
+       fracs[3], FP_ONE - fracs[3], fracs[2], FP_ONE - fracs[2],
+       fracs[1], FP_ONE - fracs[1], fracs[0], FP_ONE - fracs[0]);
+    }
+
+    in = _mm_srai_epi32(_mm_madd_epi16(in, w), FP_SHIFT);
+
+    // The interpolated values are always within the range of an int16_t.
+    simd_widen<VOLUME>(_mm_packs_epi32(in, in), vol, lo, hi);
+
+    if(CHANNELS >= STEREO)
+    {
+      simd_add(dest, lo);
+    }
+    else
+    {
+      simd_add(dest + 0, _mm_unpacklo_epi32(lo, lo));
+      simd_add(dest + 4, _mm_unpackhi_epi32(lo, lo));
+    }
+    dest += block_len;
+  }
+
+  sample_index = resample_mix_frames<CHANNELS, VOLUME, linear_mix<CHANNELS> >(
+   dest, write_len - i, src, volume, sample_index, delta);
+
+  update_sample_index(s_src, sample_index);
+}
+
+#endif /* MIXER_SSE2 */
+
+#ifdef MIXER_NEON
+
+/**
+ * Sign extend (and optionally apply volume to) 4 int16_t values.
+ */
+template<mixer_volume VOLUME>
+static inline int32x4_t simd_widen(int16x4_t in, int16_t volume)
+{
+  if(VOLUME)
+    return vshrq_n_s32(vmull_n_s16(in, volume), 8);
+
+  return vmovl_s16(in);
+}
+
+static inline void simd_add(int32_t *dest, int32x4_t value)
+{
+  vst1q_s32(dest, vaddq_s32(vld1q_s32(dest), value));
+}
+
+static inline void simd_add_mono(int32_t *dest, int32x4_t value)
+{
+  int32x4x2_t dup = vzipq_s32(value, value);
+  simd_add(dest + 0, dup.val[0]);
+  simd_add(dest + 4, dup.val[1]);
+}
+
+template<mixer_channels CHANNELS, mixer_volume VOLUME>
+static void flat_mix_loop_simd(struct sampled_stream *s_src,
+ int32_t * RESTRICT dest, size_t write_len, const int16_t *src, int volume)
+{
+  // 8 source samples per iteration.
+  size_t block_len = (CHANNELS >= STEREO) ? 8 : 16;
+  size_t i;
+
+  if(VOLUME && volume > 32767)
+    block_len = write_len + 1;
+
+  for(i = 0; i + block_len <= write_len; i += block_len)
+  {
+    int16x8_t in = vld1q_s16(src);
+    int32x4_t lo = simd_widen<VOLUME>(vget_low_s16(in), volume);
+    int32x4_t hi = simd_widen<VOLUME>(vget_high_s16(in), volume);
+
+    if(CHANNELS >= STEREO)
+    {
+      simd_add(dest + 0, lo);
+      simd_add(dest + 4, hi);
+    }
+    else
+    {
+      simd_add_mono(dest + 0, lo);
+      simd_add_mono(dest + 8, hi);
+    }
+    dest += block_len;
+    src += 8;
+  }
+
+  flat_mix_frames<CHANNELS, VOLUME>(dest, write_len - i, src, volume);
+  s_src->sample_index = 0;
+}
+
+template<mixer_channels CHANNELS, mixer_volume VOLUME>
+static void linear_mix_loop_simd(struct sampled_stream *s_src,
+ int32_t * RESTRICT dest, size_t write_len, const int16_t *src, int volume)
+{
+  int64_t sample_index = s_src->sample_index;
+  int64_t delta = s_src->frequency_delta;
+  // 4 output samples per iteration.
+  size_t block_len = (CHANNELS >= STEREO) ? 4 : 8;
+  size_t i;
+
+  if(VOLUME && volume > 32767)
+    block_len = write_len + 1;
+
+  for(i = 0; i + block_len <= write_len; i += block_len)
+  {
+    int16_t cur[4];
+    int16_t next[4];
+    int16_t w_cur[4];
+    int16_t w_next[4];
+    int32x4_t out;
+
+    for(int j = 0; j < 4; j += CHANNELS, sample_index += delta)
+    {
+      ssize_t int_index = (sample_index >> FP_SHIFT) * CHANNELS;
+      int16_t frac_index = sample_index & FP_AND;
+
+      for(int k = 0; k < CHANNELS; k++)
+      {
+        cur[j + k] = src[int_index + k];
+        next[j + k] = src[int_index + k + CHANNELS];
+        w_cur[j + k] = FP_ONE - frac_index;
+        w_next[j + k] = frac_index;
+      }
+    }
+
+    out = vmull_s16(vld1_s16(cur), vld1_s16(w_cur));
+    out = vmlal_s16(out, vld1_s16(next), vld1_s16(w_next));
+    out = vshrq_n_s32(out, FP_SHIFT);
+
+    // The interpolated values are always within the range of an int16_t.
+    out = simd_widen<VOLUME>(vmovn_s32(out), volume);
+
+    if(CHANNELS >= STEREO)
+      simd_add(dest, out);
+    else
+      simd_add_mono(dest, out);
+
+    dest += block_len;
+  }
+
+  sample_index = resample_mix_frames<CHANNELS, VOLUME, linear_mix<CHANNELS> >(
+   dest, write_len - i, src, volume, sample_index, delta);
+
   update_sample_index(s_src, sample_index);
 }
 
+#endif /* MIXER_NEON */
+
+#endif /* MIXER_SIMD */
+
 template<mixer_channels CHANNELS, mixer_volume VOLUME>
 static void mixer_function(struct sampled_stream *s_src,
  int32_t * RESTRICT dest, size_t write_len, const int16_t *src, int volume,
@@ -196,7 +523,11 @@ static void mixer_function(struct sampled_stream *s_src,
   switch((mixer_resample)resample_mode)
   {
     case FLAT:
+#ifdef MIXER_SIMD
+      flat_mix_loop_simd<CHANNELS, VOLUME>(s_src, dest, write_len, src, volume);
+#else
       flat_mix_loop<CHANNELS, VOLUME>(s_src, dest, write_len, src, volume);
+#endif
       break;
 
     case NEAREST:
@@ -205,8 +536,12 @@ static void mixer_function(struct sampled_stream *s_src,
       break;
 
     case LINEAR:
+#ifdef MIXER_SIMD
+      linear_mix_loop_simd<CHANNELS, VOLUME>(s_src, dest, write_len, src, volume);
+#else
       resample_mix_loop<CHANNELS, VOLUME, linear_mix<CHANNELS> >(s_src,
        dest, write_len, src, volume);
+#endif
       break;
 
     case CUBIC:
@@ -347,6 +682,43 @@ void sampled_mix_data(struct sampled_stream *s_src,
    s_src->stream_offset);
 }
 
+/**
+ * Saturate the final mixed buffer to 16-bit output.
+ */
+void sampled_clip_buffer(int16_t * RESTRICT dest, const int32_t *src,
+ size_t len)
+{
+  size_t i = 0;
+
+#if defined(MIXER_SSE2)
+  for(; i + 8 <= len; i += 8)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+    _mm_storeu_si128((__m128i *)(dest + i), _mm_packs_epi32(a, b));
+  }
+#elif defined(MIXER_NEON)
+  for(; i + 8 <= len; i += 8)
+  {
+    int16x4_t a = vqmovn_s32(vld1q_s32(src + i));
+    int16x4_t b = vqmovn_s32(vld1q_s32(src + i + 4));
+    vst1q_s16(dest + i, vcombine_s16(a, b));
+  }
+#endif
+
+  for(; i < len; i++)
+  {
+    int32_t cur_sample = src[i];
+    if(cur_sample > 32767)
+      cur_sample = 32767;
+
+    if(cur_sample < -32768)
+      cur_sample = -32768;
+
+    dest[i] = cur_sample;
+  }
+}
+
 void sampled_destruct(struct audio_stream *a_src)
 {
   struct sampled_stream *s_stream = (struct sampled_stream *)a_src;
@@ -357,11 +729,23 @@ void sampled_destruct(struct audio_stream *a_src)
 void initialize_sampled_stream(struct sampled_stream *s_src,
  struct sampled_stream_spec *s_spec, uint32_t frequency, uint32_t channels,
  boolean use_volume)
+{
+  s_src->output_data = NULL;
+  reinitialize_sampled_stream(s_src, s_spec, frequency, channels, use_volume);
+}
+
+/**
+ * Initialize a sampled stream that may still own the output buffer from a
+ * previous use (i.e. a pooled stream). The existing buffer is resized
+ * instead of allocating a new one.
+ */
+void reinitialize_sampled_stream(struct sampled_stream *s_src,
+ struct sampled_stream_spec *s_spec, uint32_t frequency, uint32_t channels,
+ boolean use_volume)
 {
   s_src->set_frequency = s_spec->set_frequency;
   s_src->get_frequency = s_spec->get_frequency;
   s_src->channels = channels;
-  s_src->output_data = NULL;
   s_src->use_volume = use_volume;
   s_src->sample_index = 0;
 
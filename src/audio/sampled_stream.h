@@ -56,11 +56,16 @@ struct sampled_stream_spec
 void sampled_set_buffer(struct sampled_stream *s_src);
 void sampled_mix_data(struct sampled_stream *s_src,
  int32_t * RESTRICT dest_buffer, size_t dest_frames, unsigned int dest_channels);
+void sampled_clip_buffer(int16_t * RESTRICT dest, const int32_t *src,
+ size_t len);
 void sampled_destruct(struct audio_stream *a_src);
 
 void initialize_sampled_stream(struct sampled_stream *s_src,
  struct sampled_stream_spec *s_spec, uint32_t frequency, uint32_t channels,
  boolean use_volume);
+void reinitialize_sampled_stream(struct sampled_stream *s_src,
+ struct sampled_stream_spec *s_spec, uint32_t frequency, uint32_t channels,
+ boolean use_volume);
 
 __M_END_DECLS
 
@@ -25,6 +25,7 @@
 #include "board.h"
 #include "const.h"
 #include "error.h"
+#include "extmem.h"
 #include "legacy_board.h"
 #include "robot.h"
 #include "world.h"
@@ -321,10 +322,15 @@ void default_board_settings(struct world *mzx_world, struct board *cur_board)
   cur_board->freeze_time_dur_v1 = 0;
   cur_board->slow_time_dur_v1 = 0;
   cur_board->wind_dur_v1 = 0;
+  cur_board->deferred = NULL;
+  cur_board->modified = true;
 
 #if defined(DEBUG) || defined(CONFIG_EXTRAM)
   cur_board->is_extram = false;
 #endif
+#ifdef CONFIG_EXTRAM
+  cur_board->extram_pending = false;
+#endif
 }
 
 void dummy_board(struct world *mzx_world, struct board *cur_board)
@@ -776,9 +782,44 @@ static int cmp_robots(const void *dest, const void *src)
   return strcasecmp(rdest->robot_name, rsrc->robot_name);
 }
 
-__editor_maybe_static
-int load_board_direct(struct world *mzx_world, struct board *cur_board,
- struct zip_archive *zp, int savegame, int file_version, unsigned int board_id)
+static void load_board_allocate_layers(struct board *cur_board,
+ size_t board_size)
+{
+  cur_board->level_id = ccalloc(1, board_size);
+  cur_board->level_param = ccalloc(1, board_size);
+  cur_board->level_color = ccalloc(1, board_size);
+  cur_board->level_under_id = ccalloc(1, board_size);
+  cur_board->level_under_param = ccalloc(1, board_size);
+  cur_board->level_under_color = ccalloc(1, board_size);
+
+  if(cur_board->overlay_mode)
+  {
+    cur_board->overlay = ccalloc(1, board_size);
+    cur_board->overlay_color = ccalloc(1, board_size);
+  }
+}
+
+static void load_board_allocate_lists(struct board *cur_board)
+{
+  int num_robots = cur_board->num_robots;
+  int num_scrolls = cur_board->num_scrolls;
+  int num_sensors = cur_board->num_sensors;
+
+  cur_board->robot_list = ccalloc(num_robots + 1, sizeof(struct robot *));
+  cur_board->robot_list_name_sorted =
+   ccalloc(num_robots, sizeof(struct robot *));
+  cur_board->scroll_list = ccalloc(num_scrolls + 1, sizeof(struct scroll *));
+  cur_board->sensor_list = ccalloc(num_sensors + 1, sizeof(struct sensor *));
+}
+
+/**
+ * Load a board from the current position in a world archive. If has_info is
+ * set, the board properties were already loaded by load_board_deferred and
+ * the board's object lists are allocated but empty.
+ */
+static int load_board_zip(struct world *mzx_world, struct board *cur_board,
+ struct zip_archive *zp, int savegame, int file_version, unsigned int board_id,
+ boolean has_info)
 {
   unsigned int file_id;
   unsigned int board_id_read;
@@ -812,7 +853,23 @@ int load_board_direct(struct world *mzx_world, struct board *cur_board,
   int has_och = 0;
   int has_oco = 0;
 
-  default_board_settings(mzx_world, cur_board);
+  if(has_info)
+  {
+    has_base = 1;
+    board_size = cur_board->board_width * cur_board->board_height;
+    load_board_allocate_layers(cur_board, board_size);
+
+    num_robots = cur_board->num_robots;
+    num_scrolls = cur_board->num_scrolls;
+    num_sensors = cur_board->num_sensors;
+
+    robot_list = cur_board->robot_list;
+    robot_list_name_sorted = cur_board->robot_list_name_sorted;
+    scroll_list = cur_board->scroll_list;
+    sensor_list = cur_board->sensor_list;
+  }
+  else
+    default_board_settings(mzx_world, cur_board);
 
   while(ZIP_SUCCESS == zip_get_next_mzx_file_id(zp, &file_id, &board_id_read, &robot_id_read))
   {
@@ -823,43 +880,28 @@ int load_board_direct(struct world *mzx_world, struct board *cur_board,
     {
       case FILE_ID_BOARD_INFO:
       {
+        if(has_info)
+        {
+          zip_skip_file(zp);
+          break;
+        }
+
         if(load_board_info(mzx_world, cur_board, zp, savegame, &file_version))
           goto err_invalid;
 
         has_base = 1;
         board_size = cur_board->board_width * cur_board->board_height;
-
-        cur_board->level_id = ccalloc(1, board_size);
-        cur_board->level_param = ccalloc(1, board_size);
-        cur_board->level_color = ccalloc(1, board_size);
-        cur_board->level_under_id = ccalloc(1, board_size);
-        cur_board->level_under_param = ccalloc(1, board_size);
-        cur_board->level_under_color = ccalloc(1, board_size);
-
-        if(cur_board->overlay_mode)
-        {
-          cur_board->overlay = ccalloc(1, board_size);
-          cur_board->overlay_color = ccalloc(1, board_size);
-        }
+        load_board_allocate_layers(cur_board, board_size);
 
         num_robots = cur_board->num_robots;
         num_scrolls = cur_board->num_scrolls;
         num_sensors = cur_board->num_sensors;
 
-        robot_list = ccalloc(num_robots + 1, sizeof(struct robot *));
-
-        robot_list_name_sorted =
-         ccalloc(num_robots, sizeof(struct robot *));
-
-        scroll_list = ccalloc(num_scrolls + 1, sizeof(struct scroll *));
-
-        sensor_list = ccalloc(num_sensors + 1, sizeof(struct sensor *));
-
-        cur_board->robot_list = robot_list;
-        cur_board->robot_list_name_sorted = robot_list_name_sorted;
-        cur_board->scroll_list = scroll_list;
-        cur_board->sensor_list = sensor_list;
-
+        load_board_allocate_lists(cur_board);
+        robot_list = cur_board->robot_list;
+        robot_list_name_sorted = cur_board->robot_list_name_sorted;
+        scroll_list = cur_board->scroll_list;
+        sensor_list = cur_board->sensor_list;
         break;
       }
 
@@ -1243,6 +1285,14 @@ err_invalid:
   return VAL_INVALID;
 }
 
+__editor_maybe_static
+int load_board_direct(struct world *mzx_world, struct board *cur_board,
+ struct zip_archive *zp, int savegame, int file_version, unsigned int board_id)
+{
+  return load_board_zip(mzx_world, cur_board, zp, savegame, file_version,
+   board_id, false);
+}
+
 struct board *load_board_allocate(struct world *mzx_world,
  struct zip_archive *zp, int savegame, int file_version, unsigned int board_id)
 {
@@ -1253,6 +1303,139 @@ struct board *load_board_allocate(struct world *mzx_world,
   return cur_board;
 }
 
+struct board_archive
+{
+  struct world *mzx_world;
+  struct zip_archive *zp;
+  int savegame;
+  int file_version;
+  int refcount;
+};
+
+struct board_deferred
+{
+  struct board_archive *archive;
+  size_t pos;
+  unsigned int board_id;
+  int file_version;
+};
+
+/**
+ * Take ownership of a world archive so boards can be loaded from it later.
+ * The archive is closed when the caller and every board deferred from it
+ * have released it.
+ */
+struct board_archive *board_archive_open(struct world *mzx_world,
+ struct zip_archive *zp, int savegame, int file_version)
+{
+  struct board_archive *ar = cmalloc(sizeof(struct board_archive));
+
+  ar->mzx_world = mzx_world;
+  ar->zp = zp;
+  ar->savegame = savegame;
+  ar->file_version = file_version;
+  ar->refcount = 1;
+  return ar;
+}
+
+void board_archive_release(struct board_archive *ar)
+{
+  ar->refcount--;
+  if(ar->refcount <= 0)
+  {
+    zip_close(ar->zp, NULL);
+    free(ar);
+  }
+}
+
+/**
+ * Load only the properties of the board at the current position of the
+ * archive and skip the rest of its files. The board's layers, robots, scrolls,
+ * and sensors are loaded by retrieve_board_deferred the first time the board
+ * is retrieved from extra memory. If the properties can't be loaded, the
+ * board is loaded normally instead so the usual errors are reported.
+ */
+struct board *load_board_deferred(struct board_archive *ar,
+ unsigned int board_id)
+{
+  struct world *mzx_world = ar->mzx_world;
+  struct zip_archive *zp = ar->zp;
+  struct board *cur_board = cmalloc(sizeof(struct board));
+  struct board_deferred *d;
+  unsigned int file_id;
+  unsigned int board_id_read;
+  int file_version = ar->file_version;
+  size_t pos = zp->pos;
+
+  default_board_settings(mzx_world, cur_board);
+
+  if(zip_get_next_mzx_file_id(zp, &file_id, NULL, NULL) != ZIP_SUCCESS ||
+   file_id != FILE_ID_BOARD_INFO ||
+   load_board_info(mzx_world, cur_board, zp, ar->savegame, &file_version))
+  {
+    free(cur_board->input_string);
+    free(cur_board->charset_path);
+    free(cur_board->palette_path);
+
+    zp->pos = pos;
+    load_board_direct(mzx_world, cur_board, zp, ar->savegame,
+     ar->file_version, board_id);
+    return cur_board;
+  }
+
+  cur_board->level_id = NULL;
+  cur_board->level_param = NULL;
+  cur_board->level_color = NULL;
+  cur_board->level_under_id = NULL;
+  cur_board->level_under_param = NULL;
+  cur_board->level_under_color = NULL;
+  cur_board->overlay = NULL;
+  cur_board->overlay_color = NULL;
+
+  load_board_allocate_lists(cur_board);
+  cur_board->num_robots_active = 0;
+  cur_board->robot_list[0] = &(mzx_world->global_robot);
+
+  while(zip_get_next_mzx_file_id(zp, NULL, &board_id_read, NULL) ==
+   ZIP_SUCCESS && board_id_read == board_id)
+    zip_skip_file(zp);
+
+  d = cmalloc(sizeof(struct board_deferred));
+  d->archive = ar;
+  d->pos = pos;
+  d->board_id = board_id;
+  d->file_version = file_version;
+  cur_board->deferred = d;
+  ar->refcount++;
+  return cur_board;
+}
+
+/**
+ * Load the rest of a deferred board from its world archive. If free_data is
+ * set, the board is about to be freed and its data is discarded instead.
+ */
+void retrieve_board_deferred(struct board *cur_board, boolean free_data)
+{
+  struct board_deferred *d = cur_board->deferred;
+  struct board_archive *ar;
+
+  if(!d)
+    return;
+
+  ar = d->archive;
+  cur_board->deferred = NULL;
+
+  if(!free_data)
+  {
+    ar->zp->pos = d->pos;
+    load_board_zip(ar->mzx_world, cur_board, ar->zp, ar->savegame,
+     d->file_version, d->board_id, true);
+  }
+
+  board_archive_release(ar);
+  free(d);
+}
+
 struct board *duplicate_board(struct world *mzx_world,
  struct board *src_board)
 {
@@ -1276,6 +1459,7 @@ struct board *duplicate_board(struct world *mzx_world,
 
   dest_board = cmalloc(sizeof(struct board));
   memcpy(dest_board, src_board, sizeof(struct board));
+  dest_board->deferred = NULL;
 
   // Level data
   dest_board->level_id = cmalloc(size);
@@ -1415,6 +1599,14 @@ void clear_board(struct board *cur_board)
   struct scroll **scroll_list = cur_board->scroll_list;
   struct sensor **sensor_list = cur_board->sensor_list;
 
+#ifdef CONFIG_EXTRAM
+  // This also waits for (or cancels) a background store of this board.
+  if(cur_board->is_extram)
+    clear_board_from_extram(cur_board);
+#endif
+
+  retrieve_board_deferred(cur_board, true);
+
   free(cur_board->level_id);
   free(cur_board->level_param);
   free(cur_board->level_color);
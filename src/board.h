@@ -26,6 +26,7 @@ __M_BEGIN_DECLS
 
 #include "world_struct.h"
 
+struct board_archive;
 struct zip_archive;
 
 CORE_LIBSPEC int save_board(struct world *mzx_world, struct board *cur_board,
@@ -34,6 +35,14 @@ CORE_LIBSPEC int save_board(struct world *mzx_world, struct board *cur_board,
 CORE_LIBSPEC struct board *load_board_allocate(struct world *mzx_world,
  struct zip_archive *zp, int savegame, int file_version, unsigned int board_id);
 
+struct board_archive *board_archive_open(struct world *mzx_world,
+ struct zip_archive *zp, int savegame, int file_version);
+void board_archive_release(struct board_archive *ar);
+struct board *load_board_deferred(struct board_archive *ar,
+ unsigned int board_id);
+CORE_LIBSPEC void retrieve_board_deferred(struct board *cur_board,
+ boolean free_data);
+
 CORE_LIBSPEC void board_set_input_string(struct board *cur_board,
  const char *input, size_t len);
 CORE_LIBSPEC void clear_board(struct board *cur_board);
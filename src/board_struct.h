@@ -26,6 +26,8 @@ __M_BEGIN_DECLS
 
 #include "robot_struct.h"
 
+struct board_deferred;
+
 struct board
 {
   char board_name[32];
@@ -107,9 +109,18 @@ struct board
   int num_sensors;
   int num_sensors_allocated;
   struct sensor **sensor_list;
+  // Non-NULL if this board's data hasn't been read from the world file yet.
+  struct board_deferred *deferred;
+  // Set if this board may differ from its copy in the incremental savegame
+  // snapshot. See real_set_current_board.
+  boolean modified;
 #if defined(DEBUG) || defined(CONFIG_EXTRAM)
   boolean is_extram;
 #endif
+#ifdef CONFIG_EXTRAM
+  // Set while this board is queued to be compressed in the background.
+  boolean extram_pending;
+#endif
 };
 
 __M_END_DECLS
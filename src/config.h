@@ -0,0 +1,21 @@
+#define PLATFORM "linux-amd64"
+#define VERSION "2.93-GIT"
+#define VERSION_DATE " (20261018)"
+#define VERSION_HEAD "02cbef4"
+#define CONFDIR "./"
+#define CONFFILE "config.txt"
+#define SHAREDIR "."
+#define LICENSEDIR "."
+#define CONFIG_EDITOR
+#define CONFIG_HELPSYS
+#define CONFIG_UTILS
+#define CONFIG_RENDER_SOFT
+#define CONFIG_ENABLE_SCREENSHOTS
+#define CONFIG_REALITY
+#define CONFIG_AUDIO
+#define CONFIG_PNG
+#define CONFIG_PTHREAD
+#define CONFIG_MODULAR
+#define CONFIG_CHECK_ALLOC
+#define CONFIG_COUNTER_HASH_TABLES
+#define CONFIG_VFS
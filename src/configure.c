@@ -63,6 +63,7 @@
 #ifdef CONFIG_GP2X
 #define VIDEO_OUTPUT_DEFAULT "gp2x"
 #define AUDIO_BUFFER_SAMPLES 128
+#define MODULE_PREFETCH_DEFAULT 0
 #define SAVE_SLOTS_DEFAULT true
 #endif
 
@@ -71,6 +72,8 @@
 #define FULLSCREEN_HEIGHT_DEFAULT 363
 #define FORCE_BPP_DEFAULT 8
 #define FULLSCREEN_DEFAULT 1
+#define MODULE_PREFETCH_DEFAULT 0
+#define BOARD_PREFETCH_DEFAULT 0
 #define SAVE_SLOTS_DEFAULT true
 #endif
 
@@ -173,6 +176,18 @@
 #define MOD_RESAMPLE_MODE_DEFAULT RESAMPLE_MODE_CUBIC
 #endif
 
+#ifndef VORBIS_DECODE_AHEAD_DEFAULT
+#define VORBIS_DECODE_AHEAD_DEFAULT 16384
+#endif
+
+#ifndef MODULE_PREFETCH_DEFAULT
+#define MODULE_PREFETCH_DEFAULT 4
+#endif
+
+#ifndef BOARD_PREFETCH_DEFAULT
+#define BOARD_PREFETCH_DEFAULT 2
+#endif
+
 #ifndef FULLSCREEN_WIDTH_DEFAULT
 #define FULLSCREEN_WIDTH_DEFAULT -1
 #endif
@@ -277,12 +292,22 @@ static const struct config_info user_conf_default =
   RESAMPLE_MODE_DEFAULT,        // resample_mode
   MOD_RESAMPLE_MODE_DEFAULT,    // module_resample_mode
   -1,                           // max_simultaneous_samples
+  VORBIS_DECODE_AHEAD_DEFAULT,  // vorbis_decode_ahead
+  MODULE_PREFETCH_DEFAULT,      // module_prefetch
   8,                            // music_volume
   8,                            // sam_volume
   8,                            // pc_speaker_volume
   true,                         // music_on
   true,                         // pc_speaker_on
 
+  // Offline audio render options
+  "",                           // audio_render_file
+  "",                           // audio_render_module
+  "",                           // audio_render_sample
+  "",                           // audio_render_sfx
+  1,                            // audio_render_sample_count
+  600,                          // audio_render_length
+
   // Event options
   true,                         // allow_gamecontroller
   false,                        // pause_on_unfocus
@@ -309,6 +334,11 @@ static const struct config_info user_conf_default =
   SAVE_SLOTS_DEFAULT,           // save_slots
   "%w.",                        // save_slots_name
   ".sav",                       // save_slots_ext
+  0,                            // worker_threads
+  false,                        // lazy_board_loading
+  true,                         // background_saves
+  true,                         // incremental_saves
+  BOARD_PREFETCH_DEFAULT,       // board_prefetch
 
   // Editor options
   false,                        // test_mode
@@ -642,6 +672,46 @@ static void config_set_audio_buffer(struct config_info *conf, char *name,
     conf->audio_buffer_samples = result;
 }
 
+static void config_audio_render_file(struct config_info *conf, char *name,
+ char *value, char *extended_data)
+{
+  config_string(conf->audio_render_file, value);
+}
+
+static void config_audio_render_length(struct config_info *conf, char *name,
+ char *value, char *extended_data)
+{
+  int result;
+  if(config_int(&result, value, 1, 86400))
+    conf->audio_render_length = result;
+}
+
+static void config_audio_render_module(struct config_info *conf, char *name,
+ char *value, char *extended_data)
+{
+  config_string(conf->audio_render_module, value);
+}
+
+static void config_audio_render_sample(struct config_info *conf, char *name,
+ char *value, char *extended_data)
+{
+  config_string(conf->audio_render_sample, value);
+}
+
+static void config_audio_render_sample_count(struct config_info *conf,
+ char *name, char *value, char *extended_data)
+{
+  int result;
+  if(config_int(&result, value, 1, 1024))
+    conf->audio_render_sample_count = result;
+}
+
+static void config_audio_render_sfx(struct config_info *conf, char *name,
+ char *value, char *extended_data)
+{
+  config_string(conf->audio_render_sfx, value);
+}
+
 static void config_set_resolution(struct config_info *conf, char *name,
  char *value, char *extended_data)
 {
@@ -795,6 +865,40 @@ static void config_save_slots_ext(struct config_info *conf, char *name,
   config_string(conf->save_slots_ext, value);
 }
 
+static void config_worker_threads(struct config_info *conf, char *name,
+ char *value, char *extended_data)
+{
+  int result;
+  if(config_int(&result, value, 0, 64))
+    conf->worker_threads = result;
+}
+
+static void config_lazy_board_loading(struct config_info *conf, char *name,
+ char *value, char *extended_data)
+{
+  config_boolean(&conf->lazy_board_loading, value);
+}
+
+static void config_background_saves(struct config_info *conf, char *name,
+ char *value, char *extended_data)
+{
+  config_boolean(&conf->background_saves, value);
+}
+
+static void config_incremental_saves(struct config_info *conf, char *name,
+ char *value, char *extended_data)
+{
+  config_boolean(&conf->incremental_saves, value);
+}
+
+static void config_board_prefetch(struct config_info *conf, char *name,
+ char *value, char *extended_data)
+{
+  int result;
+  if(config_int(&result, value, 0, 16))
+    conf->board_prefetch = result;
+}
+
 static void config_enable_oversampling(struct config_info *conf, char *name,
  char *value, char *extended_data)
 {
@@ -1162,6 +1266,22 @@ static void config_max_simultaneous_samples(struct config_info *conf,
     conf->max_simultaneous_samples = result;
 }
 
+static void config_vorbis_decode_ahead(struct config_info *conf,
+ char *name, char *value, char *extended_data)
+{
+  int result;
+  if(config_int(&result, value, 0, 1 << 20))
+    conf->vorbis_decode_ahead = result;
+}
+
+static void config_module_prefetch(struct config_info *conf,
+ char *name, char *value, char *extended_data)
+{
+  int result;
+  if(config_int(&result, value, 0, 16))
+    conf->module_prefetch = result;
+}
+
 static void config_test_mode(struct config_info *conf,
  char *name, char *value, char *extended_data)
 {
@@ -1213,8 +1333,16 @@ static const struct config_entry config_options[] =
   { "allow_screenshots", config_set_allow_screenshots, false },
   { "audio_buffer", config_set_audio_buffer, false },
   { "audio_buffer_samples", config_set_audio_buffer, false },
+  { "audio_render_file", config_audio_render_file, false },
+  { "audio_render_length", config_audio_render_length, false },
+  { "audio_render_module", config_audio_render_module, false },
+  { "audio_render_sample", config_audio_render_sample, false },
+  { "audio_render_sample_count", config_audio_render_sample_count, false },
+  { "audio_render_sfx", config_audio_render_sfx, false },
   { "audio_sample_rate", config_set_audio_freq, false },
   { "auto_decrypt_worlds", config_set_auto_decrypt_worlds, false },
+  { "background_saves", config_background_saves, false },
+  { "board_prefetch", config_board_prefetch, false },
   { "dialog_cursor_hints", config_set_dialog_cursor_hints, false },
   { "disable_screensaver", config_disable_screensaver, false },
   { "enable_oversampling", config_enable_oversampling, false },
@@ -1235,6 +1363,7 @@ static const struct config_entry config_options[] =
   { "gl_vsync", config_gl_vsync, false },
   { "grab_mouse", config_grab_mouse, false },
   { "include*", include_config, true },
+  { "incremental_saves", config_incremental_saves, false },
   { "joy!.*", joy_action_set, true },
   { "joy!axis!", joy_axis_set, true },
   { "joy!button!", joy_button_set, true },
@@ -1244,9 +1373,11 @@ static const struct config_entry config_options[] =
   { "joy[!,!]button!", joy_button_set, true },
   { "joy[!,!]hat", joy_hat_set, true },
   { "joy_axis_threshold", config_set_joy_axis_threshold, false },
+  { "lazy_board_loading", config_lazy_board_loading, false },
   { "mask_midchars", config_mask_midchars, false },
   { "max_simultaneous_samples", config_max_simultaneous_samples, false },
   { "modplug_resample_mode", config_mod_resample_mode, false },
+  { "module_prefetch", config_module_prefetch, false },
   { "module_resample_mode", config_mod_resample_mode, false },
   { "music_on", config_set_music, false },
   { "music_volume", config_set_mod_volume, false },
@@ -1292,7 +1423,9 @@ static const struct config_entry config_options[] =
   { "vfs_max_cache_size", config_set_vfs_max_cache_size, false },
   { "video_output", config_set_video_output, false },
   { "video_ratio", config_set_video_ratio, false },
-  { "window_resolution", config_window_resolution, false }
+  { "vorbis_decode_ahead", config_vorbis_decode_ahead, false },
+  { "window_resolution", config_window_resolution, false },
+  { "worker_threads", config_worker_threads, false }
 };
 
 static const struct config_entry *find_option(char *name,
@@ -134,12 +134,22 @@ struct config_info
   enum resample_mode resample_mode;
   enum resample_mode module_resample_mode;
   int max_simultaneous_samples;
+  int vorbis_decode_ahead;
+  int module_prefetch;
   int music_volume;
   int sam_volume;
   int pc_speaker_volume;
   boolean music_on;
   boolean pc_speaker_on;
 
+  // Offline audio render options
+  char audio_render_file[256];
+  char audio_render_module[256];
+  char audio_render_sample[256];
+  char audio_render_sfx[256];
+  int audio_render_sample_count;
+  int audio_render_length;
+
   // Event options
   boolean allow_gamecontroller;
   boolean pause_on_unfocus;
@@ -166,6 +176,11 @@ struct config_info
   boolean save_slots;
   char save_slots_name[256];
   char save_slots_ext[256];
+  int worker_threads;
+  boolean lazy_board_loading;
+  boolean background_saves;
+  boolean incremental_saves;
+  int board_prefetch;
 
   // Editor options
   boolean test_mode;
@@ -41,6 +41,7 @@
 #include "idarray.h"
 #include "idput.h"
 #include "memcasecmp.h"
+#include "mzm.h"
 #include "platform.h"
 #include "rasm.h"
 #include "robot.h"
@@ -1962,6 +1963,12 @@ static int save_game_read(struct world *mzx_world,
   return 0;
 }
 
+static int save_pending_read(struct world *mzx_world,
+ const struct function_counter *counter, const char *name, int id)
+{
+  return save_world_async_pending();
+}
+
 static int load_counters_read(struct world *mzx_world,
  const struct function_counter *counter, const char *name, int id)
 {
@@ -2737,6 +2744,7 @@ static const struct function_counter builtin_counters[] =
   { "save_bc?",         V270,   save_bc_read,         NULL },
   { "save_counters",    V290,   save_counters_read,   NULL },
   { "save_game",        V268,   save_game_read,       NULL },
+  { "save_pending",     V293,   save_pending_read,    NULL },
   { "save_robot?",      V270,   save_robot_read,      NULL },
   { "scrolledx",        V251s1, scrolledx_read,       NULL },
   { "scrolledy",        V251s1, scrolledy_read,       NULL },
@@ -2952,10 +2960,103 @@ static struct robot *get_robot_by_id(struct world *mzx_world, int id)
     return NULL;
 }
 
+/**
+ * Robots that stream data out of files tend to reopen the same handful of
+ * files over and over. Closed FREAD handles are kept open here, most recently
+ * used first, and reused if the same file is opened again and hasn't changed.
+ */
+#define FREAD_CACHE_SIZE 4
+
+struct fread_cache_entry
+{
+  char path[MAX_PATH];
+  struct stat stat_info;
+  vfile *vf;
+};
+
+static struct fread_cache_entry fread_cache[FREAD_CACHE_SIZE];
+
+static boolean fread_cache_stat_matches(const struct stat *a,
+ const struct stat *b)
+{
+  return a->st_size == b->st_size && a->st_mtime == b->st_mtime &&
+   a->st_ino == b->st_ino && a->st_dev == b->st_dev;
+}
+
+/**
+ * Take a cached handle for a translated path, if there is one. The handle
+ * is rewound so it behaves exactly like a newly opened file.
+ */
+static vfile *fread_cache_get(const char *path)
+{
+  struct stat cached_info;
+  struct stat stat_info;
+  vfile *vf;
+  int i;
+
+  for(i = 0; i < FREAD_CACHE_SIZE; i++)
+    if(fread_cache[i].vf && !strcmp(fread_cache[i].path, path))
+      break;
+
+  if(i >= FREAD_CACHE_SIZE)
+    return NULL;
+
+  vf = fread_cache[i].vf;
+  cached_info = fread_cache[i].stat_info;
+  memmove(fread_cache + i, fread_cache + i + 1,
+   (FREAD_CACHE_SIZE - i - 1) * sizeof(struct fread_cache_entry));
+  fread_cache[FREAD_CACHE_SIZE - 1].vf = NULL;
+
+  if(vstat(path, &stat_info) ||
+   !fread_cache_stat_matches(&stat_info, &cached_info))
+  {
+    vfclose(vf);
+    return NULL;
+  }
+
+  vrewind(vf);
+  return vf;
+}
+
+static void fread_cache_put(const char *path, vfile *vf)
+{
+  struct stat stat_info;
+  size_t len = strlen(path);
+
+  if(len >= MAX_PATH || vstat(path, &stat_info) || !S_ISREG(stat_info.st_mode))
+  {
+    vfclose(vf);
+    return;
+  }
+
+  if(fread_cache[FREAD_CACHE_SIZE - 1].vf)
+    vfclose(fread_cache[FREAD_CACHE_SIZE - 1].vf);
+
+  memmove(fread_cache + 1, fread_cache,
+   (FREAD_CACHE_SIZE - 1) * sizeof(struct fread_cache_entry));
+
+  memcpy(fread_cache[0].path, path, len + 1);
+  fread_cache[0].stat_info = stat_info;
+  fread_cache[0].vf = vf;
+}
+
+void fread_cache_clear(void)
+{
+  int i;
+
+  for(i = 0; i < FREAD_CACHE_SIZE; i++)
+  {
+    if(fread_cache[i].vf)
+      vfclose(fread_cache[i].vf);
+
+    fread_cache[i].vf = NULL;
+  }
+}
+
 static void fread_close(struct world *mzx_world)
 {
   if(!mzx_world->input_is_dir && mzx_world->input_file)
-    vfclose(mzx_world->input_file);
+    fread_cache_put(mzx_world->input_file_name, mzx_world->input_file);
 
   if(mzx_world->input_is_dir && mzx_world->input_directory)
     vdir_close(mzx_world->input_directory);
@@ -2969,8 +3070,14 @@ static void fread_close(struct world *mzx_world)
 static void fwrite_close(struct world *mzx_world)
 {
   if(mzx_world->output_file)
+  {
     vfclose(mzx_world->output_file);
 
+    // The file might have been an MZM or a file that is open for reading.
+    mzm_cache_clear();
+    fread_cache_clear();
+  }
+
   mzx_world->output_file_name[0] = '\0';
   mzx_world->output_file = NULL;
   mzx_world->output_mode = FWRITE_MODE_UNKNOWN;
@@ -2984,6 +3091,10 @@ int set_counter_special(struct world *mzx_world, char *char_value,
   if(strlen(char_value) >= MAX_PATH)
     return 0; // haha nope
 
+  // Make sure a savegame being written in the background is complete before
+  // Robotic tries to access it.
+  save_world_async_wait();
+
   switch(mzx_world->special_counter_return)
   {
     case FOPEN_FREAD:
@@ -3009,7 +3120,11 @@ int set_counter_special(struct world *mzx_world, char *char_value,
         else
 
         if(err == -FSAFE_SUCCESS)
-          mzx_world->input_file = vfopen_unsafe(translated_path, "rb");
+        {
+          mzx_world->input_file = fread_cache_get(translated_path);
+          if(!mzx_world->input_file)
+            mzx_world->input_file = vfopen_unsafe(translated_path, "rb");
+        }
 
         if(mzx_world->input_file || mzx_world->input_is_dir)
           strcpy(mzx_world->input_file_name, translated_path);
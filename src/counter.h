@@ -42,6 +42,7 @@ CORE_LIBSPEC void set_counter(struct world *mzx_world, const char *name,
 CORE_LIBSPEC void new_counter(struct world *mzx_world, const char *name,
  int value, int id);
 CORE_LIBSPEC void sort_counter_list(struct counter_list *counter_list);
+CORE_LIBSPEC void fread_cache_clear(void);
 CORE_LIBSPEC void counter_list_size(struct counter_list *counter_list,
  size_t *list_size, size_t *table_size, size_t *counters_size);
 
@@ -52,7 +53,7 @@ void mul_counter(struct world *mzx_world, const char *name, int value, int id);
 void div_counter(struct world *mzx_world, const char *name, int value, int id);
 void mod_counter(struct world *mzx_world, const char *name, int value, int id);
 
-int set_counter_special(struct world *mzx_world, char *char_value,
+CORE_LIBSPEC int set_counter_special(struct world *mzx_world, char *char_value,
  int value, int id);
 
 void load_new_counter(struct counter_list *counter_list, int index,
@@ -45,6 +45,7 @@ static const struct editor_config_info editor_conf_default =
   true,                         // editor_show_thing_toggles
   4,                            // editor_show_thing_blink_speed
   100,                          // Undo history size
+  64,                           // Undo history memory (MiB)
 
   // Defaults for new boards
   0,                            // viewport_x
@@ -431,6 +432,14 @@ static void config_undo_history_size(struct editor_config_info *conf,
     conf->undo_history_size = result;
 }
 
+static void config_undo_history_memory(struct editor_config_info *conf,
+ char *name, char *value, char *extended_data)
+{
+  int result;
+  if(config_int(&result, value, 0, 4095))
+    conf->undo_history_memory = result;
+}
+
 static void config_saved_positions(struct editor_config_info *conf,
  char *name, char *value, char *extended_data)
 {
@@ -781,6 +790,7 @@ static const struct editor_config_entry editor_config_options[] =
   { "palette_editor_hide_help", palette_editor_hide_help },
   { "robot_editor_hide_help", robot_editor_hide_help },
   { "saved_position!", config_saved_positions },
+  { "undo_history_memory", config_undo_history_memory },
   { "undo_history_size", config_undo_history_size },
   { "vlayer_position!", config_vlayer_positions },
 };
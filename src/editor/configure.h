@@ -72,6 +72,7 @@ struct editor_config_info
   boolean editor_show_thing_toggles;
   int editor_show_thing_blink_speed;
   int undo_history_size;
+  int undo_history_memory;
 
   // Defaults for new boards
   int viewport_x;
@@ -273,6 +273,17 @@ enum virtual_var
   VIR_RAM_DEBUGGER_ROBOTS,
   VIR_RAM_DEBUGGER_VARIABLES,
   VIR_RAM_EXTRAM_DELTA,
+  VIR_RAM_EXTRAM_RLE3,
+  VIR_RAM_EXTRAM_LZ,
+  VIR_RAM_EXTRAM_DEFLATE,
+  VIR_RAM_EXTRAM_RLE3_RATE,
+  VIR_RAM_EXTRAM_LZ_RATE,
+  VIR_RAM_EXTRAM_DEFLATE_RATE,
+  VIR_RAM_EXTRAM_PREFETCH,
+  VIR_RAM_EXTRAM_PREFETCH_HITS,
+  VIR_RAM_EXTRAM_PREFETCH_WAITS,
+  VIR_RAM_EXTRAM_PREFETCH_MISSES,
+  VIR_RAM_EXTRAM_PREFETCH_UNUSED,
   VIR_RAM_VIRTUAL_FILESYSTEM,
   VIR_RAM_VIRTUAL_FILESYSTEM_CACHED_ONLY,
 };
@@ -301,6 +312,17 @@ static const char * const virtual_var_names[] =
   "Debug (robots)*",
   "Debug (variables)*",
   "ExtRAM compression delta*",
+  "ExtRAM RLE3 (compressed)*",
+  "ExtRAM LZ (compressed)*",
+  "ExtRAM DEFLATE (compressed)*",
+  "ExtRAM RLE3 unpack (ns/KiB)*",
+  "ExtRAM LZ unpack (ns/KiB)*",
+  "ExtRAM DEFLATE unpack (ns/KiB)*",
+  "ExtRAM prefetched boards*",
+  "ExtRAM prefetch hits*",
+  "ExtRAM prefetch waits*",
+  "ExtRAM prefetch misses*",
+  "ExtRAM prefetch unused*",
   "Virtual filesystem (total)*",
   "Virtual filesystem (cached only)*",
 };
@@ -375,6 +397,17 @@ static const enum virtual_var world_ram_var_list[] =
   VIR_RAM_DEBUGGER_VARIABLES,
 #ifdef CONFIG_EXTRAM
   VIR_RAM_EXTRAM_DELTA,
+  VIR_RAM_EXTRAM_RLE3,
+  VIR_RAM_EXTRAM_LZ,
+  VIR_RAM_EXTRAM_DEFLATE,
+  VIR_RAM_EXTRAM_RLE3_RATE,
+  VIR_RAM_EXTRAM_LZ_RATE,
+  VIR_RAM_EXTRAM_DEFLATE_RATE,
+  VIR_RAM_EXTRAM_PREFETCH,
+  VIR_RAM_EXTRAM_PREFETCH_HITS,
+  VIR_RAM_EXTRAM_PREFETCH_WAITS,
+  VIR_RAM_EXTRAM_PREFETCH_MISSES,
+  VIR_RAM_EXTRAM_PREFETCH_UNUSED,
 #endif
   VIR_RAM_VIRTUAL_FILESYSTEM,
   VIR_RAM_VIRTUAL_FILESYSTEM_CACHED_ONLY,
@@ -528,8 +561,9 @@ struct debug_ram_data
   size_t video_layer_size;
   size_t debug_robot_total_size;
   size_t debug_variables_total_size;
-  size_t extram_uncompressed_size;
-  size_t extram_compressed_size;
+  struct extram_usage extram;
+  unsigned int extram_unpack_rate[NUM_EXTRAM_METHODS];
+  struct extram_prefetch_stats extram_prefetch;
   size_t virtual_filesystem_size;
   size_t virtual_filesystem_cached_size;
 };
@@ -574,6 +608,9 @@ static void update_ram_usage_data(struct world *mzx_world,
 
   memset(&ram_data, 0, sizeof(struct debug_ram_data));
 
+  // Boards being compressed in the background can't be inspected yet.
+  store_board_to_extram_wait();
+
   counter_list_size(&mzx_world->counter_list, &ram_data.counter_list_size,
    &ram_data.counter_table_size, &ram_data.counter_struct_size);
 
@@ -634,18 +671,18 @@ static void update_ram_usage_data(struct world *mzx_world,
         ram_data.scroll_sensor_total_size += sizeof(struct sensor);
 
 #ifdef CONFIG_EXTRAM
-    {
-      size_t c;
-      size_t u;
-      if(board_extram_usage(b, &c, &u))
-      {
-        ram_data.extram_compressed_size += c;
-        ram_data.extram_uncompressed_size += u;
-      }
-    }
+    board_extram_usage(b, &ram_data.extram);
 #endif
   }
 
+#ifdef CONFIG_EXTRAM
+  for(u = 0; u < NUM_EXTRAM_METHODS; u++)
+    ram_data.extram_unpack_rate[u] =
+     extram_method_unpack_rate((enum extram_method)u);
+
+  extram_prefetch_stats(&ram_data.extram_prefetch);
+#endif
+
   for(u = 0; u < graphics.layer_count; u++)
   {
     struct video_layer *layer = &(graphics.video_layers[u]);
@@ -966,8 +1003,41 @@ static void get_var_value(struct world *mzx_world, struct debug_var *v,
           value = ram_data.debug_variables_total_size;
           break;
         case VIR_RAM_EXTRAM_DELTA:
-          value = (int64_t)ram_data.extram_compressed_size -
-           (int64_t)ram_data.extram_uncompressed_size;
+          value = (int64_t)ram_data.extram.compressed -
+           (int64_t)ram_data.extram.uncompressed;
+          break;
+        case VIR_RAM_EXTRAM_RLE3:
+          value = ram_data.extram.method_compressed[EXTRAM_METHOD_RLE3];
+          break;
+        case VIR_RAM_EXTRAM_LZ:
+          value = ram_data.extram.method_compressed[EXTRAM_METHOD_LZ];
+          break;
+        case VIR_RAM_EXTRAM_DEFLATE:
+          value = ram_data.extram.method_compressed[EXTRAM_METHOD_DEFLATE];
+          break;
+        case VIR_RAM_EXTRAM_RLE3_RATE:
+          value = ram_data.extram_unpack_rate[EXTRAM_METHOD_RLE3];
+          break;
+        case VIR_RAM_EXTRAM_LZ_RATE:
+          value = ram_data.extram_unpack_rate[EXTRAM_METHOD_LZ];
+          break;
+        case VIR_RAM_EXTRAM_DEFLATE_RATE:
+          value = ram_data.extram_unpack_rate[EXTRAM_METHOD_DEFLATE];
+          break;
+        case VIR_RAM_EXTRAM_PREFETCH:
+          value = ram_data.extram_prefetch.cached_size;
+          break;
+        case VIR_RAM_EXTRAM_PREFETCH_HITS:
+          value = ram_data.extram_prefetch.hits;
+          break;
+        case VIR_RAM_EXTRAM_PREFETCH_WAITS:
+          value = ram_data.extram_prefetch.waits;
+          break;
+        case VIR_RAM_EXTRAM_PREFETCH_MISSES:
+          value = ram_data.extram_prefetch.misses;
+          break;
+        case VIR_RAM_EXTRAM_PREFETCH_UNUSED:
+          value = ram_data.extram_prefetch.unused;
           break;
         case VIR_RAM_VIRTUAL_FILESYSTEM:
           value = ram_data.virtual_filesystem_size;
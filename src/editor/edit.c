@@ -62,6 +62,7 @@
 #include "param.h"
 #include "robo_debug.h"
 #include "robot.h"
+#include "robot_search.h"
 #include "select.h"
 #include "sfx_edit.h"
 #include "undo.h"
@@ -82,6 +83,10 @@
 #define TEST_WORLD_FILENAME   "__test.mzx"
 #define TEST_WORLD_PATTERN    "__test%d.mzx"
 
+#define ROBOT_SEARCH_STRING_MAX  47
+#define ROBOT_SEARCH_MAX_RESULTS 1000
+#define ROBOT_SEARCH_CHOICE_SIZE 70
+
 static const char *const world_ext[] = { ".MZX", NULL };
 static const char *const mzb_ext[] = { ".MZB", NULL };
 static const char *const mzm_ext[] = { ".MZM", NULL };
@@ -177,6 +182,11 @@ struct editor_context
   struct undo_history *vlayer_history;
   boolean continue_mouse_history;
 
+  // Robot search
+  struct robot_search_index *robot_search;
+  char robot_search_string[ROBOT_SEARCH_STRING_MAX + 1];
+  boolean robot_search_case_sensitive;
+
   // Flash thing
   boolean flashing;
   enum thing flash_start;
@@ -203,6 +213,16 @@ struct editor_context
   boolean reload_after_testing;
 };
 
+/**
+ * Free the robot search index. This needs to be done whenever the world is
+ * cleared or reloaded.
+ */
+static void clear_robot_search(struct editor_context *editor)
+{
+  destruct_robot_search_index(editor->robot_search);
+  editor->robot_search = NULL;
+}
+
 /**
  * Wrapper for reload_world that also loads world-specific editor config files.
  */
@@ -216,6 +236,8 @@ static boolean editor_reload_world(struct editor_context *editor,
   struct stat file_info;
   boolean ignore;
 
+  clear_robot_search(editor);
+
   if(!reload_world(mzx_world, file, &ignore))
     return false;
 
@@ -593,6 +615,204 @@ static void editor_set_current_board(struct editor_context *editor,
   }
 }
 
+/**
+ * Copy text into a robot search result, escaping color codes. Every source
+ * char is displayed as exactly one char.
+ */
+static char *robot_search_copy(char *dest, const char *src, size_t src_len,
+ size_t width)
+{
+  size_t i;
+
+  for(i = 0; i < src_len && i < width; i++)
+  {
+    char c = src[i];
+
+    if(c == '~' || c == '@')
+      *(dest++) = c;
+    else
+
+    if((unsigned char)c < 32)
+      c = ' ';
+
+    *(dest++) = c;
+  }
+
+  for(; i < width; i++)
+    *(dest++) = ' ';
+
+  *dest = '\0';
+  return dest;
+}
+
+static void robot_search_format(struct world *mzx_world, char *dest,
+ const struct robot_search_result *result)
+{
+  const char *line_text = result->line_text;
+  size_t line_length = result->line_length;
+  struct robot *cur_robot;
+  char board_name[8];
+
+  if(result->board_id < 0)
+  {
+    cur_robot = &(mzx_world->global_robot);
+    snprintf(board_name, sizeof(board_name), "Global");
+  }
+  else
+  {
+    struct board *cur_board = mzx_world->board_list[result->board_id];
+    cur_robot = cur_board->robot_list[result->robot_id];
+    snprintf(board_name, sizeof(board_name), "#%d", result->board_id);
+  }
+
+  while(line_length && (*line_text == ' ' || *line_text == '\t'))
+  {
+    line_text++;
+    line_length--;
+  }
+
+  dest += sprintf(dest, "%-6s ", board_name);
+  dest = robot_search_copy(dest, cur_robot->robot_name,
+   strlen(cur_robot->robot_name), ROBOT_NAME_SIZE - 1);
+  dest += sprintf(dest, " %5d  ", result->line);
+  robot_search_copy(dest, line_text, line_length, ROBOT_SEARCH_CHOICE_SIZE - 29);
+}
+
+/**
+ * Go to the robot containing a robot search result.
+ */
+static void robot_search_goto(struct editor_context *editor,
+ const struct robot_search_result *result)
+{
+  context *ctx = (context *)editor;
+  struct world *mzx_world = ctx->world;
+  struct board *cur_board;
+  struct robot *cur_robot;
+
+  if(result->board_id < 0)
+  {
+    edit_global_robot(ctx);
+    editor->modified = true;
+    return;
+  }
+
+  if(result->board_id != mzx_world->current_board_id)
+    editor_set_current_board(editor, result->board_id, true);
+
+  if(editor->mode == EDIT_VLAYER)
+  {
+    set_editor_mode(editor, EDIT_BOARD);
+
+    // If there's a block action active, cancel it.
+    if(editor->block.selected)
+    {
+      editor->block.selected = false;
+      editor->cursor_mode = CURSOR_PLACE;
+    }
+  }
+
+  cur_board = mzx_world->current_board;
+  if(result->robot_id > cur_board->num_robots)
+    return;
+
+  cur_robot = cur_board->robot_list[result->robot_id];
+  if(!cur_robot)
+    return;
+
+  editor->cursor_x = cur_robot->xpos;
+  editor->cursor_y = cur_robot->ypos;
+
+  // This will get bounded by fix_scroll
+  editor->scroll_x = editor->cursor_x - 39;
+  editor->scroll_y = editor->cursor_y - editor->screen_height / 2;
+  fix_scroll(editor);
+}
+
+/**
+ * Search the programs of every robot in the world and list the lines that
+ * match. The index is kept between searches so only robots that changed
+ * since the last search need to be indexed again.
+ */
+static void robot_search(struct editor_context *editor)
+{
+  struct world *mzx_world = ((context *)editor)->world;
+  struct robot_search_result *results;
+  char (*choices)[ROBOT_SEARCH_CHOICE_SIZE * 2 + 1];
+  const char **choice_list;
+  size_t num_results;
+  size_t i;
+  char title[40];
+  int selected;
+
+  struct dialog di;
+  const char *case_opt[] = { "Case sensitive" };
+  int casesens = editor->robot_search_case_sensitive;
+  struct element *elements[] =
+  {
+    construct_check_box(2, 3, case_opt, 1, strlen(case_opt[0]), &casesens),
+    construct_button(60, 3, "Cancel", 1),
+    construct_input_box(2, 1, "Search: ", ROBOT_SEARCH_STRING_MAX,
+     editor->robot_search_string),
+    construct_button(60, 1, "Search", 0),
+  };
+  int result;
+
+  // Prevent previous keys from carrying through.
+  force_release_all_keys();
+
+  construct_dialog(&di, "Search All Robots", 5, 10, 70, 5,
+   elements, ARRAY_SIZE(elements), 2);
+
+  result = run_dialog(mzx_world, &di);
+  destruct_dialog(&di);
+
+  // Prevent UI keys from carrying through.
+  force_release_all_keys();
+
+  editor->robot_search_case_sensitive = casesens;
+  if(result || !editor->robot_search_string[0])
+    return;
+
+  if(!editor->robot_search)
+    editor->robot_search = construct_robot_search_index();
+
+  robot_search_update(editor->robot_search, mzx_world);
+  num_results = robot_search_find(editor->robot_search,
+   editor->robot_search_string, strlen(editor->robot_search_string),
+   !casesens, &results, ROBOT_SEARCH_MAX_RESULTS);
+
+  if(!num_results)
+  {
+    error("No robots contain the search string.",
+     ERROR_T_WARNING, ERROR_OPT_OK, 0x0000);
+    return;
+  }
+
+  choices = cmalloc(num_results * sizeof(*choices));
+  choice_list = cmalloc(num_results * sizeof(const char *));
+
+  for(i = 0; i < num_results; i++)
+  {
+    robot_search_format(mzx_world, choices[i], &(results[i]));
+    choice_list[i] = choices[i];
+  }
+
+  if(num_results >= ROBOT_SEARCH_MAX_RESULTS)
+    snprintf(title, sizeof(title), "First %u matches", (unsigned int)num_results);
+  else
+    snprintf(title, sizeof(title), "%u match(es)", (unsigned int)num_results);
+
+  selected = list_menu(choice_list, ROBOT_SEARCH_CHOICE_SIZE, title, 0,
+   (int)num_results, 2, 0);
+
+  if(selected >= 0)
+    robot_search_goto(editor, &(results[selected]));
+
+  free(choice_list);
+  free(choices);
+  free(results);
+}
+
 /**
  * Move the cursor on the board.
  */
@@ -1364,19 +1584,22 @@ static boolean editor_idle(context *ctx)
   if(!editor->board_history)
   {
     editor->board_history =
-     construct_board_undo_history(editor_conf->undo_history_size);
+     construct_board_undo_history(editor_conf->undo_history_size,
+      (size_t)editor_conf->undo_history_memory << 20);
   }
 
   if(!editor->overlay_history)
   {
     editor->overlay_history =
-     construct_layer_undo_history(editor_conf->undo_history_size);
+     construct_layer_undo_history(editor_conf->undo_history_size,
+      (size_t)editor_conf->undo_history_memory << 20);
   }
 
   if(!editor->vlayer_history)
   {
     editor->vlayer_history =
-     construct_layer_undo_history(editor_conf->undo_history_size);
+     construct_layer_undo_history(editor_conf->undo_history_size,
+      (size_t)editor_conf->undo_history_memory << 20);
   }
 
   fix_history(editor);
@@ -2764,6 +2987,12 @@ static boolean editor_key(context *ctx, int *key)
           editor->modified = true;
         }
         else
+
+        if(get_ctrl_status(keycode_internal))
+        {
+          robot_search(editor);
+        }
+        else
         {
           fill_area(mzx_world, buffer, editor->cursor_x, editor->cursor_y,
            editor->mode, editor->cur_history);
@@ -3345,6 +3574,7 @@ static boolean editor_key(context *ctx, int *key)
         // Clear world
         if(!confirm(mzx_world, "Clear ALL - Are you sure?"))
         {
+          clear_robot_search(editor);
           clear_world(mzx_world);
           create_blank_world(mzx_world);
 
@@ -3745,6 +3975,9 @@ static void editor_resume(context *ctx)
   struct world *mzx_world = ctx->world;
   boolean ignore;
 
+  // Testing may have changed or replaced any board.
+  clear_robot_search(editor);
+
   if(editor->reload_after_testing)
   {
     editor->reload_after_testing = false;
@@ -3820,6 +4053,8 @@ static void editor_destroy(context *ctx)
   // Free the robot debugger data
   free_breakpoints();
 
+  clear_robot_search(editor);
+
   insta_fadeout();
   set_screen_mode(0);
   default_palette();
@@ -3885,6 +4120,9 @@ static void __edit_world(context *parent, boolean reload_curr_file)
 
   editor->edit_menu = create_edit_menu((context *)editor);
 
+  // Set this before loading so the world is loaded for editing.
+  mzx_world->editing = true;
+
   // Reload the current world or create a blank world.
   if(curr_file[0] && vstat(curr_file, &stat_res))
     curr_file[0] = '\0';
@@ -3927,8 +4165,6 @@ static void __edit_world(context *parent, boolean reload_curr_file)
   fix_caption(editor);
 
   set_palette_intensity(100);
-
-  mzx_world->editing = true;
 }
 
 void editor_init(void)
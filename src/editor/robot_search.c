@@ -0,0 +1,778 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * World-wide search of robot programs for the editor.
+ *
+ * Every robot program in the world is a document in a trigram index. Each
+ * three character sequence of a case folded program is hashed to a bucket,
+ * and each bucket has a sorted list of the documents containing it. A query
+ * only needs to look at the documents found in all of its own buckets.
+ * Buckets are shared by unrelated trigrams, so those documents are then
+ * verified with string_search.
+ *
+ * The index is refreshed before each search instead of being hooked into
+ * every place a robot can be modified. Each program is fingerprinted, and
+ * only programs whose fingerprint changed are reindexed. Fingerprinting a
+ * board requires retrieving it from extram, so a refresh only rescans the
+ * current board, the board that was current at the previous refresh, and
+ * boards whose robot list or program lengths no longer match the index.
+ * The index must be destroyed when the world is cleared or reloaded, since
+ * the addresses of boards and robots may be reused.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../board_struct.h"
+#include "../extmem.h"
+#include "../memcasecmp.h"
+#include "../robot_struct.h"
+#include "../util.h"
+
+#ifndef CONFIG_DEBYTECODE
+#include "../legacy_rasm.h"
+#endif
+
+#include "robot_search.h"
+#include "stringsearch.h"
+
+#define ROBOT_SEARCH_BUCKET_BITS 16
+#define ROBOT_SEARCH_BUCKETS (1 << ROBOT_SEARCH_BUCKET_BITS)
+#define ROBOT_SEARCH_NO_DOC UINT32_MAX
+
+struct robot_search_postings
+{
+  uint32_t *docs;
+  uint32_t count;
+  uint32_t alloc;
+};
+
+struct robot_search_doc
+{
+  char *text;
+  size_t length;
+  uint64_t fingerprint;
+  int program_length;
+  uint16_t *buckets;
+  uint32_t num_buckets;
+};
+
+struct robot_search_entry
+{
+  const struct robot *robot;
+  int program_length;
+  uint32_t doc;
+};
+
+struct robot_search_board
+{
+  const struct board *board;
+  struct robot_search_entry *robots;
+  int num_robots;
+};
+
+struct robot_search_index
+{
+  struct robot_search_postings *postings;
+  struct robot_search_doc *docs;
+  uint32_t *free_docs;
+  uint8_t *candidates;
+  uint32_t num_docs;
+  uint32_t num_free_docs;
+  uint32_t docs_alloc;
+
+  struct robot_search_entry global_robot;
+  struct robot_search_board *boards;
+  const struct board *last_current_board;
+  int num_boards;
+};
+
+struct robot_search_query
+{
+  const char *str;
+  size_t str_len;
+  const struct string_search_data *data;
+  boolean ignore_case;
+
+  struct robot_search_result *results;
+  size_t num_results;
+  size_t results_alloc;
+  size_t max_results;
+};
+
+static inline unsigned int robot_search_bucket(const char *pos)
+{
+  uint32_t trigram =
+   (memtolower(pos[0]) << 16) | (memtolower(pos[1]) << 8) | memtolower(pos[2]);
+
+  return (trigram * 2654435761u) >> (32 - ROBOT_SEARCH_BUCKET_BITS);
+}
+
+/**
+ * Find the position of a document in a posting list, or the position it
+ * should be inserted at if it isn't in the list.
+ */
+static uint32_t robot_search_postings_find(
+ const struct robot_search_postings *p, uint32_t doc)
+{
+  uint32_t a = 0;
+  uint32_t b = p->count;
+
+  while(a < b)
+  {
+    uint32_t mid = a + (b - a) / 2;
+    if(p->docs[mid] < doc)
+      a = mid + 1;
+    else
+      b = mid;
+  }
+  return a;
+}
+
+static void robot_search_postings_add(struct robot_search_postings *p,
+ uint32_t doc)
+{
+  uint32_t pos = p->count;
+
+  if(p->count && p->docs[p->count - 1] > doc)
+    pos = robot_search_postings_find(p, doc);
+
+  if(p->count >= p->alloc)
+  {
+    p->alloc = p->alloc ? p->alloc * 2 : 8;
+    p->docs = (uint32_t *)crealloc(p->docs, p->alloc * sizeof(uint32_t));
+  }
+
+  if(pos < p->count)
+    memmove(p->docs + pos + 1, p->docs + pos, (p->count - pos) * sizeof(uint32_t));
+
+  p->docs[pos] = doc;
+  p->count++;
+}
+
+static void robot_search_postings_remove(struct robot_search_postings *p,
+ uint32_t doc)
+{
+  uint32_t pos = robot_search_postings_find(p, doc);
+
+  if(pos < p->count && p->docs[pos] == doc)
+  {
+    p->count--;
+    memmove(p->docs + pos, p->docs + pos + 1, (p->count - pos) * sizeof(uint32_t));
+  }
+}
+
+/**
+ * Add a document to the index. The index takes ownership of the text.
+ */
+static uint32_t robot_search_add_doc(struct robot_search_index *idx,
+ char *text, size_t length)
+{
+  uint8_t found[ROBOT_SEARCH_BUCKETS / 8];
+  struct robot_search_doc *doc;
+  uint32_t num_buckets = 0;
+  uint32_t id;
+  size_t i;
+  size_t j;
+
+  memset(found, 0, sizeof(found));
+  for(i = 0; i + 3 <= length; i++)
+  {
+    unsigned int bucket = robot_search_bucket(text + i);
+    uint8_t bit = 1 << (bucket & 7);
+
+    if(!(found[bucket >> 3] & bit))
+    {
+      found[bucket >> 3] |= bit;
+      num_buckets++;
+    }
+  }
+
+  if(idx->num_free_docs)
+  {
+    id = idx->free_docs[--idx->num_free_docs];
+  }
+  else
+  {
+    if(idx->num_docs >= idx->docs_alloc)
+    {
+      idx->docs_alloc = idx->docs_alloc ? idx->docs_alloc * 2 : 64;
+      idx->docs = (struct robot_search_doc *)crealloc(idx->docs,
+       idx->docs_alloc * sizeof(struct robot_search_doc));
+      idx->free_docs = (uint32_t *)crealloc(idx->free_docs,
+       idx->docs_alloc * sizeof(uint32_t));
+      idx->candidates = (uint8_t *)crealloc(idx->candidates, idx->docs_alloc);
+    }
+    id = idx->num_docs++;
+  }
+
+  doc = &(idx->docs[id]);
+  doc->text = text;
+  doc->length = length;
+  doc->fingerprint = 0;
+  doc->program_length = 0;
+  doc->buckets = NULL;
+  doc->num_buckets = num_buckets;
+
+  if(num_buckets)
+    doc->buckets = (uint16_t *)cmalloc(num_buckets * sizeof(uint16_t));
+
+  // Scanning the bitmap produces the buckets in order.
+  for(i = 0, j = 0; i < sizeof(found); i++)
+  {
+    unsigned int bucket = i * 8;
+    uint8_t bits = found[i];
+
+    for(; bits; bits >>= 1, bucket++)
+    {
+      if(bits & 1)
+      {
+        doc->buckets[j++] = bucket;
+        robot_search_postings_add(&(idx->postings[bucket]), id);
+      }
+    }
+  }
+  return id;
+}
+
+static void robot_search_remove_doc(struct robot_search_index *idx,
+ uint32_t id)
+{
+  struct robot_search_doc *doc = &(idx->docs[id]);
+  uint32_t i;
+
+  for(i = 0; i < doc->num_buckets; i++)
+    robot_search_postings_remove(&(idx->postings[doc->buckets[i]]), id);
+
+  free(doc->text);
+  free(doc->buckets);
+  memset(doc, 0, sizeof(struct robot_search_doc));
+
+  idx->free_docs[idx->num_free_docs++] = id;
+}
+
+/**
+ * Mark every document that may contain the query in idx->candidates.
+ * Returns the number of candidate documents.
+ */
+static uint32_t robot_search_candidates(struct robot_search_index *idx,
+ const char *str, size_t str_len)
+{
+  struct robot_search_postings **lists;
+  uint32_t *docs;
+  uint32_t num_docs;
+  size_t num_lists = 0;
+  size_t i;
+  size_t j;
+
+  if(!idx->num_docs)
+    return 0;
+
+  memset(idx->candidates, 0, idx->num_docs);
+
+  if(str_len < 3)
+  {
+    // Too short to have trigrams; every document is a candidate.
+    num_docs = 0;
+    for(i = 0; i < idx->num_docs; i++)
+    {
+      if(idx->docs[i].text)
+      {
+        idx->candidates[i] = 1;
+        num_docs++;
+      }
+    }
+    return num_docs;
+  }
+
+  // Get the unique posting lists for the query, shortest first.
+  lists = (struct robot_search_postings **)cmalloc((str_len - 2) *
+   sizeof(struct robot_search_postings *));
+
+  for(i = 0; i + 3 <= str_len; i++)
+  {
+    struct robot_search_postings *p =
+     &(idx->postings[robot_search_bucket(str + i)]);
+
+    for(j = 0; j < num_lists; j++)
+      if(lists[j] == p)
+        break;
+
+    if(j < num_lists)
+      continue;
+
+    for(j = num_lists; j > 0 && lists[j - 1]->count > p->count; j--)
+      lists[j] = lists[j - 1];
+
+    lists[j] = p;
+    num_lists++;
+  }
+
+  num_docs = lists[0]->count;
+  if(!num_docs)
+  {
+    free(lists);
+    return 0;
+  }
+
+  docs = (uint32_t *)cmalloc(num_docs * sizeof(uint32_t));
+  memcpy(docs, lists[0]->docs, num_docs * sizeof(uint32_t));
+
+  for(i = 1; i < num_lists && num_docs; i++)
+  {
+    const struct robot_search_postings *p = lists[i];
+    uint32_t pos = 0;
+    uint32_t out = 0;
+
+    for(j = 0; j < num_docs && pos < p->count; j++)
+    {
+      while(pos < p->count && p->docs[pos] < docs[j])
+        pos++;
+
+      if(pos < p->count && p->docs[pos] == docs[j])
+        docs[out++] = docs[j];
+    }
+    num_docs = out;
+  }
+
+  for(i = 0; i < num_docs; i++)
+    idx->candidates[docs[i]] = 1;
+
+  free(lists);
+  free(docs);
+  return num_docs;
+}
+
+/**
+ * Add a result for every line of a document containing the query.
+ * Returns false if the result limit has been reached.
+ */
+static boolean robot_search_find_doc(struct robot_search_query *q,
+ const struct robot_search_doc *doc, int board_id, int robot_id)
+{
+  const char *text = doc->text;
+  const char *end = text + doc->length;
+  const char *counted = text;
+  const char *pos = text;
+  int line = 1;
+
+  while(pos < end)
+  {
+    struct robot_search_result *result;
+    const char *found;
+    const char *line_start;
+    const char *line_end;
+
+    found = (const char *)string_search(pos, end - pos, q->str, q->str_len,
+     q->data, q->ignore_case);
+    if(!found)
+      break;
+
+    line_start = found;
+    while(line_start > text && line_start[-1] != '\n')
+      line_start--;
+
+    while(counted < line_start)
+    {
+      const char *next = (const char *)memchr(counted, '\n',
+       line_start - counted);
+      if(!next)
+        break;
+
+      counted = next + 1;
+      line++;
+    }
+
+    line_end = (const char *)memchr(found, '\n', end - found);
+    if(!line_end)
+      line_end = end;
+
+    if(q->num_results >= q->results_alloc)
+    {
+      q->results_alloc = q->results_alloc ? q->results_alloc * 2 : 32;
+      q->results = (struct robot_search_result *)crealloc(q->results,
+       q->results_alloc * sizeof(struct robot_search_result));
+    }
+
+    result = &(q->results[q->num_results++]);
+    result->board_id = board_id;
+    result->robot_id = robot_id;
+    result->line = line;
+    result->line_text = line_start;
+    result->line_length = line_end - line_start;
+
+    if(q->num_results >= q->max_results)
+      return false;
+
+    pos = line_end + 1;
+  }
+  return true;
+}
+
+static boolean robot_search_find_entry(struct robot_search_index *idx,
+ struct robot_search_query *q, const struct robot_search_entry *entry,
+ int board_id, int robot_id)
+{
+  if(entry->doc == ROBOT_SEARCH_NO_DOC || !idx->candidates[entry->doc])
+    return true;
+
+  return robot_search_find_doc(q, &(idx->docs[entry->doc]), board_id, robot_id);
+}
+
+/**
+ * Search the index for a string. Results are provided in world order: the
+ * global robot first, then each board's robots by robot ID. Each line is
+ * only reported once. The result array must be freed by the caller.
+ */
+size_t robot_search_find(struct robot_search_index *idx,
+ const char *str, size_t str_len, boolean ignore_case,
+ struct robot_search_result **results, size_t max_results)
+{
+  struct string_search_data data;
+  struct robot_search_query q;
+  int i;
+  int j;
+
+  *results = NULL;
+  if(!str_len || !max_results)
+    return 0;
+
+  if(!robot_search_candidates(idx, str, str_len))
+    return 0;
+
+  string_search_index(str, str_len, &data, ignore_case);
+
+  memset(&q, 0, sizeof(struct robot_search_query));
+  q.str = str;
+  q.str_len = str_len;
+  q.data = &data;
+  q.ignore_case = ignore_case;
+  q.max_results = max_results;
+
+  if(robot_search_find_entry(idx, &q, &(idx->global_robot), -1, 0))
+  {
+    for(i = 0; i < idx->num_boards; i++)
+    {
+      struct robot_search_board *slot = &(idx->boards[i]);
+
+      for(j = 1; j <= slot->num_robots; j++)
+        if(!robot_search_find_entry(idx, &q, &(slot->robots[j]), i, j))
+          break;
+
+      if(j <= slot->num_robots)
+        break;
+    }
+  }
+
+  *results = q.results;
+  return q.num_results;
+}
+
+/**
+ * Get the data used to identify changes to a robot's program. This doesn't
+ * access the program itself, so it is safe to use on boards in extram.
+ */
+static const char *robot_search_program(const struct robot *cur_robot,
+ int *length)
+{
+#ifdef CONFIG_DEBYTECODE
+  *length = cur_robot->program_source ? cur_robot->program_source_length : 0;
+  return cur_robot->program_source;
+#else
+  *length = cur_robot->program_bytecode ? cur_robot->program_bytecode_length : 0;
+  return cur_robot->program_bytecode;
+#endif
+}
+
+/**
+ * Get a copy of the searchable text of a program. Returns false if the
+ * program has no text.
+ */
+static boolean robot_search_program_text(const char *program, int length,
+ char **_text, size_t *_text_length)
+{
+#ifdef CONFIG_DEBYTECODE
+  char *text;
+
+  if(length <= 0)
+    return false;
+
+  text = (char *)cmalloc(length);
+  memcpy(text, program, length);
+
+  *_text = text;
+  *_text_length = length;
+  return true;
+#else
+  char *text;
+  int text_length;
+
+  if(length < 2)
+    return false;
+
+  disassemble_program((char *)program, length, &text, &text_length, NULL, NULL);
+  if(text_length <= 0)
+  {
+    free(text);
+    return false;
+  }
+
+  *_text = text;
+  *_text_length = text_length;
+  return true;
+#endif
+}
+
+/**
+ * FNV-1a (64-bit).
+ */
+static uint64_t robot_search_fingerprint(const char *data, size_t length)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  size_t i;
+
+  for(i = 0; i < length; i++)
+  {
+    hash ^= (uint8_t)data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static void robot_search_clear_entry(struct robot_search_index *idx,
+ struct robot_search_entry *entry)
+{
+  if(entry->doc != ROBOT_SEARCH_NO_DOC)
+    robot_search_remove_doc(idx, entry->doc);
+
+  entry->robot = NULL;
+  entry->program_length = 0;
+  entry->doc = ROBOT_SEARCH_NO_DOC;
+}
+
+static void robot_search_update_robot(struct robot_search_index *idx,
+ struct robot_search_entry *entry, const struct robot *cur_robot)
+{
+  struct robot_search_doc *doc;
+  const char *program;
+  uint64_t fingerprint;
+  size_t text_length;
+  char *text;
+  int length;
+
+  if(!cur_robot)
+  {
+    robot_search_clear_entry(idx, entry);
+    return;
+  }
+
+  program = robot_search_program(cur_robot, &length);
+  fingerprint = robot_search_fingerprint(program, length);
+
+  entry->robot = cur_robot;
+  entry->program_length = length;
+
+  if(entry->doc != ROBOT_SEARCH_NO_DOC)
+  {
+    doc = &(idx->docs[entry->doc]);
+    if(doc->fingerprint == fingerprint && doc->program_length == length)
+      return;
+
+    robot_search_remove_doc(idx, entry->doc);
+    entry->doc = ROBOT_SEARCH_NO_DOC;
+  }
+
+  if(!robot_search_program_text(program, length, &text, &text_length))
+    return;
+
+  entry->doc = robot_search_add_doc(idx, text, text_length);
+  doc = &(idx->docs[entry->doc]);
+  doc->fingerprint = fingerprint;
+  doc->program_length = length;
+}
+
+static void robot_search_clear_board(struct robot_search_index *idx,
+ struct robot_search_board *slot)
+{
+  int i;
+
+  for(i = 1; i <= slot->num_robots; i++)
+    robot_search_clear_entry(idx, &(slot->robots[i]));
+
+  free(slot->robots);
+  slot->robots = NULL;
+  slot->num_robots = 0;
+  slot->board = NULL;
+}
+
+static boolean robot_search_board_unchanged(
+ const struct robot_search_board *slot, const struct board *cur_board)
+{
+  int length;
+  int i;
+
+  if(slot->board != cur_board || cur_board->deferred ||
+   slot->num_robots != cur_board->num_robots)
+    return false;
+
+  for(i = 1; i <= slot->num_robots; i++)
+  {
+    const struct robot *cur_robot = cur_board->robot_list[i];
+
+    length = 0;
+    if(cur_robot)
+      robot_search_program(cur_robot, &length);
+
+    if(slot->robots[i].robot != cur_robot ||
+     slot->robots[i].program_length != length)
+      return false;
+  }
+  return true;
+}
+
+static void robot_search_update_board(struct robot_search_index *idx,
+ struct robot_search_board *slot, struct board *cur_board, boolean is_current,
+ boolean was_current)
+{
+  int num_robots;
+  int i;
+
+  if(!cur_board)
+  {
+    robot_search_clear_board(idx, slot);
+    return;
+  }
+
+  if(!is_current && !was_current &&
+   robot_search_board_unchanged(slot, cur_board))
+    return;
+
+  if(!is_current)
+    retrieve_board_from_extram(cur_board);
+
+  num_robots = cur_board->num_robots;
+  if(num_robots != slot->num_robots)
+  {
+    for(i = num_robots + 1; i <= slot->num_robots; i++)
+      robot_search_clear_entry(idx, &(slot->robots[i]));
+
+    slot->robots = (struct robot_search_entry *)crealloc(slot->robots,
+     (num_robots + 1) * sizeof(struct robot_search_entry));
+
+    for(i = slot->num_robots + 1; i <= num_robots; i++)
+    {
+      slot->robots[i].robot = NULL;
+      slot->robots[i].program_length = 0;
+      slot->robots[i].doc = ROBOT_SEARCH_NO_DOC;
+    }
+    slot->num_robots = num_robots;
+  }
+
+  for(i = 1; i <= num_robots; i++)
+    robot_search_update_robot(idx, &(slot->robots[i]), cur_board->robot_list[i]);
+
+  slot->board = cur_board;
+
+  if(!is_current)
+    store_board_to_extram(cur_board);
+}
+
+/**
+ * Bring the index up to date with the robots in the world.
+ */
+void robot_search_update(struct robot_search_index *idx,
+ struct world *mzx_world)
+{
+  int num_boards = mzx_world->num_boards;
+  int i;
+
+  if(num_boards != idx->num_boards)
+  {
+    for(i = num_boards; i < idx->num_boards; i++)
+      robot_search_clear_board(idx, &(idx->boards[i]));
+
+    if(num_boards)
+    {
+      idx->boards = (struct robot_search_board *)crealloc(idx->boards,
+       num_boards * sizeof(struct robot_search_board));
+
+      for(i = idx->num_boards; i < num_boards; i++)
+        memset(&(idx->boards[i]), 0, sizeof(struct robot_search_board));
+    }
+    else
+    {
+      free(idx->boards);
+      idx->boards = NULL;
+    }
+    idx->num_boards = num_boards;
+  }
+
+  robot_search_update_robot(idx, &(idx->global_robot),
+   &(mzx_world->global_robot));
+
+  for(i = 0; i < num_boards; i++)
+  {
+    struct board *cur_board = mzx_world->board_list[i];
+
+    robot_search_update_board(idx, &(idx->boards[i]), cur_board,
+     cur_board == mzx_world->current_board,
+     cur_board == idx->last_current_board);
+  }
+  idx->last_current_board = mzx_world->current_board;
+}
+
+struct robot_search_index *construct_robot_search_index(void)
+{
+  struct robot_search_index *idx =
+   (struct robot_search_index *)ccalloc(1, sizeof(struct robot_search_index));
+
+  idx->postings = (struct robot_search_postings *)ccalloc(ROBOT_SEARCH_BUCKETS,
+   sizeof(struct robot_search_postings));
+  idx->global_robot.doc = ROBOT_SEARCH_NO_DOC;
+  return idx;
+}
+
+void destruct_robot_search_index(struct robot_search_index *idx)
+{
+  uint32_t i;
+
+  if(!idx)
+    return;
+
+  for(i = 0; i < idx->num_docs; i++)
+  {
+    free(idx->docs[i].text);
+    free(idx->docs[i].buckets);
+  }
+
+  for(i = 0; i < ROBOT_SEARCH_BUCKETS; i++)
+    free(idx->postings[i].docs);
+
+  for(i = 0; i < (uint32_t)idx->num_boards; i++)
+    free(idx->boards[i].robots);
+
+  free(idx->postings);
+  free(idx->docs);
+  free(idx->free_docs);
+  free(idx->candidates);
+  free(idx->boards);
+  free(idx);
+}
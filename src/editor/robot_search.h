@@ -0,0 +1,53 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __EDITOR_ROBOT_SEARCH_H
+#define __EDITOR_ROBOT_SEARCH_H
+
+#include "../compat.h"
+
+__M_BEGIN_DECLS
+
+#include <stddef.h>
+
+#include "../world_struct.h"
+
+struct robot_search_index;
+
+struct robot_search_result
+{
+  int board_id;           // -1 for the global robot.
+  int robot_id;
+  int line;               // Starting from 1.
+  const char *line_text;  // Valid until the next robot_search_update.
+  size_t line_length;
+};
+
+struct robot_search_index *construct_robot_search_index(void);
+void destruct_robot_search_index(struct robot_search_index *idx);
+
+void robot_search_update(struct robot_search_index *idx,
+ struct world *mzx_world);
+size_t robot_search_find(struct robot_search_index *idx,
+ const char *str, size_t str_len, boolean ignore_case,
+ struct robot_search_result **results, size_t max_results);
+
+__M_END_DECLS
+
+#endif /* __EDITOR_ROBOT_SEARCH_H */
@@ -17,6 +17,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <assert.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -34,6 +35,7 @@
 #include "../board.h"
 #include "../graphics.h"
 #include "../idarray.h"
+#include "../rle3.h"
 #include "../robot.h"
 #include "../util.h"
 #include "../world.h"
@@ -58,6 +60,9 @@
  *
  * A special case currently exists where the undo actions will operate
  * outside of the undo frame; moving the player on the board.
+ *
+ * Frames may report their memory usage from their update function. Histories
+ * with a memory limit discard their oldest frames to stay within it.
  */
 
 enum undo_frame_type
@@ -69,6 +74,7 @@ enum undo_frame_type
 struct undo_frame
 {
   enum undo_frame_type type;
+  size_t size;
 };
 
 struct undo_history
@@ -79,6 +85,8 @@ struct undo_history
   int first;
   int last;
   int size;
+  size_t total_memory;
+  size_t max_memory;
   void (*add_pos_function)(struct undo_frame *, int, int);
   void (*undo_function)(struct undo_frame *);
   void (*redo_function)(struct undo_frame *);
@@ -95,6 +103,8 @@ static struct undo_history *construct_undo_history(int max_size)
   h->first = -1;
   h->last = -1;
   h->size = max_size;
+  h->total_memory = 0;
+  h->max_memory = 0;
   h->add_pos_function = NULL;
   h->undo_function = NULL;
   h->redo_function = NULL;
@@ -103,12 +113,19 @@ static struct undo_history *construct_undo_history(int max_size)
   return h;
 }
 
+static void clear_undo_frame(struct undo_history *h, struct undo_frame *f)
+{
+  h->total_memory -= f->size;
+  h->clear_function(f);
+}
+
 static void add_undo_frame(struct undo_history *h, void *f)
 {
   struct undo_frame *temp;
   int i, j;
 
   h->current_frame = f;
+  h->current_frame->size = 0;
 
   if(h->current != h->last)
   {
@@ -138,7 +155,7 @@ static void add_undo_frame(struct undo_history *h, void *f)
     {
       temp = h->frames[i];
       h->frames[i] = NULL;
-      h->clear_function(temp);
+      clear_undo_frame(h, temp);
 
       i++;
       if(i == h->size)
@@ -164,7 +181,7 @@ static void add_undo_frame(struct undo_history *h, void *f)
   {
     // History full? Delete the first
     temp = h->frames[h->first];
-    h->clear_function(temp);
+    clear_undo_frame(h, temp);
 
     h->first++;
     if(h->first == h->size)
@@ -240,10 +257,36 @@ void add_undo_position(struct undo_history *h, int x, int y)
   }
 }
 
+/**
+ * Discard the oldest frames until the history fits in its memory limit.
+ * The current frame is always kept.
+ */
+static void trim_undo_history(struct undo_history *h)
+{
+  while(h->max_memory && h->total_memory > h->max_memory &&
+   h->first != -1 && h->first != h->current)
+  {
+    struct undo_frame *f = h->frames[h->first];
+    h->frames[h->first] = NULL;
+    clear_undo_frame(h, f);
+
+    h->first++;
+    if(h->first == h->size)
+      h->first = 0;
+  }
+}
+
 void update_undo_frame(struct undo_history *h)
 {
   if(h && h->current_frame)
-    h->update_function(h->current_frame);
+  {
+    struct undo_frame *f = h->current_frame;
+
+    h->total_memory -= f->size;
+    h->update_function(f);
+    h->total_memory += f->size;
+    trim_undo_history(h);
+  }
 }
 
 void destruct_undo_history(struct undo_history *h)
@@ -266,6 +309,128 @@ void destruct_undo_history(struct undo_history *h)
 }
 
 
+/**
+ * Large block frames store the area after the operation as an RLE3 stream and
+ * the area before the operation as an RLE3 stream of its XOR against the area
+ * after. Block operations usually leave most of the area unchanged, so the
+ * XOR delta is mostly zeroes. Planes that don't compress are stored as-is.
+ */
+struct undo_plane
+{
+  uint8_t *data;
+  size_t length;
+};
+
+static void pack_undo_plane(struct undo_plane *p, const void *src, size_t len)
+{
+  size_t packed_len = 0;
+
+  p->data = cmalloc(len);
+  if(len > 1)
+    packed_len = rle3_pack(p->data, len - 1, src, len);
+
+  if(packed_len)
+  {
+    p->data = crealloc(p->data, packed_len);
+    p->length = packed_len;
+  }
+  else
+  {
+    memcpy(p->data, src, len);
+    p->length = len;
+  }
+}
+
+static void unpack_undo_plane(const struct undo_plane *p, void *dest,
+ size_t len)
+{
+  if(p->length == len)
+  {
+    memcpy(dest, p->data, len);
+  }
+  else
+  {
+    boolean ret = rle3_unpack(dest, len, p->data, p->length);
+    assert(ret);
+    (void)ret;
+  }
+}
+
+static void free_undo_plane(struct undo_plane *p)
+{
+  free(p->data);
+  p->data = NULL;
+  p->length = 0;
+}
+
+static void xor_undo_plane(void *dest, const void *src, size_t len)
+{
+  uint8_t *d = dest;
+  const uint8_t *s = src;
+  size_t i;
+
+  for(i = 0; i < len; i++)
+    d[i] ^= s[i];
+}
+
+/**
+ * Pack the before and after copies of an area in place. The buffers are freed.
+ */
+static void pack_undo_planes(struct undo_plane *prev_planes,
+ struct undo_plane *current_planes, char **prev, char **current,
+ int count, size_t len)
+{
+  int i;
+
+  for(i = 0; i < count; i++)
+  {
+    pack_undo_plane(&(current_planes[i]), current[i], len);
+    xor_undo_plane(prev[i], current[i], len);
+    pack_undo_plane(&(prev_planes[i]), prev[i], len);
+
+    free(prev[i]);
+    free(current[i]);
+    prev[i] = NULL;
+    current[i] = NULL;
+  }
+}
+
+/**
+ * Unpack the after copy (and optionally, the before copy) of an area into
+ * newly allocated buffers.
+ */
+static void unpack_undo_planes(const struct undo_plane *prev_planes,
+ const struct undo_plane *current_planes, char **prev, char **current,
+ int count, size_t len)
+{
+  int i;
+
+  for(i = 0; i < count; i++)
+  {
+    current[i] = cmalloc(len);
+    unpack_undo_plane(&(current_planes[i]), current[i], len);
+
+    if(prev)
+    {
+      prev[i] = cmalloc(len);
+      unpack_undo_plane(&(prev_planes[i]), prev[i], len);
+      xor_undo_plane(prev[i], current[i], len);
+    }
+  }
+}
+
+static size_t undo_planes_size(const struct undo_plane *planes, int count)
+{
+  size_t size = 0;
+  int i;
+
+  for(i = 0; i < count; i++)
+    size += planes[i].length;
+
+  return size;
+}
+
+
 /******************************/
 /* Charset specific functions */
 /******************************/
@@ -367,6 +532,8 @@ void add_charset_undo_frame(struct undo_history *h, int charset, int first_char,
 // area of the board, and use fake boards and block copies. This version does
 // not require anything to be placed from the buffer
 
+#define BOARD_UNDO_PLANES 6
+
 // storage_obj is a pointer to a robot, scroll, or sensor
 struct board_undo_pos
 {
@@ -411,8 +578,148 @@ struct block_undo_frame
   struct board *src_board;
   struct board *prev_board;
   struct board *current_board;
+  boolean packed;
+  struct undo_plane prev_planes[BOARD_UNDO_PLANES];
+  struct undo_plane current_planes[BOARD_UNDO_PLANES];
 };
 
+static void get_board_undo_planes(struct board *b,
+ char *planes[BOARD_UNDO_PLANES])
+{
+  planes[0] = b->level_id;
+  planes[1] = b->level_color;
+  planes[2] = b->level_param;
+  planes[3] = b->level_under_id;
+  planes[4] = b->level_under_color;
+  planes[5] = b->level_under_param;
+}
+
+static void set_board_undo_planes(struct board *b,
+ char *planes[BOARD_UNDO_PLANES])
+{
+  b->level_id = planes[0];
+  b->level_color = planes[1];
+  b->level_param = planes[2];
+  b->level_under_id = planes[3];
+  b->level_under_color = planes[4];
+  b->level_under_param = planes[5];
+}
+
+static void pack_block_undo_frame(struct block_undo_frame *bf)
+{
+  char *prev[BOARD_UNDO_PLANES];
+  char *current[BOARD_UNDO_PLANES];
+
+  get_board_undo_planes(bf->prev_board, prev);
+  get_board_undo_planes(bf->current_board, current);
+
+  pack_undo_planes(bf->prev_planes, bf->current_planes, prev, current,
+   BOARD_UNDO_PLANES, bf->width * bf->height);
+
+  set_board_undo_planes(bf->prev_board, prev);
+  set_board_undo_planes(bf->current_board, current);
+  bf->packed = true;
+}
+
+/**
+ * Temporarily unpack the board data of a packed frame. The board data must be
+ * released with release_block_undo_frame when it is no longer needed.
+ */
+static void unpack_block_undo_frame(struct block_undo_frame *bf,
+ boolean unpack_prev)
+{
+  char *prev[BOARD_UNDO_PLANES];
+  char *current[BOARD_UNDO_PLANES];
+
+  unpack_undo_planes(bf->prev_planes, bf->current_planes,
+   unpack_prev ? prev : NULL, current, BOARD_UNDO_PLANES,
+   bf->width * bf->height);
+
+  if(unpack_prev)
+    set_board_undo_planes(bf->prev_board, prev);
+  set_board_undo_planes(bf->current_board, current);
+}
+
+static void release_block_undo_frame(struct block_undo_frame *bf)
+{
+  char *planes[BOARD_UNDO_PLANES];
+  int i;
+
+  get_board_undo_planes(bf->prev_board, planes);
+  for(i = 0; i < BOARD_UNDO_PLANES; i++)
+  {
+    free(planes[i]);
+    planes[i] = NULL;
+  }
+  set_board_undo_planes(bf->prev_board, planes);
+
+  get_board_undo_planes(bf->current_board, planes);
+  for(i = 0; i < BOARD_UNDO_PLANES; i++)
+  {
+    free(planes[i]);
+    planes[i] = NULL;
+  }
+  set_board_undo_planes(bf->current_board, planes);
+}
+
+static void free_block_undo_planes(struct block_undo_frame *bf)
+{
+  int i;
+
+  for(i = 0; i < BOARD_UNDO_PLANES; i++)
+  {
+    free_undo_plane(&(bf->prev_planes[i]));
+    free_undo_plane(&(bf->current_planes[i]));
+  }
+  bf->packed = false;
+}
+
+static size_t board_undo_storage_size(enum thing id, void *storage_obj)
+{
+  if(!storage_obj)
+    return 0;
+
+  if(is_robot(id))
+  {
+    struct robot *cur_robot = storage_obj;
+    return sizeof(struct robot) + cur_robot->program_bytecode_length +
+     cur_robot->program_source_length;
+  }
+  else
+
+  if(is_signscroll(id))
+  {
+    struct scroll *cur_scroll = storage_obj;
+    return sizeof(struct scroll) + cur_scroll->mesg_size;
+  }
+  else
+
+  if(id == SENSOR)
+    return sizeof(struct sensor);
+
+  return 0;
+}
+
+static size_t block_undo_board_size(struct board *b)
+{
+  size_t size = sizeof(struct board);
+  int i;
+
+  for(i = 1; i <= b->num_robots; i++)
+    if(b->robot_list[i])
+      size += board_undo_storage_size(ROBOT, b->robot_list[i]);
+
+  for(i = 1; i <= b->num_scrolls; i++)
+    if(b->scroll_list[i])
+      size += board_undo_storage_size(SCROLL, b->scroll_list[i]);
+
+  for(i = 1; i <= b->num_sensors; i++)
+    if(b->sensor_list[i])
+      size += sizeof(struct sensor);
+
+  return size;
+}
+
 static void alloc_board_undo_pos(struct board_undo_pos *pos)
 {
   // An undo position that is going to take a storage object needs
@@ -538,10 +845,16 @@ static void apply_board_undo(struct undo_frame *f)
     {
       struct block_undo_frame *current = (struct block_undo_frame *)f;
 
+      if(current->packed)
+        unpack_block_undo_frame(current, true);
+
       copy_board_to_board(mzx_world,
        current->prev_board, 0, current->src_board, current->src_offset,
        current->width, current->height
       );
+
+      if(current->packed)
+        release_block_undo_frame(current);
       break;
     }
   }
@@ -590,11 +903,17 @@ static void apply_board_redo(struct undo_frame *f)
       if(current->move_player)
         id_remove_top(mzx_world, mzx_world->player_x, mzx_world->player_y);
 
+      if(current->packed)
+        unpack_block_undo_frame(current, false);
+
       copy_board_to_board(current->mzx_world,
        current->current_board, 0, current->src_board, current->src_offset,
        current->width, current->height
       );
 
+      if(current->packed)
+        release_block_undo_frame(current);
+
       if(current->move_player)
         copy_replace_player(mzx_world, current->current_player_x,
          current->current_player_y);
@@ -613,10 +932,20 @@ static void apply_board_update(struct undo_frame *f)
     {
       // Trim extra size off of the allocation
       int size = current->prev_size;
+      int i;
 
       current->prev_alloc = size;
       current->prev =
        crealloc(current->prev, size * sizeof(struct board_undo_pos));
+
+      f->size = sizeof(struct board_undo_frame) +
+       size * sizeof(struct board_undo_pos) +
+       board_undo_storage_size((enum thing)current->replace.id,
+        current->replace.storage_obj);
+
+      for(i = 0; i < size; i++)
+        f->size += board_undo_storage_size((enum thing)current->prev[i].id,
+         current->prev[i].storage_obj);
       break;
     }
 
@@ -624,6 +953,14 @@ static void apply_board_update(struct undo_frame *f)
     {
       struct block_undo_frame *current = (struct block_undo_frame *)f;
 
+      // The previous contents are stored relative to the current contents,
+      // so restore them before replacing the current contents.
+      if(current->packed)
+      {
+        unpack_block_undo_frame(current, true);
+        free_block_undo_planes(current);
+      }
+
       // Update the block frame
       if(current->current_board)
         clear_board(current->current_board);
@@ -635,6 +972,14 @@ static void apply_board_update(struct undo_frame *f)
        current->src_board, current->src_offset, current->current_board, 0,
        current->width, current->height
       );
+
+      pack_block_undo_frame(current);
+
+      f->size = sizeof(struct block_undo_frame) +
+       undo_planes_size(current->prev_planes, BOARD_UNDO_PLANES) +
+       undo_planes_size(current->current_planes, BOARD_UNDO_PLANES) +
+       block_undo_board_size(current->prev_board) +
+       block_undo_board_size(current->current_board);
       break;
     }
   }
@@ -676,8 +1021,10 @@ static void apply_board_clear(struct undo_frame *f)
     case BLOCK_FRAME:
     {
       struct block_undo_frame *current = (struct block_undo_frame *)f;
+      free_block_undo_planes(current);
       clear_board(current->prev_board);
-      clear_board(current->current_board);
+      if(current->current_board)
+        clear_board(current->current_board);
     }
   }
   free(f);
@@ -742,12 +1089,14 @@ static void add_board_undo_position(struct undo_frame *f, int x, int y)
   current->prev = prev;
 }
 
-struct undo_history *construct_board_undo_history(int max_size)
+struct undo_history *construct_board_undo_history(int max_size,
+ size_t max_memory)
 {
   if(max_size)
   {
     struct undo_history *h = construct_undo_history(max_size);
 
+    h->max_memory = max_memory;
     h->add_pos_function = add_board_undo_position;
     h->undo_function = apply_board_undo;
     h->redo_function = apply_board_redo;
@@ -829,6 +1178,9 @@ void add_block_undo_frame(struct world *mzx_world, struct undo_history *h,
 
     current->prev_board = create_buffer_board(width, height);
     current->current_board = NULL;
+    current->packed = false;
+    memset(current->prev_planes, 0, sizeof(current->prev_planes));
+    memset(current->current_planes, 0, sizeof(current->current_planes));
 
     copy_board_to_board(mzx_world,
      src_board, src_offset, current->prev_board, 0,
@@ -875,8 +1227,65 @@ struct layer_undo_frame
   char *prev_colors;
   char *current_chars;
   char *current_colors;
+  boolean packed;
+  struct undo_plane prev_planes[2];
+  struct undo_plane current_planes[2];
 };
 
+static void pack_layer_undo_frame(struct layer_undo_frame *lf)
+{
+  char *prev[2] = { lf->prev_chars, lf->prev_colors };
+  char *current[2] = { lf->current_chars, lf->current_colors };
+
+  pack_undo_planes(lf->prev_planes, lf->current_planes, prev, current, 2,
+   lf->width * lf->height);
+
+  lf->prev_chars = lf->prev_colors = NULL;
+  lf->current_chars = lf->current_colors = NULL;
+  lf->packed = true;
+}
+
+/**
+ * Temporarily unpack the layer data of a packed frame. The layer data must be
+ * released with release_layer_undo_frame when it is no longer needed.
+ */
+static void unpack_layer_undo_frame(struct layer_undo_frame *lf,
+ boolean unpack_prev)
+{
+  char *prev[2] = { NULL, NULL };
+  char *current[2];
+
+  unpack_undo_planes(lf->prev_planes, lf->current_planes,
+   unpack_prev ? prev : NULL, current, 2, lf->width * lf->height);
+
+  lf->prev_chars = prev[0];
+  lf->prev_colors = prev[1];
+  lf->current_chars = current[0];
+  lf->current_colors = current[1];
+}
+
+static void release_layer_undo_frame(struct layer_undo_frame *lf)
+{
+  free(lf->prev_chars);
+  free(lf->prev_colors);
+  free(lf->current_chars);
+  free(lf->current_colors);
+  lf->prev_chars = lf->prev_colors = NULL;
+  lf->current_chars = lf->current_colors = NULL;
+}
+
+static void free_layer_undo_planes(struct layer_undo_frame *lf)
+{
+  int i;
+
+  for(i = 0; i < 2; i++)
+  {
+    free_undo_plane(&(lf->prev_planes[i]));
+    free_undo_plane(&(lf->current_planes[i]));
+  }
+  lf->packed = false;
+}
+
 static void apply_layer_undo(struct undo_frame *f)
 {
   switch(f->type)
@@ -902,11 +1311,17 @@ static void apply_layer_undo(struct undo_frame *f)
     {
       struct layer_undo_frame *lf = (struct layer_undo_frame *)f;
 
+      if(lf->packed)
+        unpack_layer_undo_frame(lf, true);
+
       copy_layer_buffer_to_buffer(
        lf->prev_chars, lf->prev_colors, lf->width, 0,
        lf->layer_chars, lf->layer_colors, lf->layer_width, lf->layer_offset,
        lf->width, lf->height
       );
+
+      if(lf->packed)
+        release_layer_undo_frame(lf);
       break;
     }
   }
@@ -939,11 +1354,17 @@ static void apply_layer_redo(struct undo_frame *f)
     {
       struct layer_undo_frame *lf = (struct layer_undo_frame *)f;
 
+      if(lf->packed)
+        unpack_layer_undo_frame(lf, false);
+
       copy_layer_buffer_to_buffer(
        lf->current_chars, lf->current_colors, lf->width, 0,
        lf->layer_chars, lf->layer_colors, lf->layer_width, lf->layer_offset,
        lf->width, lf->height
       );
+
+      if(lf->packed)
+        release_layer_undo_frame(lf);
       break;
     }
   }
@@ -962,6 +1383,9 @@ static void apply_layer_update(struct undo_frame *f)
       current->prev_alloc = size;
       current->prev =
        crealloc(current->prev, size * sizeof(struct layer_undo_pos));
+
+      f->size = sizeof(struct layer_undo_pos_frame) +
+       size * sizeof(struct layer_undo_pos);
       break;
     }
 
@@ -969,11 +1393,25 @@ static void apply_layer_update(struct undo_frame *f)
     {
       struct layer_undo_frame *lf = (struct layer_undo_frame *)f;
 
+      // The previous contents are stored relative to the current contents,
+      // so restore them before replacing the current contents.
+      if(lf->packed)
+      {
+        unpack_layer_undo_frame(lf, true);
+        free_layer_undo_planes(lf);
+      }
+
       copy_layer_buffer_to_buffer(
        lf->layer_chars, lf->layer_colors, lf->layer_width, lf->layer_offset,
        lf->current_chars, lf->current_colors, lf->width, 0,
        lf->width, lf->height
       );
+
+      pack_layer_undo_frame(lf);
+
+      f->size = sizeof(struct layer_undo_frame) +
+       undo_planes_size(lf->prev_planes, 2) +
+       undo_planes_size(lf->current_planes, 2);
       break;
     }
   }
@@ -993,6 +1431,7 @@ static void apply_layer_clear(struct undo_frame *f)
     case BLOCK_FRAME:
     {
       struct layer_undo_frame *current = (struct layer_undo_frame *)f;
+      free_layer_undo_planes(current);
       free(current->prev_chars);
       free(current->prev_colors);
       free(current->current_chars);
@@ -1036,12 +1475,14 @@ static void add_layer_undo_position(struct undo_frame *f, int x, int y)
   current->prev_alloc = prev_alloc;
 }
 
-struct undo_history *construct_layer_undo_history(int max_size)
+struct undo_history *construct_layer_undo_history(int max_size,
+ size_t max_memory)
 {
   if(max_size)
   {
     struct undo_history *h = construct_undo_history(max_size);
 
+    h->max_memory = max_memory;
     h->add_pos_function = add_layer_undo_position;
     h->undo_function = apply_layer_undo;
     h->redo_function = apply_layer_redo;
@@ -1102,6 +1543,9 @@ void add_layer_undo_frame(struct undo_history *h, char *layer_chars,
     current->prev_colors = cmalloc(width * height);
     current->current_chars = cmalloc(width * height);
     current->current_colors = cmalloc(width * height);
+    current->packed = false;
+    memset(current->prev_planes, 0, sizeof(current->prev_planes));
+    memset(current->current_planes, 0, sizeof(current->current_planes));
 
     copy_layer_buffer_to_buffer(
      layer_chars, layer_colors, layer_width, layer_offset,
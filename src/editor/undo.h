@@ -29,15 +29,17 @@ __M_BEGIN_DECLS
 
 struct undo_history;
 
-boolean apply_undo(struct undo_history *h);
-boolean apply_redo(struct undo_history *h);
+EDITOR_LIBSPEC boolean apply_undo(struct undo_history *h);
+EDITOR_LIBSPEC boolean apply_redo(struct undo_history *h);
 void add_undo_position(struct undo_history *h, int x, int y);
-void update_undo_frame(struct undo_history *h);
-void destruct_undo_history(struct undo_history *h);
+EDITOR_LIBSPEC void update_undo_frame(struct undo_history *h);
+EDITOR_LIBSPEC void destruct_undo_history(struct undo_history *h);
 
 struct undo_history *construct_charset_undo_history(int max_size);
-struct undo_history *construct_board_undo_history(int max_size);
-struct undo_history *construct_layer_undo_history(int max_size);
+struct undo_history *construct_board_undo_history(int max_size,
+ size_t max_memory);
+EDITOR_LIBSPEC struct undo_history *construct_layer_undo_history(
+ int max_size, size_t max_memory);
 
 void add_charset_undo_frame(struct undo_history *h, int charset, int first_char,
  int width, int height);
@@ -51,8 +53,9 @@ void add_block_undo_frame(struct world *mzx_world, struct undo_history *h,
 void add_layer_undo_pos_frame(struct undo_history *h, char *layer_chars,
  char *layer_colors, int layer_width, struct buffer_info *buffer, int x, int y);
 
-void add_layer_undo_frame(struct undo_history *h, char *layer_chars,
- char *layer_colors, int layer_width, int layer_offset, int width, int height);
+EDITOR_LIBSPEC void add_layer_undo_frame(struct undo_history *h,
+ char *layer_chars, char *layer_colors, int layer_width, int layer_offset,
+ int width, int height);
 
 enum text_undo_line_type
 {
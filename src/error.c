@@ -321,12 +321,6 @@ int error_message(enum error_code id, int parameter, const char *string)
       code = 0x0D02;
       break;
 
-    case E_WORLD_DECRYPT_WRITE_PROTECTED:
-      sprintf(error_mesg, "Cannot decrypt write-protected world; "
-       "check permissions");
-      code = 0x0DD5;
-      break;
-
     case E_WORLD_LOCKED:
       sprintf(error_mesg, "Cannot load password protected world");
       code = 0x0D02;
@@ -54,7 +54,6 @@ enum error_code
   E_WORLD_FILE_INVALID,
   E_WORLD_FILE_VERSION_OLD,
   E_WORLD_FILE_VERSION_TOO_RECENT,
-  E_WORLD_DECRYPT_WRITE_PROTECTED,
   E_WORLD_LOCKED,
   E_WORLD_IO_POST_VALIDATION,
   E_WORLD_IO_SAVING,
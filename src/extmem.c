@@ -19,15 +19,23 @@
 
 #include "error.h"
 #include "extmem.h"
+#include "platform.h"
 #include "platform_endian.h"
+#include "lz.h"
+#include "rle3.h"
 #include "robot.h"
 #include "util.h"
 #include "world_struct.h"
 
 #include <limits.h>
 #include <stdint.h>
+#include <time.h>
 #include <zlib.h>
 
+#ifndef _MSC_VER
+#include <unistd.h> /* _POSIX_TIMERS */
+#endif
+
 #ifdef CONFIG_NDS
 #include "../arch/nds/extmem.h"
 #define USE_PLATFORM_EXTRAM_ALLOC
@@ -69,6 +77,24 @@ static void *platform_extram_retrieve(void *buffer, size_t len) { return buffer;
 
 #define EXTRAM_ID ((uint32_t)(('E') | ('X' << 8) | ('T' << 16) | (0xfe << 24)))
 
+#ifndef PLATFORM_NO_THREADING
+#define EXTRAM_ASYNC
+#endif
+
+/* Prefetching decompresses boards into normal RAM ahead of time, which is
+ * only useful when the compressed boards are directly addressable. */
+#if defined(EXTRAM_ASYNC) && !defined(USE_PLATFORM_EXTRAM_STORE)
+#define EXTRAM_PREFETCH
+#endif
+
+#ifndef EXTRAM_PREFETCH_MAX
+/* Maximum number of boards to keep decompressed ahead of time. */
+#define EXTRAM_PREFETCH_MAX 16
+#endif
+
+/* Layers (6) and overlay (2). */
+#define EXTRAM_BOARD_PLANES 8
+
 #ifndef EXTRAM_COMPRESS_BOARDS_THRESHOLD
 /* Minimum size (in bytes) for board planes to be deflated. Blocks less than
  * this don't save much RAM in the long run and mostly slow down loading. */
@@ -81,6 +107,19 @@ static void *platform_extram_retrieve(void *buffer, size_t len) { return buffer;
 #define EXTRAM_COMPRESS_ROBOTS_THRESHOLD 16384
 #endif
 
+#ifndef EXTRAM_NS_PER_BYTE
+/* Nanoseconds of packing and unpacking time that one byte of saved RAM is
+ * worth when choosing a compression method for a buffer. Larger values favor
+ * smaller output, smaller values favor faster board switches. */
+#define EXTRAM_NS_PER_BYTE 64
+#endif
+
+#ifndef EXTRAM_PROBE_INTERVAL
+/* DEFLATE is used at least once every this many compressed buffers even when
+ * it doesn't look worth it, so its measured ratio and speed stay current. */
+#define EXTRAM_PROBE_INTERVAL 64
+#endif
+
 #ifndef EXTRAM_BUFFER_SIZE
 /* Size (in uint32_t) of extra memory deflate buffer. */
 #define EXTRAM_BUFFER_SIZE (4096 / sizeof(uint32_t))
@@ -96,6 +135,7 @@ enum extram_flags
   EXTRAM_DEFLATE          = (1 << 1), /* Buffer uses DEFLATE compression. */
   EXTRAM_PAGED            = (1 << 2), /* Buffer was paged to disk. (TODO?) */
   EXTRAM_RLE3             = (1 << 3), /* Buffer uses MZX RLE3 compression. */
+  EXTRAM_LZ               = (1 << 4), /* Buffer uses MZX LZ compression. */
 };
 
 struct extram_block
@@ -112,11 +152,208 @@ struct extram_data
 {
   z_stream z;
   size_t compression_threshold;
+  size_t fast_size;
   int status;
   boolean initialized;
   boolean free_data;
+  boolean keep_block;
+};
+
+#ifdef EXTRAM_ASYNC
+
+/**
+ * Stores are compressed by a worker thread so the game can continue on the
+ * next board while the previous board is compressed. The worker exits when
+ * it runs out of boards and is restarted by the next store.
+ */
+#ifdef EXTRAM_PREFETCH
+
+enum extram_prefetch_state
+{
+  PREFETCH_FREE,
+  PREFETCH_QUEUED,
+  PREFETCH_ACTIVE,
+  PREFETCH_READY,
+  PREFETCH_FAILED,
+};
+
+/**
+ * A board predicted to be entered soon. The worker decompresses copies of
+ * the board's layers while leaving the compressed blocks in place, so the
+ * board remains in extra RAM until it is retrieved.
+ */
+struct extram_prefetch
+{
+  struct board *board;
+  char *planes[EXTRAM_BOARD_PLANES];
+  size_t size;
+  enum extram_prefetch_state state;
+  boolean discard;
+};
+
+#endif /* EXTRAM_PREFETCH */
+
+struct extram_job
+{
+  struct board *board;
+  const char *file;
+  int line;
+#ifdef EXTRAM_PREFETCH
+  struct extram_prefetch *prefetch;
+#endif
+};
+
+struct extram_worker
+{
+  platform_thread thread;
+  platform_mutex lock;
+  platform_cond cond;
+  struct extram_job *queue;
+  size_t queue_size;
+  size_t queue_alloc;
+  struct board *active;
+  const char *failed_file;
+  int failed_line;
+  boolean init;
+  boolean running;
+  boolean joinable;
+  boolean failed;
+#ifdef EXTRAM_PREFETCH
+  struct extram_prefetch prefetch[EXTRAM_PREFETCH_MAX];
+  struct extram_prefetch_stats prefetch_stats;
+#endif
+};
+
+static struct extram_worker extram_worker;
+
+static void extram_stats_lock(void)
+{
+  if(extram_worker.init)
+    platform_mutex_lock(&(extram_worker.lock));
+}
+
+static void extram_stats_unlock(void)
+{
+  if(extram_worker.init)
+    platform_mutex_unlock(&(extram_worker.lock));
+}
+
+#else /* !EXTRAM_ASYNC */
+
+static void extram_stats_lock(void) {}
+static void extram_stats_unlock(void) {}
+
+#endif /* !EXTRAM_ASYNC */
+
+/* Running totals used to choose a compression method for each buffer. These
+ * are weighted by size and periodically halved so they follow recent data. */
+struct extram_rate
+{
+  uint64_t time;
+  uint64_t bytes;
+};
+
+struct extram_method_rate
+{
+  struct extram_rate pack;
+  struct extram_rate unpack;
+};
+
+/* Rough starting points in ns per KiB, weighted as 64 KiB of data so they
+ * are replaced by measurements quickly. */
+#define RATE(p, u) { { (p) * 64, 65536 }, { (u) * 64, 65536 } }
+
+static struct extram_method_rate method_rates[NUM_EXTRAM_METHODS] =
+{
+  RATE(4000, 1000),   /* RLE3 */
+  RATE(8000, 1000),   /* LZ */
+  RATE(40000, 8000),  /* DEFLATE */
 };
 
+#undef RATE
+
+#define EXTRAM_RATE_WINDOW (1 << 22)
+
+/* Expected DEFLATE size relative to the best fast method (fixed point 8.8).
+ * Like the rates, these are protected by the stats lock. */
+static uint32_t deflate_gain = 180;
+static unsigned int deflate_probe_count;
+
+/**
+ * Get a monotonic timestamp in nanoseconds. get_ticks() only has millisecond
+ * precision, which is too coarse to time individual buffers. The totals are
+ * still usable with the fallback, though.
+ */
+static uint64_t extram_time(void)
+{
+#if !defined(_WIN32) && defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && \
+ defined(CLOCK_MONOTONIC)
+  struct timespec tp;
+
+  if(!clock_gettime(CLOCK_MONOTONIC, &tp))
+    return (uint64_t)tp.tv_sec * 1000000000 + tp.tv_nsec;
+#endif
+  return get_ticks() * 1000000;
+}
+
+/**
+ * Add a new measurement to a running total.
+ */
+static void extram_tick_rate(struct extram_rate *rate, uint64_t start,
+ size_t len)
+{
+  uint64_t elapsed = extram_time() - start;
+
+  extram_stats_lock();
+  rate->time += elapsed;
+  rate->bytes += len;
+
+  while(rate->bytes > EXTRAM_RATE_WINDOW)
+  {
+    rate->time >>= 1;
+    rate->bytes >>= 1;
+  }
+  extram_stats_unlock();
+}
+
+/**
+ * Get the average time in nanoseconds per KiB from a running total.
+ */
+static uint32_t extram_rate(const struct extram_rate *rate)
+{
+  uint64_t value = rate->bytes ? rate->time * 1024 / rate->bytes : 0;
+  return MIN(value, UINT32_MAX);
+}
+
+/**
+ * Estimate the cost of storing a buffer with a given method in bytes, counting
+ * the time spent packing and unpacking it as RAM at EXTRAM_NS_PER_BYTE.
+ */
+static size_t extram_method_cost(enum extram_method method, size_t size,
+ size_t len)
+{
+  const struct extram_method_rate *rate = &(method_rates[method]);
+  uint64_t time;
+
+  extram_stats_lock();
+  time = (uint64_t)extram_rate(&rate->pack) * len / 1024 +
+   (uint64_t)extram_rate(&rate->unpack) * len / 1024;
+  extram_stats_unlock();
+
+  return size + (size_t)(time / EXTRAM_NS_PER_BYTE);
+}
+
+static int extram_block_method(const struct extram_block *block)
+{
+  if(block->flags & EXTRAM_RLE3)
+    return EXTRAM_METHOD_RLE3;
+  if(block->flags & EXTRAM_LZ)
+    return EXTRAM_METHOD_LZ;
+  if(block->flags & EXTRAM_DEFLATE)
+    return EXTRAM_METHOD_DEFLATE;
+  return -1;
+}
+
 #ifdef EXTRAM_STATS
 struct method_stats
 {
@@ -127,8 +364,13 @@ struct method_stats
   double worst_ratio;
 };
 
-static struct method_stats deflate_stats;
-static struct method_stats rle3_stats;
+static struct method_stats method_stats[NUM_EXTRAM_METHODS];
+static const char * const method_names[NUM_EXTRAM_METHODS] =
+{
+  "RLE3",
+  "LZ",
+  "DEFLATE",
+};
 
 static void tick_method_stats(struct method_stats *stats, size_t compressed,
  size_t uncompressed)
@@ -148,14 +390,12 @@ static void tick_method_stats(struct method_stats *stats, size_t compressed,
 
 static void tick_stats(struct extram_block *block)
 {
-  if(block->flags & EXTRAM_RLE3)
+  int method = extram_block_method(block);
+  if(method >= 0)
   {
-    tick_method_stats(&rle3_stats, block->compressed_size, block->uncompressed_size);
+    tick_method_stats(&method_stats[method], block->compressed_size,
+     block->uncompressed_size);
   }
-  else
-
-  if(block->flags & EXTRAM_DEFLATE)
-    tick_method_stats(&deflate_stats, block->compressed_size, block->uncompressed_size);
 }
 
 static void print_method_stats(struct method_stats *stats)
@@ -168,15 +408,16 @@ static void print_method_stats(struct method_stats *stats)
 
 static void print_stats(void)
 {
-  if(rle3_stats.total)
-  {
-    trace("--EXTRAM--   RLE3 stats:\n");
-    print_method_stats(&rle3_stats);
-  }
-  if(deflate_stats.total)
+  int i;
+  for(i = 0; i < NUM_EXTRAM_METHODS; i++)
   {
-    trace("--EXTRAM--   DEFLATE stats:\n");
-    print_method_stats(&deflate_stats);
+    if(method_stats[i].total)
+    {
+      trace("--EXTRAM--   %s stats (pack %u ns/KiB, unpack %u ns/KiB):\n",
+       method_names[i], (unsigned int)extram_rate(&method_rates[i].pack),
+       (unsigned int)extram_rate(&method_rates[i].unpack));
+      print_method_stats(&method_stats[i]);
+    }
   }
 }
 #endif
@@ -253,348 +494,6 @@ static boolean RLE2_unpack(uint8_t * RESTRICT dest, size_t dest_len,
 }
 #endif
 
-#define RLE3_MAX_CHAR   (0x3F)
-#define RLE3_MAX_BLOCK  (0x2000)
-
-#define RLE3_PACK_OVERHEAD(sz) (((sz) - 1 >= 0x20) ? 2 : 1)
-
-#define RLE3_PACK_SIZE(code, sz) do { \
-  size_t tmp = (sz) - 1; \
-  if(j >= data_len || !(sz)) \
-    return 0; \
-  if(tmp >= 0x20) \
-  { \
-    if(j + 1 >= data_len) \
-      return 0; \
-    data[j++] = code | 0x20 | (tmp >> 8); \
-    data[j++] = tmp & 0xFF; \
-  } \
-  else \
-    data[j++] = code | tmp; \
-} while(0)
-
-#define RLE3_PACK_CHAR(ch)      do{ data[j++] = (ch) & RLE3_MAX_CHAR; }while(0)
-#define RLE3_PACK_BLOCK(sz)     RLE3_PACK_SIZE(0x40, sz)
-#define RLE3_PACK_RUN_CHAR(sz)  RLE3_PACK_SIZE(0x80, sz)
-#define RLE3_PACK_RUN_BLOCK(sz) RLE3_PACK_SIZE(0xC0, sz)
-
-#define RLE3_UNPACK_SIZE(ch) \
- (((ch) & 0x20) && j < data_len ? ((((ch) & 0x1F) << 8) | data[j++]) + 1 : (ch & 0x1F) + 1)
-
-/**
- * Bound the maximum RLE3 stream size for an input of a given length. This will
- * always be slightly larger than the given input (regardless of how well the
- * input compresses).
- *
- * @param  src_len  length of the source data to be compressed.
- * @return          upper bound size of the corresponding RLE3 stream.
- */
-static inline size_t RLE3_bound(size_t src_len)
-{
-  return src_len + ((src_len + 8191u) & ~8192u) / 4096u;
-}
-
-/**
- * Pack a buffer with RLE3 compression, a run length encoding scheme designed
- * to address some of the major flaws of Alexis' RLE2 without losing much speed.
- * This is much faster than zlib DEFLATE and compresses board data fairly well.
- *
- * @param   data      buffer to output RLE3 stream to.
- * @param   data_len  size of RLE3 buffer.
- * @param   src       uncompressed source data.
- * @param   src_len   length of uncompressed source.
- * @return            final RLE3 stream length, or 0 on failure.
- */
-static size_t RLE3_pack(uint8_t * RESTRICT data, size_t data_len,
- const uint8_t *src, size_t src_len)
-{
-  ssize_t last_index[256];
-  uint8_t prev_chr = 0;
-  size_t i = 0;
-  size_t j = 0;
-
-  memset(last_index, 0xFF, sizeof(last_index));
-
-  while(i < src_len)
-  {
-    const uint8_t *block = src + i;
-    ssize_t block_start = i;
-    size_t block_len = 0;
-    size_t block_repeats = 0;
-    size_t block_repeat_len = 0;
-    size_t prev_repeats = 0;
-    boolean block_split = false;
-
-    while(i < src_len && block_len < RLE3_MAX_BLOCK)
-    {
-      if(src[i] == prev_chr)
-      {
-        // Is this a char run big enough to justify ending a block?
-        // A char run needs to be 3 or longer to break even in the worst case
-        // where the following block requires a 2 byte length (uncommon).
-        if(i + 2 < src_len &&
-         src[i + 1] == prev_chr &&
-         src[i + 2] == prev_chr)
-        {
-          prev_repeats = 3;
-          i += 3;
-          while(i < src_len && src[i] == prev_chr)
-            i++, prev_repeats++;
-
-          break;
-        }
-      }
-
-      // Is this the start of a block repeat?
-      if(last_index[src[i]] >= block_start && (size_t)last_index[src[i]] + 1 < i)
-      {
-        ssize_t block_break = last_index[src[i]];
-        size_t block_break_len = block_break - block_start;
-        const uint8_t *prev_pos = src + block_break;
-        const uint8_t *pos = src + i;
-        size_t k = i;
-        size_t x;
-        size_t savings;
-        size_t overhead;
-
-        block_repeat_len = i - block_break;
-
-        while(k < src_len)
-        {
-          for(x = 0; k + x < src_len && x < block_repeat_len; x++)
-            if(pos[x] != prev_pos[x])
-              break;
-
-          if(x < block_repeat_len)
-            break;
-
-          block_repeats++;
-          pos += block_repeat_len;
-          k += block_repeat_len;
-        }
-
-        savings = block_repeat_len * block_repeats;
-        /* Max overhead of following block + size of repeat code + overhead of
-         * splitting the current block (if applicable). */
-        overhead = 2 + RLE3_PACK_OVERHEAD(block_repeats) +
-         ((block_break_len) ? RLE3_PACK_OVERHEAD(block_break_len) : 0);
-
-        // Is this worth ending the block?
-        if(savings >= overhead)
-        {
-          if(block_break > block_start)
-          {
-            block_split = true;
-            block_len = block_break_len;
-          }
-          i += block_repeat_len * block_repeats;
-          break;
-        }
-        block_repeats = 0;
-      }
-
-      if(last_index[src[i]] < block_start)
-        last_index[src[i]] = i;
-
-      // Continue the block...
-      prev_chr = src[i++];
-      block_len++;
-    }
-
-    // Emit block(s) (never allow an individual block to go over RLE3_MAX_BLOCK).
-    while(block_len)
-    {
-      size_t pos_start = 0;
-      size_t pos_end = block_len;
-      boolean trim = false;
-
-      if(!block_repeats || block_split)
-      {
-        // If this block isn't required to be encoded as a single block it
-        // may be possible to replace part (or all) of it with literal chars,
-        // reducing the block length encoding overhead.
-        size_t old_overhead = RLE3_PACK_OVERHEAD(block_len);
-        size_t new_overhead;
-
-        while(pos_start < block_len && block[pos_start] <= RLE3_MAX_CHAR)
-          pos_start++;
-
-        if(pos_start < block_len)
-          while(pos_end > pos_start && block[pos_end - 1] <= RLE3_MAX_CHAR)
-            pos_end--;
-
-        new_overhead = pos_start < block_len ? RLE3_PACK_OVERHEAD(pos_end - pos_start) : 0;
-        if(new_overhead < old_overhead)
-          trim = true;
-      }
-
-      if(trim)
-      {
-        // Emit the head and tail of the block as literal chars.
-        size_t k = 0;
-        if(j + block_len > data_len)
-          return 0;
-
-        while(block[k] <= RLE3_MAX_CHAR && k < block_len)
-        {
-          RLE3_PACK_CHAR(block[k]);
-          k++;
-        }
-        if(pos_start < pos_end)
-        {
-          size_t middle_len = pos_end - pos_start;
-          RLE3_PACK_BLOCK(middle_len);
-          if(j + middle_len > data_len)
-            return 0;
-
-          memcpy(data + j, block + k, middle_len);
-          j += middle_len;
-          k += middle_len;
-        }
-
-        if(j + block_len > data_len)
-          return 0;
-
-        while(k < block_len)
-        {
-          RLE3_PACK_CHAR(block[k]);
-          k++;
-        }
-        //trace("--RLE3--     %s %zu\n", (pos_start < pos_end) ? "mixed" : "chars", block_len);
-      }
-      else
-      {
-        RLE3_PACK_BLOCK(block_len);
-        if(j + block_len > data_len)
-          return 0;
-
-        memcpy(data + j, block, block_len);
-        j += block_len;
-        //trace("--RLE3--     block %zu\n", block_len);
-      }
-
-      if(block_split)
-      {
-        block += block_len;
-        block_len = block_repeat_len;
-        block_split = false;
-      }
-      else
-        break;
-    }
-
-    // Emit block run.
-    while(block_repeats)
-    {
-      size_t pack_count = MIN(RLE3_MAX_BLOCK, block_repeats);
-      block_repeats -= pack_count;
-      RLE3_PACK_RUN_BLOCK(pack_count);
-      //trace("--RLE3--     repeat block x %zu\n", pack_count);
-    }
-
-    // Emit char run.
-    while(prev_repeats)
-    {
-      size_t pack_count = MIN(RLE3_MAX_BLOCK, prev_repeats);
-      prev_repeats -= pack_count;
-      RLE3_PACK_RUN_CHAR(pack_count);
-      //trace("--RLE3--     repeat %02Xh x %zu\n", (int)prev_chr, pack_count);
-    }
-  }
-  return j;
-}
-
-/**
- * Unpack an RLE3 stream.
- *
- * @param   dest      destination buffer for the unpacked stream.
- * @param   dest_len  size of destination buffer.
- * @param   data      source RLE3 stream to unpack.
- * @param   data_len  length of source RLE3 stream.
- * @return            `true` on success, otherwise `false`. This function will
- *                    fail if the unpacked stream size doesn't match `dest_len`.
- */
-static boolean RLE3_unpack(uint8_t * RESTRICT dest, size_t dest_len,
- const uint8_t *data, size_t data_len)
-{
-  const uint8_t *prev_block = NULL;
-  size_t prev_len = 0;
-  uint8_t prev_chr = 0;
-  size_t count;
-  size_t i = 0;
-  size_t j = 0;
-  uint8_t chr;
-
-  while(j < data_len)
-  {
-    if(i >= dest_len)
-      break;
-
-    chr = data[j++];
-    if(chr >> 6)
-      count = RLE3_UNPACK_SIZE(chr);
-
-    switch(chr >> 6)
-    {
-      case 0:
-      {
-        // Char. Usually there are several of these in a row.
-        dest[i++] = chr;
-        while(i < dest_len && j < data_len && data[j] <= RLE3_MAX_CHAR)
-          dest[i++] = data[j++];
-
-        prev_chr = data[j - 1];
-        prev_block = data + j - 1;
-        prev_len = 1;
-        break;
-      }
-
-      case 1:
-      {
-        // Block.
-        if(i + count > dest_len || j + count > data_len)
-          return false;
-
-        prev_block = data + j;
-        prev_len = count;
-
-        memcpy(dest + i, data + j, count);
-        i += count;
-        j += count;
-
-        prev_chr = data[j - 1];
-        break;
-      }
-
-      case 2:
-      {
-        // Repeat last char.
-        if(i + count > dest_len)
-          return false;
-
-        memset(dest + i, prev_chr, count);
-        i += count;
-        break;
-      }
-
-      case 3:
-      {
-        // Repeat last block.
-        if(!prev_block || i + count * prev_len > dest_len)
-          return false;
-
-        while(count--)
-        {
-          memcpy(dest + i, prev_block, prev_len);
-          i += prev_len;
-        }
-        break;
-      }
-    }
-  }
-  return (i == dest_len);
-}
-
 /**
  * Initialize a deflate stream.
  */
@@ -797,6 +696,94 @@ static size_t extram_block_size(size_t len)
   return sizeof(struct extram_block) + extram_alloc_size(len);
 }
 
+/**
+ * Choose a compression method for a buffer. The fast methods are tried first
+ * and DEFLATE is only used when its expected savings outweigh its expected
+ * extra time, going by the ratios and speeds measured so far.
+ *
+ * @param  data       structure including z_stream information.
+ * @param  src        buffer to be stored to extra RAM.
+ * @param  len        size of buffer to be stored to extra RAM.
+ * @param  rle3       RLE3 output buffer.
+ * @param  rle3_len   size of RLE3 output buffer.
+ * @param  rle3_size  RLE3 stream length, or 0 if RLE3 wasn't usable.
+ * @param  lz         LZ output buffer (allocated here if needed; free after).
+ * @param  lz_size    LZ stream length, or 0 if LZ wasn't usable.
+ * @return            selected method, or -1 to store uncompressed.
+ */
+static int extram_select_method(struct extram_data *data, const uint8_t *src,
+ size_t len, uint8_t *rle3, size_t rle3_len, size_t *rle3_size,
+ uint8_t **lz, size_t *lz_size)
+{
+  int method = -1;
+  size_t best_size = len;
+  size_t best_cost = len;
+  size_t deflate_size;
+  size_t cost;
+  uint64_t start;
+  boolean use_deflate;
+
+  start = extram_time();
+  *rle3_size = rle3_pack(rle3, rle3_len, src, len);
+  extram_tick_rate(&method_rates[EXTRAM_METHOD_RLE3].pack, start, len);
+  cost = extram_method_cost(EXTRAM_METHOD_RLE3, *rle3_size, len);
+  if(*rle3_size && cost < best_cost)
+  {
+    method = EXTRAM_METHOD_RLE3;
+    best_size = *rle3_size;
+    best_cost = cost;
+  }
+
+  // Skip LZ if its time alone would cost more than RLE3 does.
+  *lz_size = 0;
+  if(extram_method_cost(EXTRAM_METHOD_LZ, 0, len) < best_cost)
+  {
+    *lz = (uint8_t *)cmalloc(len);
+
+    start = extram_time();
+    *lz_size = lz_pack(*lz, best_size, src, len);
+    extram_tick_rate(&method_rates[EXTRAM_METHOD_LZ].pack, start, len);
+
+    cost = extram_method_cost(EXTRAM_METHOD_LZ, *lz_size, len);
+    if(*lz_size && cost < best_cost)
+    {
+      method = EXTRAM_METHOD_LZ;
+      best_size = *lz_size;
+      best_cost = cost;
+    }
+  }
+
+  extram_stats_lock();
+  deflate_size = (size_t)((uint64_t)best_size * deflate_gain / 256);
+  extram_stats_unlock();
+
+  cost = extram_method_cost(EXTRAM_METHOD_DEFLATE, deflate_size, len);
+  use_deflate = (cost < best_cost);
+  if(!use_deflate)
+  {
+    extram_stats_lock();
+    use_deflate = (++deflate_probe_count >= EXTRAM_PROBE_INTERVAL);
+    extram_stats_unlock();
+  }
+
+  if(use_deflate)
+  {
+    data->z.next_in = (Bytef *)src;
+    data->z.avail_in = len;
+
+    if(extram_deflate_init(data))
+    {
+      extram_stats_lock();
+      deflate_probe_count = 0;
+      extram_stats_unlock();
+
+      data->fast_size = best_size;
+      method = EXTRAM_METHOD_DEFLATE;
+    }
+  }
+  return method;
+}
+
 /**
  * Send a buffer to extra memory.
  *
@@ -810,34 +797,36 @@ static boolean store_buffer_to_extram(struct extram_data *data,
 {
   struct extram_block *block;
   uint8_t *src = (uint8_t *)*_src;
+  uint8_t *lz_buffer = NULL;
   void *ptr;
   uint32_t flags = EXTRAM_PLATFORM_ALLOC;
   size_t projected_size = len;
   size_t alloc_size;
+  size_t rle3_size;
+  size_t lz_size;
   EXTRAM_BUFFER_DECL;
 
   trace("--EXTRAM-- store_buffer_to_extram %p %zu\n", src, len);
 
   if(len >= data->compression_threshold)
   {
-    // Before trying zlib (slow), how well does this RLE?
-    size_t rle3_size = RLE3_pack((void *)extram_deflate_buffer, sizeof(extram_deflate_buffer), src, len);
-    if(rle3_size > 0)
-    {
-      projected_size = rle3_size;
-      flags |= EXTRAM_RLE3;
-    }
-    else
+    switch(extram_select_method(data, src, len, (uint8_t *)extram_deflate_buffer,
+     sizeof(extram_deflate_buffer), &rle3_size, &lz_buffer, &lz_size))
     {
-      // Project compressed size...
-      data->z.next_in = (Bytef *)src;
-      data->z.avail_in = len;
+      case EXTRAM_METHOD_RLE3:
+        projected_size = rle3_size;
+        flags |= EXTRAM_RLE3;
+        break;
 
-      if(extram_deflate_init(data))
-      {
+      case EXTRAM_METHOD_LZ:
+        projected_size = lz_size;
+        flags |= EXTRAM_LZ;
+        break;
+
+      case EXTRAM_METHOD_DEFLATE:
         projected_size = deflateBound(&data->z, len);
         flags |= EXTRAM_DEFLATE;
-      }
+        break;
     }
   }
 
@@ -860,6 +849,7 @@ static boolean store_buffer_to_extram(struct extram_data *data,
   {
     // Compress.
     uint32_t *pos = block->data;
+    uint64_t start = extram_time();
     size_t sz;
     size_t new_alloc_size;
     int res = Z_OK;
@@ -900,6 +890,16 @@ static boolean store_buffer_to_extram(struct extram_data *data,
 
     block->compressed_size = data->z.total_out;
 
+    extram_tick_rate(&method_rates[EXTRAM_METHOD_DEFLATE].pack, start, len);
+    if(data->fast_size)
+    {
+      uint64_t gain = (uint64_t)block->compressed_size * 256 / data->fast_size;
+
+      extram_stats_lock();
+      deflate_gain = (uint32_t)((deflate_gain * 7 + MIN(gain, 256)) / 8);
+      extram_stats_unlock();
+    }
+
     /* Shrink the allocation to the real compressed size. */
     new_alloc_size = extram_block_size(block->compressed_size);
     if(new_alloc_size < alloc_size)
@@ -930,6 +930,18 @@ static boolean store_buffer_to_extram(struct extram_data *data,
     trace("--EXTRAM--   RLE3 size=%zu\n", projected_size);
   }
   else
+
+  if(flags & EXTRAM_LZ)
+  {
+    // LZ.
+    block->compressed_size = projected_size;
+
+    if(!extram_copy(block->data, lz_buffer, projected_size))
+      goto err;
+
+    trace("--EXTRAM--   LZ size=%zu\n", projected_size);
+  }
+  else
   {
     // Store.
     block->compressed_size = len;
@@ -951,6 +963,7 @@ static boolean store_buffer_to_extram(struct extram_data *data,
     goto err;
   }
 
+  free(lz_buffer);
   free(src);
   *_src = ptr;
   return true;
@@ -964,6 +977,7 @@ err:
     free(block);
 
   platform_extram_unlock();
+  free(lz_buffer);
   return false;
 }
 
@@ -981,8 +995,10 @@ static boolean retrieve_buffer_from_extram(struct extram_data *data,
   struct extram_block *block = (struct extram_block *)(*src);
   void *ptr;
   uint32_t checksum;
+  uint64_t start;
   size_t alloc_size;
   uint8_t *buffer = NULL;
+  int method;
   EXTRAM_BUFFER_DECL;
 
   trace("--EXTRAM-- retrieve_buffer_from_extram %p %zu\n", *src, len);
@@ -1019,6 +1035,7 @@ static boolean retrieve_buffer_from_extram(struct extram_data *data,
 
   alloc_size = extram_alloc_size(len);
   buffer = cmalloc(alloc_size);
+  start = extram_time();
 
   if(block->flags & EXTRAM_DEFLATE)
   {
@@ -1090,7 +1107,7 @@ static boolean retrieve_buffer_from_extram(struct extram_data *data,
       goto err;
     }
 
-    if(!RLE3_unpack(buffer, len, (void *)extram_deflate_buffer,
+    if(!rle3_unpack(buffer, len, (void *)extram_deflate_buffer,
      block->compressed_size))
     {
       debug("--EXTRAM-- failed to unpack RLE3 @ %p\n", (void *)block);
@@ -1100,6 +1117,38 @@ static boolean retrieve_buffer_from_extram(struct extram_data *data,
      (size_t)block->compressed_size, (size_t)block->uncompressed_size);
   }
   else
+
+  if(block->flags & EXTRAM_LZ)
+  {
+    // LZ.
+    const uint8_t *lz = (const uint8_t *)block->data;
+    uint8_t *tmp = NULL;
+    boolean ret;
+
+    if(block->flags & EXTRAM_PLATFORM_ALLOC)
+    {
+      // Platform RAM can't be relied on for byte reads.
+      size_t sz = extram_alloc_size(block->compressed_size);
+      tmp = (uint8_t *)cmalloc(sz);
+      if(!extram_copy(tmp, block->data, sz))
+      {
+        free(tmp);
+        goto err;
+      }
+      lz = tmp;
+    }
+
+    ret = lz_unpack(buffer, len, lz, block->compressed_size);
+    free(tmp);
+    if(!ret)
+    {
+      debug("--EXTRAM-- failed to unpack LZ @ %p\n", (void *)block);
+      goto err;
+    }
+    trace("--EXTRAM--   LZ unpacked block of size %zu to %zu\n",
+     (size_t)block->compressed_size, (size_t)block->uncompressed_size);
+  }
+  else
   {
     // Stored.
     if(block->compressed_size != block->uncompressed_size)
@@ -1113,6 +1162,10 @@ static boolean retrieve_buffer_from_extram(struct extram_data *data,
       goto err;
   }
 
+  method = extram_block_method(block);
+  if(method >= 0)
+    extram_tick_rate(&method_rates[method].unpack, start, len);
+
   checksum = extram_checksum(buffer, len);
   if(checksum != block->checksum)
   {
@@ -1123,6 +1176,12 @@ static boolean retrieve_buffer_from_extram(struct extram_data *data,
   }
 
 clear:
+  if(data->keep_block)
+  {
+    /* Leave the block in extra RAM; the caller only wants a copy. */
+  }
+  else
+
   if(block->flags & EXTRAM_PLATFORM_ALLOC)
   {
     platform_extram_free(block);
@@ -1141,28 +1200,18 @@ err:
 }
 
 /**
- * Move the board's memory from normal RAM to extra RAM.
+ * Compress and move the board's memory from normal RAM to extra RAM.
  *
  * @param  board  board to send to extra RAM.
- * @param  file   __FILE__ of invoking call (via macro).
- * @param  line   __LINE__ of invoking call (via macro).
+ * @return        `true` on success, otherwise `false`.
  */
-void real_store_board_to_extram(struct board *board, const char *file, int line)
+static boolean store_board_data_to_extram(struct board *board)
 {
   size_t board_size = board->board_width * board->board_height;
   struct robot **robot_list = board->robot_list;
   struct extram_data data;
   int i;
 
-  if(board->is_extram)
-  {
-    warn("--EXTRAM-- board %p is already in extram! (%s:%d)\n", (void *)board, file, line);
-    return;
-  }
-
-  trace("--EXTRAM-- storing board %p (%s:%d)\n", (void *)board, file, line);
-  board->is_extram = true;
-
   memset(&data, 0, sizeof(struct extram_data));
 
   // Layer data.
@@ -1231,14 +1280,590 @@ void real_store_board_to_extram(struct board *board, const char *file, int line)
 #endif
 
   extram_deflate_destroy(&data);
-  return;
+  return true;
 
 err:
+  extram_deflate_destroy(&data);
+  return false;
+}
+
+static void store_board_error(const char *file, int line)
+{
+  char msg[81];
+  snprintf(msg, ARRAY_SIZE(msg), "Failed to store board to extram at %s:%d", file, line);
+  error(msg, ERROR_T_FATAL, ERROR_OPT_EXIT | ERROR_OPT_NO_HELP, 0);
+}
+
+#ifdef EXTRAM_PREFETCH
+
+/**
+ * Get pointers to the board buffers that are decompressed by prefetching.
+ */
+static int board_extram_planes(struct board *board,
+ char **planes[EXTRAM_BOARD_PLANES])
+{
+  int num = 0;
+
+  planes[num++] = &board->level_id;
+  planes[num++] = &board->level_param;
+  planes[num++] = &board->level_color;
+  planes[num++] = &board->level_under_id;
+  planes[num++] = &board->level_under_param;
+  planes[num++] = &board->level_under_color;
+
+  if(board->overlay_mode)
   {
-    char msg[81];
-    snprintf(msg, ARRAY_SIZE(msg), "Failed to store board to extram at %s:%d", file, line);
-    error(msg, ERROR_T_FATAL, ERROR_OPT_EXIT | ERROR_OPT_NO_HELP, 0);
+    planes[num++] = &board->overlay;
+    planes[num++] = &board->overlay_color;
+  }
+  return num;
+}
+
+static void prefetch_free(struct extram_prefetch *p)
+{
+  int i;
+
+  for(i = 0; i < EXTRAM_BOARD_PLANES; i++)
+  {
+    free(p->planes[i]);
+    p->planes[i] = NULL;
+  }
+  p->board = NULL;
+  p->size = 0;
+  p->state = PREFETCH_FREE;
+  p->discard = false;
+}
+
+/**
+ * Decompress copies of a board's layers. This runs on the worker thread; the
+ * board's compressed blocks are only read.
+ */
+static boolean prefetch_board_data(struct extram_prefetch *p)
+{
+  struct board *board = p->board;
+  size_t board_size = board->board_width * board->board_height;
+  char **planes[EXTRAM_BOARD_PLANES];
+  struct extram_data data;
+  int num = board_extram_planes(board, planes);
+  int i;
+
+  memset(&data, 0, sizeof(struct extram_data));
+  data.keep_block = true;
+
+  for(i = 0; i < num; i++)
+  {
+    char *buffer = *(planes[i]);
+    if(!retrieve_buffer_from_extram(&data, &buffer, board_size))
+      goto err;
+
+    p->planes[i] = buffer;
+    p->size += board_size;
+  }
+  extram_inflate_destroy(&data);
+  return true;
+
+err:
+  extram_inflate_destroy(&data);
+  while(i > 0)
+  {
+    i--;
+    free(p->planes[i]);
+    p->planes[i] = NULL;
+  }
+  p->size = 0;
+  return false;
+}
+
+#endif /* EXTRAM_PREFETCH */
+
+#ifdef EXTRAM_ASYNC
+
+static THREAD_RES extram_worker_thread(void *data)
+{
+  struct extram_worker *w = (struct extram_worker *)data;
+  struct extram_job job;
+  boolean ret;
+
+  platform_mutex_lock(&(w->lock));
+  while(w->queue_size)
+  {
+    job = w->queue[0];
+    w->queue_size--;
+    memmove(w->queue, w->queue + 1, w->queue_size * sizeof(struct extram_job));
+    w->active = job.board;
+
+#ifdef EXTRAM_PREFETCH
+    if(job.prefetch)
+    {
+      struct extram_prefetch *p = job.prefetch;
+
+      p->state = PREFETCH_ACTIVE;
+      platform_mutex_unlock(&(w->lock));
+
+      ret = prefetch_board_data(p);
+
+      platform_mutex_lock(&(w->lock));
+      if(p->discard)
+      {
+        // The board stopped being a candidate while it was decompressed.
+        prefetch_free(p);
+        w->prefetch_stats.unused++;
+      }
+      else
+        p->state = ret ? PREFETCH_READY : PREFETCH_FAILED;
+    }
+    else
+#endif
+    {
+      platform_mutex_unlock(&(w->lock));
+
+      ret = store_board_data_to_extram(job.board);
+
+      platform_mutex_lock(&(w->lock));
+      if(!ret && !w->failed)
+      {
+        w->failed = true;
+        w->failed_file = job.file;
+        w->failed_line = job.line;
+      }
+      job.board->extram_pending = false;
+    }
+    w->active = NULL;
+    platform_cond_broadcast(&(w->cond));
+
+    // Let the game thread have the CPU between boards.
+    platform_mutex_unlock(&(w->lock));
+    platform_yield();
+    platform_mutex_lock(&(w->lock));
   }
+  w->running = false;
+  platform_mutex_unlock(&(w->lock));
+  THREAD_RETURN;
+}
+
+static boolean extram_worker_init(struct extram_worker *w)
+{
+  if(!w->init)
+  {
+    if(!platform_mutex_init(&(w->lock)))
+      return false;
+
+    if(!platform_cond_init(&(w->cond)))
+    {
+      platform_mutex_destroy(&(w->lock));
+      return false;
+    }
+    w->init = true;
+  }
+  return true;
+}
+
+/**
+ * Make sure the worker thread is running. This must be called with the
+ * worker lock held, so the worker can't exit before the new job is queued.
+ */
+static boolean extram_worker_start(struct extram_worker *w)
+{
+  if(!w->running)
+  {
+    // The previous worker has exited (or is about to).
+    if(w->joinable)
+    {
+      platform_thread_join(&(w->thread));
+      w->joinable = false;
+    }
+
+    if(!platform_thread_create(&(w->thread), extram_worker_thread, w))
+      return false;
+
+    w->running = true;
+    w->joinable = true;
+  }
+  return true;
+}
+
+/**
+ * Add a job to the end of the queue. This must be called with the worker
+ * lock held.
+ */
+static struct extram_job *extram_worker_push(struct extram_worker *w)
+{
+  struct extram_job *job;
+
+  if(w->queue_size >= w->queue_alloc)
+  {
+    size_t new_alloc = w->queue_alloc ? w->queue_alloc * 2 : 8;
+    struct extram_job *tmp = (struct extram_job *)realloc(w->queue,
+     new_alloc * sizeof(struct extram_job));
+    if(!tmp)
+      return NULL;
+
+    w->queue = tmp;
+    w->queue_alloc = new_alloc;
+  }
+
+  job = &(w->queue[w->queue_size++]);
+  memset(job, 0, sizeof(struct extram_job));
+  return job;
+}
+
+static void extram_worker_remove(struct extram_worker *w, size_t pos)
+{
+  w->queue_size--;
+  memmove(w->queue + pos, w->queue + pos + 1,
+   (w->queue_size - pos) * sizeof(struct extram_job));
+}
+
+/**
+ * Report a store that failed on the worker thread. This must be called with
+ * the worker lock held.
+ */
+static void extram_worker_check_failed(struct extram_worker *w)
+{
+  if(w->failed)
+  {
+    platform_mutex_unlock(&(w->lock));
+    store_board_error(w->failed_file, w->failed_line);
+    platform_mutex_lock(&(w->lock));
+    w->failed = false;
+  }
+}
+
+/**
+ * Queue a board to be stored by the worker thread.
+ *
+ * @return  `true` if the board was queued, otherwise `false` (store it now).
+ */
+static boolean store_board_async(struct board *board, const char *file,
+ int line)
+{
+  struct extram_worker *w = &extram_worker;
+  struct extram_job *job;
+
+  if(!extram_worker_init(w))
+    return false;
+
+  platform_mutex_lock(&(w->lock));
+  extram_worker_check_failed(w);
+
+  if(!extram_worker_start(w))
+    goto err;
+
+  job = extram_worker_push(w);
+  if(!job)
+    goto err;
+
+  job->board = board;
+  job->file = file;
+  job->line = line;
+  board->extram_pending = true;
+
+  platform_mutex_unlock(&(w->lock));
+  return true;
+
+err:
+  platform_mutex_unlock(&(w->lock));
+  return false;
+}
+
+/**
+ * Make sure a board isn't being stored by the worker. If the worker hasn't
+ * started on the board yet, the store is cancelled and `true` is returned;
+ * the board's data was never moved to extra RAM.
+ */
+static boolean store_board_cancel(struct board *board)
+{
+  struct extram_worker *w = &extram_worker;
+  boolean cancelled = false;
+  size_t i;
+
+  if(!w->init)
+    return false;
+
+  platform_mutex_lock(&(w->lock));
+  if(board->extram_pending && w->active != board)
+  {
+    for(i = 0; i < w->queue_size; i++)
+    {
+      if(w->queue[i].board == board)
+      {
+        extram_worker_remove(w, i);
+        break;
+      }
+    }
+    board->extram_pending = false;
+    cancelled = true;
+  }
+
+  while(board->extram_pending)
+    platform_cond_wait(&(w->cond), &(w->lock));
+
+  extram_worker_check_failed(w);
+  platform_mutex_unlock(&(w->lock));
+  return cancelled;
+}
+
+/**
+ * Wait for all queued boards to finish storing to extra RAM.
+ */
+void store_board_to_extram_wait(void)
+{
+  struct extram_worker *w = &extram_worker;
+
+  if(!w->init)
+    return;
+
+  platform_mutex_lock(&(w->lock));
+  while(w->queue_size || w->active)
+    platform_cond_wait(&(w->cond), &(w->lock));
+
+  extram_worker_check_failed(w);
+
+  if(!w->running && w->joinable)
+  {
+    platform_thread_join(&(w->thread));
+    w->joinable = false;
+  }
+  platform_mutex_unlock(&(w->lock));
+}
+
+#else /* !EXTRAM_ASYNC */
+
+void store_board_to_extram_wait(void) {}
+
+#endif /* !EXTRAM_ASYNC */
+
+#ifdef EXTRAM_PREFETCH
+
+static struct extram_prefetch *prefetch_find(struct extram_worker *w,
+ struct board *board)
+{
+  int i;
+
+  for(i = 0; i < EXTRAM_PREFETCH_MAX; i++)
+    if(w->prefetch[i].state != PREFETCH_FREE && w->prefetch[i].board == board)
+      return &(w->prefetch[i]);
+
+  return NULL;
+}
+
+static void prefetch_cancel(struct extram_worker *w, struct extram_prefetch *p)
+{
+  size_t i;
+
+  for(i = 0; i < w->queue_size; i++)
+  {
+    if(w->queue[i].prefetch == p)
+    {
+      extram_worker_remove(w, i);
+      break;
+    }
+  }
+  prefetch_free(p);
+}
+
+/**
+ * Decompress boards that are likely to be retrieved soon in the background.
+ * Previously requested boards that aren't in the list are dropped, and the
+ * number of boards kept is limited to `EXTRAM_PREFETCH_MAX`.
+ *
+ * @param  boards   boards to prefetch, in order of priority.
+ * @param  count    number of boards in the list.
+ */
+void prefetch_boards_from_extram(struct board **boards, int count)
+{
+  struct extram_worker *w = &extram_worker;
+  struct extram_prefetch *p;
+  struct extram_job *job;
+  int i;
+  int j;
+
+  if(!extram_worker_init(w))
+    return;
+
+  platform_mutex_lock(&(w->lock));
+  for(i = 0; i < EXTRAM_PREFETCH_MAX; i++)
+  {
+    p = &(w->prefetch[i]);
+    if(p->state == PREFETCH_FREE)
+      continue;
+
+    for(j = 0; j < count; j++)
+      if(boards[j] == p->board)
+        break;
+
+    if(j < count)
+    {
+      p->discard = false;
+      continue;
+    }
+
+    switch(p->state)
+    {
+      case PREFETCH_QUEUED:
+        prefetch_cancel(w, p);
+        break;
+
+      case PREFETCH_ACTIVE:
+        // The worker will free it when it's done.
+        p->discard = true;
+        break;
+
+      case PREFETCH_READY:
+        w->prefetch_stats.unused++;
+        prefetch_free(p);
+        break;
+
+      default:
+        prefetch_free(p);
+        break;
+    }
+  }
+
+  for(j = 0; j < count; j++)
+  {
+    struct board *board = boards[j];
+
+    if(!board->is_extram || board->deferred || board->extram_pending ||
+     prefetch_find(w, board))
+      continue;
+
+    for(i = 0; i < EXTRAM_PREFETCH_MAX; i++)
+      if(w->prefetch[i].state == PREFETCH_FREE)
+        break;
+
+    if(i >= EXTRAM_PREFETCH_MAX || !extram_worker_start(w))
+      break;
+
+    job = extram_worker_push(w);
+    if(!job)
+      break;
+
+    p = &(w->prefetch[i]);
+    p->board = board;
+    p->state = PREFETCH_QUEUED;
+    p->discard = false;
+    job->board = board;
+    job->prefetch = p;
+  }
+  platform_mutex_unlock(&(w->lock));
+}
+
+/**
+ * Replace the layers of a board being retrieved with prefetched copies. If
+ * the board is still being decompressed, this waits for it to finish. Any
+ * prefetch of the board is dropped.
+ *
+ * @return  `true` if the board's layers were replaced, otherwise `false`.
+ */
+static boolean retrieve_board_prefetched(struct board *board,
+ boolean free_data)
+{
+  struct extram_worker *w = &extram_worker;
+  struct extram_prefetch *p;
+  char *buffers[EXTRAM_BOARD_PLANES];
+  char **planes[EXTRAM_BOARD_PLANES];
+  struct extram_data data;
+  size_t board_size;
+  boolean hit = false;
+  int num;
+  int i;
+
+  if(!w->init)
+    return false;
+
+  platform_mutex_lock(&(w->lock));
+  p = prefetch_find(w, board);
+  if(p && p->state == PREFETCH_QUEUED)
+    prefetch_cancel(w, p);
+
+  if(p && p->state == PREFETCH_ACTIVE)
+  {
+    if(!free_data && !p->discard)
+      w->prefetch_stats.waits++;
+
+    // If the prefetch was discarded, the worker frees it.
+    while(p->state == PREFETCH_ACTIVE)
+      platform_cond_wait(&(w->cond), &(w->lock));
+  }
+
+  if(p && p->state == PREFETCH_READY && p->board == board && !free_data)
+  {
+    memcpy(buffers, p->planes, sizeof(buffers));
+    memset(p->planes, 0, sizeof(p->planes));
+    w->prefetch_stats.hits++;
+    hit = true;
+  }
+  else
+
+  if(free_data)
+  {
+    if(p && p->state == PREFETCH_READY)
+      w->prefetch_stats.unused++;
+  }
+  else
+    w->prefetch_stats.misses++;
+
+  if(p && p->state != PREFETCH_FREE && p->board == board)
+    prefetch_free(p);
+
+  platform_mutex_unlock(&(w->lock));
+
+  if(!hit)
+    return false;
+
+  // Free the compressed blocks and swap in the prefetched layers.
+  board_size = board->board_width * board->board_height;
+  num = board_extram_planes(board, planes);
+
+  memset(&data, 0, sizeof(struct extram_data));
+  data.free_data = true;
+
+  for(i = 0; i < num; i++)
+  {
+    retrieve_buffer_from_extram(&data, planes[i], board_size);
+    *(planes[i]) = buffers[i];
+  }
+  return true;
+}
+
+#else /* !EXTRAM_PREFETCH */
+
+void prefetch_boards_from_extram(struct board **boards, int count) {}
+
+#endif /* !EXTRAM_PREFETCH */
+
+/**
+ * Move the board's memory from normal RAM to extra RAM. When possible, the
+ * board is compressed in the background; it won't be accessed again until
+ * it is retrieved (which waits for the store to finish).
+ *
+ * @param  board  board to send to extra RAM.
+ * @param  file   __FILE__ of invoking call (via macro).
+ * @param  line   __LINE__ of invoking call (via macro).
+ */
+void real_store_board_to_extram(struct board *board, const char *file, int line)
+{
+  if(board->is_extram)
+  {
+    warn("--EXTRAM-- board %p is already in extram! (%s:%d)\n", (void *)board, file, line);
+    return;
+  }
+
+  trace("--EXTRAM-- storing board %p (%s:%d)\n", (void *)board, file, line);
+  board->is_extram = true;
+
+  // Deferred boards don't have any data to store yet.
+  if(board->deferred)
+    return;
+
+#ifdef EXTRAM_ASYNC
+  if(store_board_async(board, file, line))
+    return;
+#endif
+
+  if(!store_board_data_to_extram(board))
+    store_board_error(file, line);
 }
 
 /**
@@ -1268,9 +1893,27 @@ void real_retrieve_board_from_extram(struct board *board, boolean free_data,
    (free_data ? "freeing" : "retrieving"), (void *)board, file, line);
   board->is_extram = false;
 
+  if(board->deferred)
+  {
+    retrieve_board_deferred(board, free_data);
+    return;
+  }
+
+#ifdef EXTRAM_ASYNC
+  // If the store hasn't started yet, the board is still in normal RAM.
+  if(store_board_cancel(board))
+    return;
+#endif
+
   memset(&data, 0, sizeof(struct extram_data));
   data.free_data = free_data;
 
+#ifdef EXTRAM_PREFETCH
+  // The layers may have already been decompressed in the background.
+  if(retrieve_board_prefetched(board, free_data))
+    goto robots;
+#endif
+
   // Layer data.
   if(!retrieve_buffer_from_extram(&data, &board->level_id, board_size))
     goto err;
@@ -1294,6 +1937,10 @@ void real_retrieve_board_from_extram(struct board *board, boolean free_data,
       goto err;
   }
 
+#ifdef EXTRAM_PREFETCH
+robots:
+#endif
+
   // Robot programs and source.
   for(i = 1; robot_list && i <= board->num_robots; i++)
   {
@@ -1343,30 +1990,40 @@ err:
 
 #ifdef CONFIG_EDITOR
 
-static boolean get_extram_buffer_usage(const void *buffer, size_t *compressed,
- size_t *uncompressed)
+static boolean get_extram_buffer_usage(const void *buffer,
+ struct extram_usage *usage)
 {
   const struct extram_block *block = (const struct extram_block *)buffer;
+  size_t compressed;
+  int method;
+
   if(block->id != EXTRAM_ID)
     return false;
 
-  *compressed += extram_block_size(block->compressed_size);
-  *uncompressed += block->uncompressed_size;
+  compressed = extram_block_size(block->compressed_size);
+  usage->compressed += compressed;
+  usage->uncompressed += block->uncompressed_size;
+
+  method = extram_block_method(block);
+  if(method >= 0)
+  {
+    usage->method_compressed[method] += compressed;
+    usage->method_uncompressed[method] += block->uncompressed_size;
+  }
   return true;
 }
 
 /**
- * Get total actual extra RAM usage (compressed) and total uncompressed
- * extra RAM size data for a board.
+ * Add the actual extra RAM usage (compressed) and the uncompressed size of the
+ * extra RAM data of a board to a usage total, both overall and per method.
  *
  * @param  board          board to get extra RAM statistics for.
- * @param  compressed     pointer to write total actual RAM usage to.
- * @param  uncompressed   pointer to write total stored data size to.
+ * @param  total          usage total to add this board's usage to.
  * @return                `true` on success, otherwise `false`.
  */
-boolean board_extram_usage(struct board *board, size_t *compressed,
- size_t *uncompressed)
+boolean board_extram_usage(struct board *board, struct extram_usage *total)
 {
+  struct extram_usage usage;
   struct robot **robot_list;
   int i;
 
@@ -1375,35 +2032,34 @@ boolean board_extram_usage(struct board *board, size_t *compressed,
   return false;
 #endif
 
-  if(!board || !compressed | !uncompressed)
+  if(!board || !total)
     return false;
 
-  *compressed = 0;
-  *uncompressed = 0;
-
   if(!board->is_extram)
     return true;
 
+  memset(&usage, 0, sizeof(struct extram_usage));
+
   platform_extram_lock();
 
-  if(!get_extram_buffer_usage(board->level_id, compressed, uncompressed))
+  if(!get_extram_buffer_usage(board->level_id, &usage))
     goto err;
-  if(!get_extram_buffer_usage(board->level_param, compressed, uncompressed))
+  if(!get_extram_buffer_usage(board->level_param, &usage))
     goto err;
-  if(!get_extram_buffer_usage(board->level_color, compressed, uncompressed))
+  if(!get_extram_buffer_usage(board->level_color, &usage))
     goto err;
-  if(!get_extram_buffer_usage(board->level_under_id, compressed, uncompressed))
+  if(!get_extram_buffer_usage(board->level_under_id, &usage))
     goto err;
-  if(!get_extram_buffer_usage(board->level_under_param, compressed, uncompressed))
+  if(!get_extram_buffer_usage(board->level_under_param, &usage))
     goto err;
-  if(!get_extram_buffer_usage(board->level_under_color, compressed, uncompressed))
+  if(!get_extram_buffer_usage(board->level_under_color, &usage))
     goto err;
 
   if(board->overlay_mode)
   {
-    if(!get_extram_buffer_usage(board->overlay, compressed, uncompressed))
+    if(!get_extram_buffer_usage(board->overlay, &usage))
       goto err;
-    if(!get_extram_buffer_usage(board->overlay_color, compressed, uncompressed))
+    if(!get_extram_buffer_usage(board->overlay_color, &usage))
       goto err;
   }
 
@@ -1414,24 +2070,29 @@ boolean board_extram_usage(struct board *board, size_t *compressed,
     if(cur_robot)
     {
       if(cur_robot->program_bytecode)
-        if(!get_extram_buffer_usage(cur_robot->program_bytecode,
-         compressed, uncompressed))
+        if(!get_extram_buffer_usage(cur_robot->program_bytecode, &usage))
           goto err;
 
 #if defined(CONFIG_DEBYTECODE) || defined(CONFIG_EDITOR)
       if(cur_robot->program_source)
-        if(!get_extram_buffer_usage(cur_robot->program_source,
-         compressed, uncompressed))
+        if(!get_extram_buffer_usage(cur_robot->program_source, &usage))
           goto err;
 
       if(cur_robot->command_map)
-        if(!get_extram_buffer_usage(cur_robot->command_map,
-         compressed, uncompressed))
+        if(!get_extram_buffer_usage(cur_robot->command_map, &usage))
           goto err;
 #endif
     }
   }
   platform_extram_unlock();
+
+  total->compressed += usage.compressed;
+  total->uncompressed += usage.uncompressed;
+  for(i = 0; i < NUM_EXTRAM_METHODS; i++)
+  {
+    total->method_compressed[i] += usage.method_compressed[i];
+    total->method_uncompressed[i] += usage.method_uncompressed[i];
+  }
   return true;
 
 err:
@@ -1439,4 +2100,58 @@ err:
   return false;
 }
 
+/**
+ * Get the measured time to unpack a buffer compressed with a given method.
+ *
+ * @param  method   compression method.
+ * @return          average nanoseconds per KiB of unpacked data.
+ */
+unsigned int extram_method_unpack_rate(enum extram_method method)
+{
+  unsigned int rate;
+
+  if((int)method < 0 || method >= NUM_EXTRAM_METHODS)
+    return 0;
+
+  extram_stats_lock();
+  rate = extram_rate(&method_rates[method].unpack);
+  extram_stats_unlock();
+  return rate;
+}
+
+/**
+ * Get statistics for boards decompressed ahead of time by prefetching.
+ *
+ * @param  stats    destination for the prefetch statistics.
+ */
+void extram_prefetch_stats(struct extram_prefetch_stats *stats)
+{
+#ifdef EXTRAM_PREFETCH
+  struct extram_worker *w = &extram_worker;
+  int i;
+#endif
+
+  memset(stats, 0, sizeof(struct extram_prefetch_stats));
+
+#ifdef EXTRAM_PREFETCH
+  if(!w->init)
+    return;
+
+  platform_mutex_lock(&(w->lock));
+  *stats = w->prefetch_stats;
+  stats->cached = 0;
+  stats->cached_size = 0;
+
+  for(i = 0; i < EXTRAM_PREFETCH_MAX; i++)
+  {
+    if(w->prefetch[i].state == PREFETCH_READY)
+    {
+      stats->cached++;
+      stats->cached_size += w->prefetch[i].size;
+    }
+  }
+  platform_mutex_unlock(&(w->lock));
+#endif
+}
+
 #endif /* CONFIG_EDITOR */
@@ -25,6 +25,7 @@
 
 __M_BEGIN_DECLS
 
+#include "board.h"
 #include "board_struct.h"
 #include "world_struct.h"
 
@@ -35,6 +36,33 @@ __M_BEGIN_DECLS
 #define clear_board_from_extram(b) \
  real_retrieve_board_from_extram(b, true, __FILE__, __LINE__)
 
+// Compression methods used for boards in extra RAM.
+enum extram_method
+{
+  EXTRAM_METHOD_RLE3,
+  EXTRAM_METHOD_LZ,
+  EXTRAM_METHOD_DEFLATE,
+  NUM_EXTRAM_METHODS
+};
+
+struct extram_usage
+{
+  size_t compressed;
+  size_t uncompressed;
+  size_t method_compressed[NUM_EXTRAM_METHODS];
+  size_t method_uncompressed[NUM_EXTRAM_METHODS];
+};
+
+struct extram_prefetch_stats
+{
+  unsigned int hits;      // Retrieved boards that were already decompressed.
+  unsigned int waits;     // Hits that waited for decompression to finish.
+  unsigned int misses;    // Retrieved boards that weren't prefetched.
+  unsigned int unused;    // Prefetched boards dropped without being used.
+  unsigned int cached;    // Prefetched boards currently decompressed.
+  size_t cached_size;
+};
+
 #define set_current_board(mzx_world, b) \
  real_set_current_board(mzx_world, b, __FILE__, __LINE__)
 #define set_current_board_ext(mzx_world, b) \
@@ -51,9 +79,18 @@ CORE_LIBSPEC void real_store_board_to_extram(struct board *board,
 CORE_LIBSPEC void real_retrieve_board_from_extram(struct board *board,
  boolean free_data, const char *file, int line);
 
+// Wait for boards being stored in the background to finish.
+CORE_LIBSPEC void store_board_to_extram_wait(void);
+
+// Decompress boards likely to be retrieved soon in the background.
+CORE_LIBSPEC void prefetch_boards_from_extram(struct board **boards,
+ int count);
+
 #ifdef CONFIG_EDITOR
-CORE_LIBSPEC boolean board_extram_usage(struct board *board, size_t *compressed,
- size_t *uncompressed);
+CORE_LIBSPEC boolean board_extram_usage(struct board *board,
+ struct extram_usage *usage);
+CORE_LIBSPEC unsigned int extram_method_unpack_rate(enum extram_method method);
+CORE_LIBSPEC void extram_prefetch_stats(struct extram_prefetch_stats *stats);
 #endif /* CONFIG_EDITOR */
 
 #else /* !CONFIG_EXTRAM */
@@ -76,6 +113,9 @@ static inline void real_store_board_to_extram(struct board *board,
 static inline void real_retrieve_board_from_extram(struct board *board,
  boolean free_data, const char *file, int line)
 {
+  if(board->deferred)
+    retrieve_board_deferred(board, free_data);
+
 #ifdef DEBUG
   if(board->is_extram)
     board->is_extram = false;
@@ -84,6 +124,11 @@ static inline void real_retrieve_board_from_extram(struct board *board,
 #endif
 }
 
+static inline void store_board_to_extram_wait(void) {}
+
+static inline void prefetch_boards_from_extram(struct board **boards,
+ int count) {}
+
 #endif /* !CONFIG_EXTRAM */
 
 static inline void real_set_current_board(struct world *mzx_world,
@@ -92,6 +137,11 @@ static inline void real_set_current_board(struct world *mzx_world,
   if(mzx_world->current_board && mzx_world->current_board != cur_board)
     real_store_board_to_extram(mzx_world->current_board, file, line);
   mzx_world->current_board = cur_board;
+
+  // During gameplay, boards can only be modified while they are the current
+  // board, so setting the flag here covers every change to a loaded board.
+  if(cur_board)
+    cur_board->modified = true;
 }
 
 static inline void real_set_current_board_ext(struct world *mzx_world,
@@ -0,0 +1,198 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "file_cache.h"
+#include "util.h"
+#include "io/vio.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static void file_cache_free_entry(struct file_cache *cache,
+ struct file_cache_entry *e)
+{
+  cache->total -= e->size;
+  if(e->priv && cache->free_priv)
+    cache->free_priv(e->priv);
+
+  free(e->data);
+  memset(e, 0, sizeof(struct file_cache_entry));
+}
+
+/**
+ * Evict the least recently used entries (except for the entry in use) until
+ * the cache fits in its memory limit.
+ */
+static void file_cache_trim(struct file_cache *cache,
+ struct file_cache_entry *keep)
+{
+  while(cache->total > cache->max_size)
+  {
+    struct file_cache_entry *oldest = NULL;
+    unsigned int i;
+
+    for(i = 0; i < cache->num_entries; i++)
+    {
+      struct file_cache_entry *e = &(cache->entries[i]);
+      if(e->data && e != keep &&
+       (!oldest || e->last_used < oldest->last_used))
+        oldest = e;
+    }
+
+    if(!oldest)
+      break;
+
+    file_cache_free_entry(cache, oldest);
+  }
+}
+
+/**
+ * Get the cache entry for a file, reading it if it isn't cached or has
+ * changed. Returns NULL if the file can't be cached; the caller should read
+ * it directly instead.
+ */
+struct file_cache_entry *file_cache_get(struct file_cache *cache,
+ const char *path)
+{
+  struct file_cache_entry *e = NULL;
+  struct file_cache_entry *oldest = NULL;
+  unsigned int generation = vio_get_file_generation();
+  struct stat stat_info;
+  size_t length;
+  vfile *vf;
+  unsigned int i;
+
+  if(generation != cache->generation)
+  {
+    file_cache_clear(cache);
+    cache->generation = generation;
+  }
+
+  if(strlen(path) >= MAX_PATH || vstat(path, &stat_info) ||
+   !S_ISREG(stat_info.st_mode) || stat_info.st_size <= 0)
+    return NULL;
+
+  if(cache->max_file_size && (size_t)stat_info.st_size > cache->max_file_size)
+    return NULL;
+
+  for(i = 0; i < cache->num_entries; i++)
+  {
+    struct file_cache_entry *cur = &(cache->entries[i]);
+
+    if(!cur->data)
+    {
+      if(!oldest || oldest->data)
+        oldest = cur;
+      continue;
+    }
+
+    if(!strcmp(cur->path, path))
+    {
+      e = cur;
+      break;
+    }
+
+    if(!oldest || (oldest->data && cur->last_used < oldest->last_used))
+      oldest = cur;
+  }
+
+  if(e)
+  {
+    if(e->mtime == stat_info.st_mtime &&
+     e->file_length == (size_t)stat_info.st_size)
+    {
+      e->last_used = ++cache->tick;
+      return e;
+    }
+    file_cache_free_entry(cache, e);
+  }
+  else
+  {
+    e = oldest;
+    if(!e)
+      return NULL;
+
+    if(e->data)
+      file_cache_free_entry(cache, e);
+  }
+
+  length = stat_info.st_size;
+  if(cache->max_read)
+    length = MIN(length, cache->max_read);
+
+  vf = vfopen_unsafe(path, "rb");
+  if(!vf)
+    return NULL;
+
+  e->data = malloc(length);
+  if(!e->data || !vfread(e->data, length, 1, vf))
+  {
+    vfclose(vf);
+    free(e->data);
+    e->data = NULL;
+    return NULL;
+  }
+  vfclose(vf);
+
+  snprintf(e->path, MAX_PATH, "%s", path);
+  e->mtime = stat_info.st_mtime;
+  e->file_length = stat_info.st_size;
+  e->length = length;
+  e->last_used = ++cache->tick;
+  file_cache_resize(cache, e, length);
+  return e;
+}
+
+/**
+ * Set the amount of memory an entry is counted as using, e.g. after data
+ * derived from the file has been attached to it. Other entries are evicted
+ * if the cache no longer fits in its limit.
+ */
+void file_cache_resize(struct file_cache *cache, struct file_cache_entry *e,
+ size_t size)
+{
+  cache->total += size - e->size;
+  e->size = size;
+  file_cache_trim(cache, e);
+}
+
+/**
+ * Remove a file from the cache.
+ */
+void file_cache_invalidate(struct file_cache *cache, const char *path)
+{
+  unsigned int i;
+
+  for(i = 0; i < cache->num_entries; i++)
+    if(cache->entries[i].data && !strcmp(cache->entries[i].path, path))
+      file_cache_free_entry(cache, &(cache->entries[i]));
+}
+
+/**
+ * Remove all files from the cache.
+ */
+void file_cache_clear(struct file_cache *cache)
+{
+  unsigned int i;
+
+  for(i = 0; i < cache->num_entries; i++)
+    if(cache->entries[i].data)
+      file_cache_free_entry(cache, &(cache->entries[i]));
+}
@@ -0,0 +1,70 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __FILE_CACHE_H
+#define __FILE_CACHE_H
+
+#include "compat.h"
+
+__M_BEGIN_DECLS
+
+#include <stddef.h>
+#include <time.h>
+
+struct file_cache_entry
+{
+  char path[MAX_PATH];
+  time_t mtime;
+  size_t file_length;     // Length of the file when it was read.
+  size_t length;          // Bytes of the file in data.
+  size_t size;            // Memory counted against the cache limit.
+  void *data;
+  void *priv;             // Owned by the cache user; freed with free_priv.
+  unsigned int last_used;
+};
+
+/**
+ * Fixed-size LRU cache of file contents, keyed by path, modification time,
+ * and length. Entries are dropped whenever vio reports that a file or the
+ * working directory may have changed. Not thread-safe.
+ */
+struct file_cache
+{
+  struct file_cache_entry *entries;
+  unsigned int num_entries;
+  size_t max_size;        // Memory limit of all entries.
+  size_t max_file_size;   // Larger files aren't cached (0 for no limit).
+  size_t max_read;        // Only keep this much of each file (0 for all).
+  void (*free_priv)(void *priv);
+  size_t total;
+  unsigned int generation;
+  unsigned int tick;
+};
+
+CORE_LIBSPEC struct file_cache_entry *file_cache_get(struct file_cache *cache,
+ const char *path);
+CORE_LIBSPEC void file_cache_resize(struct file_cache *cache,
+ struct file_cache_entry *e, size_t size);
+CORE_LIBSPEC void file_cache_invalidate(struct file_cache *cache,
+ const char *path);
+CORE_LIBSPEC void file_cache_clear(struct file_cache *cache);
+
+__M_END_DECLS
+
+#endif /* __FILE_CACHE_H */
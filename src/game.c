@@ -23,6 +23,7 @@
 // Main title screen/gaming code
 
 #include <ctype.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -35,12 +36,14 @@
 #include "data.h"
 #include "error.h"
 #include "event.h"
+#include "extmem.h"
 #include "game.h"
 #include "game_menu.h"
 #include "game_player.h"
 #include "game_update.h"
 #include "graphics.h"
 #include "robot.h"
+#include "util.h"
 #include "window.h"
 #include "world.h"
 #include "world_struct.h"
@@ -182,6 +185,336 @@ void load_board_module(struct world *mzx_world)
   load_game_module(mzx_world, mzx_world->current_board->mod_playing, false);
 }
 
+static void prefetch_board_module(struct world *mzx_world, int board_id,
+ boolean *visited, int *remaining)
+{
+  char translated_name[MAX_PATH];
+  char filename[MAX_PATH];
+  struct board *dest_board;
+  size_t len;
+
+  if(*remaining <= 0 || board_id < 0 || board_id >= mzx_world->num_boards ||
+   visited[board_id])
+    return;
+
+  visited[board_id] = true;
+  dest_board = mzx_world->board_list[board_id];
+  if(!dest_board || !dest_board->mod_playing[0])
+    return;
+
+  // Strip the * used to keep the current module playing.
+  snprintf(filename, MAX_PATH, "%s", dest_board->mod_playing);
+  len = strlen(filename);
+  if(len && filename[len - 1] == '*')
+    filename[--len] = '\0';
+
+  if(!len)
+    return;
+
+  if(fsafetranslate(filename, translated_name, MAX_PATH) != FSAFE_SUCCESS &&
+   audio_legacy_translate(filename, translated_name, MAX_PATH) != FSAFE_SUCCESS)
+    return;
+
+  if(!strcasecmp(translated_name, mzx_world->real_mod_playing))
+    return;
+
+  audio_prefetch_module(translated_name);
+  (*remaining)--;
+}
+
+/**
+ * Load the modules of boards reachable from the current board in the
+ * background. Adjacent boards are requested first, followed by boards
+ * reachable through entrances.
+ */
+void prefetch_board_modules(struct world *mzx_world)
+{
+  struct board *cur_board = mzx_world->current_board;
+  boolean visited[MAX_BOARDS];
+  int remaining = audio_get_module_prefetch();
+  int board_size;
+  int i;
+
+  if(!remaining || !cur_board)
+    return;
+
+  memset(visited, 0, sizeof(visited));
+  if(mzx_world->current_board_id >= 0 &&
+   mzx_world->current_board_id < MAX_BOARDS)
+    visited[mzx_world->current_board_id] = true;
+
+  for(i = 0; i < 4; i++)
+    prefetch_board_module(mzx_world, cur_board->board_dir[i], visited,
+     &remaining);
+
+  board_size = cur_board->board_width * cur_board->board_height;
+  for(i = 0; i < board_size && remaining > 0; i++)
+  {
+    enum thing id = (enum thing)cur_board->level_id[i];
+    enum thing under_id = (enum thing)cur_board->level_under_id[i];
+
+    if(flags[id] & A_ENTRANCE)
+    {
+      prefetch_board_module(mzx_world,
+       (unsigned char)cur_board->level_param[i], visited, &remaining);
+    }
+    else
+
+    if(flags[under_id] & A_ENTRANCE)
+    {
+      prefetch_board_module(mzx_world,
+       (unsigned char)cur_board->level_under_param[i], visited, &remaining);
+    }
+  }
+}
+
+#ifdef CONFIG_EXTRAM
+
+// Distance from the player to look for entrances to prefetch.
+#define BOARD_PREFETCH_RADIUS 16
+#define BOARD_PREFETCH_TELEPORTS 32
+#define BOARD_PREFETCH_MAX 16
+// Idle cycles before the prediction is refreshed while the player is still.
+#define BOARD_PREFETCH_REFRESH 32
+
+struct board_prefetch_state
+{
+  struct board *board;
+  int player_x;
+  int player_y;
+  int idle;
+  uint32_t robots_hash;
+  int robots_age;
+  int num_teleports;
+  int teleport_robot[BOARD_PREFETCH_TELEPORTS];
+  int teleport_board[BOARD_PREFETCH_TELEPORTS];
+};
+
+static struct board_prefetch_state board_prefetch_state;
+
+/**
+ * Forget the current board's prediction. This needs to be done when the
+ * world is cleared, since the address of a freed board may be reused.
+ */
+void reset_extram_board_prefetch(void)
+{
+  memset(&board_prefetch_state, 0, sizeof(struct board_prefetch_state));
+}
+
+/**
+ * Get a value that changes when the current board's robots or their programs
+ * change, so the TELEPORT targets can be found again.
+ */
+static uint32_t prefetch_robots_hash(struct board *cur_board)
+{
+  uint32_t hash = 2166136261u;
+  int i;
+  int j;
+
+  for(i = 1; i <= cur_board->num_robots; i++)
+  {
+    struct robot *cur_robot = cur_board->robot_list[i];
+    const char *program;
+
+    if(!cur_robot || !cur_robot->program_bytecode)
+      continue;
+
+    program = cur_robot->program_bytecode;
+    hash = (hash ^ i) * 16777619u;
+    for(j = 0; j < cur_robot->program_bytecode_length; j++)
+      hash = (hash ^ (uint8_t)program[j]) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Find the TELEPORT commands in the current board's robots that have a
+ * constant destination board.
+ */
+static void prefetch_find_teleports(struct world *mzx_world,
+ struct board_prefetch_state *state)
+{
+  struct board *cur_board = mzx_world->current_board;
+  const char *names[BOARD_PREFETCH_TELEPORTS];
+  int num_names;
+  int i;
+  int j;
+
+  state->num_teleports = 0;
+
+  for(i = 1; i <= cur_board->num_robots; i++)
+  {
+    struct robot *cur_robot = cur_board->robot_list[i];
+
+    if(!cur_robot)
+      continue;
+
+    num_names = get_program_teleports(cur_robot->program_bytecode,
+     cur_robot->program_bytecode_length, names,
+     BOARD_PREFETCH_TELEPORTS - state->num_teleports);
+
+    for(j = 0; j < num_names; j++)
+    {
+      int board_id = find_board(mzx_world, (char *)names[j]);
+      if(board_id == NO_BOARD)
+        continue;
+
+      state->teleport_robot[state->num_teleports] = i;
+      state->teleport_board[state->num_teleports] = board_id;
+      state->num_teleports++;
+    }
+
+    if(state->num_teleports >= BOARD_PREFETCH_TELEPORTS)
+      return;
+  }
+}
+
+static void prefetch_board_candidate(struct world *mzx_world, int *distance,
+ int board_id, int dist)
+{
+  if(board_id >= 0 && board_id < mzx_world->num_boards &&
+   dist < distance[board_id])
+    distance[board_id] = dist;
+}
+
+/**
+ * Decompress the boards the player is most likely to enter next out of extra
+ * RAM in the background. Candidates are the adjacent boards, the targets of
+ * entrances near the player, and the targets of robot teleports; the closest
+ * to the player are requested first.
+ */
+static void prefetch_extram_boards(struct world *mzx_world)
+{
+  struct board_prefetch_state *state = &board_prefetch_state;
+  struct board *cur_board = mzx_world->current_board;
+  struct board *boards[BOARD_PREFETCH_MAX];
+  int distance[MAX_BOARDS];
+  int remaining = get_config()->board_prefetch;
+  int player_x = mzx_world->player_x;
+  int player_y = mzx_world->player_y;
+  int board_width;
+  int board_height;
+  int count = 0;
+  int x1, y1, x2, y2;
+  int x, y;
+  int i;
+
+  if(!remaining || !cur_board)
+    return;
+
+  if(cur_board == state->board && player_x == state->player_x &&
+   player_y == state->player_y && state->idle++ < BOARD_PREFETCH_REFRESH)
+    return;
+
+  // Robot programs can change at any time, but they don't need to be checked
+  // every time the player moves.
+  if(cur_board != state->board || state->robots_age++ >= BOARD_PREFETCH_REFRESH)
+  {
+    uint32_t robots_hash = prefetch_robots_hash(cur_board);
+
+    if(cur_board != state->board || robots_hash != state->robots_hash)
+    {
+      state->board = cur_board;
+      state->robots_hash = robots_hash;
+      prefetch_find_teleports(mzx_world, state);
+    }
+    state->robots_age = 0;
+  }
+  state->player_x = player_x;
+  state->player_y = player_y;
+  state->idle = 0;
+
+  for(i = 0; i < MAX_BOARDS; i++)
+    distance[i] = INT_MAX;
+
+  board_width = cur_board->board_width;
+  board_height = cur_board->board_height;
+
+  // Adjacent boards, by distance to the edge.
+  prefetch_board_candidate(mzx_world, distance, cur_board->board_dir[0],
+   player_y + 1);
+  prefetch_board_candidate(mzx_world, distance, cur_board->board_dir[1],
+   board_height - player_y);
+  prefetch_board_candidate(mzx_world, distance, cur_board->board_dir[2],
+   board_width - player_x);
+  prefetch_board_candidate(mzx_world, distance, cur_board->board_dir[3],
+   player_x + 1);
+
+  // Entrances near the player.
+  x1 = MAX(0, player_x - BOARD_PREFETCH_RADIUS);
+  y1 = MAX(0, player_y - BOARD_PREFETCH_RADIUS);
+  x2 = MIN(board_width - 1, player_x + BOARD_PREFETCH_RADIUS);
+  y2 = MIN(board_height - 1, player_y + BOARD_PREFETCH_RADIUS);
+
+  for(y = y1; y <= y2; y++)
+  {
+    for(x = x1; x <= x2; x++)
+    {
+      int offset = x + y * board_width;
+      int dist = abs(x - player_x) + abs(y - player_y);
+      enum thing id = (enum thing)cur_board->level_id[offset];
+      enum thing under_id = (enum thing)cur_board->level_under_id[offset];
+
+      if(flags[id] & A_ENTRANCE)
+      {
+        prefetch_board_candidate(mzx_world, distance,
+         (unsigned char)cur_board->level_param[offset], dist);
+      }
+      else
+
+      if(flags[under_id] & A_ENTRANCE)
+      {
+        prefetch_board_candidate(mzx_world, distance,
+         (unsigned char)cur_board->level_under_param[offset], dist);
+      }
+    }
+  }
+
+  // Robot teleports.
+  for(i = 0; i < state->num_teleports; i++)
+  {
+    int robot_id = state->teleport_robot[i];
+    struct robot *cur_robot;
+
+    if(robot_id > cur_board->num_robots)
+      continue;
+
+    cur_robot = cur_board->robot_list[robot_id];
+    if(cur_robot)
+    {
+      prefetch_board_candidate(mzx_world, distance, state->teleport_board[i],
+       abs(cur_robot->xpos - player_x) + abs(cur_robot->ypos - player_y));
+    }
+  }
+
+  if(mzx_world->current_board_id >= 0 &&
+   mzx_world->current_board_id < MAX_BOARDS)
+    distance[mzx_world->current_board_id] = INT_MAX;
+
+  remaining = MIN(remaining, BOARD_PREFETCH_MAX);
+  while(count < remaining)
+  {
+    struct board *dest_board;
+    int best = -1;
+
+    for(i = 0; i < mzx_world->num_boards; i++)
+      if(distance[i] < INT_MAX && (best < 0 || distance[i] < distance[best]))
+        best = i;
+
+    if(best < 0)
+      break;
+
+    distance[best] = INT_MAX;
+    dest_board = mzx_world->board_list[best];
+    if(dest_board && dest_board->is_extram && !dest_board->deferred)
+      boards[count++] = dest_board;
+  }
+
+  prefetch_boards_from_extram(boards, count);
+}
+
+#endif /* CONFIG_EXTRAM */
+
 /**
  * Fade out before the world load and clear the screen. The Emscripten port and
  * anything using the meter without a protected palette need special handling.
@@ -255,6 +588,7 @@ static boolean load_world_gameplay_ext(struct game_context *game, char *name,
     // Load the mod unless it's the mod from the title screen or *.
     strcpy(mzx_world->real_mod_playing, old_mod_playing);
     load_game_module(mzx_world, cur_board->mod_playing, true);
+    prefetch_board_modules(mzx_world);
     sfx_clear_queue();
 
     caption_set_world(mzx_world);
@@ -352,6 +686,7 @@ static boolean load_savegame(struct game_context *game, char *name)
     find_player(mzx_world);
 
     load_game_module(mzx_world, mzx_world->real_mod_playing, false);
+    prefetch_board_modules(mzx_world);
     sfx_clear_queue();
 
     if(save_is_faded)
@@ -482,6 +817,13 @@ static boolean game_idle(context *ctx)
   if(!mzx_world->active)
     return false;
 
+  // Report the result of a finished background save.
+  save_world_async_update();
+
+#ifdef CONFIG_EXTRAM
+  prefetch_extram_boards(mzx_world);
+#endif
+
   if(game->fade_in)
   {
     vquick_fadein();
@@ -502,6 +844,7 @@ static boolean game_idle(context *ctx)
 
       // Load the new board's mod
       load_board_module(mzx_world);
+      prefetch_board_modules(mzx_world);
 
       // Send both JUSTLOADED and JUSTENTERED; the JUSTENTERED label will take
       // priority if a robot defines it (instead of JUSTLOADED like on the title
@@ -521,6 +864,7 @@ static boolean game_idle(context *ctx)
       // real_mod_playing was set during the savegame load but the mod hasn't
       // started playing yet.
       load_game_module(mzx_world, mzx_world->real_mod_playing, false);
+      prefetch_board_modules(mzx_world);
 
       // Only send JUSTLOADED for savegames.
       send_robot_def(mzx_world, 0, LABEL_JUSTLOADED);
@@ -570,7 +914,7 @@ static boolean game_idle(context *ctx)
   // The SAVE_GAME counter might have been used this cycle.
   if(!game->is_title && mzx_world->robotic_save_type == SAVE_GAME)
   {
-    save_world(mzx_world, mzx_world->robotic_save_path, true, MZX_VERSION);
+    save_world_async(mzx_world, mzx_world->robotic_save_path);
     mzx_world->robotic_save_type = SAVE_NONE;
   }
 
@@ -696,7 +1040,7 @@ static boolean game_key(context *ctx, int *key)
             ALLOW_ALL_DIRS))
           {
             strcpy(curr_sav, save_game);
-            save_world(mzx_world, curr_sav, true, MZX_VERSION);
+            save_world_async(mzx_world, curr_sav);
           }
         }
         return true;
@@ -756,7 +1100,7 @@ static boolean game_key(context *ctx, int *key)
       case IKEY_F9:
       {
         if(allow_save_menu(mzx_world))
-          save_world(mzx_world, curr_sav, true, MZX_VERSION);
+          save_world_async(mzx_world, curr_sav);
 
         return true;
       }
@@ -768,6 +1112,7 @@ static boolean game_key(context *ctx, int *key)
         {
           struct stat file_info;
 
+          save_world_async_wait();
           if(!vstat(curr_sav, &file_info))
             load_savegame(game, curr_sav);
         }
@@ -35,6 +35,13 @@ CORE_LIBSPEC void title_screen(context *parent);
 CORE_LIBSPEC void load_board_module(struct world *mzx_world);
 CORE_LIBSPEC boolean load_game_module(struct world *mzx_world, char *filename,
  boolean fail_if_same);
+void prefetch_board_modules(struct world *mzx_world);
+
+#ifdef CONFIG_EXTRAM
+void reset_extram_board_prefetch(void);
+#else
+static inline void reset_extram_board_prefetch(void) {}
+#endif
 
 void clear_intro_mesg(void);
 void draw_intro_mesg(struct world *mzx_world);
@@ -1192,6 +1192,9 @@ boolean update_resolve_target(struct world *mzx_world,
        */
       load_game_module(mzx_world, src_board->mod_playing, true);
 
+      // Start loading the modules for the boards reachable from here.
+      prefetch_board_modules(mzx_world);
+
 #ifdef CONFIG_EDITOR
       // Also, update the caption to indicate the current board.
       if(mzx_world->editing)
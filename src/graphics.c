@@ -35,6 +35,7 @@
 #include "configure.h"
 #include "error.h"
 #include "event.h"
+#include "file_cache.h"
 #include "graphics.h"
 #include "platform.h"
 #include "render.h"
@@ -218,13 +219,116 @@ void ec_clear_set(void)
   remap_char_range(&graphics, 0, FULL_CHARSET_SIZE);
 }
 
-boolean ec_load_set(const char *filename)
+/**
+ * Worlds that animate by swapping charsets and palettes load the same few
+ * files over and over, so recently loaded graphics files are cached in memory
+ * (see file_cache.h). Only as much of a file as can be loaded into the
+ * charset is kept.
+ */
+#define GRAPHICS_CACHE_MAX_ENTRIES 32
+#define GRAPHICS_CACHE_MAX_READ    (PROTECTED_CHARSET_POSITION * CHAR_SIZE)
+#define GRAPHICS_CACHE_MAX_SIZE    (GRAPHICS_CACHE_MAX_READ * 8)
+
+struct graphics_file
+{
+  const uint8_t *data;
+  size_t file_length;
+  size_t length;
+  void *to_free;
+};
+
+static struct file_cache_entry
+ graphics_cache_entries[GRAPHICS_CACHE_MAX_ENTRIES];
+static struct file_cache graphics_cache =
+{
+  graphics_cache_entries,
+  GRAPHICS_CACHE_MAX_ENTRIES,
+  GRAPHICS_CACHE_MAX_SIZE,
+  0,
+  GRAPHICS_CACHE_MAX_READ,
+  NULL,
+  0, 0, 0
+};
+
+/**
+ * Remove all graphics files from the cache.
+ */
+void graphics_cache_clear(void)
+{
+  file_cache_clear(&graphics_cache);
+}
+
+/**
+ * Read up to GRAPHICS_CACHE_MAX_READ bytes of a file into a new buffer.
+ */
+static uint8_t *graphics_file_read(const char *filename, size_t *file_length,
+ size_t *length)
 {
   vfile *vf = vfopen_unsafe(filename, "rb");
-  if(vf)
+  uint8_t *data;
+  int64_t len;
+
+  if(!vf)
+    return NULL;
+
+  len = vfilelength(vf, false);
+  if(len < 0)
   {
-    int count = vfread(graphics.charset, CHAR_SIZE, PROTECTED_CHARSET_POSITION, vf);
     vfclose(vf);
+    return NULL;
+  }
+
+  *file_length = len;
+  *length = MIN((size_t)len, (size_t)GRAPHICS_CACHE_MAX_READ);
+  data = (uint8_t *)malloc(MAX(*length, 1));
+  if(data)
+    *length = vfread(data, 1, *length, vf);
+
+  vfclose(vf);
+  return data;
+}
+
+/**
+ * Get the contents of a graphics file, from the cache if possible.
+ * Release the file with graphics_file_release.
+ */
+static boolean graphics_file_get(const char *filename, struct graphics_file *f)
+{
+  struct file_cache_entry *e = file_cache_get(&graphics_cache, filename);
+
+  memset(f, 0, sizeof(struct graphics_file));
+
+  if(!e)
+  {
+    // Not cacheable, but it might still be possible to open it.
+    uint8_t *data = graphics_file_read(filename, &(f->file_length), &(f->length));
+    f->data = data;
+    f->to_free = data;
+    return data != NULL;
+  }
+
+  f->data = (const uint8_t *)e->data;
+  f->file_length = e->file_length;
+  f->length = e->length;
+  return true;
+}
+
+static void graphics_file_release(struct graphics_file *f)
+{
+  free(f->to_free);
+  f->to_free = NULL;
+}
+
+boolean ec_load_set(const char *filename)
+{
+  struct graphics_file f;
+  if(graphics_file_get(filename, &f))
+  {
+    size_t len = MIN(f.length, (size_t)PROTECTED_CHARSET_POSITION * CHAR_SIZE);
+    int count = len / CHAR_SIZE;
+
+    memcpy(graphics.charset, f.data, len);
+    graphics_file_release(&f);
 
     if(count > 0)
     {
@@ -254,13 +358,13 @@ __editor_maybe_static void ec_load_set_secondary(const char *filename,
 
 int ec_load_set_var(const char *filename, uint16_t first_chr, int version)
 {
-  vfile *vf = vfopen_unsafe(filename, "rb");
-  if(vf)
+  struct graphics_file f;
+  if(graphics_file_get(filename, &f))
   {
     int maxchars = PROTECTED_CHARSET_POSITION;
     int count;
 
-    int size = vfilelength(vf, false) / CHAR_SIZE;
+    int size = f.file_length / CHAR_SIZE;
 
     if(version >= V290)
     {
@@ -271,15 +375,16 @@ int ec_load_set_var(const char *filename, uint16_t first_chr, int version)
 
     if(first_chr > maxchars)
     {
-      vfclose(vf);
+      graphics_file_release(&f);
       return -1;
     }
 
     if(size + first_chr > maxchars)
       size = maxchars - first_chr;
 
-    count = vfread(graphics.charset + (first_chr * CHAR_SIZE), CHAR_SIZE, size, vf);
-    vfclose(vf);
+    count = MIN((size_t)size, f.length / CHAR_SIZE);
+    memcpy(graphics.charset + (first_chr * CHAR_SIZE), f.data, count * CHAR_SIZE);
+    graphics_file_release(&f);
 
     // some renderers may want to map charsets to textures
     if(count > 0)
@@ -782,14 +887,13 @@ int get_char_average_luma(uint16_t chr, uint8_t palette, int mode, int mask_chr)
 
 void load_palette(const char *filename)
 {
+  struct graphics_file f;
   int file_size, i, r, g, b;
-  vfile *pal_file;
 
-  pal_file = vfopen_unsafe(filename, "rb");
-  if(!pal_file)
+  if(!graphics_file_get(filename, &f))
     return;
 
-  file_size = vfilelength(pal_file, false);
+  file_size = f.length;
 
   switch(graphics.screen_mode)
   {
@@ -806,13 +910,13 @@ void load_palette(const char *filename)
 
   for(i = 0; i < file_size / 3; i++)
   {
-    r = vfgetc(pal_file);
-    g = vfgetc(pal_file);
-    b = vfgetc(pal_file);
+    r = f.data[i * 3 + 0];
+    g = f.data[i * 3 + 1];
+    b = f.data[i * 3 + 2];
     set_rgb(i, r, g, b);
   }
 
-  vfclose(pal_file);
+  graphics_file_release(&f);
 }
 
 void load_palette_mem(const void *buffer, size_t len)
@@ -844,24 +948,21 @@ void load_palette_mem(const void *buffer, size_t len)
 
 void load_index_file(const char *filename)
 {
-  vfile *idx_file;
-  int i;
+  struct graphics_file f;
+  size_t pos;
+  int i, j;
 
   if(get_screen_mode() != 3)
     return;
 
-  idx_file = vfopen_unsafe(filename, "rb");
-  if(idx_file)
+  if(graphics_file_get(filename, &f))
   {
-    for(i = 0; i < SMZX_PAL_SIZE; i++)
-    {
-      set_smzx_index(i, 0, vfgetc(idx_file));
-      set_smzx_index(i, 1, vfgetc(idx_file));
-      set_smzx_index(i, 2, vfgetc(idx_file));
-      set_smzx_index(i, 3, vfgetc(idx_file));
-    }
+    // Missing bytes read as EOF, which wraps to 255.
+    for(i = 0, pos = 0; i < SMZX_PAL_SIZE; i++)
+      for(j = 0; j < 4; j++, pos++)
+        set_smzx_index(i, j, pos < f.length ? f.data[pos] : 255);
 
-    vfclose(idx_file);
+    graphics_file_release(&f);
   }
 }
 
@@ -287,6 +287,7 @@ CORE_LIBSPEC void update_palette(void);
 CORE_LIBSPEC void load_palette(const char *filename);
 CORE_LIBSPEC void load_palette_mem(const void *buffer, size_t len);
 CORE_LIBSPEC void load_index_file(const char *filename);
+CORE_LIBSPEC void graphics_cache_clear(void);
 CORE_LIBSPEC void smzx_palette_loaded(boolean is_loaded);
 CORE_LIBSPEC void set_screen_mode(unsigned int mode);
 CORE_LIBSPEC unsigned int get_screen_mode(void);
@@ -28,6 +28,7 @@
 #include "path.h"
 #include "vio.h"
 
+#include "../hashtable.h"
 #include "../util.h"
 
 #if defined(CONFIG_3DS)
@@ -419,6 +420,245 @@ static int case5(char *path, size_t buffer_len, char *string, boolean check_sfn)
   return ret;
 }
 
+/**
+ * Directory index cache. Resolving a path component case-insensitively
+ * otherwise requires several stat calls and possibly a scan of the entire
+ * directory, which adds up quickly for worlds that load many files per board.
+ * Instead, each directory that needs resolving is read once into a hash table
+ * keyed by the case-folded filename. The cache is discarded whenever vio
+ * reports that the filesystem or the working directory may have changed.
+ * Files can also be created outside of vio (by another program, or by the
+ * user copying files in), so a directory is read again before a name that
+ * isn't in its index is reported missing.
+ *
+ * This cache is not thread-safe; fsafetranslate is only used from the
+ * main thread.
+ */
+
+#define FSAFE_INDEX_CACHE_SIZE 8
+
+enum fsafe_index_result
+{
+  FSAFE_INDEX_FOUND,
+  FSAFE_INDEX_NOT_FOUND,
+  FSAFE_INDEX_UNAVAILABLE
+};
+
+struct fsafe_index_entry
+{
+  uint32_t hash;
+  uint16_t name_length;
+  uint8_t ambiguous;
+  uint8_t unused;
+
+  /**
+   * Allocated with extra space to hold the entire null-terminated name.
+   * This field must be 4-aligned and must be the last field.
+   */
+  char name[1];
+};
+
+HASH_SET_INIT(FSAFE_INDEX, struct fsafe_index_entry *, name, name_length)
+
+struct fsafe_index
+{
+  char *dir;
+  size_t dir_len;
+  hash_t(FSAFE_INDEX) *table;
+  unsigned int last_used;
+};
+
+static struct fsafe_index fsafe_index_cache[FSAFE_INDEX_CACHE_SIZE];
+static unsigned int fsafe_index_generation;
+static unsigned int fsafe_index_timer;
+
+static void fsafe_index_free(struct fsafe_index *idx)
+{
+  struct fsafe_index_entry *entry;
+
+  HASH_ITER(FSAFE_INDEX, idx->table, entry,
+  {
+    free(entry);
+  });
+  HASH_CLEAR(FSAFE_INDEX, idx->table);
+
+  free(idx->dir);
+  idx->dir = NULL;
+  idx->dir_len = 0;
+}
+
+static void fsafe_index_add(struct fsafe_index *idx, const char *name)
+{
+  struct fsafe_index_entry *entry;
+  size_t name_length = strlen(name);
+
+  if(name_length > UINT16_MAX)
+    return;
+
+  HASH_FIND(FSAFE_INDEX, idx->table, name, name_length, entry);
+  if(entry)
+  {
+    // Another file with the same name in a different case. The index can't
+    // choose between them, so lookups for this name fall back to probing.
+    entry->ambiguous = true;
+    return;
+  }
+
+  entry = (struct fsafe_index_entry *)cmalloc(
+   MAX(sizeof(struct fsafe_index_entry),
+   offsetof(struct fsafe_index_entry, name) + name_length + 1));
+
+  memcpy(entry->name, name, name_length + 1);
+  entry->name_length = name_length;
+  entry->ambiguous = false;
+  HASH_ADD(FSAFE_INDEX, idx->table, entry);
+}
+
+/**
+ * Read the directory with the given prefix into a free (or the least
+ * recently used) index cache slot.
+ */
+static struct fsafe_index *fsafe_index_build(const char *dir, size_t dir_len)
+{
+  struct fsafe_index *idx = &(fsafe_index_cache[0]);
+  char *buffer;
+  vdir *wd;
+  int i;
+
+  if(dir_len + 2 >= MAX_PATH)
+    return NULL;
+
+  for(i = 1; i < FSAFE_INDEX_CACHE_SIZE; i++)
+  {
+    if(!idx->dir)
+      break;
+
+    if(!fsafe_index_cache[i].dir ||
+     fsafe_index_cache[i].last_used < idx->last_used)
+      idx = &(fsafe_index_cache[i]);
+  }
+
+  if(idx->dir)
+    fsafe_index_free(idx);
+
+  // The directory prefix includes its trailing slash, if any.
+  buffer = (char *)cmalloc(MAX_PATH);
+  snprintf(buffer, MAX_PATH, "./%.*s", (int)(dir_len ? dir_len - 1 : 0), dir);
+
+  wd = vdir_open_ext(buffer, VDIR_FAST);
+  if(!wd)
+  {
+    free(buffer);
+    return NULL;
+  }
+
+  while(vdir_read(wd, buffer, MAX_PATH, NULL))
+    fsafe_index_add(idx, buffer);
+
+  vdir_close(wd);
+
+  // Reuse the buffer for the directory key.
+  memcpy(buffer, dir, dir_len);
+  buffer[dir_len] = '\0';
+  idx->dir = buffer;
+  idx->dir_len = dir_len;
+  return idx;
+}
+
+static struct fsafe_index *fsafe_index_get(const char *dir, size_t dir_len,
+ boolean *is_new)
+{
+  unsigned int generation = vio_get_directory_generation();
+  struct fsafe_index *idx = NULL;
+  int i;
+
+  *is_new = false;
+
+  if(generation != fsafe_index_generation)
+  {
+    for(i = 0; i < FSAFE_INDEX_CACHE_SIZE; i++)
+      if(fsafe_index_cache[i].dir)
+        fsafe_index_free(&(fsafe_index_cache[i]));
+
+    fsafe_index_generation = generation;
+  }
+
+  for(i = 0; i < FSAFE_INDEX_CACHE_SIZE; i++)
+  {
+    struct fsafe_index *current = &(fsafe_index_cache[i]);
+
+    if(current->dir && current->dir_len == dir_len &&
+     !memcmp(current->dir, dir, dir_len))
+    {
+      idx = current;
+      break;
+    }
+  }
+
+  if(!idx)
+  {
+    idx = fsafe_index_build(dir, dir_len);
+    *is_new = true;
+  }
+
+  if(idx)
+    idx->last_used = ++fsafe_index_timer;
+
+  return idx;
+}
+
+/**
+ * Look up the final token of `path` in the index of its parent directory.
+ * If it is found, the token is replaced with the real name of the file.
+ */
+static enum fsafe_index_result fsafe_index_lookup(const char *path,
+ char *token)
+{
+  struct fsafe_index_entry *entry;
+  struct fsafe_index *idx;
+  size_t token_len = strlen(token);
+  size_t dir_len = token - path;
+  boolean is_new;
+
+  idx = fsafe_index_get(path, dir_len, &is_new);
+  if(!idx)
+    return FSAFE_INDEX_UNAVAILABLE;
+
+  HASH_FIND(FSAFE_INDEX, idx->table, token, token_len, entry);
+  if(!entry && !is_new)
+  {
+    // The file may have been created since the index was built.
+    fsafe_index_free(idx);
+    idx = fsafe_index_build(path, dir_len);
+    if(!idx)
+      return FSAFE_INDEX_UNAVAILABLE;
+
+    idx->last_used = ++fsafe_index_timer;
+    HASH_FIND(FSAFE_INDEX, idx->table, token, token_len, entry);
+  }
+  if(!entry)
+    return FSAFE_INDEX_NOT_FOUND;
+
+  if(entry->ambiguous)
+    return FSAFE_INDEX_UNAVAILABLE;
+
+  memcpy(token, entry->name, token_len);
+  return FSAFE_INDEX_FOUND;
+}
+
+/**
+ * Determine if case5 might still match a token that isn't in the index.
+ */
+static boolean fsafe_index_can_expand(const char *token, boolean is_file)
+{
+#ifdef CONFIG_DJGPP
+  // An LFN can also be matched by its generated SFN.
+  return true;
+#else
+  return is_file && is_sfn(token, strlen(token)) == SFN_TRUNCATED;
+#endif
+}
+
 static int match(char *path, size_t buffer_len)
 {
   char *nexttoken = path;
@@ -444,7 +684,29 @@ static int match(char *path, size_t buffer_len)
       // this token is the file
       if(nexttoken == NULL)
       {
-        for(i = 0; i < 5; i++)
+        i = 0;
+        switch(fsafe_index_lookup(path, token))
+        {
+          case FSAFE_INDEX_FOUND:
+            return FSAFE_SUCCESS;
+
+          case FSAFE_INDEX_NOT_FOUND:
+            // The file doesn't exist in any case; only try brute force if it
+            // might match an SFN.
+            if(!fsafe_index_can_expand(token, true))
+            {
+              trace("%s:%d: file matches for %s failed (index).\n",
+               __FILE__, __LINE__, path);
+              return -FSAFE_MATCH_FAILED;
+            }
+            i = 4;
+            break;
+
+          case FSAFE_INDEX_UNAVAILABLE:
+            break;
+        }
+
+        for(; i < 5; i++)
         {
           // check file
           if(vstat(path, &inode) == 0)
@@ -487,7 +749,28 @@ static int match(char *path, size_t buffer_len)
         break;
       }
 
-      for(i = 0; i < 3; i++)
+      i = 0;
+      switch(fsafe_index_lookup(path, token))
+      {
+        case FSAFE_INDEX_FOUND:
+          i = 3;
+          break;
+
+        case FSAFE_INDEX_NOT_FOUND:
+          if(!fsafe_index_can_expand(token, false))
+          {
+            trace("%s:%d: directory matches for %s failed (index).\n",
+             __FILE__, __LINE__, path);
+            return -FSAFE_MATCH_FAILED;
+          }
+          i = 2;
+          break;
+
+        case FSAFE_INDEX_UNAVAILABLE:
+          break;
+      }
+
+      for(; i < 3; i++)
       {
         // check directory
         if(vstat(path, &inode) == 0)
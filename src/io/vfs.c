@@ -61,6 +61,7 @@ enum vfs_inode_flags
   VFS_INODE_DIR        = (1<<1),
   VFS_INODE_TYPEMASK   = VFS_INODE_FILE | VFS_INODE_DIR,
   VFS_INODE_IS_REAL    = (1<<2), // Cache of a real location in the filesystem.
+  VFS_INODE_IN_LRU     = (1<<3), // Cached file in the eviction list.
   VFS_INODE_NAME_ALLOC = (1<<7),
 };
 
@@ -84,6 +85,10 @@ struct vfs_inode
   uint8_t refcount; // If 255, refuse creation of new refs.
   uint16_t name_length;
   uint32_t parent;
+  uint32_t lru_prev; // More recently used cached file.
+  uint32_t lru_next; // Less recently used cached file.
+  uint16_t lock_readers; // Number of reading locks on the file contents.
+  uint8_t lock_writer; // Is the file contents locked for writing?
   char name[16];
 };
 
@@ -101,6 +106,10 @@ struct vfs_inode_name_alloc
   uint8_t refcount; // If 255, refuse creation of new refs.
   uint16_t name_length;
   uint32_t parent;
+  uint32_t lru_prev;
+  uint32_t lru_next;
+  uint16_t lock_readers;
+  uint8_t lock_writer;
   char *name;
 };
 
@@ -116,11 +125,17 @@ struct vfilesystem
   platform_thread_id origin;
   platform_mutex lock;
   platform_cond cond;
+  platform_cond file_cond;
   int num_writers;
   int num_readers;
   int num_promotions;
 #endif
   size_t cache_total;
+  size_t cache_hits;
+  size_t cache_misses;
+  size_t cache_evictions;
+  uint32_t lru_head; // Most recently used cached file.
+  uint32_t lru_tail; // Least recently used cached file.
   boolean is_writer;
   boolean disable_timestamp;
   int error;
@@ -224,6 +239,8 @@ static boolean vfs_inode_init_file(struct vfs_inode *n, const char *name,
   n->create_time = 0;
   n->modify_time = 0;
   n->refcount = 0;
+  n->lock_readers = 0;
+  n->lock_writer = 0;
   n->flags = VFS_INODE_FILE;
   n->parent = VFS_NO_INODE;
   if(is_real)
@@ -407,6 +424,7 @@ static boolean vfs_init_lock(vfilesystem *vfs)
 #ifdef VIRTUAL_FILESYSTEM_PARALLEL
   platform_mutex_init(&(vfs->lock));
   platform_cond_init(&(vfs->cond));
+  platform_cond_init(&(vfs->file_cond));
   vfs->origin = platform_get_thread_id();
   vfs->num_readers = 0;
   vfs->num_writers = 0;
@@ -423,6 +441,7 @@ static boolean vfs_clear_lock(vfilesystem *vfs)
 #ifdef VIRTUAL_FILESYSTEM_PARALLEL
   platform_mutex_destroy(&(vfs->lock));
   platform_cond_destroy(&(vfs->cond));
+  platform_cond_destroy(&(vfs->file_cond));
 #endif
   return true;
 }
@@ -457,7 +476,8 @@ static boolean vfs_read_unlock(vfilesystem *vfs)
 
   assert(vfs->num_readers > 0);
   vfs->num_readers--;
-  if(!vfs->num_readers)
+  // Wake writers, including readers waiting to be promoted to writers.
+  if(vfs->num_readers <= vfs->num_promotions)
     platform_cond_broadcast(&(vfs->cond));
 
   platform_mutex_unlock(&(vfs->lock));
@@ -534,6 +554,111 @@ static boolean vfs_elevate_lock(vfilesystem *vfs)
   return true;
 }
 
+/**
+ * Serialize a small update to shared state (the LRU list or the cache
+ * statistics) made by a thread holding a reader lock. Readers can run in
+ * parallel with each other, but never with a writer, so a writer doesn't
+ * need to use this.
+ */
+static void vfs_shared_update_begin(vfilesystem *vfs)
+{
+#ifdef VIRTUAL_FILESYSTEM_PARALLEL
+  platform_mutex_lock(&(vfs->lock));
+#endif
+}
+
+static void vfs_shared_update_end(vfilesystem *vfs)
+{
+#ifdef VIRTUAL_FILESYSTEM_PARALLEL
+  platform_mutex_unlock(&(vfs->lock));
+#endif
+}
+
+/**
+ * The contents of each open file have their own reader/writer lock, separate
+ * from the lock for the inode table. A thread holding a file lock does not
+ * hold any lock on the table, so reading one file never blocks reading or
+ * writing a different file, and never blocks operations on the table.
+ *
+ * The inode structure of an open file is never freed or moved, so it is safe
+ * to use after the table lock is released. Table operations never modify
+ * the contents of an open file.
+ */
+static boolean vfs_file_read_lock(vfilesystem *vfs, struct vfs_inode *n)
+{
+#ifdef VIRTUAL_FILESYSTEM_PARALLEL
+  if(!platform_mutex_lock(&(vfs->lock)))
+  {
+    vfs_seterror(vfs, VFS_ERR_UNKNOWN);
+    return false;
+  }
+
+  while(n->lock_writer)
+    platform_cond_wait(&(vfs->file_cond), &(vfs->lock));
+
+  n->lock_readers++;
+
+  platform_mutex_unlock(&(vfs->lock));
+#endif
+  return true;
+}
+
+static boolean vfs_file_read_unlock(vfilesystem *vfs, struct vfs_inode *n)
+{
+#ifdef VIRTUAL_FILESYSTEM_PARALLEL
+  if(!platform_mutex_lock(&(vfs->lock)))
+  {
+    vfs_seterror(vfs, VFS_ERR_UNKNOWN);
+    return false;
+  }
+
+  assert(n->lock_readers > 0);
+  n->lock_readers--;
+  if(!n->lock_readers)
+    platform_cond_broadcast(&(vfs->file_cond));
+
+  platform_mutex_unlock(&(vfs->lock));
+#endif
+  return true;
+}
+
+static boolean vfs_file_write_lock(vfilesystem *vfs, struct vfs_inode *n)
+{
+#ifdef VIRTUAL_FILESYSTEM_PARALLEL
+  if(!platform_mutex_lock(&(vfs->lock)))
+  {
+    vfs_seterror(vfs, VFS_ERR_UNKNOWN);
+    return false;
+  }
+
+  while(n->lock_writer || n->lock_readers)
+    platform_cond_wait(&(vfs->file_cond), &(vfs->lock));
+
+  n->lock_writer = 1;
+
+  platform_mutex_unlock(&(vfs->lock));
+#endif
+  return true;
+}
+
+static boolean vfs_file_write_unlock(vfilesystem *vfs, struct vfs_inode *n)
+{
+#ifdef VIRTUAL_FILESYSTEM_PARALLEL
+  if(!platform_mutex_lock(&(vfs->lock)))
+  {
+    vfs_seterror(vfs, VFS_ERR_UNKNOWN);
+    return false;
+  }
+
+  assert(n->lock_writer);
+  n->lock_writer = 0;
+  platform_cond_broadcast(&(vfs->file_cond));
+
+  platform_mutex_unlock(&(vfs->lock));
+#endif
+  return true;
+}
+
 /**
  * Initialize the given VFS. The initialized VFS will contain one root inode
  * corresponding to C: (Windows) or / (everything else).
@@ -651,6 +776,28 @@ static struct vfs_inode *vfs_get_inode_ptr(vfilesystem *vfs, uint32_t inode)
   return vfs->table[inode];
 }
 
+/**
+ * Get a pointer to an open inode from its index, or `NULL` if the inode is
+ * not open. The caller must not hold a lock on the inode table.
+ */
+static struct vfs_inode *vfs_get_open_inode_ptr(vfilesystem *vfs,
+ uint32_t inode)
+{
+  struct vfs_inode *n = NULL;
+
+  if(!vfs_read_lock(vfs))
+    return NULL;
+
+  if(inode < vfs->table_length)
+  {
+    n = vfs_get_inode_ptr(vfs, inode);
+    if(n && !n->refcount)
+      n = NULL;
+  }
+  vfs_read_unlock(vfs);
+  return n;
+}
+
 /**
  * Get the next unused inode in the VFS. table_next will be advanced to the
  * position of the returned inode. This will allocate more inode space in the
@@ -695,6 +842,65 @@ static uint32_t vfs_get_next_free_inode(vfilesystem *vfs)
   return (vfs->table_length++);
 }
 
+/**
+ * Add a cached file to the front of the LRU list. Cached files are evicted
+ * starting from the back of this list by `vfs_invalidate_at_least`.
+ */
+static void vfs_lru_insert(vfilesystem *vfs, uint32_t inode)
+{
+  struct vfs_inode *n = vfs_get_inode_ptr(vfs, inode);
+
+  assert(~n->flags & VFS_INODE_IN_LRU);
+  n->lru_prev = VFS_NO_INODE;
+  n->lru_next = vfs->lru_head;
+
+  if(vfs->lru_head)
+    vfs_get_inode_ptr(vfs, vfs->lru_head)->lru_prev = inode;
+  else
+    vfs->lru_tail = inode;
+
+  vfs->lru_head = inode;
+  n->flags |= VFS_INODE_IN_LRU;
+}
+
+/**
+ * Remove a cached file from the LRU list.
+ */
+static void vfs_lru_remove(vfilesystem *vfs, uint32_t inode)
+{
+  struct vfs_inode *n = vfs_get_inode_ptr(vfs, inode);
+
+  if(~n->flags & VFS_INODE_IN_LRU)
+    return;
+
+  if(n->lru_prev)
+    vfs_get_inode_ptr(vfs, n->lru_prev)->lru_next = n->lru_next;
+  else
+    vfs->lru_head = n->lru_next;
+
+  if(n->lru_next)
+    vfs_get_inode_ptr(vfs, n->lru_next)->lru_prev = n->lru_prev;
+  else
+    vfs->lru_tail = n->lru_prev;
+
+  n->flags &= ~VFS_INODE_IN_LRU;
+}
+
+/**
+ * Move a cached file to the front of the LRU list. The caller must hold a
+ * writer lock or be inside of `vfs_shared_update_begin`.
+ */
+static void vfs_lru_touch(vfilesystem *vfs, uint32_t inode)
+{
+  struct vfs_inode *n = vfs_get_inode_ptr(vfs, inode);
+
+  if((n->flags & VFS_INODE_IN_LRU) && vfs->lru_head != inode)
+  {
+    vfs_lru_remove(vfs, inode);
+    vfs_lru_insert(vfs, inode);
+  }
+}
+
 /**
  * Returns the inode of a given name within parent. This name should not include
  * path separators. The value of `index` will be set to the index of the inode
@@ -1025,7 +1231,10 @@ static uint32_t vfs_make_inode(vfilesystem *vfs, uint32_t parent,
 
     // Update tracking for the total size of cached files.
     if(is_real)
+    {
       vfs->cache_total += n->length_alloc;
+      vfs_lru_insert(vfs, pos);
+    }
   }
   // Replace the placeholder timestamp with a real one...
   if(is_real && !vfs->disable_timestamp)
@@ -1073,6 +1282,9 @@ static boolean vfs_delete_inode(vfilesystem *vfs, uint32_t inode)
     n->parent = VFS_NO_INODE;
   }
 
+  // Unlinked files can't be evicted, even if they're still open.
+  vfs_lru_remove(vfs, inode);
+
   // Clear the inode and mark it for reuse if it's not currently in-use.
   if(n->refcount == 0)
   {
@@ -1473,7 +1685,12 @@ int vfs_open_if_exists(vfilesystem *vfs, const char *path, boolean is_write,
 
   inode = vfs_get_inode_by_path(vfs, path);
   if(!inode)
+  {
+    vfs_shared_update_begin(vfs);
+    vfs->cache_misses++;
+    vfs_shared_update_end(vfs);
     goto err;
+  }
 
   n = vfs_get_inode_ptr(vfs, inode);
   if(!n || n->refcount >= VFS_MAX_REFCOUNT)
@@ -1486,9 +1703,14 @@ int vfs_open_if_exists(vfilesystem *vfs, const char *path, boolean is_write,
     goto err;
   }
 
+  vfs_shared_update_begin(vfs);
   n->refcount++;
   if(VFS_IS_CACHED(n))
+  {
+    vfs->cache_hits++;
     code = VFS_ERR_IS_CACHED;
+  }
+  vfs_shared_update_end(vfs);
 
   vfs_read_unlock(vfs);
   *_inode = inode;
@@ -1511,6 +1733,7 @@ err:
 int vfs_close(vfilesystem *vfs, uint32_t inode)
 {
   struct vfs_inode *n;
+  uint8_t refcount;
   if(inode >= vfs->table_length)
     return -EBADF;
 
@@ -1518,23 +1741,24 @@ int vfs_close(vfilesystem *vfs, uint32_t inode)
     return -vfs_geterror(vfs);
 
   n = vfs_get_inode_ptr(vfs, inode);
+
+  vfs_shared_update_begin(vfs);
   assert(n->refcount > 0);
-  n->refcount--;
+  refcount = --(n->refcount);
 
   n->modify_time = vfs_get_date();
-  if(VFS_IS_CACHED(n))
+  if(VFS_IS_CACHED(n) && !vfs->disable_timestamp)
+    n->timestamp = vfs_get_timestamp();
+  vfs_shared_update_end(vfs);
+
+  if(refcount == 0 && VFS_IS_CACHED(n) && VFS_IS_INVALIDATED(n))
   {
-    if(n->refcount == 0 && VFS_IS_INVALIDATED(n))
+    if(vfs_elevate_lock(vfs))
     {
-      if(vfs_elevate_lock(vfs))
-      {
-        vfs_delete_inode(vfs, inode);
-        vfs_write_unlock(vfs);
-        return 0;
-      }
+      vfs_delete_inode(vfs, inode);
+      vfs_write_unlock(vfs);
+      return 0;
     }
-    if(!vfs->disable_timestamp)
-      n->timestamp = vfs_get_timestamp();
   }
 
   vfs_read_unlock(vfs);
@@ -1551,30 +1775,26 @@ int vfs_close(vfilesystem *vfs, uint32_t inode)
  */
 int vfs_truncate(vfilesystem *vfs, uint32_t inode)
 {
-  struct vfs_inode *n;
-  if(inode >= vfs->table_length)
+  struct vfs_inode *n = vfs_get_open_inode_ptr(vfs, inode);
+  if(!n)
     return -EBADF;
 
-  if(!vfs_write_lock(vfs))
+  if(!vfs_file_write_lock(vfs, n))
     return -vfs_geterror(vfs);
 
-  n = vfs_get_inode_ptr(vfs, inode);
-  if(!n || !n->refcount)
-  {
-    vfs_write_unlock(vfs);
-    return -EBADF;
-  }
-
   if(n->length_alloc > VFS_DEFAULT_FILE_SIZE)
   {
     unsigned char *tmp = (unsigned char *)realloc(n->contents.data, VFS_DEFAULT_FILE_SIZE);
     if(tmp)
     {
       // Update cache size tracking.
-      if(VFS_IS_CACHED(n))
+      if(VFS_IS_CACHED(n) && vfs_read_lock(vfs))
       {
+        vfs_shared_update_begin(vfs);
         assert(vfs->cache_total >= n->length_alloc);
         vfs->cache_total -= n->length_alloc - VFS_DEFAULT_FILE_SIZE;
+        vfs_shared_update_end(vfs);
+        vfs_read_unlock(vfs);
       }
       n->contents.data = tmp;
       n->length_alloc = VFS_DEFAULT_FILE_SIZE;
@@ -1583,7 +1803,7 @@ int vfs_truncate(vfilesystem *vfs, uint32_t inode)
   }
   n->length = 0;
 
-  vfs_write_unlock(vfs);
+  vfs_file_write_unlock(vfs, n);
   return 0;
 }
 
@@ -1625,8 +1845,9 @@ err:
 
 /**
  * Lock an "open" VFS file for reading and retrieve its underlying data buffer.
- * Multiple reading locks can be acquired on a VFS handle simultaneously, but
- * a reading lock will block if a writing lock is held. To avoid deadlocks,
+ * Multiple reading locks can be acquired on a file simultaneously, but
+ * a reading lock will block if a writing lock is held on the same file.
+ * Locks on different files never block each other. To avoid deadlocks,
  * only one lock should ever be acquired per thread simultaneously.
  *
  * @param vfs         VFS handle.
@@ -1652,6 +1873,14 @@ int vfs_lock_file_read(vfilesystem *vfs, uint32_t inode,
       return -EBADF;
     }
 
+    vfs_shared_update_begin(vfs);
+    vfs_lru_touch(vfs, inode);
+    vfs_shared_update_end(vfs);
+    vfs_read_unlock(vfs);
+
+    if(!vfs_file_read_lock(vfs, n))
+      return -vfs_geterror(vfs);
+
     *data = n->contents.data;
     *data_length = n->length;
     return 0;
@@ -1660,7 +1889,7 @@ int vfs_lock_file_read(vfilesystem *vfs, uint32_t inode,
 }
 
 /**
- * Release a held reading lock on a VFS handle.
+ * Release a held reading lock on a VFS file.
  *
  * @param vfs   VFS handle.
  * @param inode file descriptor to the file to read.
@@ -1669,23 +1898,18 @@ int vfs_lock_file_read(vfilesystem *vfs, uint32_t inode,
  */
 int vfs_unlock_file_read(vfilesystem *vfs, uint32_t inode)
 {
-  if(inode < vfs->table_length)
-  {
-    struct vfs_inode *n = vfs_get_inode_ptr(vfs, inode);
-    if(!n || !n->refcount)
-      return -EBADF;
+  struct vfs_inode *n = vfs_get_open_inode_ptr(vfs, inode);
+  if(n && vfs_file_read_unlock(vfs, n))
+    return 0;
 
-    if(vfs_read_unlock(vfs))
-      return 0;
-  }
   return -EBADF;
 }
 
 /**
  * Lock an "open" VFS file for writing and retrieve its underlying data buffer.
- * Only one writing lock can be acquired on a VFS handle at any given time.
- * To avoid deadlocks, only one lock should ever be acquired per thread
- * simultaneously.
+ * Only one writing lock can be acquired on a file at any given time.
+ * Locks on different files never block each other. To avoid deadlocks,
+ * only one lock should ever be acquired per thread simultaneously.
  *
  * @param vfs         VFS handle.
  * @param inode       file descriptor to the file to write.
@@ -1698,36 +1922,36 @@ int vfs_unlock_file_read(vfilesystem *vfs, uint32_t inode)
 int vfs_lock_file_write(vfilesystem *vfs, uint32_t inode,
  unsigned char ***data, size_t **data_length, size_t **data_alloc)
 {
-  struct vfs_inode *n;
-  if(inode < vfs->table_length)
-  {
-    if(!vfs_write_lock(vfs))
-      return -vfs_geterror(vfs);
+  struct vfs_inode *n = vfs_get_open_inode_ptr(vfs, inode);
+  if(!n)
+    return -EBADF;
 
-    n = vfs_get_inode_ptr(vfs, inode);
-    if(!n || !n->refcount)
-    {
-      vfs_write_unlock(vfs);
-      return -EBADF;
-    }
+  if(!vfs_file_write_lock(vfs, n))
+    return -vfs_geterror(vfs);
 
-    // Since the buffer may be reallocated, remove the old alloc size.
+  // Since the buffer may be reallocated, remove the old alloc size.
+  // This needs to exclude table writers, which also modify the total.
+  if(vfs_read_lock(vfs))
+  {
+    vfs_shared_update_begin(vfs);
     if(VFS_IS_CACHED(n))
     {
       assert(vfs->cache_total >= n->length_alloc);
       vfs->cache_total -= n->length_alloc;
     }
-
-    *data = &(n->contents.data);
-    *data_length = &(n->length);
-    *data_alloc = &(n->length_alloc);
-    return 0;
+    vfs_lru_touch(vfs, inode);
+    vfs_shared_update_end(vfs);
+    vfs_read_unlock(vfs);
   }
-  return -EBADF;
+
+  *data = &(n->contents.data);
+  *data_length = &(n->length);
+  *data_alloc = &(n->length_alloc);
+  return 0;
 }
 
 /**
- * Release a held writing lock on a VFS handle.
+ * Release a held writing lock on a VFS file.
  *
  * @param vfs   VFS handle.
  * @param inode file descriptor to the file to write.
@@ -1736,19 +1960,23 @@ int vfs_lock_file_write(vfilesystem *vfs, uint32_t inode,
  */
 int vfs_unlock_file_write(vfilesystem *vfs, uint32_t inode)
 {
-  if(inode < vfs->table_length)
-  {
-    struct vfs_inode *n = vfs_get_inode_ptr(vfs, inode);
-    if(!n || !n->refcount)
-      return -EBADF;
+  struct vfs_inode *n = vfs_get_open_inode_ptr(vfs, inode);
+  if(!n)
+    return -EBADF;
 
-    // The size of this file may have changed, add the new size back.
+  // The size of this file may have changed, add the new size back.
+  if(vfs_read_lock(vfs))
+  {
+    vfs_shared_update_begin(vfs);
     if(VFS_IS_CACHED(n))
       vfs->cache_total += n->length_alloc;
-
-    if(vfs_write_unlock(vfs))
-      return 0;
+    vfs_shared_update_end(vfs);
+    vfs_read_unlock(vfs);
   }
+
+  if(vfs_file_write_unlock(vfs, n))
+    return 0;
+
   return -EBADF;
 }
 
@@ -2578,35 +2806,11 @@ int vfs_invalidate_at_path(vfilesystem *vfs, const char *path)
   return -code;
 }
 
-struct sort_data
-{
-  struct vfs_inode *n;
-  uint32_t inode;
-};
-
-static int invalidate_sort_fn(const void *A, const void *B)
-{
-  const struct sort_data *a = (const struct sort_data *)A;
-  const struct sort_data *b = (const struct sort_data *)B;
-
-  // Sort by timestamp ascending (invalidate older files first).
-  // Intentionally underflow since these are 32-bit truncated timestamps.
-  if(a->n->timestamp != b->n->timestamp)
-    return (int32_t)b->n->timestamp - (int32_t)a->n->timestamp;
-
-  // Sort by size descending.
-  if(a->n->length_alloc != b->n->length_alloc)
-    return a->n->length_alloc > b->n->length_alloc ? -1 : 1;
-
-  // Stabilize using the unique inode number.
-  return a->inode < b->inode ? -1 : a->inode > b->inode ? 1 : 0;
-}
-
 /**
  * Free cached entries until the amount of memory pointed to by
- * `amount_to_free` has been invalidated. This function ignores cached
- * entries that have active references and directories. This may be an
- * expensive operation.
+ * `amount_to_free` has been invalidated. Entries are freed starting from the
+ * least recently used. This function ignores cached entries that have active
+ * references and directories.
  *
  * @param vfs       VFS handle
  * @param amount_to_free  a pointer to the amount of memory to be freed
@@ -2619,13 +2823,9 @@ static int invalidate_sort_fn(const void *A, const void *B)
  */
 int vfs_invalidate_at_least(vfilesystem *vfs, size_t *_amount_to_free)
 {
-  struct sort_data fallback[64];
-  struct sort_data *targets;
   size_t amount_to_free;
   size_t total_free;
-  size_t max_targets;
-  size_t num_targets;
-  size_t i;
+  uint32_t inode;
 
   if(!_amount_to_free)
     return -EINVAL;
@@ -2634,75 +2834,29 @@ int vfs_invalidate_at_least(vfilesystem *vfs, size_t *_amount_to_free)
 
   amount_to_free = *_amount_to_free;
 
-  if(!vfs_read_lock(vfs))
+  if(!vfs_write_lock(vfs))
     return -vfs_geterror(vfs);
 
-  // This is likely too large, but that's why there's a fallback table.
-  max_targets = vfs->table_length;
-  targets = (struct sort_data *)malloc(max_targets * sizeof(struct sort_data));
-  if(!targets)
-  {
-    targets = fallback;
-    max_targets = ARRAY_SIZE(fallback);
-  }
-
-  num_targets = 0;
-  for(i = 0; i < vfs->table_length; i++)
-  {
-    struct vfs_inode *n = vfs->table[i];
-
-    if(n && VFS_INODE_TYPE(n) == VFS_INODE_FILE && n->refcount == 0 &&
-     VFS_IS_CACHED(n) && !VFS_IS_INVALIDATED(n))
-    {
-      struct sort_data tmp = { n, i };
-      targets[num_targets++] = tmp;
-
-      if(num_targets >= max_targets)
-        break;
-    }
-  }
-
-  if(num_targets)
-    qsort(targets, num_targets, sizeof(struct sort_data), invalidate_sort_fn);
-
-  // Can't do anything, just exit.
-  if(!num_targets || !vfs_elevate_lock(vfs))
+  total_free = 0;
+  inode = vfs->lru_tail;
+  while(inode && total_free < amount_to_free)
   {
-    vfs_read_unlock(vfs);
-    if(targets != fallback)
-      free(targets);
-    return 0;
-  }
+    struct vfs_inode *n = vfs_get_inode_ptr(vfs, inode);
+    uint32_t prev = n->lru_prev;
 
-  // If there is an oldest accessed file of at least the requested size and no
-  // open references, deleting it should be good enough.
-  for(i = 0; i < num_targets; i++)
-  {
-    if(targets[i].n->length_alloc >= amount_to_free)
+    // Open files stay in the list and are skipped.
+    if(n->refcount == 0)
     {
-      vfs_delete_inode(vfs, targets[i].inode);
-      amount_to_free = 0;
-      goto success;
+      total_free += n->length_alloc;
+      vfs_delete_inode(vfs, inode);
+      vfs->cache_evictions++;
     }
+    inode = prev;
   }
 
-  // Delete entries from oldest to newest until the threshold is reached.
-  total_free = 0;
-  for(i = 0; i < num_targets && total_free < amount_to_free; i++)
-  {
-    total_free += targets[i].n->length_alloc;
-    vfs_delete_inode(vfs, targets[i].inode);
-    if(total_free >= amount_to_free)
-      break;
-  }
-  amount_to_free = amount_to_free > total_free ? amount_to_free - total_free : 0;
-
-success:
   vfs_write_unlock(vfs);
 
-  *_amount_to_free = amount_to_free;
-  if(targets != fallback)
-    free(targets);
+  *_amount_to_free = amount_to_free > total_free ? amount_to_free - total_free : 0;
   return 0;
 }
 
@@ -2930,12 +3084,42 @@ size_t vfs_get_cache_total_size(vfilesystem *vfs)
 
   if(vfs_read_lock(vfs))
   {
+    vfs_shared_update_begin(vfs);
     sz = vfs->cache_total;
+    vfs_shared_update_end(vfs);
     vfs_read_unlock(vfs);
   }
   return sz;
 }
 
+/**
+ * Get the cache statistics for the VFS. Any of the output pointers may be
+ * `NULL`.
+ *
+ * @param vfs         VFS handle.
+ * @param hits        pointer to store the number of opened cached files to.
+ * @param misses      pointer to store the number of opened files that were
+ *                    not in the VFS to.
+ * @param evictions   pointer to store the number of cached files freed by
+ *                    `vfs_invalidate_at_least` to.
+ */
+void vfs_get_cache_stats(vfilesystem *vfs, size_t *hits, size_t *misses,
+ size_t *evictions)
+{
+  if(vfs_read_lock(vfs))
+  {
+    vfs_shared_update_begin(vfs);
+    if(hits)
+      *hits = vfs->cache_hits;
+    if(misses)
+      *misses = vfs->cache_misses;
+    if(evictions)
+      *evictions = vfs->cache_evictions;
+    vfs_shared_update_end(vfs);
+    vfs_read_unlock(vfs);
+  }
+}
+
 /**
  * Get the total memory usage for the entire VFS.
  * This may be a slow operation.
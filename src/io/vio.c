@@ -45,11 +45,18 @@
 #define VFILE_LARGE_BUFFER_SIZE 32768
 #endif
 
+#ifndef VFILE_READ_BUFFER_SIZE
+#define VFILE_READ_BUFFER_SIZE 4096
+#endif
+
 // If 0 is provided as a cache maximum size, use this value instead.
 #define DEFAULT_MAX_SIZE (1<<22)
 
 struct vfile
 {
+  // Must be first (see vio.h).
+  struct vfile_read_buffer rb;
+
   FILE *fp;
 
   struct memfile mf;
@@ -65,6 +72,10 @@ struct vfile
   size_t position_writeback;
   uint32_t inode;
 
+  // Read-ahead buffer for read-only binary real files, allocated on demand.
+  unsigned char *read_buffer;
+  size_t read_buffer_size;
+
   // vungetc buffer for memory files.
   int tmp_chr;
   int flags;
@@ -87,6 +98,58 @@ static size_t vfs_max_size = 0;
 static size_t vfs_max_auto_cache_file_size = 0;
 static boolean vfs_enable_auto_cache = false;
 
+/**
+ * The generation counters are changed by other threads (e.g. the async world
+ * save), so they need atomic increments. Targets without lock-free atomics
+ * don't have threads that use vio.
+ */
+#if defined(__GCC_ATOMIC_INT_LOCK_FREE) && __GCC_ATOMIC_INT_LOCK_FREE == 2
+#define vio_generation_increment(var) __atomic_add_fetch(&(var), 1, __ATOMIC_RELAXED)
+#define vio_generation_load(var) __atomic_load_n(&(var), __ATOMIC_RELAXED)
+#elif defined(_MSC_VER)
+#define vio_generation_increment(var) InterlockedIncrement((volatile LONG *)&(var))
+#define vio_generation_load(var) ((unsigned int)(var))
+#else
+#define vio_generation_increment(var) ((var)++)
+#define vio_generation_load(var) ((unsigned int)(var))
+#endif
+
+/**
+ * Incremented whenever a directory listing (or the current working directory)
+ * may have changed through this interface. Caches of directory contents (see
+ * fsafeopen.c) compare against this to detect stale data.
+ */
+static volatile unsigned int vio_dir_generation = 0;
+
+/**
+ * Incremented whenever the contents of a file may have changed through this
+ * interface, and whenever the directory generation changes (which can change
+ * which file a path refers to). Caches of file contents compare against this.
+ */
+static volatile unsigned int vio_file_generation = 0;
+
+static inline void vio_file_changed(void)
+{
+  vio_generation_increment(vio_file_generation);
+}
+
+static inline void vio_directory_changed(void)
+{
+  vio_generation_increment(vio_dir_generation);
+  vio_file_changed();
+}
+
+/**
+ * Wrapper for the return value of filesystem operations: if the operation
+ * succeeded, notify directory caches.
+ */
+static inline int vio_directory_result(int ret)
+{
+  if(ret == 0)
+    vio_directory_changed();
+  return ret;
+}
+
 /**
  * Recursively cache the provided directory path if it doesn't exist in
  * the cache, including the root. This function will cache as much of `path`
@@ -341,6 +404,48 @@ size_t vio_filesystem_total_cached_usage(void)
   return 0;
 }
 
+/**
+ * Get the number of times a file was opened from the vio.c virtual filesystem
+ * cache.
+ *
+ * @return                    the number of cache hits.
+ */
+size_t vio_filesystem_cache_hits(void)
+{
+  size_t hits = 0;
+  if(vfs_base)
+    vfs_get_cache_stats(vfs_base, &hits, NULL, NULL);
+  return hits;
+}
+
+/**
+ * Get the number of times a file was opened that was not in the vio.c
+ * virtual filesystem.
+ *
+ * @return                    the number of cache misses.
+ */
+size_t vio_filesystem_cache_misses(void)
+{
+  size_t misses = 0;
+  if(vfs_base)
+    vfs_get_cache_stats(vfs_base, NULL, &misses, NULL);
+  return misses;
+}
+
+/**
+ * Get the number of cached files the vio.c virtual filesystem has freed to
+ * stay under its maximum cache size.
+ *
+ * @return                    the number of cache evictions.
+ */
+size_t vio_filesystem_cache_evictions(void)
+{
+  size_t evictions = 0;
+  if(vfs_base)
+    vfs_get_cache_stats(vfs_base, NULL, NULL, &evictions);
+  return evictions;
+}
+
 /**
  * Get the total memory usage of the vio.c virtual filesystem,
  * INCLUDING cached files.
@@ -449,6 +554,26 @@ boolean vio_invalidate_all(void)
   return true;
 }
 
+/**
+ * Get the current directory generation. This value changes every time a
+ * file or directory is created, renamed, or removed via vio, and every time
+ * the current working directory changes.
+ */
+unsigned int vio_get_directory_generation(void)
+{
+  return vio_generation_load(vio_dir_generation);
+}
+
+/**
+ * Get the current file generation. This value changes every time a file is
+ * opened for writing or closed after writing via vio, and every time the
+ * directory generation changes.
+ */
+unsigned int vio_get_file_generation(void)
+{
+  return vio_generation_load(vio_file_generation);
+}
+
 
 /************************************************************************
  * vfile functions and stdio/unistd wrappers.
@@ -540,6 +665,117 @@ static int vfopen_virtual(vfilesystem *vfs, vfile *vf, const char *filename,
   return ret;
 }
 
+/**
+ * Read-ahead buffering for real files opened read-only in binary mode. The
+ * window in vf->rb always ends at the FILE's position, so the logical file
+ * position is the FILE's position minus the number of bytes left in it.
+ */
+static inline boolean vfile_use_read_buffer(vfile *vf)
+{
+  return (vf->flags & (VF_FILE | VF_MEMORY | VF_WRITE | VF_BINARY)) ==
+   (VF_FILE | VF_BINARY);
+}
+
+static inline void vfile_read_buffer_reset(vfile *vf)
+{
+  unsigned char *start = vf->read_buffer ? vf->read_buffer :
+   (unsigned char *)vf->dummy;
+
+  vf->rb.pos = start;
+  vf->rb.end = start;
+}
+
+static inline size_t vfile_read_buffer_avail(vfile *vf)
+{
+  return vf->rb.end - vf->rb.pos;
+}
+
+/**
+ * Refill the read-ahead buffer. Returns false at the end of the file or if
+ * the buffer couldn't be allocated.
+ */
+static boolean vfile_read_buffer_fill(vfile *vf)
+{
+  size_t len;
+
+  if(!vf->read_buffer)
+  {
+    size_t size = VFILE_READ_BUFFER_SIZE;
+    if(vf->flags & V_LARGE_BUFFER)
+      size = VFILE_LARGE_BUFFER_SIZE;
+    else
+
+    if(vf->flags & V_SMALL_BUFFER)
+      size = VFILE_SMALL_BUFFER_SIZE;
+
+    vf->read_buffer = (unsigned char *)malloc(size);
+    if(!vf->read_buffer)
+      return false;
+
+    vf->read_buffer_size = size;
+  }
+
+  len = fread(vf->read_buffer, 1, vf->read_buffer_size, vf->fp);
+  vf->rb.pos = vf->read_buffer;
+  vf->rb.end = vf->read_buffer + len;
+  return len > 0;
+}
+
+/**
+ * Move the FILE back to the logical file position and empty the window, for
+ * operations that need to use the FILE directly.
+ */
+static void vfile_read_buffer_sync(vfile *vf)
+{
+  size_t avail = vfile_read_buffer_avail(vf);
+  if(avail)
+    platform_fseek(vf->fp, -(int64_t)avail, SEEK_CUR);
+
+  vfile_read_buffer_reset(vf);
+}
+
+static inline int vfile_file_getc(vfile *vf)
+{
+  if(!vfile_use_read_buffer(vf))
+    return platform_fgetc(vf->fp);
+
+  if(!vfile_read_buffer_avail(vf) && !vfile_read_buffer_fill(vf))
+    return vf->read_buffer ? EOF : platform_fgetc(vf->fp);
+
+  return *(vf->rb.pos++);
+}
+
+/**
+ * Map a real file opened in read-only mode into memory. On success, the vfile
+ * becomes a memory vfile and the FILE is closed, so reads no longer require
+ * any system calls. If the file is truncated while mapped, reading past the
+ * new end raises SIGBUS instead of failing, so this should only be used for
+ * files that are read and closed before control returns to game code.
+ */
+static boolean vfile_map(vfile *vf)
+{
+  int64_t len = platform_filelength(vf->fp);
+  void *ptr;
+
+  if(len <= 0 || (uint64_t)len >= SIZE_MAX)
+    return false;
+
+  ptr = platform_mmap(vf->fp, len);
+  if(!ptr)
+    return false;
+
+  mfopen(ptr, len, &(vf->mf));
+  vf->mf.seek_past_end = true;
+  vf->flags |= VF_MEMORY | VF_MEMORY_MAPPED;
+  vf->local_buffer = ptr;
+  vf->local_buffer_size = len;
+
+  fclose(vf->fp);
+  vf->flags &= ~VF_FILE;
+  vf->fp = NULL;
+  return true;
+}
+
 /**
  * Open a file for input or output with user-defined flags.
  */
@@ -556,6 +792,7 @@ vfile *vfopen_unsafe_ext(const char *filename, const char *mode,
   flags |= (user_flags & VF_PUBLIC_MASK);
 
   vf = (vfile *)calloc(1, sizeof(vfile));
+  vfile_read_buffer_reset(vf);
   vf->tmp_chr = EOF;
   vf->flags = flags;
 
@@ -565,7 +802,13 @@ vfile *vfopen_unsafe_ext(const char *filename, const char *mode,
     ret = vfopen_virtual(vfs_base, vf, filename, flags);
     // File is 100% virtual? Can exit now.
     if(ret == 0)
+    {
+      if(flags & (VF_TRUNCATE | VF_APPEND))
+        vio_directory_changed();
+      if(flags & VF_WRITE)
+        vio_file_changed();
       return vf;
+    }
     // Non-write and cached? Don't need a FILE handle for that either...
     if(ret == -VFS_ERR_IS_CACHED && (~flags & VF_WRITE))
       return vf;
@@ -604,6 +847,12 @@ vfile *vfopen_unsafe_ext(const char *filename, const char *mode,
   vf->fp = fp;
   vf->flags |= VF_FILE;
 
+  // The file may not have existed before this.
+  if(flags & (VF_TRUNCATE | VF_APPEND))
+    vio_directory_changed();
+  if(flags & VF_WRITE)
+    vio_file_changed();
+
   if(vfs_base && !vf->inode && (~flags & V_DONT_CACHE))
   {
     if(vfs_enable_auto_cache || (flags & V_FORCE_CACHE))
@@ -615,6 +864,11 @@ vfile *vfopen_unsafe_ext(const char *filename, const char *mode,
       }
     }
   }
+
+  // Cached files are already in memory; otherwise, try mapping the file.
+  if(!vf->inode && (flags & V_MAP_FILE) && (~flags & VF_WRITE))
+    vfile_map(vf);
+
   return vf;
 }
 
@@ -637,6 +891,7 @@ vfile *vfile_init_fp(FILE *fp, const char *mode)
   assert(fp && flags);
 
   vf = (vfile *)ccalloc(1, sizeof(vfile));
+  vfile_read_buffer_reset(vf);
   vf->fp = fp;
   vf->tmp_chr = EOF;
   vf->flags = flags | VF_FILE;
@@ -661,6 +916,7 @@ vfile *vfile_init_mem(void *buffer, size_t size, const char *mode)
     filesize = 0;
 
   vf = (vfile *)ccalloc(1, sizeof(vfile));
+  vfile_read_buffer_reset(vf);
   mfopen_wr(buffer ? buffer : vf->dummy, filesize, &(vf->mf));
   vf->mf.seek_past_end = true;
   vf->tmp_chr = EOF;
@@ -813,9 +1069,17 @@ int vfclose(vfile *vf)
     }
   }
 
+  if((vf->flags & VF_MEMORY) && (vf->flags & VF_MEMORY_MAPPED))
+    platform_munmap(vf->local_buffer, vf->local_buffer_size);
+
   if(vf->flags & VF_FILE)
     retval = fclose(vf->fp);
 
+  free(vf->read_buffer);
+
+  if((vf->flags & VF_WRITE) && ((vf->flags & VF_FILE) || vf->inode))
+    vio_file_changed();
+
   free(vf);
   return retval;
 }
@@ -839,7 +1103,7 @@ int vchdir(const char *path)
     // If this is also a virtual path, this will succeed. The vfs_access
     // call filters out cached directories, which vfs_chdir DOES work on.
     if(vfs_access(vfs_base, path, R_OK) == 0 && vfs_chdir(vfs_base, path) == 0)
-      return 0;
+      return vio_directory_result(0);
 
     // Special: the current directory must exist in the VFS.
     vio_cache_directory_recursively(vfs_base, path);
@@ -854,9 +1118,9 @@ int vchdir(const char *path)
       ret = 0;
     }
 
-    return ret;
+    return vio_directory_result(ret);
   }
-  return platform_chdir(path);
+  return vio_directory_result(platform_chdir(path));
 }
 
 /**
@@ -891,7 +1155,7 @@ int vmkdir(const char *path, int mode)
     // Use vio_virtual_directory to force creation of virtual directories.
     ret = platform_mkdir(path, mode);
     if(ret == 0 || errno != ENOENT)
-      return ret;
+      return vio_directory_result(ret);
 
     ret = vfs_mkdir(vfs_base, path, mode);
     if(ret < 0)
@@ -899,9 +1163,9 @@ int vmkdir(const char *path, int mode)
       errno = -ret;
       return -1;
     }
-    return 0;
+    return vio_directory_result(0);
   }
-  return platform_mkdir(path, mode);
+  return vio_directory_result(platform_mkdir(path, mode));
 }
 
 /**
@@ -926,7 +1190,7 @@ int vrename(const char *oldpath, const char *newpath)
     // No filesystem operation needs to be done in this case.
     ret = vfs_rename(vfs_base, oldpath, newpath);
     if(ret == 0)
-      return 0;
+      return vio_directory_result(0);
 
     if(ret == -EBUSY || ret == -ENOTDIR || ret == -EISDIR || ret == -EEXIST)
     {
@@ -942,9 +1206,9 @@ int vrename(const char *oldpath, const char *newpath)
       // This unfortunately won't bring back the old dir/file at newpath.
       vfs_rename(vfs_base, newpath, oldpath);
     }
-    return ret;
+    return vio_directory_result(ret);
   }
-  return platform_rename(oldpath, newpath);
+  return vio_directory_result(platform_rename(oldpath, newpath));
 }
 
 /**
@@ -961,7 +1225,7 @@ int vunlink(const char *path)
     path = vio_normalize_virtual_path(vfs_base, buffer, MAX_PATH, path);
     ret = vfs_unlink(vfs_base, path);
     if(ret == 0)
-      return 0;
+      return vio_directory_result(0);
 
     // VFS inode exists and isn't cached, but there was an error.
     if(ret == -EBUSY || ret == -EPERM)
@@ -973,9 +1237,9 @@ int vunlink(const char *path)
     ret = platform_unlink(path);
     if(ret == 0)
       vfs_invalidate_at_path(vfs_base, path);
-    return ret;
+    return vio_directory_result(ret);
   }
-  return platform_unlink(path);
+  return vio_directory_result(platform_unlink(path));
 }
 
 /**
@@ -991,7 +1255,7 @@ int vrmdir(const char *path)
     path = vio_normalize_virtual_path(vfs_base, buffer, MAX_PATH, path);
     ret = vfs_rmdir(vfs_base, path);
     if(ret == 0)
-      return 0;
+      return vio_directory_result(0);
 
     // VFS inode exists and isn't cached, but there was an error.
     if(ret == -EBUSY || ret == -ENOTDIR || ret == -ENOTEMPTY)
@@ -1003,9 +1267,9 @@ int vrmdir(const char *path)
     ret = platform_rmdir(path);
     if(ret == 0)
       vfs_invalidate_at_path(vfs_base, path);
-    return ret;
+    return vio_directory_result(ret);
   }
-  return platform_rmdir(path);
+  return vio_directory_result(platform_rmdir(path));
 }
 
 /**
@@ -1283,9 +1547,10 @@ boolean vfile_get_memfile_block(vfile *vf, size_t length, struct memfile *dest)
 }
 
 /**
- * Read a single byte from a file.
+ * Read a single byte from a file. Called by vfgetc when the read-ahead
+ * window is empty.
  */
-int vfgetc(vfile *vf)
+int vfgetc_slow(vfile *vf)
 {
   assert(vf);
   assert(vf->flags & VF_READ);
@@ -1308,15 +1573,16 @@ int vfgetc(vfile *vf)
   }
 
   if(vf->flags & VF_FILE)
-    return fgetc(vf->fp);
+    return vfile_file_getc(vf);
 
   return EOF;
 }
 
 /**
- * Read two bytes from a file as an unsigned integer (little endian).
+ * Read two bytes from a file as an unsigned integer (little endian). Called
+ * by vfgetw when the read-ahead window has fewer than two bytes.
  */
-int vfgetw(vfile *vf)
+int vfgetw_slow(vfile *vf)
 {
   assert(vf);
   assert(vf->flags & VF_READ);
@@ -1343,9 +1609,8 @@ int vfgetw(vfile *vf)
 
   if(vf->flags & VF_FILE)
   {
-    FILE *fp = vf->fp;
-    int a = fgetc(fp);
-    int b = fgetc(fp);
+    int a = vfile_file_getc(vf);
+    int b = vfile_file_getc(vf);
 
     return (a != EOF) && (b != EOF) ? ((b << 8) | a) : EOF;
   }
@@ -1354,9 +1619,10 @@ int vfgetw(vfile *vf)
 }
 
 /**
- * Read four bytes from a file as a signed integer (little endian).
+ * Read four bytes from a file as a signed integer (little endian). Called
+ * by vfgetd when the read-ahead window has fewer than four bytes.
  */
-int vfgetd(vfile *vf)
+int vfgetd_slow(vfile *vf)
 {
   assert(vf);
   assert(vf->flags & VF_READ);
@@ -1385,11 +1651,10 @@ int vfgetd(vfile *vf)
 
   if(vf->flags & VF_FILE)
   {
-    FILE *fp = vf->fp;
-    int a = fgetc(fp);
-    int b = fgetc(fp);
-    int c = fgetc(fp);
-    int d = fgetc(fp);
+    int a = vfile_file_getc(vf);
+    int b = vfile_file_getc(vf);
+    int c = vfile_file_getc(vf);
+    int d = vfile_file_getc(vf);
 
     if((a == EOF) || (b == EOF) || (c == EOF) || (d == EOF))
       return EOF;
@@ -1433,15 +1698,14 @@ int64_t vfgetq(vfile *vf)
 
   if(vf->flags & VF_FILE)
   {
-    FILE *fp = vf->fp;
-    int a = fgetc(fp);
-    int b = fgetc(fp);
-    int c = fgetc(fp);
-    int d = fgetc(fp);
-    int e = fgetc(fp);
-    int f = fgetc(fp);
-    int g = fgetc(fp);
-    int h = fgetc(fp);
+    int a = vfile_file_getc(vf);
+    int b = vfile_file_getc(vf);
+    int c = vfile_file_getc(vf);
+    int d = vfile_file_getc(vf);
+    int e = vfile_file_getc(vf);
+    int f = vfile_file_getc(vf);
+    int g = vfile_file_getc(vf);
+    int h = vfile_file_getc(vf);
 
     if((a == EOF) || (b == EOF) || (c == EOF) || (d == EOF) ||
      (e == EOF) || (f == EOF) || (g == EOF) || (h == EOF))
@@ -1623,7 +1887,27 @@ size_t vfread(void *dest, size_t size, size_t count, vfile *vf)
   }
 
   if(vf->flags & VF_FILE)
+  {
+    size_t avail = vfile_read_buffer_avail(vf);
+    if(avail && size && count)
+    {
+      size_t total = size * count;
+      size_t got;
+
+      if(avail >= total)
+      {
+        memcpy(dest, vf->rb.pos, total);
+        vf->rb.pos += total;
+        return count;
+      }
+
+      memcpy(dest, vf->rb.pos, avail);
+      vf->rb.pos += avail;
+      got = fread((char *)dest + avail, 1, total - avail, vf->fp);
+      return (avail + got) / size;
+    }
     return fread(dest, size, count, vf->fp);
+  }
 
   return 0;
 }
@@ -1694,6 +1978,7 @@ char *vfsafegets(char *dest, int size, vfile *vf)
 
   if(vf->flags & VF_FILE)
   {
+    vfile_read_buffer_sync(vf);
     if(fgets(dest, size, vf->fp))
     {
       size_t len = strlen(dest);
@@ -1843,7 +2128,16 @@ int vungetc(int chr, vfile *vf)
   }
 
   if(vf->flags & VF_FILE)
+  {
+    // Unreading the previous byte only needs to move the window back.
+    if(vf->read_buffer && vf->rb.pos > vf->read_buffer && vf->rb.pos[-1] == chr)
+    {
+      vf->rb.pos--;
+      return chr;
+    }
+    vfile_read_buffer_sync(vf);
     return ungetc(chr, vf->fp);
+  }
 
   return EOF;
 }
@@ -1864,7 +2158,17 @@ int vfseek(vfile *vf, int64_t offset, int whence)
   }
 
   if(vf->flags & VF_FILE)
-    return platform_fseek(vf->fp, offset, whence);
+  {
+    int ret;
+    if(whence == SEEK_CUR)
+      offset -= vfile_read_buffer_avail(vf);
+
+    // A failed seek leaves the FILE (and therefore the window) where it was.
+    ret = platform_fseek(vf->fp, offset, whence);
+    if(!ret)
+      vfile_read_buffer_reset(vf);
+    return ret;
+  }
 
   return -1;
 }
@@ -1892,7 +2196,13 @@ int64_t vftell(vfile *vf)
   }
 
   if(vf->flags & VF_FILE)
-    return platform_ftell(vf->fp);
+  {
+    int64_t pos = platform_ftell(vf->fp);
+    if(pos < 0)
+      return pos;
+
+    return pos - vfile_read_buffer_avail(vf);
+  }
 
   return -1;
 }
@@ -1914,6 +2224,7 @@ void vrewind(vfile *vf)
 
   if(vf->flags & VF_FILE)
   {
+    vfile_read_buffer_reset(vf);
     rewind(vf->fp);
     return;
   }
@@ -45,15 +45,17 @@ enum vfileflags
   VF_BINARY             = (1<<7),
   VF_TRUNCATE           = (1<<8),
   VF_VIRTUAL            = (1<<9), // Virtual or cached file.
+  VF_MEMORY_MAPPED      = (1<<10), // Unmap memory buffer on vfclose.
 
   /* Public flags. */
+  V_MAP_FILE     = (1<<26), // map read-only real files; short-lived reads only.
   V_DONT_CACHE   = (1<<27), // do not add this file to the cache.
   V_FORCE_CACHE  = (1<<28), // ignore the auto cache settings, always cache.
   V_SMALL_BUFFER = (1<<29), // setvbuf <= 256 for real files in binary mode.
   V_LARGE_BUFFER = (1<<30), // setvbuf >= 8192 for real files in binary mode.
 
   VF_STORAGE_MASK       = (VF_FILE | VF_MEMORY),
-  VF_PUBLIC_MASK        = (V_DONT_CACHE | V_FORCE_CACHE |
+  VF_PUBLIC_MASK        = (V_MAP_FILE | V_DONT_CACHE | V_FORCE_CACHE |
                            V_SMALL_BUFFER | V_LARGE_BUFFER)
 };
 
@@ -77,11 +79,16 @@ UTILS_LIBSPEC boolean vio_filesystem_init(size_t max_size, size_t max_file_size,
  boolean enable_auto_cache);
 UTILS_LIBSPEC boolean vio_filesystem_exit(void);
 UTILS_LIBSPEC size_t vio_filesystem_total_cached_usage(void);
+UTILS_LIBSPEC size_t vio_filesystem_cache_hits(void);
+UTILS_LIBSPEC size_t vio_filesystem_cache_misses(void);
+UTILS_LIBSPEC size_t vio_filesystem_cache_evictions(void);
 UTILS_LIBSPEC size_t vio_filesystem_total_memory_usage(void);
 UTILS_LIBSPEC boolean vio_virtual_file(const char *path);
 UTILS_LIBSPEC boolean vio_virtual_directory(const char *path);
 UTILS_LIBSPEC boolean vio_invalidate_at_least(size_t *amount_to_free);
 UTILS_LIBSPEC boolean vio_invalidate_all(void);
+UTILS_LIBSPEC unsigned int vio_get_directory_generation(void);
+UTILS_LIBSPEC unsigned int vio_get_file_generation(void);
 
 UTILS_LIBSPEC vfile *vfopen_unsafe_ext(const char *filename, const char *mode,
  int user_flags);
@@ -107,9 +114,9 @@ UTILS_LIBSPEC int vrmdir(const char *path);
 UTILS_LIBSPEC int vaccess(const char *path, int mode);
 UTILS_LIBSPEC int vstat(const char *path, struct stat *buf);
 
-UTILS_LIBSPEC int vfgetc(vfile *vf);
-UTILS_LIBSPEC int vfgetw(vfile *vf);
-UTILS_LIBSPEC int vfgetd(vfile *vf);
+UTILS_LIBSPEC int vfgetc_slow(vfile *vf);
+UTILS_LIBSPEC int vfgetw_slow(vfile *vf);
+UTILS_LIBSPEC int vfgetd_slow(vfile *vf);
 UTILS_LIBSPEC int64_t vfgetq(vfile *vf);
 UTILS_LIBSPEC int vfputc(int character, vfile *vf);
 UTILS_LIBSPEC int vfputw(int character, vfile *vf);
@@ -129,6 +136,61 @@ UTILS_LIBSPEC int64_t vftell(vfile *vf);
 UTILS_LIBSPEC void vrewind(vfile *vf);
 UTILS_LIBSPEC int64_t vfilelength(vfile *vf, boolean rewind);
 
+/**
+ * Read-ahead window of a vfile. This is the first member of every vfile so
+ * the byte, word, and dword reads below can be inlined. It is only ever
+ * non-empty for real files opened read-only in binary mode; everything else
+ * (and refilling the window) goes through the out-of-line functions.
+ */
+struct vfile_read_buffer
+{
+  const unsigned char *pos;
+  const unsigned char *end;
+};
+
+/**
+ * Read a single byte from a file.
+ */
+static inline int vfgetc(vfile *vf)
+{
+  struct vfile_read_buffer *rb = (struct vfile_read_buffer *)vf;
+  if(rb->pos < rb->end)
+    return *(rb->pos++);
+
+  return vfgetc_slow(vf);
+}
+
+/**
+ * Read two bytes from a file as an unsigned integer (little endian).
+ */
+static inline int vfgetw(vfile *vf)
+{
+  struct vfile_read_buffer *rb = (struct vfile_read_buffer *)vf;
+  if(rb->end - rb->pos >= 2)
+  {
+    int value = rb->pos[0] | (rb->pos[1] << 8);
+    rb->pos += 2;
+    return value;
+  }
+  return vfgetw_slow(vf);
+}
+
+/**
+ * Read four bytes from a file as a signed integer (little endian).
+ */
+static inline int vfgetd(vfile *vf)
+{
+  struct vfile_read_buffer *rb = (struct vfile_read_buffer *)vf;
+  if(rb->end - rb->pos >= 4)
+  {
+    int value = (int)(((uint32_t)rb->pos[3] << 24) | (rb->pos[2] << 16) |
+     (rb->pos[1] << 8) | rb->pos[0]);
+    rb->pos += 4;
+    return value;
+  }
+  return vfgetd_slow(vf);
+}
+
 UTILS_LIBSPEC vdir *vdir_open(const char *path);
 UTILS_LIBSPEC vdir *vdir_open_ext(const char *path, int flags);
 UTILS_LIBSPEC int vdir_close(vdir *dir);
@@ -42,6 +42,15 @@ __M_BEGIN_DECLS
 #define PLATFORM_NO_REWINDDIR
 #endif
 
+// Console SDKs generally don't provide mmap even when they claim POSIX.
+#if defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES > 0 && \
+ !defined(CONFIG_3DS) && !defined(CONFIG_NDS) && !defined(CONFIG_PSP) && \
+ !defined(CONFIG_PSVITA) && !defined(CONFIG_SWITCH) && !defined(CONFIG_WII) && \
+ !defined(CONFIG_DREAMCAST)
+#define PLATFORM_HAS_MMAP
+#include <sys/mman.h>
+#endif
+
 /* clang has broken MemorySanitizer instrumentation for *stat, leading to false
  * positives. Use this define to enable memset() in the functions that use them.
  */
@@ -169,6 +178,19 @@ static inline boolean platform_rewinddir(struct dir_handle dh)
   return false;
 }
 
+/**
+ * Read a byte from a file without locking it. A vfile is only used by one
+ * thread at a time, so the lock only adds overhead to every byte read.
+ */
+static inline int platform_fgetc(FILE *fp)
+{
+#if defined(_POSIX_THREAD_SAFE_FUNCTIONS) && _POSIX_THREAD_SAFE_FUNCTIONS > 0
+  return getc_unlocked(fp);
+#else
+  return fgetc(fp);
+#endif
+}
+
 static inline int platform_fseek(FILE *fp, int64_t offset, int whence)
 {
 #if defined(_FILE_OFFSET_BITS) && _FILE_OFFSET_BITS == 64
@@ -207,6 +229,33 @@ static inline int64_t platform_filelength(FILE *fp)
   return st.st_size;
 }
 
+/**
+ * Map `len` bytes of a file opened for reading into memory, read-only.
+ * Returns NULL if the file can't be mapped.
+ */
+static inline void *platform_mmap(FILE *fp, size_t len)
+{
+#ifdef PLATFORM_HAS_MMAP
+  int fd = fileno(fp);
+  void *ptr;
+
+  if(fd < 0)
+    return NULL;
+
+  ptr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  return ptr != MAP_FAILED ? ptr : NULL;
+#else
+  return NULL;
+#endif
+}
+
+static inline void platform_munmap(void *ptr, size_t len)
+{
+#ifdef PLATFORM_HAS_MMAP
+  munmap(ptr, len);
+#endif
+}
+
 __M_END_DECLS
 
 #endif /* __IO_VIO_POSIX_H */
@@ -338,6 +338,19 @@ static inline boolean platform_rewinddir(struct dir_handle dh)
   return true;
 }
 
+/**
+ * Read a byte from a file without locking it. A vfile is only used by one
+ * thread at a time, so the lock only adds overhead to every byte read.
+ */
+static inline int platform_fgetc(FILE *fp)
+{
+#if defined(_MSC_VER) || defined(__MINGW64_VERSION_MAJOR)
+  return _fgetc_nolock(fp);
+#else
+  return fgetc(fp);
+#endif
+}
+
 static inline int platform_fseek(FILE *fp, int64_t offset, int whence)
 {
 #if WINVER >= _WIN32_WINNT_WINXP
@@ -382,6 +395,14 @@ static inline int64_t platform_filelength(FILE *fp)
   return fd >= 0 ? _filelengthi64(fd) : -1;
 }
 
+// Memory mapping is currently only implemented for POSIX platforms.
+static inline void *platform_mmap(FILE *fp, size_t len)
+{
+  return NULL;
+}
+
+static inline void platform_munmap(void *ptr, size_t len) {}
+
 __M_END_DECLS
 
 #endif /* __IO_VIO_WIN32_H */
@@ -32,6 +32,7 @@
 // This needs to stay self-sufficient - don't use core functions.
 // Including util.h for the macros only...
 
+#include "../memcasecmp.h"
 #include "../util.h"
 
 #include "memfile.h"
@@ -75,6 +76,10 @@
 #define ZIP_STREAM_BUFFER_U_SIZE (ZIP_STREAM_BUFFER_SIZE * 3 / 4)
 #define ZIP_STREAM_BUFFER_C_SIZE (ZIP_STREAM_BUFFER_SIZE / 4)
 
+// Limit for compressed input provided directly from a memory archive at once.
+// zlib can't accept more than 4GiB of input per call.
+#define ZIP_MAX_DIRECT_INPUT ((uint64_t)1 << 30)
+
 #define LOCAL_FILE_HEADER_LEN 30
 #define CENTRAL_FILE_HEADER_LEN 46
 #define EOCD_RECORD_LEN 22
@@ -205,6 +210,8 @@ static const char *zip_error_string(enum zip_error code)
       return "decompression failed";
     case ZIP_COMPRESS_FAILED:
       return "compression failed";
+    case ZIP_FILE_NOT_FOUND:
+      return "file not found in archive";
     case ZIP_INPUT_EMPTY:
       return "stream input buffer exhausted";
     case ZIP_OUTPUT_FULL:
@@ -1129,17 +1136,24 @@ static enum zip_error zread_stream(uint8_t *destBuf, size_t readLen,
       out_size = zp->streaming_file->uncompressed_size;
       in_size = size;
 
+      // Memory archives are decompressed directly from the archive buffer.
+      if(zp->is_memory)
+        size = 0;
+
       if(!direct_write)
         size += out_size;
 
-      result = zip_set_stream_buffer_size(zp, size);
-      if(result != ZIP_SUCCESS)
-        return result;
+      if(size)
+      {
+        result = zip_set_stream_buffer_size(zp, size);
+        if(result != ZIP_SUCCESS)
+          return result;
+      }
 
       decompress_fn = zp->stream->decompress_file;
 
       in = zp->stream_buffer;
-      if(!direct_write)
+      if(!direct_write && !zp->is_memory)
         in += out_size;
     }
     // If block decompression isn't available, the entire file should have
@@ -1161,14 +1175,31 @@ static enum zip_error zread_stream(uint8_t *destBuf, size_t readLen,
 
     while((result = decompress_fn(stream_data)) == ZIP_INPUT_EMPTY)
     {
-      in_size = MIN(in_size, zp->stream_left - *consumed);
-      if(!in_size)
-        return ZIP_EOF;
+      if(zp->is_memory)
+      {
+        struct memfile mf;
+
+        // Provide as much of the compressed data as possible at once.
+        in_size = MIN(zp->stream_left - *consumed, ZIP_MAX_DIRECT_INPUT);
+        if(!in_size)
+          return ZIP_EOF;
 
-      zp->stream->input(stream_data, in, in_size);
-      if(!vfread(in, in_size, 1, zp->vf))
-        return ZIP_READ_ERROR;
+        if(!vfile_get_memfile_block(zp->vf, in_size, &mf) ||
+         vfseek(zp->vf, in_size, SEEK_CUR))
+          return ZIP_READ_ERROR;
+
+        zp->stream->input(stream_data, mf.start, in_size);
+      }
+      else
+      {
+        in_size = MIN(in_size, zp->stream_left - *consumed);
+        if(!in_size)
+          return ZIP_EOF;
 
+        zp->stream->input(stream_data, in, in_size);
+        if(!vfread(in, in_size, 1, zp->vf))
+          return ZIP_READ_ERROR;
+      }
       *consumed += in_size;
     }
     if(result != ZIP_OUTPUT_FULL && result != ZIP_STREAM_FINISHED)
@@ -1330,6 +1361,226 @@ err_out:
   return result;
 }
 
+/**
+ * Lookup index for random access. Files can be found by name (ignoring case)
+ * or by their MZX file, board, and robot IDs in constant time. Both tables
+ * use open addressing with linear probing and store the position of each file
+ * plus one, so zero marks an empty slot. When multiple files share a key, the
+ * first one in the archive is found.
+ */
+static uint32_t zip_index_hash_name(const char *name, size_t len)
+{
+  // FNV-1a on the lowercase name.
+  uint32_t hash = 2166136261u;
+  size_t i;
+
+  for(i = 0; i < len; i++)
+  {
+    uint8_t c = name[i];
+    if(c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+
+    hash = (hash ^ c) * 16777619u;
+  }
+  return hash;
+}
+
+static uint32_t zip_index_hash_id(unsigned int file_id, unsigned int board_id,
+ unsigned int robot_id)
+{
+  uint32_t hash = (file_id << 16) ^ (board_id << 8) ^ robot_id;
+  return hash * 2654435761u;
+}
+
+static inline boolean zip_index_id_equal(struct zip_file_header *fh,
+ unsigned int file_id, unsigned int board_id, unsigned int robot_id)
+{
+  return fh->mzx_file_id == file_id && fh->mzx_board_id == board_id &&
+   fh->mzx_robot_id == robot_id;
+}
+
+static void zip_free_index(struct zip_archive *zp)
+{
+  free(zp->name_index);
+  free(zp->id_index);
+  zp->name_index = NULL;
+  zp->id_index = NULL;
+  zp->index_size = 0;
+}
+
+/**
+ * (Re)build the lookup index of a read archive. This is done automatically
+ * when the central directory is read, but must be repeated if the MZX IDs of
+ * the files are assigned or the files are reordered (see world_format.h).
+ * If the index can't be allocated, lookups fall back to a linear search.
+ */
+void zip_update_index(struct zip_archive *zp)
+{
+  size_t mask;
+  size_t size;
+  size_t i;
+
+  zip_free_index(zp);
+  if(!zp->num_files || zp->num_files > UINT32_MAX / 2)
+    return;
+
+  for(size = 16; size < zp->num_files * 2; size <<= 1);
+
+  zp->name_index = (uint32_t *)calloc(size, sizeof(uint32_t));
+  zp->id_index = (uint32_t *)calloc(size, sizeof(uint32_t));
+  if(!zp->name_index || !zp->id_index)
+  {
+    zip_free_index(zp);
+    return;
+  }
+  zp->index_size = size;
+  mask = size - 1;
+
+  for(i = 0; i < zp->num_files; i++)
+  {
+    struct zip_file_header *fh = zp->files[i];
+    struct zip_file_header *other;
+    size_t j;
+
+    j = zip_index_hash_name(fh->file_name, fh->file_name_length) & mask;
+    while(zp->name_index[j])
+    {
+      other = zp->files[zp->name_index[j] - 1];
+      if(other->file_name_length == fh->file_name_length &&
+       !memcasecmp(other->file_name, fh->file_name, fh->file_name_length))
+        break;
+
+      j = (j + 1) & mask;
+    }
+    if(!zp->name_index[j])
+      zp->name_index[j] = i + 1;
+
+    j = zip_index_hash_id(fh->mzx_file_id, fh->mzx_board_id,
+     fh->mzx_robot_id) & mask;
+    while(zp->id_index[j])
+    {
+      other = zp->files[zp->id_index[j] - 1];
+      if(zip_index_id_equal(other, fh->mzx_file_id, fh->mzx_board_id,
+       fh->mzx_robot_id))
+        break;
+
+      j = (j + 1) & mask;
+    }
+    if(!zp->id_index[j])
+      zp->id_index[j] = i + 1;
+  }
+}
+
+static enum zip_error zip_seek_check(struct zip_archive *zp)
+{
+  if(!zp)
+    return ZIP_NULL;
+
+  if(zp->read_file_error)
+    return zp->read_file_error;
+
+  return ZIP_SUCCESS;
+}
+
+/**
+ * Set the current file of the archive to the first file with a given name,
+ * ignoring case. Returns ZIP_FILE_NOT_FOUND if there is no such file, in
+ * which case the current position is not changed.
+ */
+enum zip_error zip_seek_to_file(struct zip_archive *zp, const char *name)
+{
+  size_t len = strlen(name);
+  enum zip_error result;
+  size_t i;
+
+  result = zip_seek_check(zp);
+  if(result)
+    goto err_out;
+
+  if(zp->name_index)
+  {
+    size_t mask = zp->index_size - 1;
+    size_t j = zip_index_hash_name(name, len) & mask;
+
+    while(zp->name_index[j])
+    {
+      i = zp->name_index[j] - 1;
+      if(zp->files[i]->file_name_length == len &&
+       !memcasecmp(zp->files[i]->file_name, name, len))
+      {
+        zp->pos = i;
+        return ZIP_SUCCESS;
+      }
+      j = (j + 1) & mask;
+    }
+    return ZIP_FILE_NOT_FOUND;
+  }
+
+  for(i = 0; i < zp->num_files; i++)
+  {
+    if(zp->files[i]->file_name_length == len &&
+     !memcasecmp(zp->files[i]->file_name, name, len))
+    {
+      zp->pos = i;
+      return ZIP_SUCCESS;
+    }
+  }
+  return ZIP_FILE_NOT_FOUND;
+
+err_out:
+  zip_error("zip_seek_to_file", result);
+  return result;
+}
+
+/**
+ * Set the current file of the archive to the first file with the given MZX
+ * IDs. These need to be assigned first (see world_format.h). Returns
+ * ZIP_FILE_NOT_FOUND if there is no such file, in which case the current
+ * position is not changed.
+ */
+enum zip_error zip_seek_to_mzx_file(struct zip_archive *zp,
+ unsigned int file_id, unsigned int board_id, unsigned int robot_id)
+{
+  enum zip_error result;
+  size_t i;
+
+  result = zip_seek_check(zp);
+  if(result)
+    goto err_out;
+
+  if(zp->id_index)
+  {
+    size_t mask = zp->index_size - 1;
+    size_t j = zip_index_hash_id(file_id, board_id, robot_id) & mask;
+
+    while(zp->id_index[j])
+    {
+      i = zp->id_index[j] - 1;
+      if(zip_index_id_equal(zp->files[i], file_id, board_id, robot_id))
+      {
+        zp->pos = i;
+        return ZIP_SUCCESS;
+      }
+      j = (j + 1) & mask;
+    }
+    return ZIP_FILE_NOT_FOUND;
+  }
+
+  for(i = 0; i < zp->num_files; i++)
+  {
+    if(zip_index_id_equal(zp->files[i], file_id, board_id, robot_id))
+    {
+      zp->pos = i;
+      return ZIP_SUCCESS;
+    }
+  }
+  return ZIP_FILE_NOT_FOUND;
+
+err_out:
+  zip_error("zip_seek_to_mzx_file", result);
+  return result;
+}
+
 /**
  * Get the uncompressed length of the next file in the archive within the
  * range of `size_t`. This should be used when reading whole files to memory.
@@ -2395,6 +2646,142 @@ err_out:
   return result;
 }
 
+/**
+ * Copy the next file of a memory archive in file read mode to a zip archive.
+ * The file's data is copied as-is without being recompressed, so files can be
+ * compressed into separate memory archives (e.g. by other threads) and then
+ * combined into a single archive.
+ */
+enum zip_error zip_write_copy_file(struct zip_archive *zp,
+ struct zip_archive *src)
+{
+  struct zip_file_header *src_fh;
+  struct zip_file_header *fh;
+  struct memfile mf;
+  enum zip_error result;
+
+  result = (zp && src ? zp->write_file_error : ZIP_NULL);
+  if(result)
+    goto err_out;
+
+  result = src->read_file_error;
+  if(result)
+    goto err_out;
+
+  if(!src->is_memory)
+  {
+    result = ZIP_NOT_MEMORY_ARCHIVE;
+    goto err_out;
+  }
+
+  if(src->pos >= src->num_files)
+  {
+    result = ZIP_EOF;
+    goto err_out;
+  }
+
+  src_fh = src->files[src->pos];
+  if(vfseek(src->vf, src_fh->offset, SEEK_SET))
+  {
+    result = ZIP_SEEK_ERROR;
+    goto err_out;
+  }
+
+  result = zip_verify_local_file_header(src, src_fh);
+  if(result)
+    goto err_out;
+
+  if(src_fh->compressed_size > SIZE_MAX ||
+   !vfile_get_memfile_block(src->vf, src_fh->compressed_size, &mf))
+  {
+    result = ZIP_EOF;
+    goto err_out;
+  }
+
+  // If needed, expand the files list so the file can be added to it.
+  if(zp->pos == zp->files_alloc)
+  {
+    size_t count = zp->files_alloc * 2;
+    struct zip_file_header **tmp = (struct zip_file_header **)realloc(zp->files,
+     count * sizeof(struct zip_file_header *));
+    if(!tmp)
+    {
+      result = ZIP_ALLOC_ERROR;
+      goto err_out;
+    }
+
+    zp->files = tmp;
+    zp->files_alloc = count;
+  }
+
+  fh = zip_allocate_file_header(src_fh->file_name_length);
+  if(!fh)
+  {
+    result = ZIP_ALLOC_ERROR;
+    goto err_out;
+  }
+
+  // Like a regular stream, the CRC and sizes are filled in after the data.
+  fh->flags = src_fh->flags & ~ZIP_F_DATA_DESCRIPTOR;
+#ifdef ZIP_WRITE_DATA_DESCRIPTOR
+  fh->flags |= ZIP_F_DATA_DESCRIPTOR;
+#endif
+  fh->method = src_fh->method;
+  fh->crc32 = 0;
+  fh->compressed_size = 0;
+  fh->uncompressed_size = 0;
+  fh->offset = vftell(zp->vf);
+  fh->file_name_length = src_fh->file_name_length;
+  memcpy(fh->file_name, src_fh->file_name, fh->file_name_length + 1);
+
+  zp->zip64_current = zp->zip64_enabled &&
+   (src_fh->compressed_size >= 0xfffffffful ||
+    src_fh->uncompressed_size >= 0xfffffffful);
+
+  if(zp->is_memory && zip_ensure_capacity(fh->file_name_length + 30, zp))
+  {
+    result = ZIP_EOF;
+    goto err_free;
+  }
+
+  result = zip_write_file_header(zp, fh, 0);
+  if(result)
+    goto err_free;
+
+  if(src_fh->compressed_size)
+  {
+    result = zwrite_out(mf.start, src_fh->compressed_size, zp);
+    if(result)
+      goto err_free;
+  }
+
+  fh->crc32 = src_fh->crc32;
+  fh->compressed_size = src_fh->compressed_size;
+  fh->uncompressed_size = src_fh->uncompressed_size;
+
+  result = zip_write_data_descriptor(zp, fh);
+  if(result)
+    goto err_free;
+
+  zp->running_file_name_length += fh->file_name_length;
+  zp->files[zp->pos] = fh;
+  zp->num_files++;
+  zp->pos++;
+  zp->mode = ZIP_S_WRITE_FILES;
+  precalculate_write_errors(zp);
+
+  src->pos++;
+  return ZIP_SUCCESS;
+
+err_free:
+  zip_free_file_header(fh);
+
+err_out:
+  if(result != ZIP_EOF)
+    zip_error("zip_write_copy_file", result);
+  return result;
+}
+
 /**
  * Reads the central directory of a zip archive. This places the archive into
  * file read mode; read files using zip_read_file(). If this fails, the input
@@ -2763,6 +3150,8 @@ static enum zip_error zip_read_directory(struct zip_archive *zp)
     }
   }
 
+  zip_update_index(zp);
+
   // We're in file read mode now.
   zp->mode = ZIP_S_READ_FILES;
   precalculate_read_errors(zp);
@@ -3081,7 +3470,9 @@ enum zip_error zip_close(struct zip_archive *zp, uint64_t *final_length)
 
   free(zp->header_buffer);
   free(zp->stream_buffer);
+  free(zp->local_buffer);
   free(zp->files);
+  zip_free_index(zp);
   free(zp);
 
   if(result != ZIP_SUCCESS)
@@ -3148,6 +3539,11 @@ struct zip_archive *zip_open_vf_read(vfile *vf)
     zp->vf = vf;
     file_len = vfilelength(zp->vf, false);
 
+    // Files mapped into memory can be read directly, like memory archives.
+    // Virtual files can't, since their buffers may move between reads.
+    if((vfile_get_flags(vf) & (VF_MEMORY | VF_VIRTUAL)) == VF_MEMORY)
+      zp->is_memory = true;
+
     if(file_len < 0)
     {
       zip_error("zip_open_vf_read", ZIP_STAT_ERROR);
@@ -3243,6 +3639,109 @@ struct zip_archive *zip_open_mem_read(const void *src, size_t len)
   return NULL;
 }
 
+/**
+ * Copy the raw data of the next `count` files in a zip archive to memory and
+ * open it as a new, independent read archive containing only those files.
+ * The files are not decompressed, so this is fairly cheap, and the new archive
+ * can be read on a different thread than the original archive. On success,
+ * the original archive is advanced past these files.
+ *
+ * This requires the files to be stored close together in the archive, which
+ * is always the case for a board and its contents in MZX worlds. If the data
+ * between the first and last file is much larger than the files themselves,
+ * this will fail and the caller should read the files normally instead.
+ */
+struct zip_archive *zip_open_subset_read(struct zip_archive *zp, size_t count)
+{
+  struct zip_archive *dest;
+  struct zip_file_header **files;
+  uint64_t start = UINT64_MAX;
+  uint64_t last = 0;
+  uint64_t end;
+  uint64_t expected = 0;
+  size_t len;
+  size_t i;
+
+  if(!zp || zp->read_file_error || !count || count > zp->num_files - zp->pos)
+    return NULL;
+
+  files = zp->files + zp->pos;
+  for(i = 0; i < count; i++)
+  {
+    start = MIN(start, files[i]->offset);
+    last = MAX(last, files[i]->offset);
+    expected += files[i]->compressed_size + LOCAL_FILE_HEADER_LEN +
+     files[i]->file_name_length + ZIP64_LOCAL_EXTRA_LEN +
+     ZIP64_DATA_DESCRIPTOR_LEN + 4;
+  }
+
+  // The subset ends where the next file (or the central directory) starts.
+  end = zp->offset_central_directory;
+  for(i = 0; i < zp->num_files; i++)
+    if(zp->files[i]->offset > last && zp->files[i]->offset < end)
+      end = zp->files[i]->offset;
+
+  if(end <= last || end > zp->end_in_file ||
+   end - start > expected * 2 + 4096 || end - start >= SIZE_MAX - 32)
+    return NULL;
+
+  // Data descriptors are read with a fixed size that may overlap the next
+  // record, so include a few bytes past the end if they exist.
+  end = MIN(end + ZIP64_DATA_DESCRIPTOR_LEN + 4, zp->end_in_file);
+  len = end - start;
+
+  dest = zip_new_archive();
+  if(!dest)
+    return NULL;
+
+  dest->local_buffer = malloc(len);
+  dest->files = (struct zip_file_header **)calloc(count,
+   sizeof(struct zip_file_header *));
+  if(!dest->local_buffer || !dest->files)
+    goto err_free;
+
+  if(vfseek(zp->vf, start, SEEK_SET) ||
+   !vfread(dest->local_buffer, len, 1, zp->vf))
+    goto err_free;
+
+  for(i = 0; i < count; i++)
+  {
+    size_t size = MAX(sizeof(struct zip_file_header),
+     offsetof(struct zip_file_header, file_name) +
+     files[i]->file_name_length + 1);
+
+    dest->files[i] = zip_allocate_file_header(files[i]->file_name_length);
+    if(!dest->files[i])
+      goto err_free;
+
+    memcpy(dest->files[i], files[i], size);
+    dest->files[i]->offset -= start;
+    dest->files_alloc++;
+  }
+
+  dest->vf = vfile_init_mem(dest->local_buffer, len, "rb");
+  dest->is_memory = true;
+  dest->num_files = count;
+  dest->end_in_file = len;
+  dest->mode = ZIP_S_READ_FILES;
+  zip_update_index(dest);
+
+  precalculate_read_errors(dest);
+  precalculate_write_errors(dest);
+
+  zp->pos += count;
+  return dest;
+
+err_free:
+  for(i = 0; i < dest->files_alloc; i++)
+    zip_free_file_header(dest->files[i]);
+
+  free(dest->files);
+  free(dest->local_buffer);
+  free(dest);
+  return NULL;
+}
+
 /**
  * Open a zip archive for writing to a block of memory. Returns a zip_archive
  * upon success; otherwise, returns NULL. An optional offset can be specified
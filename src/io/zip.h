@@ -148,6 +148,7 @@ enum zip_error
   ZIP_CRC32_MISMATCH,
   ZIP_DECOMPRESS_FAILED,
   ZIP_COMPRESS_FAILED,
+  ZIP_FILE_NOT_FOUND,
   ZIP_INPUT_EMPTY,
   ZIP_OUTPUT_FULL,
   ZIP_STREAM_FINISHED,
@@ -219,6 +220,9 @@ struct zip_archive
 
   struct zip_file_header **files;
   struct zip_file_header *streaming_file;
+  uint32_t *name_index; // Hash table of file positions + 1 by name.
+  uint32_t *id_index; // Hash table of file positions + 1 by MZX IDs.
+  size_t index_size;
   uint8_t *stream_buffer;
   uint32_t stream_buffer_pos;
   uint32_t stream_buffer_end;
@@ -244,6 +248,7 @@ struct zip_archive
   boolean zip64_current; // Zip64 is active for current file.
   void **external_buffer;
   size_t *external_buffer_size;
+  void *local_buffer; // Archive data owned by this archive (subsets).
 
   struct zip_method_handler *stream;
   struct zip_stream_data *stream_data;
@@ -262,6 +267,12 @@ UTILS_LIBSPEC enum zip_error zip_get_next_name(struct zip_archive *zp,
 UTILS_LIBSPEC enum zip_error zip_get_next_mzx_file_id(struct zip_archive *zp,
  unsigned int *prop_id, unsigned int *board_id, unsigned int *robot_id);
 
+UTILS_LIBSPEC void zip_update_index(struct zip_archive *zp);
+UTILS_LIBSPEC enum zip_error zip_seek_to_file(struct zip_archive *zp,
+ const char *name);
+UTILS_LIBSPEC enum zip_error zip_seek_to_mzx_file(struct zip_archive *zp,
+ unsigned int file_id, unsigned int board_id, unsigned int robot_id);
+
 UTILS_LIBSPEC enum zip_error zip_get_next_method(struct zip_archive *zp,
  unsigned int *method);
 
@@ -305,6 +316,9 @@ UTILS_LIBSPEC enum zip_error zip_write_close_mem_stream(struct zip_archive *zp,
 UTILS_LIBSPEC enum zip_error zip_write_file(struct zip_archive *zp,
  const char *name, const void *src, size_t srcLen, int method);
 
+UTILS_LIBSPEC enum zip_error zip_write_copy_file(struct zip_archive *zp,
+ struct zip_archive *src);
+
 UTILS_LIBSPEC enum zip_error zip_close(struct zip_archive *zp,
  uint64_t *final_length);
 
@@ -313,6 +327,8 @@ UTILS_LIBSPEC struct zip_archive *zip_open_vf_write(vfile *vf);
 UTILS_LIBSPEC struct zip_archive *zip_open_file_read(const char *file_name);
 UTILS_LIBSPEC struct zip_archive *zip_open_file_write(const char *file_name);
 UTILS_LIBSPEC struct zip_archive *zip_open_mem_read(const void *src, size_t len);
+UTILS_LIBSPEC struct zip_archive *zip_open_subset_read(struct zip_archive *zp,
+ size_t count);
 UTILS_LIBSPEC struct zip_archive *zip_open_mem_write(void *src, size_t len,
  size_t start_pos);
 UTILS_LIBSPEC struct zip_archive *zip_open_mem_write_ext(void **external_buffer,
@@ -36,13 +36,14 @@
 #include "extmem.h"
 #include "graphics.h"
 #include "idput.h"
+#include "platform_endian.h"
 #include "robot.h"
 #include "sprite.h"
 #include "str.h"
 #include "window.h"
 #include "world.h"
 #include "util.h"
-#include "io/path.h"
+#include "io/memfile.h"
 #include "io/vio.h"
 
 #include "audio/sfx.h"
@@ -244,318 +245,207 @@ static int get_pw_xor_code(char *password, int pro_method)
   return work;
 }
 
-struct decrypt_data
-{
-  vfile *source;
-  vfile *dest;
-  const char *file_name;
-  size_t source_length;
-  unsigned int xor_val;
-  int xor_w;
-  int xor_d;
-  char password[MAX_PASSWORD_LENGTH + 1];
-  char backup_name[MAX_PATH];
-  char buffer[DECRYPT_BUFFER_SIZE];
-  int meter_curr;
-  int meter_target;
-};
-
-static long decrypt_backup(struct decrypt_data *data)
-{
-  vfile *source = NULL;
-  vfile *dest = NULL;
-  long ret = -1;
-  long file_length;
-  long left;
-  int meter_target = 1;
-  int meter_curr = 0;
-  int len;
-
-  meter_initial_draw(meter_curr, meter_target, "Writing backup world...");
+#if ARCHITECTURE_BITS >= 64
+#define DECRYPT_ALIGN_TYPE uint64_t
+#define DECRYPT_ALIGN_XOR(x) ((x) | ((x) << 8) | ((x) << 16) | ((x) << 24) | \
+ ((x) << 32) | ((x) << 40) | ((x) << 48) | ((x) << 56))
+#else
+#define DECRYPT_ALIGN_TYPE uint32_t
+#define DECRYPT_ALIGN_XOR(x) ((x) | ((x) << 8) | ((x) << 16) | ((x) << 24))
+#endif
 
-  source = vfopen_unsafe(data->file_name, "rb");
-  if(!source)
-    goto err;
+// Title, protection method, and magic (the password is removed).
+#define DECRYPT_HEADER_SIZE (LEGACY_BOARD_NAME_SIZE + 1 + 3)
 
-  dest = vfopen_unsafe(data->backup_name, "wb");
-  if(!dest)
-    goto err;
+/**
+ * Everything after the header of a protected world is XORed with the same
+ * value, so it can be decrypted in place a machine word at a time.
+ */
+static void decrypt_xor(unsigned char *pos, size_t len, unsigned int xor_val)
+{
+  DECRYPT_ALIGN_TYPE xor_w = DECRYPT_ALIGN_XOR((DECRYPT_ALIGN_TYPE)xor_val);
+  unsigned char *end = pos + len;
 
-  file_length = vfilelength(source, false);
-  meter_target = file_length;
+  while(pos < end && ((size_t)pos) % sizeof(DECRYPT_ALIGN_TYPE))
+    *(pos++) ^= xor_val;
 
-  left = file_length;
-  while(left > 0)
+  while(end - pos >= (ptrdiff_t)sizeof(DECRYPT_ALIGN_TYPE))
   {
-    len = MIN(left, DECRYPT_BUFFER_SIZE);
-    left -= len;
-
-    if(!vfread(data->buffer, len, 1, source))
-      goto err;
-
-    if(!vfwrite(data->buffer, len, 1, dest))
-      goto err;
-
-    meter_curr += len - 1;
-    meter_update_screen(&meter_curr, meter_target);
+    *((DECRYPT_ALIGN_TYPE *)pos) ^= xor_w;
+    pos += sizeof(DECRYPT_ALIGN_TYPE);
   }
 
-  ret = file_length;
-
-err:
-  if(source)
-    vfclose(source);
-  if(dest)
-    vfclose(dest);
-
-  meter_restore_screen();
-  return ret;
+  while(pos < end)
+    *(pos++) ^= xor_val;
 }
 
-static boolean decrypt_block(struct decrypt_data *data, int block_len)
+/**
+ * Copy and decrypt the rest of the source to the destination. If the
+ * destination is in memory, the source is read directly into it.
+ */
+static boolean decrypt_body(vfile *source, vfile *dest, size_t len,
+ unsigned int xor_val)
 {
-  int len;
-  int i;
+  unsigned char *buffer;
+  struct memfile mf;
+  boolean ret = false;
+  size_t sz;
 
-  while(block_len > 0)
+  if(vfile_get_flags(dest) & VF_MEMORY)
   {
-    len = MIN(block_len, DECRYPT_BUFFER_SIZE);
-    block_len -= len;
+    if(!vfile_get_memfile_block(dest, len, &mf))
+      return false;
 
-    if(!vfread(data->buffer, len, 1, data->source))
+    if(len && !vfread(mf.start, len, 1, source))
       return false;
 
-    for(i = 0; i < len; i++)
-      data->buffer[i] ^= data->xor_val;
+    decrypt_xor(mf.start, len, xor_val);
+    return true;
+  }
+
+  buffer = (unsigned char *)cmalloc(DECRYPT_BUFFER_SIZE);
+  while(len > 0)
+  {
+    sz = MIN(len, DECRYPT_BUFFER_SIZE);
+    len -= sz;
 
-    if(!vfwrite(data->buffer, len, 1, data->dest))
-      return false;
+    if(!vfread(buffer, sz, 1, source))
+      goto err;
 
-    data->meter_curr += len - 1;
-    meter_update_screen(&data->meter_curr, data->meter_target);
+    decrypt_xor(buffer, sz, xor_val);
+
+    if(!vfwrite(buffer, sz, 1, dest))
+      goto err;
   }
-  return true;
+  ret = true;
+
+err:
+  free(buffer);
+  return ret;
 }
 
-static boolean decrypt_and_fix_offset(struct decrypt_data *data)
+static boolean decrypt_fix_offset(vfile *vf)
 {
-  long offset = vfgetd(data->source);
-  if(offset == EOF)
+  long pos = vftell(vf);
+  int offset = vfgetd(vf);
+  if(offset == EOF || vfseek(vf, pos, SEEK_SET))
     return false;
 
-  offset ^= data->xor_d;
-
   // Adjust the offset to account for removing the password...
-  offset -= MAX_PASSWORD_LENGTH;
-
-  vfputd(offset, data->dest);
-
-  data->meter_curr += 4 - 1;
-  meter_update_screen(&data->meter_curr, data->meter_target);
+  vfputd(offset - MAX_PASSWORD_LENGTH, vf);
   return true;
 }
 
-static boolean decrypt(struct decrypt_data *data)
+/**
+ * Adjust the offsets in the decrypted world, which point past the removed
+ * password.
+ */
+static boolean decrypt_fix_offsets(vfile *vf)
 {
-  int pro_method;
-  int i;
   int num_boards;
-  char *src_ptr;
-  char *magic_pos;
-
-  data->meter_target = (data->source_length - MAX_PASSWORD_LENGTH);
-  data->meter_curr = 0;
-  meter_initial_draw(data->meter_curr, data->meter_target, "Decrypting...");
-
-  if(!vfread(data->buffer, 44, 1, data->source))
-    goto err_meter;
-
-  src_ptr = data->buffer + LEGACY_BOARD_NAME_SIZE;
-  pro_method = *src_ptr;
-  src_ptr++;
-
-  // Get password
-  memcpy(data->password, src_ptr, MAX_PASSWORD_LENGTH);
-  data->password[MAX_PASSWORD_LENGTH] = '\0';
-  // First, normalize password...
-  for(i = 0; i < MAX_PASSWORD_LENGTH; i++)
-  {
-    data->password[i] ^= magic_code[i];
-    data->password[i] -= 0x12 + pro_method;
-    data->password[i] ^= 0x8D;
-  }
-
-  // Xor code
-  data->xor_val = get_pw_xor_code(data->password, pro_method);
-  data->xor_w = data->xor_val | (data->xor_val << 8);
-  data->xor_d = data->xor_val | (data->xor_val << 8) |
-   (data->xor_val << 16) | (data->xor_val << 24);
-
-  // Copy title
-  if(!vfwrite(data->buffer, LEGACY_BOARD_NAME_SIZE, 1, data->dest))
-    goto err_meter;
-
-  // Protection method.
-  vfputc(0, data->dest);
-
-  // Copy magic.
-  magic_pos = data->buffer + LEGACY_BOARD_NAME_SIZE + 1 + MAX_PASSWORD_LENGTH;
-  if(!vfwrite(magic_pos, 3, 1, data->dest))
-    goto err_meter;
-
-  data->meter_curr += LEGACY_BOARD_NAME_SIZE + 1 + 3 - 1;
-  meter_update_screen(&data->meter_curr, data->meter_target);
-
-  // Decrypt world data.
-  if(!decrypt_block(data, WORLD_BLOCK_1_SIZE + WORLD_BLOCK_2_SIZE))
-    goto err_meter;
+  int i;
 
-  // Decrypt and fix global robot offset.
-  if(!decrypt_and_fix_offset(data))
-    goto err_meter;
+  // Global robot offset.
+  if(vfseek(vf, DECRYPT_HEADER_SIZE + WORLD_BLOCK_1_SIZE + WORLD_BLOCK_2_SIZE,
+   SEEK_SET) || !decrypt_fix_offset(vf))
+    return false;
 
-  // Decrypt SFX table (if present).
-  num_boards = vfgetc(data->source) ^ data->xor_val;
-  vfputc(num_boards, data->dest);
-  data->meter_curr++;
+  // Skip the SFX table (if present).
+  num_boards = vfgetc(vf);
   if(!num_boards)
   {
-    int sfx_length = vfgetw(data->source) ^ data->xor_w;
-    vfputw(sfx_length, data->dest);
-    data->meter_curr += 2;
-
-    if(!decrypt_block(data, sfx_length))
-      goto err_meter;
+    int sfx_length = vfgetw(vf);
+    if(sfx_length == EOF || vfseek(vf, sfx_length, SEEK_CUR))
+      return false;
 
-    num_boards = vfgetc(data->source) ^ data->xor_val;
-    vfputc(num_boards, data->dest);
-    data->meter_curr++;
+    num_boards = vfgetc(vf);
   }
+  if(num_boards == EOF)
+    return false;
 
-  // Decrypt board titles.
-  if(!decrypt_block(data, LEGACY_BOARD_NAME_SIZE * num_boards))
-    goto err_meter;
+  // Skip board titles.
+  if(vfseek(vf, LEGACY_BOARD_NAME_SIZE * num_boards, SEEK_CUR))
+    return false;
 
-  // Decrypt and fix board table.
+  // Fix board table.
   for(i = 0; i < num_boards; i++)
   {
     // Board length.
-    int board_length = vfgetd(data->source) ^ data->xor_d;
-    vfputd(board_length, data->dest);
-    data->meter_curr += 4;
+    if(vfseek(vf, 4, SEEK_CUR))
+      return false;
 
     // Board offset.
-    if(!decrypt_and_fix_offset(data))
-      goto err_meter;
+    if(!decrypt_fix_offset(vf))
+      return false;
   }
-
-  // Decrypt the rest of the file.
-  i = vftell(data->source);
-  if(!decrypt_block(data, data->source_length - i))
-    goto err_meter;
-
-  meter_restore_screen();
   return true;
-
-err_meter:
-  meter_restore_screen();
-  return false;
 }
 
-static vfile *legacy_decrypt_world_to_temp_file(vfile *source)
+/**
+ * Decrypt a protected world into a temporary file, which is in memory unless
+ * there isn't enough RAM for it. The original world is left untouched.
+ */
+static vfile *legacy_decrypt_world(vfile *source)
 {
-  struct decrypt_data *data;
-  vfile *dest;
+  char header[DECRYPT_HEADER_SIZE + MAX_PASSWORD_LENGTH];
+  char password[MAX_PASSWORD_LENGTH + 1];
+  unsigned int xor_val;
   size_t source_length = vfilelength(source, true);
+  int pro_method;
+  vfile *dest;
+  int i;
 
-  debug("Attempting decrypt: to temporary file.\n");
-  dest = vtempfile(source_length - MAX_PASSWORD_LENGTH);
-  if(!dest)
-  {
-    debug("Attempting decrypt: to _DECRYPT.TMP\n");
-    dest = vfopen_unsafe("_DECRYPT.TMP", "wb+");
-    if(!dest)
-      return NULL;
-  }
+  if(source_length < sizeof(header))
+    return NULL;
 
-  data = ccalloc(1, sizeof(struct decrypt_data));
+  if(!vfread(header, sizeof(header), 1, source))
+    return NULL;
 
-  data->source_length = source_length;
-  data->source = source;
-  data->dest = dest;
+  pro_method = header[LEGACY_BOARD_NAME_SIZE];
 
-  if(!decrypt(data))
+  // Get password
+  memcpy(password, header + LEGACY_BOARD_NAME_SIZE + 1, MAX_PASSWORD_LENGTH);
+  password[MAX_PASSWORD_LENGTH] = '\0';
+  // First, normalize password...
+  for(i = 0; i < MAX_PASSWORD_LENGTH; i++)
   {
-    vfclose(data->dest);
-    free(data);
-    return NULL;
+    password[i] ^= magic_code[i];
+    password[i] -= 0x12 + pro_method;
+    password[i] ^= 0x8D;
   }
-  free(data);
-  return dest;
-}
-
-static vfile *legacy_decrypt_world(const char *file_name)
-{
-  struct decrypt_data *data;
-  vfile *dest;
-  int file_length;
-
-  data = ccalloc(1, sizeof(struct decrypt_data));
 
-  data->file_name = file_name;
-  snprintf(data->backup_name, MAX_PATH, "%.*s.locked", MAX_PATH - 8, file_name);
-  debug("Attempting decrypt: to '%s'.\n", data->backup_name);
+  // Xor code
+  xor_val = get_pw_xor_code(password, pro_method);
 
-  file_length = decrypt_backup(data);
-  if(file_length < 0)
-  {
-    // Try a shorter name...
-    ptrdiff_t pos = strrchr(file_name, '.') - file_name;
-    if(pos >= 0 && pos < MAX_PATH)
-    {
-      data->backup_name[pos] = '\0';
+  debug("Attempting decrypt: to temporary file.\n");
+  dest = vtempfile(source_length - MAX_PASSWORD_LENGTH);
+  if(!dest)
+    return NULL;
 
-      if(path_force_ext(data->backup_name, MAX_PATH, ".LCK"))
-      {
-        debug("Attempting decrypt: to '%s'.\n", data->backup_name);
-        file_length = decrypt_backup(data);
-      }
-    }
+  // Title.
+  if(!vfwrite(header, LEGACY_BOARD_NAME_SIZE, 1, dest))
+    goto err;
 
-    if(file_length < 0)
-    {
-      free(data);
-      return NULL;
-    }
-  }
+  // Protection method.
+  vfputc(0, dest);
 
-  data->source_length = file_length;
-  data->source = vfopen_unsafe(data->backup_name, "rb");
-  if(!data->source)
-    goto err_free;
+  // Magic.
+  if(!vfwrite(header + LEGACY_BOARD_NAME_SIZE + 1 + MAX_PASSWORD_LENGTH, 3, 1,
+   dest))
+    goto err;
 
-  data->dest = vfopen_unsafe_ext(file_name, "wb", V_SMALL_BUFFER);
-  if(!data->dest)
-  {
-    error_message(E_WORLD_DECRYPT_WRITE_PROTECTED, 0, NULL);
-    goto err_free;
-  }
+  // Decrypt world data.
+  if(!decrypt_body(source, dest, source_length - sizeof(header), xor_val))
+    goto err;
 
-  if(!decrypt(data))
-    goto err_free;
+  if(!decrypt_fix_offsets(dest))
+    goto err;
 
-  dest = data->dest;
-  vfclose(data->source);
-  free(data);
+  vrewind(dest);
   return dest;
 
-err_free:
-  if(data->source)
-    vfclose(data->source);
-  if(data->dest)
-    vfclose(data->dest);
-
-  free(data);
+err:
+  vfclose(dest);
   return NULL;
 }
 
@@ -876,30 +766,18 @@ vfile *validate_legacy_world_file(struct world *mzx_world,
 
   if(res == VAL_PROTECTED)
   {
-    if(conf->auto_decrypt_worlds || !has_video_initialized())
+    if(conf->auto_decrypt_worlds || !has_video_initialized() ||
+     !confirm(mzx_world, "This world may be password protected. Decrypt it?"))
     {
-      // Attempt to decrypt to a temporary file.
-      vfile *tmp = legacy_decrypt_world_to_temp_file(vf);
-      if(tmp)
-      {
-        vfclose(vf);
-        return tmp;
-      }
-      error_message(E_IO_WRITE, 0, NULL);
-      return NULL;
-    }
-
-    if(!confirm(mzx_world, "This world may be password protected. Decrypt it?"))
-    {
-      vfclose(vf);
-
       // Decrypt and try again
-      vf = legacy_decrypt_world(file);
-      if(!vf)
+      vfile *tmp = legacy_decrypt_world(vf);
+      vfclose(vf);
+      if(!tmp)
       {
         error_message(E_IO_READ, 0, NULL);
         return NULL;
       }
+      vf = tmp;
 
       res = __validate_legacy_world_file(vf, savegame);
       if(res == VAL_SUCCESS)
@@ -0,0 +1,263 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "lz.h"
+#include "util.h"
+
+#include <string.h>
+
+#ifndef LZ_HASH_BITS
+#ifdef CONFIG_NDS
+// Keep the match table small; it lives on the (small) stack.
+#define LZ_HASH_BITS 10
+#else
+// Size (in bits) of the compressor's match table.
+#define LZ_HASH_BITS 12
+#endif
+#endif
+
+#define LZ_MIN_MATCH    4
+#define LZ_MAX_OFFSET   0xFFFF
+#define LZ_HASH_SIZE    (1 << LZ_HASH_BITS)
+#define LZ_NO_POS       UINT32_MAX
+
+static inline uint32_t LZ_hash(const uint8_t *src, unsigned int bits)
+{
+  uint32_t value = src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t)src[3] << 24);
+  return (value * 2654435761u) >> (32 - bits);
+}
+
+static inline boolean LZ_pack_length(uint8_t * RESTRICT data, size_t data_len,
+ size_t *j, size_t len)
+{
+  while(len >= 255)
+  {
+    if(*j >= data_len)
+      return false;
+    data[(*j)++] = 255;
+    len -= 255;
+  }
+  if(*j >= data_len)
+    return false;
+  data[(*j)++] = len;
+  return true;
+}
+
+static inline boolean LZ_unpack_length(const uint8_t *data, size_t data_len,
+ size_t *j, size_t *len)
+{
+  uint8_t ext;
+  do
+  {
+    if(*j >= data_len)
+      return false;
+    ext = data[(*j)++];
+    *len += ext;
+  }
+  while(ext == 255);
+  return true;
+}
+
+/**
+ * Emit an LZ sequence: a token, literals, and optionally a match.
+ * The token contains the literal count in the high nibble and the match
+ * length (minus LZ_MIN_MATCH) in the low nibble; 15 means more length bytes
+ * follow. A sequence without a match can only occur at the end of the stream.
+ */
+static boolean LZ_pack_sequence(uint8_t * RESTRICT data, size_t data_len,
+ size_t *j, const uint8_t *literals, size_t num_literals, size_t offset,
+ size_t match_len)
+{
+  size_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+  uint8_t token = (MIN(num_literals, 15) << 4) | MIN(match_code, 15);
+
+  if(*j >= data_len)
+    return false;
+  data[(*j)++] = token;
+
+  if(num_literals >= 15)
+    if(!LZ_pack_length(data, data_len, j, num_literals - 15))
+      return false;
+
+  if(*j + num_literals > data_len)
+    return false;
+  memcpy(data + *j, literals, num_literals);
+  *j += num_literals;
+
+  if(match_len)
+  {
+    if(*j + 1 >= data_len)
+      return false;
+    data[(*j)++] = offset & 0xFF;
+    data[(*j)++] = offset >> 8;
+
+    if(match_code >= 15)
+      if(!LZ_pack_length(data, data_len, j, match_code - 15))
+        return false;
+  }
+  return true;
+}
+
+/**
+ * Pack a buffer with MZX LZ compression, a byte oriented LZ77 variant. It
+ * compresses repeated patterns in board planes (walls, floors, etc.) much
+ * better than RLE3 and unpacks far faster than zlib inflate.
+ *
+ * @param   data      buffer to output LZ stream to.
+ * @param   data_len  size of LZ buffer.
+ * @param   src       uncompressed source data.
+ * @param   src_len   length of uncompressed source.
+ * @return            final LZ stream length, or 0 on failure (including when
+ *                    the stream doesn't fit in the output buffer).
+ */
+size_t lz_pack(uint8_t * RESTRICT data, size_t data_len,
+ const uint8_t *src, size_t src_len)
+{
+  uint32_t table[LZ_HASH_SIZE];
+  unsigned int bits = 8;
+  size_t anchor = 0;
+  size_t i = 0;
+  size_t j = 0;
+
+  // Small buffers don't need the whole table (and clearing it adds up).
+  while(bits < LZ_HASH_BITS && ((size_t)1 << bits) < src_len)
+    bits++;
+
+  memset(table, 0xFF, sizeof(uint32_t) << bits);
+
+  while(i + LZ_MIN_MATCH <= src_len)
+  {
+    uint32_t hash = LZ_hash(src + i, bits);
+    uint32_t ref = table[hash];
+    size_t match_len;
+
+    table[hash] = i;
+
+    if(ref == LZ_NO_POS || i - ref > LZ_MAX_OFFSET ||
+     memcmp(src + ref, src + i, LZ_MIN_MATCH))
+    {
+      i++;
+      continue;
+    }
+
+    match_len = LZ_MIN_MATCH;
+    while(i + match_len < src_len && src[ref + match_len] == src[i + match_len])
+      match_len++;
+
+    if(!LZ_pack_sequence(data, data_len, &j, src + anchor, i - anchor,
+     i - ref, match_len))
+      return 0;
+
+    i += match_len;
+    anchor = i;
+
+    // Keep the table useful for the position right before the next search.
+    if(i + LZ_MIN_MATCH <= src_len)
+      table[LZ_hash(src + i - 1, bits)] = i - 1;
+  }
+
+  if(!LZ_pack_sequence(data, data_len, &j, src + anchor, src_len - anchor, 0, 0))
+    return 0;
+
+  return j;
+}
+
+/**
+ * Unpack an LZ stream.
+ *
+ * @param   dest      destination buffer for the unpacked stream.
+ * @param   dest_len  size of destination buffer.
+ * @param   data      source LZ stream to unpack.
+ * @param   data_len  length of source LZ stream.
+ * @return            `true` on success, otherwise `false`. This function will
+ *                    fail if the unpacked stream size doesn't match `dest_len`.
+ */
+boolean lz_unpack(uint8_t * RESTRICT dest, size_t dest_len,
+ const uint8_t *data, size_t data_len)
+{
+  size_t i = 0;
+  size_t j = 0;
+
+  while(true)
+  {
+    uint8_t token;
+    size_t count;
+    size_t offset;
+
+    // Every stream ends with a sequence that has no match.
+    if(j >= data_len)
+      return false;
+
+    token = data[j++];
+    count = token >> 4;
+
+    // Literals.
+    if(count == 15)
+      if(!LZ_unpack_length(data, data_len, &j, &count))
+        return false;
+
+    if(i + count > dest_len || j + count > data_len)
+      return false;
+
+    memcpy(dest + i, data + j, count);
+    i += count;
+    j += count;
+
+    // The final sequence has no match.
+    if(j >= data_len)
+      break;
+
+    // Match.
+    if(j + 1 >= data_len)
+      return false;
+
+    offset = data[j] | (data[j + 1] << 8);
+    j += 2;
+
+    count = token & 0x0F;
+    if(count == 15)
+      if(!LZ_unpack_length(data, data_len, &j, &count))
+        return false;
+    count += LZ_MIN_MATCH;
+
+    if(!offset || offset > i || i + count > dest_len)
+      return false;
+
+    if(offset == 1)
+    {
+      // Char run. These are very common in board planes.
+      memset(dest + i, dest[i - 1], count);
+      i += count;
+    }
+    else
+    {
+      // Copy the repeating pattern in progressively larger chunks that never
+      // overlap their source.
+      const uint8_t *from = dest + i - offset;
+      while(count)
+      {
+        size_t sz = MIN(count, (size_t)(dest + i - from));
+        memcpy(dest + i, from, sz);
+        i += sz;
+        count -= sz;
+      }
+    }
+  }
+  return (i == dest_len);
+}
@@ -0,0 +1,37 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __LZ_H
+#define __LZ_H
+
+#include "compat.h"
+
+__M_BEGIN_DECLS
+
+#include <stddef.h>
+#include <stdint.h>
+
+CORE_LIBSPEC size_t lz_pack(uint8_t * RESTRICT data, size_t data_len,
+ const uint8_t *src, size_t src_len);
+CORE_LIBSPEC boolean lz_unpack(uint8_t * RESTRICT dest, size_t dest_len,
+ const uint8_t *data, size_t data_len);
+
+__M_END_DECLS
+
+#endif /* __LZ_H */
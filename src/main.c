@@ -51,6 +51,7 @@
 #include "io/vio.h"
 
 #include "audio/audio.h"
+#include "audio/audio_render.h"
 #include "audio/sfx.h"
 #include "network/network.h"
 
@@ -273,6 +274,14 @@ __libspec int main(int argc, char *argv[])
       warn("failed to initialize virtual filesystem!\n");
   }
 
+  // Offline audio rendering doesn't need video, events, or the game.
+  if(conf->audio_render_file[0])
+  {
+    if(audio_render(conf))
+      err = 0;
+    goto err_free_config;
+  }
+
   counter_fsg();
 
   rng_seed_init();
@@ -331,6 +340,7 @@ __libspec int main(int argc, char *argv[])
   title_screen((context *)core_data);
   core_run(core_data);
 
+  save_world_async_wait();
   vquick_fadeout();
 
   if(mzx_world.active)
@@ -27,6 +27,7 @@
 
 #include "data.h"
 #include "error.h"
+#include "file_cache.h"
 #include "idput.h"
 #include "legacy_robot.h"
 #include "legacy_world.h"
@@ -324,6 +325,9 @@ void save_mzm(struct world *mzx_world, char *name, int start_x, int start_y,
     vfwrite(buffer, mzm_size, 1, output_file);
     free(buffer);
     vfclose(output_file);
+
+    // The file may be rewritten without changing its size or timestamp.
+    mzm_cache_invalidate(name);
   }
 }
 
@@ -426,11 +430,294 @@ static boolean read_mzm_header(struct memfile *mf, size_t file_length,
   return true;
 }
 
+/**
+ * Robots loaded from an MZM. Loading robots doesn't depend on where the MZM is
+ * placed, so the loaded robots of cached MZMs are kept as templates and are
+ * cloned into the board each time the MZM is placed.
+ */
+struct mzm_robots
+{
+  struct robot **robots;
+  char *dummy;
+  int num_robots;
+  int savegame;
+  boolean error;
+  boolean loaded;
+};
+
+static void mzm_robots_free(struct mzm_robots *mr)
+{
+  int i;
+
+  for(i = 0; i < mr->num_robots; i++)
+    if(mr->robots[i])
+      clear_robot(mr->robots[i]);
+
+  free(mr->robots);
+  free(mr->dummy);
+  memset(mr, 0, sizeof(struct mzm_robots));
+}
+
+static size_t mzm_robots_size(struct mzm_robots *mr)
+{
+  size_t size = mr->num_robots * (sizeof(struct robot *) + 1);
+  int i;
+
+  for(i = 0; i < mr->num_robots; i++)
+  {
+    struct robot *cur_robot = mr->robots[i];
+    if(cur_robot)
+    {
+      size += sizeof(struct robot);
+      size += cur_robot->program_bytecode_length;
+      size += cur_robot->program_source_length;
+      size += cur_robot->num_labels * (sizeof(struct label) +
+       sizeof(struct label *));
+      size += cur_robot->stack_size * sizeof(int);
+    }
+  }
+  return size;
+}
+
+/**
+ * Clone a robot template. Unlike duplicating a robot on the board, this
+ * keeps the runtime state stored in savegame MZMs.
+ */
+static struct robot *mzm_clone_robot(struct world *mzx_world,
+ struct robot *src_robot, int x, int y)
+{
+  struct robot *cur_robot = cmalloc(sizeof(struct robot));
+  size_t stack_capacity = src_robot->stack_size * sizeof(int);
+
+  duplicate_robot_direct(mzx_world, src_robot, cur_robot, x, y, 0);
+
+  cur_robot->cur_prog_line = src_robot->cur_prog_line;
+  cur_robot->pos_within_line = src_robot->pos_within_line;
+  cur_robot->status = src_robot->status;
+  cur_robot->stack_size = src_robot->stack_size;
+  cur_robot->stack_pointer = src_robot->stack_pointer;
+
+  if(stack_capacity)
+  {
+    cur_robot->stack = cmalloc(stack_capacity);
+    memcpy(cur_robot->stack, src_robot->stack, stack_capacity);
+  }
+  return cur_robot;
+}
+
+static void load_mzm_robots(struct world *mzx_world, struct mzm_robots *mr,
+ struct memfile *mf, int file_length, struct mzm_header *mzm, int savegame)
+{
+  struct zip_archive *zp;
+  struct robot *cur_robot;
+  unsigned int file_id;
+  unsigned int robot_id;
+  int robot_calculated_size = 0;
+  int robot_partial_size = 0;
+  int current_position;
+  int dummy = 0;
+  int result;
+  int i;
+
+  mr->robots = (struct robot **)ccalloc(mzm->num_robots, sizeof(struct robot *));
+  mr->dummy = (char *)ccalloc(mzm->num_robots, 1);
+  mr->num_robots = mzm->num_robots;
+  mr->savegame = savegame;
+  mr->loaded = true;
+
+  // We suppress the errors that will generally occur here and barely
+  // error check the zip functions. Why? This needs to run all the way
+  // through, regardless of whether it finds errors. Otherwise, we'll
+  // get invalid robots with ID=0 littered around the board.
+
+  set_error_suppression(E_WORLD_ROBOT_MISSING, 1);
+  set_error_suppression(E_BOARD_ROBOT_CORRUPT, 1);
+
+  // Reset the error count.
+  get_and_reset_error_count();
+
+  if(mzm->world_version <= MZX_LEGACY_FORMAT_VERSION)
+  {
+    robot_partial_size =
+     legacy_calculate_partial_robot_size(mzm->savegame_mode,
+     mzm->world_version);
+
+    mfseek(mf, mzm->robots_location, SEEK_SET);
+    zp = NULL;
+  }
+  else
+  {
+    zp = zip_open_mem_read(mf->start, file_length);
+    world_assign_file_ids(zp, false);
+  }
+
+  // If we're loading a "runtime MZM" then it means that we're loading
+  // bytecode. And to do this we must both be in-game and must be
+  // running the same version this was made in. But since loading
+  // dynamically created MZMs in the editor is still useful, we'll just
+  // dummy out the robots.
+
+  if((mzm->savegame_mode > savegame) ||
+   (MZX_VERSION < mzm->world_version))
+  {
+    dummy = 1;
+  }
+
+  for(i = 0; i < mzm->num_robots; i++)
+  {
+    cur_robot = cmalloc(sizeof(struct robot));
+
+    // TODO: Skipped legacy robots aren't checked for, so the loaded
+    // chars for dummy robots on clipped MZMs might be off. This
+    // shouldn't matter too often though.
+
+    if(mzm->world_version <= MZX_LEGACY_FORMAT_VERSION)
+    {
+      create_blank_robot(cur_robot);
+
+      current_position = mftell(mf);
+
+      // If we fail, we have to continue, or robots won't be dummied
+      // correctly. In this case, seek to the end.
+
+      if(current_position + robot_partial_size <= file_length)
+      {
+        robot_calculated_size =
+         legacy_load_robot_calculate_size(mf->current, mzm->savegame_mode,
+         mzm->world_version);
+
+        if(current_position + robot_calculated_size <= file_length)
+        {
+          struct memfile r_mf;
+          mfopen(mf->current, robot_calculated_size, &r_mf);
+          legacy_load_robot_from_memory(mzx_world, cur_robot, &r_mf,
+           mzm->savegame_mode, mzm->world_version, (int)current_position);
+        }
+        else
+        {
+          mfseek(mf, 0, SEEK_END);
+          dummy = 1;
+        }
+      }
+      else
+      {
+        mfseek(mf, 0, SEEK_END);
+        dummy = 1;
+      }
+
+      mf->current += robot_calculated_size;
+    }
+
+    // Search the zip until a robot is found.
+    else do
+    {
+      result = zip_get_next_mzx_file_id(zp, &file_id, NULL, &robot_id);
+
+      if(result != ZIP_SUCCESS)
+      {
+        // We have to continue, or we'll get screwed up robots.
+        create_blank_robot(cur_robot);
+        create_blank_robot_program(cur_robot);
+        dummy = 1;
+        break;
+      }
+      else
+
+      if(file_id != FILE_ID_ROBOT || (int)robot_id < i)
+      {
+        // Not a robot or is a skipped robot
+        zip_skip_file(zp);
+      }
+      else
+
+      if((int)robot_id > i)
+      {
+        // There's a robot missing.
+        create_blank_robot(cur_robot);
+        create_blank_robot_program(cur_robot);
+        break;
+      }
+
+      else
+      {
+        load_robot(mzx_world, cur_robot, zp, mzm->savegame_mode,
+         mzm->world_version);
+        break;
+      }
+    }
+    while(1);
+
+    if(!dummy)
+    {
+      cur_robot->world_version = mzx_world->version;
+
+#ifdef CONFIG_DEBYTECODE
+      // If we're loading source code at runtime, we need to compile it
+      if(mzm->savegame_mode < savegame)
+        prepare_robot_bytecode(mzx_world, cur_robot);
+#endif
+    }
+
+    mr->robots[i] = cur_robot;
+    mr->dummy[i] = dummy;
+  }
+
+  if(mzm->world_version > MZX_LEGACY_FORMAT_VERSION)
+  {
+    zip_close(zp, NULL);
+  }
+
+  if(get_and_reset_error_count())
+    mr->error = true;
+}
+
+/**
+ * Worlds that stream tiles can place the same MZMs thousands of times. The
+ * contents of recently used MZM files and their loaded robots are cached in
+ * memory; see file_cache.h.
+ */
+#define MZM_CACHE_MAX_ENTRIES 64
+#define MZM_CACHE_MAX_SIZE    (4 << 20)
+
+static void mzm_cache_free_robots(void *priv)
+{
+  mzm_robots_free((struct mzm_robots *)priv);
+  free(priv);
+}
+
+static struct file_cache_entry mzm_cache_entries[MZM_CACHE_MAX_ENTRIES];
+static struct file_cache mzm_cache =
+{
+  mzm_cache_entries,
+  MZM_CACHE_MAX_ENTRIES,
+  MZM_CACHE_MAX_SIZE,
+  MZM_CACHE_MAX_SIZE / 4,
+  0,
+  mzm_cache_free_robots,
+  0, 0, 0
+};
+
+/**
+ * Remove an MZM file from the cache.
+ */
+void mzm_cache_invalidate(const char *name)
+{
+  file_cache_invalidate(&mzm_cache, name);
+}
+
+/**
+ * Remove all MZM files from the cache.
+ */
+void mzm_cache_clear(void)
+{
+  file_cache_clear(&mzm_cache);
+}
+
 // This will clip.
 
 static int load_mzm_common(struct world *mzx_world, struct memfile *mf,
  int file_length, int start_x, int start_y, int mode, int savegame,
- enum thing layer_convert_id, char *name)
+ enum thing layer_convert_id, char *name, struct file_cache_entry *cached)
 {
   struct mzm_header mzm;
 
@@ -590,146 +877,42 @@ static int load_mzm_common(struct world *mzx_world, struct memfile *mf,
 
           if(mzm.num_robots)
           {
-            struct zip_archive *zp;
-            unsigned int file_id;
-            unsigned int robot_id;
-            int result;
-
+            struct mzm_robots tmp_robots;
+            struct mzm_robots *mr = &tmp_robots;
             struct robot *cur_robot;
             int current_x, current_y;
             int offset;
             int new_param;
-            int robot_calculated_size = 0;
-            int robot_partial_size = 0;
-            int current_position;
-            int dummy = 0;
-
-            // We suppress the errors that will generally occur here and barely
-            // error check the zip functions. Why? This needs to run all the way
-            // through, regardless of whether it finds errors. Otherwise, we'll
-            // get invalid robots with ID=0 littered around the board.
-
-            set_error_suppression(E_WORLD_ROBOT_MISSING, 1);
-            set_error_suppression(E_BOARD_ROBOT_CORRUPT, 1);
 
-            // Reset the error count.
-            get_and_reset_error_count();
-
-            if(mzm.world_version <= MZX_LEGACY_FORMAT_VERSION)
+            if(cached)
             {
-              robot_partial_size =
-               legacy_calculate_partial_robot_size(mzm.savegame_mode,
-               mzm.world_version);
+              if(!cached->priv)
+                cached->priv = ccalloc(1, sizeof(struct mzm_robots));
 
-              mfseek(mf, mzm.robots_location, SEEK_SET);
-              zp = NULL;
+              mr = (struct mzm_robots *)cached->priv;
+              if(mr->loaded && mr->savegame != savegame)
+                mzm_robots_free(mr);
             }
             else
-            {
-              zp = zip_open_mem_read(mf->start, file_length);
-              world_assign_file_ids(zp, false);
-            }
+              memset(mr, 0, sizeof(struct mzm_robots));
 
-            // If we're loading a "runtime MZM" then it means that we're loading
-            // bytecode. And to do this we must both be in-game and must be
-            // running the same version this was made in. But since loading
-            // dynamically created MZMs in the editor is still useful, we'll just
-            // dummy out the robots.
-
-            if((mzm.savegame_mode > savegame) ||
-             (MZX_VERSION < mzm.world_version))
+            if(!mr->loaded)
             {
-              dummy = 1;
+              load_mzm_robots(mzx_world, mr, mf, file_length, &mzm, savegame);
+              if(cached)
+              {
+                file_cache_resize(&mzm_cache, cached,
+                 cached->length + mzm_robots_size(mr));
+              }
             }
 
             for(i = 0; i < mzm.num_robots; i++)
             {
-              cur_robot = cmalloc(sizeof(struct robot));
-
               current_x = robot_x_locations[i];
               current_y = robot_y_locations[i];
+              cur_robot = mr->robots[i];
 
-              // TODO: Skipped legacy robots aren't checked for, so the loaded
-              // chars for dummy robots on clipped MZMs might be off. This
-              // shouldn't matter too often though.
-
-              if(mzm.world_version <= MZX_LEGACY_FORMAT_VERSION)
-              {
-                create_blank_robot(cur_robot);
-
-                current_position = mftell(mf);
-
-                // If we fail, we have to continue, or robots won't be dummied
-                // correctly. In this case, seek to the end.
-
-                if(current_position + robot_partial_size <= file_length)
-                {
-                  robot_calculated_size =
-                   legacy_load_robot_calculate_size(mf->current, mzm.savegame_mode,
-                   mzm.world_version);
-
-                  if(current_position + robot_calculated_size <= file_length)
-                  {
-                    struct memfile r_mf;
-                    mfopen(mf->current, robot_calculated_size, &r_mf);
-                    legacy_load_robot_from_memory(mzx_world, cur_robot, &r_mf,
-                     mzm.savegame_mode, mzm.world_version, (int)current_position);
-                  }
-                  else
-                  {
-                    mfseek(mf, 0, SEEK_END);
-                    dummy = 1;
-                  }
-                }
-                else
-                {
-                  mfseek(mf, 0, SEEK_END);
-                  dummy = 1;
-                }
-
-                mf->current += robot_calculated_size;
-              }
-
-              // Search the zip until a robot is found.
-              else do
-              {
-                result = zip_get_next_mzx_file_id(zp, &file_id, NULL, &robot_id);
-
-                if(result != ZIP_SUCCESS)
-                {
-                  // We have to continue, or we'll get screwed up robots.
-                  create_blank_robot(cur_robot);
-                  create_blank_robot_program(cur_robot);
-                  dummy = 1;
-                  break;
-                }
-                else
-
-                if(file_id != FILE_ID_ROBOT || (int)robot_id < i)
-                {
-                  // Not a robot or is a skipped robot
-                  zip_skip_file(zp);
-                }
-                else
-
-                if((int)robot_id > i)
-                {
-                  // There's a robot missing.
-                  create_blank_robot(cur_robot);
-                  create_blank_robot_program(cur_robot);
-                  break;
-                }
-
-                else
-                {
-                  load_robot(mzx_world, cur_robot, zp, mzm.savegame_mode,
-                   mzm.world_version);
-                  break;
-                }
-              }
-              while(1);
-
-              if(dummy)
+              if(mr->dummy[i])
               {
                 // Unfortunately, getting the actual character for the robot is
                 // kind of a lot of work right now. We have to load it then
@@ -743,65 +926,57 @@ static int load_mzm_common(struct world *mzx_world, struct memfile *mf,
                   level_id[offset] = CUSTOM_BLOCK;
                   level_param[offset] = cur_robot->robot_char;
                 }
-                clear_robot(cur_robot);
               }
 
               else
-              {
-                cur_robot->world_version = mzx_world->version;
 
-#ifdef CONFIG_DEBYTECODE
-                // If we're loading source code at runtime, we need to compile it
-                if(mzm.savegame_mode < savegame)
-                  prepare_robot_bytecode(mzx_world, cur_robot);
-#endif
+              if(current_x != -1)
+              {
+                new_param = find_free_robot(src_board);
+                offset = current_x + (current_y * board_width);
 
-                if(current_x != -1)
+                if(new_param != -1)
                 {
-                  new_param = find_free_robot(src_board);
-                  offset = current_x + (current_y * board_width);
-
-                  if(new_param != -1)
+                  if((enum thing)level_id[offset] != PLAYER)
                   {
-                    if((enum thing)level_id[offset] != PLAYER)
+                    // Cached robots are templates; otherwise use the robot.
+                    if(cached)
                     {
-                      add_robot_name_entry(src_board, cur_robot,
-                        cur_robot->robot_name);
-                      src_board->robot_list[new_param] = cur_robot;
-                      cur_robot->xpos = current_x;
-                      cur_robot->ypos = current_y;
-                      cur_robot->compat_xpos = current_x;
-                      cur_robot->compat_ypos = current_y;
-                      level_param[offset] = new_param;
+                      cur_robot = mzm_clone_robot(mzx_world, cur_robot,
+                       current_x, current_y);
                     }
                     else
-                    {
-                      clear_robot(cur_robot);
-                    }
-                  }
-                  else
-                  {
-                    clear_robot(cur_robot);
-                    level_id[offset] = 0;
-                    level_param[offset] = 0;
-                    level_color[offset] = 7;
+                      mr->robots[i] = NULL;
+
+                    cur_robot->world_version = mzx_world->version;
+                    add_robot_name_entry(src_board, cur_robot,
+                      cur_robot->robot_name);
+                    src_board->robot_list[new_param] = cur_robot;
+                    cur_robot->xpos = current_x;
+                    cur_robot->ypos = current_y;
+                    cur_robot->compat_xpos = current_x;
+                    cur_robot->compat_ypos = current_y;
+                    level_param[offset] = new_param;
                   }
                 }
                 else
                 {
-                  clear_robot(cur_robot);
+                  level_id[offset] = 0;
+                  level_param[offset] = 0;
+                  level_color[offset] = 7;
                 }
               }
             }
 
-            if(mzm.world_version > MZX_LEGACY_FORMAT_VERSION)
+            if(mr->error)
             {
-              zip_close(zp, NULL);
+              if(!cached)
+                mzm_robots_free(mr);
+              goto err_robots;
             }
 
-            // If any errors were encountered, report
-            if(get_and_reset_error_count())
-              goto err_robots;
+            if(!cached)
+              mzm_robots_free(mr);
           }
           break;
         }
@@ -970,12 +1145,22 @@ err_invalid:
 int load_mzm(struct world *mzx_world, char *name, int start_x, int start_y,
  int mode, int savegame, enum thing layer_convert_id)
 {
+  struct file_cache_entry *cached;
   vfile *input_file;
   size_t file_size;
   void *buffer;
   int success;
   int count;
   struct memfile mf;
+
+  cached = file_cache_get(&mzm_cache, name);
+  if(cached)
+  {
+    mfopen(cached->data, cached->length, &mf);
+    return load_mzm_common(mzx_world, &mf, (int)cached->length, start_x,
+     start_y, mode, savegame, layer_convert_id, name, cached);
+  }
+
   input_file = vfopen_unsafe(name, "rb");
   if(input_file)
   {
@@ -992,7 +1177,7 @@ int load_mzm(struct world *mzx_world, char *name, int start_x, int start_y,
 
     mfopen(buffer, file_size, &mf);
     success = load_mzm_common(mzx_world, &mf, (int)file_size, start_x,
-     start_y, mode, savegame, layer_convert_id, name);
+     start_y, mode, savegame, layer_convert_id, name, NULL);
     free(buffer);
     return success;
   }
@@ -1010,7 +1195,7 @@ int load_mzm_memory(struct world *mzx_world, char *name, int start_x,
   struct memfile mf;
   mfopen(buffer, length, &mf);
   return load_mzm_common(mzx_world, &mf, (int)length, start_x, start_y,
-   mode, savegame, layer_convert_id, name);
+   mode, savegame, layer_convert_id, name, NULL);
 }
 
 boolean load_mzm_header(char *name, struct mzm_header *mzm_header)
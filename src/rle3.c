@@ -0,0 +1,352 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2021 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "rle3.h"
+#include "util.h"
+
+#include <string.h>
+
+#define RLE3_MAX_CHAR   (0x3F)
+#define RLE3_MAX_BLOCK  (0x2000)
+
+#define RLE3_PACK_OVERHEAD(sz) (((sz) - 1 >= 0x20) ? 2 : 1)
+
+#define RLE3_PACK_SIZE(code, sz) do { \
+  size_t tmp = (sz) - 1; \
+  if(j >= data_len || !(sz)) \
+    return 0; \
+  if(tmp >= 0x20) \
+  { \
+    if(j + 1 >= data_len) \
+      return 0; \
+    data[j++] = code | 0x20 | (tmp >> 8); \
+    data[j++] = tmp & 0xFF; \
+  } \
+  else \
+    data[j++] = code | tmp; \
+} while(0)
+
+#define RLE3_PACK_CHAR(ch)      do{ data[j++] = (ch) & RLE3_MAX_CHAR; }while(0)
+#define RLE3_PACK_BLOCK(sz)     RLE3_PACK_SIZE(0x40, sz)
+#define RLE3_PACK_RUN_CHAR(sz)  RLE3_PACK_SIZE(0x80, sz)
+#define RLE3_PACK_RUN_BLOCK(sz) RLE3_PACK_SIZE(0xC0, sz)
+
+#define RLE3_UNPACK_SIZE(ch) \
+ (((ch) & 0x20) && j < data_len ? ((((ch) & 0x1F) << 8) | data[j++]) + 1 : (ch & 0x1F) + 1)
+
+/**
+ * Pack a buffer with RLE3 compression, a run length encoding scheme designed
+ * to address some of the major flaws of Alexis' RLE2 without losing much speed.
+ * This is much faster than zlib DEFLATE and compresses board data fairly well.
+ *
+ * @param   data      buffer to output RLE3 stream to.
+ * @param   data_len  size of RLE3 buffer.
+ * @param   src       uncompressed source data.
+ * @param   src_len   length of uncompressed source.
+ * @return            final RLE3 stream length, or 0 on failure.
+ */
+size_t rle3_pack(uint8_t * RESTRICT data, size_t data_len,
+ const uint8_t *src, size_t src_len)
+{
+  ssize_t last_index[256];
+  uint8_t prev_chr = 0;
+  size_t i = 0;
+  size_t j = 0;
+
+  memset(last_index, 0xFF, sizeof(last_index));
+
+  while(i < src_len)
+  {
+    const uint8_t *block = src + i;
+    ssize_t block_start = i;
+    size_t block_len = 0;
+    size_t block_repeats = 0;
+    size_t block_repeat_len = 0;
+    size_t prev_repeats = 0;
+    boolean block_split = false;
+
+    while(i < src_len && block_len < RLE3_MAX_BLOCK)
+    {
+      if(src[i] == prev_chr)
+      {
+        // Is this a char run big enough to justify ending a block?
+        // A char run needs to be 3 or longer to break even in the worst case
+        // where the following block requires a 2 byte length (uncommon).
+        if(i + 2 < src_len &&
+         src[i + 1] == prev_chr &&
+         src[i + 2] == prev_chr)
+        {
+          prev_repeats = 3;
+          i += 3;
+          while(i < src_len && src[i] == prev_chr)
+            i++, prev_repeats++;
+
+          break;
+        }
+      }
+
+      // Is this the start of a block repeat?
+      if(last_index[src[i]] >= block_start && (size_t)last_index[src[i]] + 1 < i)
+      {
+        ssize_t block_break = last_index[src[i]];
+        size_t block_break_len = block_break - block_start;
+        const uint8_t *prev_pos = src + block_break;
+        const uint8_t *pos = src + i;
+        size_t k = i;
+        size_t x;
+        size_t savings;
+        size_t overhead;
+
+        block_repeat_len = i - block_break;
+
+        while(k < src_len)
+        {
+          for(x = 0; k + x < src_len && x < block_repeat_len; x++)
+            if(pos[x] != prev_pos[x])
+              break;
+
+          if(x < block_repeat_len)
+            break;
+
+          block_repeats++;
+          pos += block_repeat_len;
+          k += block_repeat_len;
+        }
+
+        savings = block_repeat_len * block_repeats;
+        /* Max overhead of following block + size of repeat code + overhead of
+         * splitting the current block (if applicable). */
+        overhead = 2 + RLE3_PACK_OVERHEAD(block_repeats) +
+         ((block_break_len) ? RLE3_PACK_OVERHEAD(block_break_len) : 0);
+
+        // Is this worth ending the block?
+        if(savings >= overhead)
+        {
+          if(block_break > block_start)
+          {
+            block_split = true;
+            block_len = block_break_len;
+          }
+          i += block_repeat_len * block_repeats;
+          break;
+        }
+        block_repeats = 0;
+      }
+
+      if(last_index[src[i]] < block_start)
+        last_index[src[i]] = i;
+
+      // Continue the block...
+      prev_chr = src[i++];
+      block_len++;
+    }
+
+    // Emit block(s) (never allow an individual block to go over RLE3_MAX_BLOCK).
+    while(block_len)
+    {
+      size_t pos_start = 0;
+      size_t pos_end = block_len;
+      boolean trim = false;
+
+      if(!block_repeats || block_split)
+      {
+        // If this block isn't required to be encoded as a single block it
+        // may be possible to replace part (or all) of it with literal chars,
+        // reducing the block length encoding overhead.
+        size_t old_overhead = RLE3_PACK_OVERHEAD(block_len);
+        size_t new_overhead;
+
+        while(pos_start < block_len && block[pos_start] <= RLE3_MAX_CHAR)
+          pos_start++;
+
+        if(pos_start < block_len)
+          while(pos_end > pos_start && block[pos_end - 1] <= RLE3_MAX_CHAR)
+            pos_end--;
+
+        new_overhead = pos_start < block_len ? RLE3_PACK_OVERHEAD(pos_end - pos_start) : 0;
+        if(new_overhead < old_overhead)
+          trim = true;
+      }
+
+      if(trim)
+      {
+        // Emit the head and tail of the block as literal chars.
+        size_t k = 0;
+        if(j + block_len > data_len)
+          return 0;
+
+        while(k < block_len && block[k] <= RLE3_MAX_CHAR)
+        {
+          RLE3_PACK_CHAR(block[k]);
+          k++;
+        }
+        if(pos_start < pos_end)
+        {
+          size_t middle_len = pos_end - pos_start;
+          RLE3_PACK_BLOCK(middle_len);
+          if(j + middle_len > data_len)
+            return 0;
+
+          memcpy(data + j, block + k, middle_len);
+          j += middle_len;
+          k += middle_len;
+        }
+
+        if(j + block_len > data_len)
+          return 0;
+
+        while(k < block_len)
+        {
+          RLE3_PACK_CHAR(block[k]);
+          k++;
+        }
+        //trace("--RLE3--     %s %zu\n", (pos_start < pos_end) ? "mixed" : "chars", block_len);
+      }
+      else
+      {
+        RLE3_PACK_BLOCK(block_len);
+        if(j + block_len > data_len)
+          return 0;
+
+        memcpy(data + j, block, block_len);
+        j += block_len;
+        //trace("--RLE3--     block %zu\n", block_len);
+      }
+
+      if(block_split)
+      {
+        block += block_len;
+        block_len = block_repeat_len;
+        block_split = false;
+      }
+      else
+        break;
+    }
+
+    // Emit block run.
+    while(block_repeats)
+    {
+      size_t pack_count = MIN(RLE3_MAX_BLOCK, block_repeats);
+      block_repeats -= pack_count;
+      RLE3_PACK_RUN_BLOCK(pack_count);
+      //trace("--RLE3--     repeat block x %zu\n", pack_count);
+    }
+
+    // Emit char run.
+    while(prev_repeats)
+    {
+      size_t pack_count = MIN(RLE3_MAX_BLOCK, prev_repeats);
+      prev_repeats -= pack_count;
+      RLE3_PACK_RUN_CHAR(pack_count);
+      //trace("--RLE3--     repeat %02Xh x %zu\n", (int)prev_chr, pack_count);
+    }
+  }
+  return j;
+}
+
+/**
+ * Unpack an RLE3 stream.
+ *
+ * @param   dest      destination buffer for the unpacked stream.
+ * @param   dest_len  size of destination buffer.
+ * @param   data      source RLE3 stream to unpack.
+ * @param   data_len  length of source RLE3 stream.
+ * @return            `true` on success, otherwise `false`. This function will
+ *                    fail if the unpacked stream size doesn't match `dest_len`.
+ */
+boolean rle3_unpack(uint8_t * RESTRICT dest, size_t dest_len,
+ const uint8_t *data, size_t data_len)
+{
+  const uint8_t *prev_block = NULL;
+  size_t prev_len = 0;
+  uint8_t prev_chr = 0;
+  size_t count;
+  size_t i = 0;
+  size_t j = 0;
+  uint8_t chr;
+
+  while(j < data_len)
+  {
+    if(i >= dest_len)
+      break;
+
+    chr = data[j++];
+    if(chr >> 6)
+      count = RLE3_UNPACK_SIZE(chr);
+
+    switch(chr >> 6)
+    {
+      case 0:
+      {
+        // Char. Usually there are several of these in a row.
+        dest[i++] = chr;
+        while(i < dest_len && j < data_len && data[j] <= RLE3_MAX_CHAR)
+          dest[i++] = data[j++];
+
+        prev_chr = data[j - 1];
+        prev_block = data + j - 1;
+        prev_len = 1;
+        break;
+      }
+
+      case 1:
+      {
+        // Block.
+        if(i + count > dest_len || j + count > data_len)
+          return false;
+
+        prev_block = data + j;
+        prev_len = count;
+
+        memcpy(dest + i, data + j, count);
+        i += count;
+        j += count;
+
+        prev_chr = data[j - 1];
+        break;
+      }
+
+      case 2:
+      {
+        // Repeat last char.
+        if(i + count > dest_len)
+          return false;
+
+        memset(dest + i, prev_chr, count);
+        i += count;
+        break;
+      }
+
+      case 3:
+      {
+        // Repeat last block.
+        if(!prev_block || i + count * prev_len > dest_len)
+          return false;
+
+        while(count--)
+        {
+          memcpy(dest + i, prev_block, prev_len);
+          i += prev_len;
+        }
+        break;
+      }
+    }
+  }
+  return (i == dest_len);
+}
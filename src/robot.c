@@ -3715,6 +3715,41 @@ void optimize_null_objects(struct board *src_board)
   free(sensor_id_translation_list);
 }
 
+/**
+ * Find the TELEPORT commands in a program that have a constant destination
+ * board and return their destination names. Each command is stored as
+ * [length][command][params][length]. Returns the number of names found.
+ */
+int get_program_teleports(const char *program, int program_length,
+ const char **names, int max_names)
+{
+  int num_names = 0;
+  int next;
+  int pos;
+
+  if(!program)
+    return 0;
+
+  for(pos = 1; pos < program_length - 3 && num_names < max_names; pos = next)
+  {
+    const char *name = program + pos + 3;
+
+    if(!program[pos])
+      break;
+
+    next = pos + (unsigned char)program[pos] + 2;
+    if(next > program_length)
+      break;
+
+    if(program[pos + 1] != ROBOTIC_CMD_TELEPORT ||
+     !memchr(name, '\0', next - pos - 3) || strchr(name, '&'))
+      continue;
+
+    names[num_names++] = name;
+  }
+  return num_names;
+}
+
 #ifndef CONFIG_DEBYTECODE
 /* Fix nonsense robot stack values, 2.x edition.
  * This should eventually be merged into translate_robot_bytecode_offsets
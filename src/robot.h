@@ -108,6 +108,8 @@ CORE_LIBSPEC void send_robot_all_def(struct world *mzx_world, const char *mesg);
 CORE_LIBSPEC void send_robot_def(struct world *mzx_world, int robot_id,
  enum builtin_label mesg_id);
 CORE_LIBSPEC void optimize_null_objects(struct board *src_board);
+CORE_LIBSPEC int get_program_teleports(const char *program,
+ int program_length, const char **names, int max_names);
 
 CORE_LIBSPEC int place_at_xy(struct world *mzx_world, enum thing id,
  int color, int param, int x, int y);
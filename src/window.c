@@ -3836,6 +3836,9 @@ skip_dir:
           snprintf(confirm_string, MAX_PATH,
            "Delete %s - are you sure?", ret_file);
 
+          // Robots may have left this file open.
+          fread_cache_clear();
+
           if(!confirm(mzx_world, confirm_string))
             if(vunlink(ret))
               error("File could not be deleted.",
@@ -3863,6 +3866,8 @@ skip_dir:
           path_join(old_path, MAX_PATH, current_dir_name, e->filename);
           path_join(new_path, MAX_PATH, current_dir_name, new_name);
 
+          fread_cache_clear();
+
           if(strcmp(old_path, new_path))
             if(vrename(old_path, new_path))
               error("File rename failed.",
@@ -3930,6 +3935,8 @@ skip_dir:
             path_join(old_path, MAX_PATH, current_dir_name, dir_list[chosen_dir]);
             path_join(new_path, MAX_PATH, current_dir_name, new_name);
 
+            fread_cache_clear();
+
             if(strcmp(old_path, new_path))
               if(vrename(old_path, new_path))
                 error("Directory rename failed.",
@@ -0,0 +1,150 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Runs batches of independent jobs (e.g. (de)compressing boards) on several
+ * threads. The calling thread takes part in the work and this function only
+ * returns once every job has finished, so callers don't need to deal with
+ * threads at all. Threads are created per batch; batches are only run for
+ * slow operations like loading and saving worlds, where this is negligible.
+ */
+
+#include "configure.h"
+#include "platform.h"
+#include "util.h"
+#include "workers.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif !defined(_MSC_VER)
+#include <unistd.h>
+#endif
+
+#define MAX_WORKER_THREADS 64
+
+#ifndef PLATFORM_NO_THREADING
+
+struct workers_data
+{
+  worker_job_fn job_fn;
+  void *priv;
+  size_t num_jobs;
+  size_t next_job;
+  platform_mutex lock;
+};
+
+static boolean workers_next_job(struct workers_data *data, size_t *job)
+{
+  boolean ret = false;
+
+  platform_mutex_lock(&(data->lock));
+  if(data->next_job < data->num_jobs)
+  {
+    *job = data->next_job++;
+    ret = true;
+  }
+  platform_mutex_unlock(&(data->lock));
+  return ret;
+}
+
+static void workers_run_jobs(struct workers_data *data)
+{
+  size_t job;
+
+  while(workers_next_job(data, &job))
+    data->job_fn(data->priv, job);
+}
+
+static THREAD_RES workers_thread(void *opaque)
+{
+  workers_run_jobs((struct workers_data *)opaque);
+  THREAD_RETURN;
+}
+
+#endif /* !PLATFORM_NO_THREADING */
+
+/**
+ * Get the number of threads (including the calling thread) that jobs will be
+ * run on. This is set by the config option `worker_threads`; if that is 0,
+ * the number of processors is used.
+ */
+unsigned int workers_get_count(void)
+{
+#ifdef PLATFORM_NO_THREADING
+  return 1;
+#else
+  struct config_info *conf = get_config();
+  long count = conf->worker_threads;
+
+  if(count <= 0)
+  {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    count = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  }
+
+  return CLAMP(count, 1, MAX_WORKER_THREADS);
+#endif
+}
+
+/**
+ * Run `num_jobs` jobs, each as `job_fn(priv, job)`, and wait for all of them
+ * to complete. If threads can't be created, the remaining work is done on the
+ * calling thread.
+ */
+void workers_run(worker_job_fn job_fn, void *priv, size_t num_jobs)
+{
+#ifndef PLATFORM_NO_THREADING
+  platform_thread threads[MAX_WORKER_THREADS - 1];
+  struct workers_data data;
+  size_t num_threads = MIN(workers_get_count(), num_jobs);
+  size_t i;
+
+  if(num_threads > 1)
+  {
+    data.job_fn = job_fn;
+    data.priv = priv;
+    data.num_jobs = num_jobs;
+    data.next_job = 0;
+    platform_mutex_init(&(data.lock));
+
+    for(i = 0; i < num_threads - 1; i++)
+      if(!platform_thread_create(&(threads[i]), workers_thread, &data))
+        break;
+
+    num_threads = i;
+    workers_run_jobs(&data);
+
+    for(i = 0; i < num_threads; i++)
+      platform_thread_join(&(threads[i]));
+
+    platform_mutex_destroy(&(data.lock));
+    return;
+  }
+#endif
+  {
+    size_t job;
+    for(job = 0; job < num_jobs; job++)
+      job_fn(priv, job);
+  }
+}
@@ -0,0 +1,43 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __WORKERS_H
+#define __WORKERS_H
+
+#include "compat.h"
+
+__M_BEGIN_DECLS
+
+#include <stddef.h>
+
+/**
+ * Function to run a single job. `job` is the index of the job, from 0 to
+ * the number of jobs minus one. Jobs may run in any order and in parallel,
+ * so they must not touch any state shared with other jobs or with the rest
+ * of MegaZeux (including the UI) without synchronization.
+ */
+typedef void (*worker_job_fn)(void *priv, size_t job);
+
+CORE_LIBSPEC unsigned int workers_get_count(void);
+CORE_LIBSPEC void workers_run(worker_job_fn job_fn, void *priv,
+ size_t num_jobs);
+
+__M_END_DECLS
+
+#endif /* __WORKERS_H */
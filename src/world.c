@@ -43,14 +43,18 @@
 #include "error.h"
 #include "event.h"
 #include "extmem.h"
+#include "game.h"
 #include "game_player.h"
 #include "graphics.h"
 #include "idput.h"
+#include "mzm.h"
+#include "platform.h"
 #include "robot.h"
 #include "sprite.h"
 #include "str.h"
 #include "util.h"
 #include "window.h"
+#include "workers.h"
 #include "io/fsafeopen.h"
 #include "io/memfile.h"
 #include "io/path.h"
@@ -62,8 +66,6 @@
 
 #ifdef CONFIG_LOADSAVE_METER
 
-#include "platform.h"
-
 static uint32_t last_ticks;
 
 void meter_update_screen(int *curr, int target)
@@ -103,6 +105,13 @@ static inline void meter_initial_draw(int curr, int target, const char *title) {
 
 #endif //CONFIG_LOADSAVE_METER
 
+#ifndef PLATFORM_NO_THREADING
+#define SAVE_WORLD_ASYNC
+
+// Initial size of the memory archive for background saves.
+#define SAVE_WORLD_MEM_INITIAL_SIZE (1 << 16)
+#endif
+
 
 int world_magic(const char magic_string[3])
 {
@@ -2092,7 +2101,6 @@ err_close_file:
 static enum val_result validate_world_zip(struct world *mzx_world,
  struct zip_archive *zp, boolean savegame, int *file_version)
 {
-  unsigned int file_id;
   int result;
 
   int has_world = 0;
@@ -2104,61 +2112,26 @@ static enum val_result validate_world_zip(struct world *mzx_world,
   // The directory has already been read by this point.
   world_assign_file_ids(zp, true);
 
-  // Step through the directory and make sure the mandatory files exist.
-  while(ZIP_SUCCESS == zip_get_next_mzx_file_id(zp, &file_id, NULL, NULL))
+  // Look up the files that must exist. Everything needs world info, no
+  // negotiations. Charsets and palettes are the bare minimum of what counts
+  // as a world, and counters and strings the bare minimum of a save. The
+  // other files can be replaced with defaults if missing.
+  if(!zip_seek_to_mzx_file(zp, FILE_ID_WORLD_INFO, 0, 0))
   {
-    // Can we stop early?
-    if((!savegame && has_pal) || has_string)
-      break;
-
-    switch(file_id)
-    {
-      // Everything needs this, no negotiations.
-      case FILE_ID_WORLD_INFO:
-        result = validate_world_info(mzx_world, zp, savegame, file_version);
-        if(result != VAL_SUCCESS)
-          return result;
-        // Continue so it doesn't skip the file.
-        has_world = 1;
-        continue;
-
-      // These are pretty much the bare minimum of what counts as a world
-      case FILE_ID_WORLD_CHARS:
-        has_chars = 1;
-        break;
-
-      case FILE_ID_WORLD_PAL:
-        has_pal = 1;
-        break;
-
-      // These are pretty much the bare minimum of what counts as a save
-      case FILE_ID_WORLD_COUNTERS:
-        has_counter = 1;
-        break;
+    result = validate_world_info(mzx_world, zp, savegame, file_version);
+    if(result != VAL_SUCCESS)
+      return result;
 
-      case FILE_ID_WORLD_STRINGS:
-        has_string = 1;
-        break;
-
-      // These should exist, but can be replaced with defaults if missing.
-      case FILE_ID_WORLD_GLOBAL_ROBOT:
-      case FILE_ID_WORLD_PAL_INDEX:
-      case FILE_ID_WORLD_PAL_INTENSITY:
-      case FILE_ID_WORLD_PAL_INTENSITY_SMZX:
-      case FILE_ID_WORLD_VCO:
-      case FILE_ID_WORLD_VCH:
-      case FILE_ID_WORLD_SPRITES:
-        break;
+    has_world = 1;
+  }
 
-      // Completely optional.
-      case FILE_ID_WORLD_SFX:
-        break;
+  has_chars = !zip_seek_to_mzx_file(zp, FILE_ID_WORLD_CHARS, 0, 0);
+  has_pal = !zip_seek_to_mzx_file(zp, FILE_ID_WORLD_PAL, 0, 0);
 
-      // Everything else: who knows
-      default:
-        break;
-    }
-    zip_skip_file(zp);
+  if(savegame)
+  {
+    has_counter = !zip_seek_to_mzx_file(zp, FILE_ID_WORLD_COUNTERS, 0, 0);
+    has_string = !zip_seek_to_mzx_file(zp, FILE_ID_WORLD_STRINGS, 0, 0);
   }
 
   if(!(has_world && has_pal && has_chars))
@@ -2181,24 +2154,239 @@ err_out:
 }
 
 
-static int save_world_zip(struct world *mzx_world, const char *file,
- boolean savegame, int file_version)
+/**
+ * Incremental savegames copy the files of boards that haven't been modified
+ * since the previous savegame snapshot without recompressing them. Returns
+ * true if the board can be copied, in which case the snapshot is positioned
+ * at the board's first file.
+ */
+static boolean save_board_find_unmodified(struct world *mzx_world,
+ struct zip_archive *prev, struct board *cur_board, int board_id)
 {
-  vfile *vf;
-  struct zip_archive *zp = NULL;
-  struct board *cur_board;
-  int i;
+  if(!prev || !cur_board || cur_board->modified ||
+   cur_board == mzx_world->current_board || board_id == TEMPORARY_BOARD)
+    return false;
 
-  int meter_curr = 0;
-  int meter_target = 2 + mzx_world->num_boards + mzx_world->temporary_board;
+  return zip_seek_to_mzx_file(prev, FILE_ID_BOARD_INFO, board_id, 0) ==
+   ZIP_SUCCESS;
+}
 
-  meter_initial_draw(meter_curr, meter_target, "Saving...");
+static int save_board_copy(struct zip_archive *zp, struct zip_archive *prev,
+ int board_id)
+{
+  do
+  {
+    if(zip_write_copy_file(zp, prev))
+      return -1;
+  }
+  while(prev->pos < prev->num_files &&
+   prev->files[prev->pos]->mzx_board_id == (unsigned int)board_id);
 
-  vf = vfopen_unsafe_ext(file, "wb", V_LARGE_BUFFER);
-  if(!vf)
-    goto err;
+  return 0;
+}
+
+/**
+ * Like loading, saving a world spends most of its time compressing boards.
+ * Batches of boards are serialized and compressed into separate memory
+ * archives on the worker threads, and their files are then copied into the
+ * world in order without being recompressed. Boards are retrieved from and
+ * stored to extram on the main thread.
+ */
+struct board_save_job
+{
+  struct board *board;
+  struct zip_archive *zp;
+  void *buffer;
+  size_t buffer_size;
+  int board_id;
+  boolean copy;
+  boolean ok;
+};
+
+struct board_save_batch
+{
+  struct world *mzx_world;
+  struct board_save_job *jobs;
+  int savegame;
+  int file_version;
+};
+
+static void save_board_deflate_job(void *priv, size_t job)
+{
+  struct board_save_batch *batch = (struct board_save_batch *)priv;
+  struct board_save_job *j = &(batch->jobs[job]);
+  uint64_t final_length;
+
+  if(!j->zp)
+    return;
+
+  if(save_board(batch->mzx_world, j->board, j->zp, batch->savegame,
+   batch->file_version, j->board_id))
+  {
+    zip_close(j->zp, NULL);
+  }
+  else
+
+  if(zip_close(j->zp, &final_length) == ZIP_SUCCESS)
+  {
+    j->buffer_size = final_length;
+    j->ok = true;
+  }
+  j->zp = NULL;
+}
+
+/**
+ * Prepare a board to be saved by a worker. This opens the archive the board
+ * will be saved to, since opening a write archive isn't thread-safe.
+ */
+static void save_board_deflate_init(struct world *mzx_world,
+ struct board_save_job *j, int savegame, int file_version)
+{
+  struct board *cur_board = j->board;
+
+  if(cur_board != mzx_world->current_board)
+    retrieve_board_from_extram(cur_board);
+
+#ifdef CONFIG_DEBYTECODE
+  if(savegame)
+  {
+    int i;
+    for(i = 1; i <= cur_board->num_robots; i++)
+      if(cur_board->robot_list[i] && cur_board->robot_list[i]->used)
+        prepare_robot_bytecode(mzx_world, cur_board->robot_list[i]);
+  }
+#endif
+
+  // This is expanded as needed.
+  j->buffer_size = cur_board->board_width * cur_board->board_height + 4096;
+  j->buffer = malloc(j->buffer_size);
+  if(!j->buffer)
+    return;
+
+  j->zp = zip_open_mem_write_ext(&(j->buffer), &(j->buffer_size), 0);
+  if(j->zp && file_version < V293)
+    zip_set_zip64_enabled(j->zp, false);
+}
+
+static int save_world_boards(struct world *mzx_world, struct zip_archive *zp,
+ struct zip_archive *prev, int savegame, int file_version, int *meter_curr,
+ int meter_target)
+{
+  struct board_save_batch batch;
+  struct board_save_job *jobs;
+  unsigned int max_jobs = workers_get_count() * 4;
+  unsigned int num_jobs;
+  unsigned int i;
+  int num_boards = mzx_world->num_boards + !!mzx_world->temporary_board;
+  int next = 0;
+  int ret = 0;
+
+  jobs = (struct board_save_job *)cmalloc(max_jobs *
+   sizeof(struct board_save_job));
+
+  batch.mzx_world = mzx_world;
+  batch.jobs = jobs;
+  batch.savegame = savegame;
+  batch.file_version = file_version;
+
+  while(next < num_boards && !ret)
+  {
+    for(num_jobs = 0; num_jobs < max_jobs && next < num_boards; next++)
+    {
+      struct board_save_job *j = &(jobs[num_jobs++]);
+
+      memset(j, 0, sizeof(struct board_save_job));
+      if(next < mzx_world->num_boards)
+      {
+        j->board = mzx_world->board_list[next];
+        j->board_id = next;
+      }
+      else
+      {
+        j->board = mzx_world->current_board;
+        j->board_id = TEMPORARY_BOARD;
+      }
+
+      if(save_board_find_unmodified(mzx_world, prev, j->board, j->board_id))
+        j->copy = true;
+      else
+
+      if(j->board)
+        save_board_deflate_init(mzx_world, j, savegame, file_version);
+    }
+
+    workers_run(save_board_deflate_job, &batch, num_jobs);
+
+    for(i = 0; i < num_jobs; i++)
+    {
+      struct board_save_job *j = &(jobs[i]);
+      struct zip_archive *bzp = NULL;
+
+      if(j->copy)
+      {
+        if(!ret && (!save_board_find_unmodified(mzx_world, prev, j->board,
+         j->board_id) || save_board_copy(zp, prev, j->board_id)))
+          ret = -1;
+      }
+      else
+
+      if(j->board)
+      {
+        if(j->ok)
+          bzp = zip_open_mem_read(j->buffer, j->buffer_size);
+
+        if(bzp)
+        {
+          while(!ret && bzp->pos < bzp->num_files)
+            if(zip_write_copy_file(zp, bzp))
+              ret = -1;
+
+          zip_close(bzp, NULL);
+        }
+        else
+
+        // Fall back to saving the board directly, which will also report any
+        // errors the worker encountered.
+        if(!ret && save_board(mzx_world, j->board, zp, savegame, file_version,
+         j->board_id))
+          ret = -1;
 
-  // Header
+        if(j->board != mzx_world->current_board)
+          store_board_to_extram(j->board);
+
+        free(j->buffer);
+      }
+      meter_update_screen(meter_curr, meter_target);
+    }
+  }
+
+  free(jobs);
+  return ret;
+}
+
+/**
+ * Deferred boards are still read from the original world file, which may
+ * be the file that is about to be overwritten. Load them all first.
+ */
+static void save_world_load_deferred(struct world *mzx_world)
+{
+  struct board *cur_board;
+  int i;
+
+  for(i = 0; i < mzx_world->num_boards; i++)
+  {
+    cur_board = mzx_world->board_list[i];
+    if(cur_board && cur_board->deferred)
+    {
+      retrieve_board_from_extram(cur_board);
+      store_board_to_extram(cur_board);
+    }
+  }
+}
+
+static int save_world_header(struct world *mzx_world, vfile *vf,
+ boolean savegame, int file_version)
+{
   if(!savegame)
   {
     // World name
@@ -2208,7 +2396,7 @@ static int save_world_zip(struct world *mzx_world, const char *file,
     snprintf(name, BOARD_NAME_SIZE, "%s", mzx_world->name);
 
     if(!vfwrite(name, BOARD_NAME_SIZE, 1, vf))
-      goto err_close;
+      return -1;
 
     // Protection method -- always zero
     vfputc(0, vf);
@@ -2222,7 +2410,7 @@ static int save_world_zip(struct world *mzx_world, const char *file,
   {
     // Version string
     if(!vfwrite("MZS", 3, 1, vf))
-      goto err_close;
+      return -1;
 
     vfputc((file_version >> 8) & 0xFF, vf);
     vfputc(file_version & 0xFF, vf);
@@ -2233,69 +2421,120 @@ static int save_world_zip(struct world *mzx_world, const char *file,
     // Current board ID
     vfputc(mzx_world->current_board_id, vf);
   }
+  return 0;
+}
 
-  zp = zip_open_vf_write(vf);
-  if(!zp)
-    goto err_close;
+static int save_world_contents(struct world *mzx_world, struct zip_archive *zp,
+ struct zip_archive *prev, boolean savegame, int file_version,
+ int *meter_curr, int meter_target)
+{
+  struct board *cur_board;
+  int i;
 
   // Zip64 support was added in 2.93.
   if(file_version < V293)
     zip_set_zip64_enabled(zp, false);
 
   if(save_world_info(mzx_world, zp, savegame, file_version, "world"))
-    goto err_close;
+    return -1;
 
   if(save_world_global_robot(mzx_world, zp, savegame, file_version, "gr"))
-    goto err_close;
+    return -1;
 
-  if(save_world_sfx(mzx_world, zp, file_version,"sfx"))     goto err_close;
-  if(save_world_chars(mzx_world, zp, savegame,  "chars"))   goto err_close;
-  if(save_world_pal(mzx_world, zp, file_version,"pal"))     goto err_close;
-  if(save_world_pal_smzx(mzx_world, zp,         "palsmzx")) goto err_close;
-  if(save_world_pal_index(mzx_world, zp,        "palidx"))  goto err_close;
-  if(save_world_vco(mzx_world, zp,              "vco"))     goto err_close;
-  if(save_world_vch(mzx_world, zp,              "vch"))     goto err_close;
+  if(save_world_sfx(mzx_world, zp, file_version,"sfx"))     return -1;
+  if(save_world_chars(mzx_world, zp, savegame,  "chars"))   return -1;
+  if(save_world_pal(mzx_world, zp, file_version,"pal"))     return -1;
+  if(save_world_pal_smzx(mzx_world, zp,         "palsmzx")) return -1;
+  if(save_world_pal_index(mzx_world, zp,        "palidx"))  return -1;
+  if(save_world_vco(mzx_world, zp,              "vco"))     return -1;
+  if(save_world_vch(mzx_world, zp,              "vch"))     return -1;
 
   if(savegame)
   {
-    if(save_world_pal_inten(mzx_world, zp, file_version, "palint"))   goto err_close;
-    if(save_world_pal_inten_smzx(mzx_world, zp,"palints"))  goto err_close;
-    if(save_world_sprites(mzx_world, zp,       "spr"))      goto err_close;
-    if(save_world_counters(mzx_world, zp,      "counter"))  goto err_close;
-    if(save_world_strings(mzx_world, zp,       "string"))   goto err_close;
+    if(save_world_pal_inten(mzx_world, zp, file_version, "palint"))   return -1;
+    if(save_world_pal_inten_smzx(mzx_world, zp,"palints"))  return -1;
+    if(save_world_sprites(mzx_world, zp,       "spr"))      return -1;
+    if(save_world_counters(mzx_world, zp,      "counter"))  return -1;
+    if(save_world_strings(mzx_world, zp,       "string"))   return -1;
   }
 
-  meter_update_screen(&meter_curr, meter_target);
+  meter_update_screen(meter_curr, meter_target);
 
-  for(i = 0; i < mzx_world->num_boards; i++)
+  if(workers_get_count() > 1)
   {
-    cur_board = mzx_world->board_list[i];
-
-    if(cur_board)
+    if(save_world_boards(mzx_world, zp, prev, savegame, file_version,
+     meter_curr, meter_target))
+      return -1;
+  }
+  else
+  {
+    for(i = 0; i < mzx_world->num_boards; i++)
     {
-      if(cur_board != mzx_world->current_board)
-        retrieve_board_from_extram(cur_board);
+      cur_board = mzx_world->board_list[i];
+
+      if(save_board_find_unmodified(mzx_world, prev, cur_board, i))
+      {
+        if(save_board_copy(zp, prev, i))
+          return -1;
+      }
+      else
+
+      if(cur_board)
+      {
+        if(cur_board != mzx_world->current_board)
+          retrieve_board_from_extram(cur_board);
 
-      if(save_board(mzx_world, cur_board, zp, savegame, file_version, i))
-        goto err_close;
+        if(save_board(mzx_world, cur_board, zp, savegame, file_version, i))
+          return -1;
 
-      if(cur_board != mzx_world->current_board)
-        store_board_to_extram(cur_board);
+        if(cur_board != mzx_world->current_board)
+          store_board_to_extram(cur_board);
+      }
+
+      meter_update_screen(meter_curr, meter_target);
     }
 
-    meter_update_screen(&meter_curr, meter_target);
+    if(mzx_world->temporary_board)
+    {
+      if(save_board(mzx_world, mzx_world->current_board, zp, savegame,
+       file_version, TEMPORARY_BOARD))
+        return -1;
+
+      meter_update_screen(meter_curr, meter_target);
+    }
   }
 
-  if(mzx_world->temporary_board)
-  {
-    if(save_board(mzx_world, mzx_world->current_board, zp, savegame,
-     file_version, TEMPORARY_BOARD))
-      goto err_close;
+  meter_update_screen(meter_curr, meter_target);
+  return 0;
+}
 
-    meter_update_screen(&meter_curr, meter_target);
-  }
+static int save_world_zip(struct world *mzx_world, const char *file,
+ boolean savegame, int file_version)
+{
+  vfile *vf;
+  struct zip_archive *zp = NULL;
 
-  meter_update_screen(&meter_curr, meter_target);
+  int meter_curr = 0;
+  int meter_target = 2 + mzx_world->num_boards + mzx_world->temporary_board;
+
+  meter_initial_draw(meter_curr, meter_target, "Saving...");
+
+  save_world_load_deferred(mzx_world);
+
+  vf = vfopen_unsafe_ext(file, "wb", V_LARGE_BUFFER);
+  if(!vf)
+    goto err;
+
+  if(save_world_header(mzx_world, vf, savegame, file_version))
+    goto err_close;
+
+  zp = zip_open_vf_write(vf);
+  if(!zp)
+    goto err_close;
+
+  if(save_world_contents(mzx_world, zp, NULL, savegame, file_version,
+   &meter_curr, meter_target))
+    goto err_close;
 
   meter_restore_screen();
 
@@ -2314,47 +2553,334 @@ err:
   return -1;
 }
 
-#undef if_savegame
-#undef if_savegame_or_291
-
-#define if_savegame         if(!savegame) { zip_skip_file(zp); break; }
-#define if_savegame_or_291  if(!savegame && mzx_world->version < V291) \
-                             { zip_skip_file(zp); break; }
+#ifdef SAVE_WORLD_ASYNC
 
-static int load_world_zip(struct world *mzx_world, struct zip_archive *zp,
- boolean savegame, int file_version, boolean *faded)
+/**
+ * Save the current version savegame to a memory archive. Unmodified boards
+ * are copied from the previous snapshot if it is provided. The caller is
+ * responsible for freeing the buffer.
+ */
+static int save_world_zip_mem(struct world *mzx_world, struct zip_archive *prev,
+ void **_buffer, size_t *_length)
 {
-  unsigned int file_id;
-  unsigned int board_id;
-  enum zip_error err;
-
-  int loaded_global_robot = 0;
+  struct zip_archive *zp;
+  size_t buffer_size = SAVE_WORLD_MEM_INITIAL_SIZE;
+  size_t header_length;
+  uint64_t length;
+  void *buffer;
+  vfile *vf;
 
   int meter_curr = 0;
-  int meter_target = 2;
-  boolean loaded_temp_board = false;
-
-  meter_initial_draw(meter_curr, meter_target, "Loading...");
+  int meter_target = 2 + mzx_world->num_boards + mzx_world->temporary_board;
 
-  // The directory has already been read by this point, and we're at the start.
+  meter_initial_draw(meter_curr, meter_target, "Saving...");
 
-  while(ZIP_SUCCESS == zip_get_next_mzx_file_id(zp, &file_id, &board_id, NULL))
-  {
-    err = ZIP_SUCCESS;
+  save_world_load_deferred(mzx_world);
 
-    switch(file_id)
-    {
-      case FILE_ID_NONE:
-      default:
-        zip_skip_file(zp);
-        break;
+  buffer = malloc(buffer_size);
+  if(!buffer)
+    goto err;
 
-      case FILE_ID_WORLD_INFO:
-      {
-        load_world_info(mzx_world, zp, savegame, &file_version, faded);
+  vf = vfile_init_mem(buffer, buffer_size, "wb");
+  if(!vf)
+    goto err_free;
 
-        mzx_world->num_boards_allocated = mzx_world->num_boards;
-        mzx_world->board_list =
+  if(save_world_header(mzx_world, vf, true, MZX_VERSION))
+  {
+    vfclose(vf);
+    goto err_free;
+  }
+  header_length = vftell(vf);
+  vfclose(vf);
+
+  zp = zip_open_mem_write_ext(&buffer, &buffer_size, header_length);
+  if(!zp)
+    goto err_free;
+
+  if(save_world_contents(mzx_world, zp, prev, true, MZX_VERSION,
+   &meter_curr, meter_target))
+  {
+    zip_close(zp, NULL);
+    goto err_free;
+  }
+
+  if(zip_close(zp, &length))
+    goto err_free;
+
+  meter_restore_screen();
+
+  *_buffer = buffer;
+  *_length = length;
+  return 0;
+
+err_free:
+  free(buffer);
+
+err:
+  error_message(E_WORLD_IO_SAVING, 0, NULL);
+  meter_restore_screen();
+  return -1;
+}
+
+#endif /* SAVE_WORLD_ASYNC */
+
+#undef if_savegame
+#undef if_savegame_or_291
+
+#define if_savegame         if(!savegame) { zip_skip_file(zp); break; }
+#define if_savegame_or_291  if(!savegame && mzx_world->version < V291) \
+                             { zip_skip_file(zp); break; }
+
+/**
+ * Boards are the bulk of a world file, so their files are inflated on the
+ * worker threads before they are parsed. Each job gets a raw subset of the
+ * world archive containing one board and its robots and rebuilds it as an
+ * uncompressed archive in memory. Parsing the boards can report errors and
+ * modifies the world, so it is still done on the main thread in the original
+ * order. Boards are handled in batches to limit the extra memory required.
+ */
+struct board_load_job
+{
+  struct zip_archive *src;
+  struct zip_archive *dest;
+  void *buffer;
+  size_t buffer_size;
+  size_t pos;
+  unsigned int board_id;
+  boolean ok;
+};
+
+static void load_board_inflate_job(void *priv, size_t job)
+{
+  struct board_load_job *j = ((struct board_load_job *)priv) + job;
+  struct zip_archive *src = j->src;
+  struct zip_archive *dest = j->dest;
+  uint64_t final_length;
+  char name[MAX_PATH];
+  void *data = NULL;
+  size_t data_alloc = 0;
+  size_t size;
+
+  // Boards that couldn't get a subset are loaded from the world instead.
+  if(!dest)
+    return;
+
+  while(zip_get_next_name(src, name, MAX_PATH) == ZIP_SUCCESS)
+  {
+    if(zip_get_next_uncompressed_size(src, &size))
+      goto err;
+
+    if(size > data_alloc)
+    {
+      void *tmp = realloc(data, size);
+      if(!tmp)
+        goto err;
+
+      data = tmp;
+      data_alloc = size;
+    }
+
+    if(zip_read_file(src, data, size, &size))
+      goto err;
+
+    if(zip_write_file(dest, name, data, size, ZIP_M_NONE))
+      goto err;
+  }
+
+  if(zip_close(dest, &final_length) == ZIP_SUCCESS)
+  {
+    j->buffer_size = final_length;
+    j->ok = true;
+  }
+  dest = NULL;
+
+err:
+  if(dest)
+    zip_close(dest, NULL);
+
+  zip_close(src, NULL);
+  j->dest = NULL;
+  j->src = NULL;
+  free(data);
+}
+
+/**
+ * Open the archive a board's files will be inflated into. This is done before
+ * starting the workers since opening a write archive isn't thread-safe.
+ */
+static void load_board_inflate_init(struct board_load_job *j)
+{
+  struct zip_archive *src = j->src;
+  uint64_t total = 0;
+  int max_name = 0;
+  size_t i;
+
+  for(i = 0; i < src->num_files; i++)
+  {
+    total += src->files[i]->uncompressed_size;
+    max_name = MAX(max_name, src->files[i]->file_name_length);
+  }
+
+  if(max_name >= MAX_PATH || total > SIZE_MAX / 2)
+    return;
+
+  j->buffer_size = total +
+   zip_bound_total_header_usage(src->num_files, max_name);
+  j->buffer = malloc(j->buffer_size);
+  if(!j->buffer)
+    return;
+
+  j->dest = zip_open_mem_write_ext(&(j->buffer), &(j->buffer_size), 0);
+}
+
+static void load_world_boards(struct world *mzx_world, struct zip_archive *zp,
+ boolean savegame, int file_version, int *meter_curr, int meter_target,
+ boolean *loaded_temp_board)
+{
+  struct board_load_job *jobs;
+  unsigned int max_jobs = workers_get_count() * 4;
+  unsigned int num_jobs;
+  unsigned int file_id;
+  unsigned int board_id;
+  unsigned int i;
+  size_t end_pos;
+
+  jobs = (struct board_load_job *)cmalloc(max_jobs *
+   sizeof(struct board_load_job));
+
+  do
+  {
+    num_jobs = 0;
+
+    while(num_jobs < max_jobs &&
+     zip_get_next_mzx_file_id(zp, &file_id, &board_id, NULL) == ZIP_SUCCESS &&
+     file_id == FILE_ID_BOARD_INFO)
+    {
+      struct board_load_job *j = &(jobs[num_jobs]);
+      size_t count = 1;
+
+      // Leave boards that won't be loaded to the main loop.
+      if((int)board_id >= mzx_world->num_boards &&
+       !(mzx_world->temporary_board && board_id == TEMPORARY_BOARD))
+        break;
+
+      while(zp->pos + count < zp->num_files &&
+       zp->files[zp->pos + count]->mzx_board_id == board_id)
+        count++;
+
+      memset(j, 0, sizeof(struct board_load_job));
+      j->pos = zp->pos;
+      j->board_id = board_id;
+      j->src = zip_open_subset_read(zp, count);
+      if(j->src)
+      {
+        load_board_inflate_init(j);
+        if(!j->dest)
+        {
+          zip_close(j->src, NULL);
+          j->src = NULL;
+        }
+      }
+      else
+        zp->pos += count;
+
+      num_jobs++;
+    }
+    end_pos = zp->pos;
+
+    workers_run(load_board_inflate_job, jobs, num_jobs);
+
+    for(i = 0; i < num_jobs; i++)
+    {
+      struct board_load_job *j = &(jobs[i]);
+      struct zip_archive *bzp = NULL;
+      struct board *cur_board;
+
+      if(j->ok)
+        bzp = zip_open_mem_read(j->buffer, j->buffer_size);
+
+      if(bzp)
+      {
+        world_assign_file_ids(bzp, true);
+        cur_board = load_board_allocate(mzx_world, bzp, savegame, file_version,
+         j->board_id);
+        zip_close(bzp, NULL);
+      }
+      else
+      {
+        // Fall back to loading from the world archive, which will also report
+        // any errors in the board data.
+        zp->pos = j->pos;
+        cur_board = load_board_allocate(mzx_world, zp, savegame, file_version,
+         j->board_id);
+      }
+      free(j->buffer);
+
+      if((int)j->board_id < mzx_world->num_boards)
+      {
+        mzx_world->board_list[j->board_id] = cur_board;
+        store_board_to_extram(cur_board);
+      }
+      else
+      {
+        mzx_world->current_board = cur_board;
+        *loaded_temp_board = true;
+      }
+      meter_update_screen(meter_curr, meter_target);
+    }
+    zp->pos = end_pos;
+  }
+  while(num_jobs == max_jobs);
+
+  free(jobs);
+}
+
+/**
+ * The editor always needs every board, so only defer them in gameplay. When
+ * boards are deferred, the world archive stays open until the world is closed.
+ */
+static boolean load_boards_lazily(struct world *mzx_world)
+{
+  return get_config()->lazy_board_loading && !mzx_world->editing;
+}
+
+static int load_world_zip(struct world *mzx_world, struct zip_archive *zp,
+ boolean savegame, int file_version, boolean *faded)
+{
+  unsigned int file_id;
+  unsigned int board_id;
+  enum zip_error err;
+
+  int loaded_global_robot = 0;
+
+  int meter_curr = 0;
+  int meter_target = 2;
+  boolean loaded_temp_board = false;
+
+  struct board_archive *ar = NULL;
+  boolean lazy_boards = load_boards_lazily(mzx_world);
+
+  meter_initial_draw(meter_curr, meter_target, "Loading...");
+
+  // The directory has already been read by this point, and we're at the start.
+
+  while(ZIP_SUCCESS == zip_get_next_mzx_file_id(zp, &file_id, &board_id, NULL))
+  {
+    err = ZIP_SUCCESS;
+
+    switch(file_id)
+    {
+      case FILE_ID_NONE:
+      default:
+        zip_skip_file(zp);
+        break;
+
+      case FILE_ID_WORLD_INFO:
+      {
+        load_world_info(mzx_world, zp, savegame, &file_version, faded);
+
+        mzx_world->num_boards_allocated = mzx_world->num_boards;
+        mzx_world->board_list =
          ccalloc(mzx_world->num_boards, sizeof(struct board *));
 
         meter_target += mzx_world->num_boards + mzx_world->temporary_board;
@@ -2426,6 +2952,26 @@ static int load_world_zip(struct world *mzx_world, struct zip_archive *zp,
       // Defer to the board loader.
       case FILE_ID_BOARD_INFO:
       {
+        if(lazy_boards && (int)board_id < mzx_world->num_boards)
+        {
+          if(!ar)
+            ar = board_archive_open(mzx_world, zp, savegame, file_version);
+
+          mzx_world->board_list[board_id] = load_board_deferred(ar, board_id);
+
+          store_board_to_extram(mzx_world->board_list[board_id]);
+          meter_update_screen(&meter_curr, meter_target);
+        }
+        else
+
+        if(workers_get_count() > 1 && ((int)board_id < mzx_world->num_boards ||
+         (mzx_world->temporary_board && board_id == TEMPORARY_BOARD)))
+        {
+          load_world_boards(mzx_world, zp, savegame, file_version,
+           &meter_curr, meter_target, &loaded_temp_board);
+        }
+        else
+
         if((int)board_id < mzx_world->num_boards)
         {
           mzx_world->board_list[board_id] =
@@ -2506,7 +3052,10 @@ static int load_world_zip(struct world *mzx_world, struct zip_archive *zp,
 
   meter_restore_screen();
 
-  zip_close(zp, NULL);
+  if(ar)
+    board_archive_release(ar);
+  else
+    zip_close(zp, NULL);
   return 0;
 }
 
@@ -2515,6 +3064,46 @@ static int load_world_zip(struct world *mzx_world, struct zip_archive *zp,
 static void v1_store_globals_to_board(struct world *mzx_world);
 static void v1_load_globals_from_board(struct world *mzx_world);
 
+/**
+ * Store state that isn't otherwise kept in the world struct so it can be
+ * saved.
+ */
+static void save_world_prepare(struct world *mzx_world)
+{
+  // Prepare input pos
+  if(!mzx_world->input_is_dir && mzx_world->input_file)
+  {
+    mzx_world->temp_input_pos = vftell(mzx_world->input_file);
+  }
+  else
+
+  if(mzx_world->input_is_dir)
+  {
+    mzx_world->temp_input_pos = vdir_tell(mzx_world->input_directory);
+  }
+  else
+  {
+    mzx_world->temp_input_pos = 0;
+  }
+
+  // Closed FREAD handles might be holding the file being replaced open,
+  // which would make the final rename or unlink fail on some platforms.
+  fread_cache_clear();
+
+  // Prepare output pos
+  if(mzx_world->output_file)
+  {
+    mzx_world->temp_output_pos = vftell(mzx_world->output_file);
+  }
+  else
+  {
+    mzx_world->temp_output_pos = 0;
+  }
+
+  // Synchronize global variables in the current board.
+  v1_store_globals_to_board(mzx_world);
+}
+
 int save_world(struct world *mzx_world, const char *file, boolean savegame,
  int file_version)
 {
@@ -2555,34 +3144,7 @@ int save_world(struct world *mzx_world, const char *file, boolean savegame,
   }
 #endif /* CONFIG_DEBYTECODE */
 
-  // Prepare input pos
-  if(!mzx_world->input_is_dir && mzx_world->input_file)
-  {
-    mzx_world->temp_input_pos = vftell(mzx_world->input_file);
-  }
-  else
-
-  if(mzx_world->input_is_dir)
-  {
-    mzx_world->temp_input_pos = vdir_tell(mzx_world->input_directory);
-  }
-  else
-  {
-    mzx_world->temp_input_pos = 0;
-  }
-
-  // Prepare output pos
-  if(mzx_world->output_file)
-  {
-    mzx_world->temp_output_pos = vftell(mzx_world->output_file);
-  }
-  else
-  {
-    mzx_world->temp_output_pos = 0;
-  }
-
-  // Synchronize global variables in the current board.
-  v1_store_globals_to_board(mzx_world);
+  save_world_prepare(mzx_world);
 
   // Supported file format versions are the current version (typical world or
   // save files) and the previous version (downver export from the editor).
@@ -2613,6 +3175,284 @@ int save_world(struct world *mzx_world, const char *file, boolean savegame,
   }
 }
 
+#ifdef SAVE_WORLD_ASYNC
+
+/**
+ * Savegames made during gameplay are built in memory on the main thread and
+ * written to disk on a separate thread, so slow storage doesn't pause the
+ * game. The savegame is written to a temporary file which then replaces the
+ * destination, so the destination is never left partially written. Only one
+ * savegame is written at a time.
+ */
+struct save_writer
+{
+  platform_thread thread;
+  platform_mutex lock;
+  char path[MAX_PATH];
+  char tmp_path[MAX_PATH];
+  void *buffer;
+  size_t length;
+  boolean active;
+  boolean finished;
+  boolean failed;
+};
+
+/**
+ * The most recent savegame is kept in memory so the next savegame only needs
+ * to serialize the boards that have been modified since (incremental saves).
+ */
+struct save_snapshot
+{
+  void *buffer;
+  size_t length;
+  int num_boards;
+};
+
+static struct save_writer save_writer;
+static struct save_snapshot save_snapshot;
+
+static boolean save_world_write_file(struct save_writer *w)
+{
+  boolean ret = false;
+  vfile *vf;
+
+  vf = vfopen_unsafe_ext(w->tmp_path, "wb", V_LARGE_BUFFER);
+  if(!vf)
+    return false;
+
+  if(vfwrite(w->buffer, w->length, 1, vf) == 1)
+    ret = true;
+
+  if(vfclose(vf))
+    ret = false;
+
+  if(ret && vrename(w->tmp_path, w->path))
+  {
+    // rename() doesn't replace existing files on some platforms.
+    vunlink(w->path);
+    if(vrename(w->tmp_path, w->path))
+      ret = false;
+  }
+
+  if(!ret)
+    vunlink(w->tmp_path);
+
+  return ret;
+}
+
+static THREAD_RES save_world_async_thread(void *data)
+{
+  struct save_writer *w = (struct save_writer *)data;
+  boolean ret = save_world_write_file(w);
+
+  platform_mutex_lock(&(w->lock));
+  w->failed = !ret;
+  w->finished = true;
+  platform_mutex_unlock(&(w->lock));
+  THREAD_RETURN;
+}
+
+static void save_world_free_buffer(struct save_writer *w)
+{
+  // The snapshot may share the buffer being written.
+  if(w->buffer != save_snapshot.buffer)
+    free(w->buffer);
+
+  w->buffer = NULL;
+}
+
+static void save_world_async_join(void)
+{
+  platform_thread_join(&(save_writer.thread));
+  platform_mutex_destroy(&(save_writer.lock));
+
+  save_world_free_buffer(&save_writer);
+  save_writer.active = false;
+
+  if(save_writer.failed)
+    error_message(E_WORLD_IO_SAVING, 0, NULL);
+}
+
+static void save_world_clear_snapshot(void)
+{
+  save_world_async_wait();
+
+  free(save_snapshot.buffer);
+  save_snapshot.buffer = NULL;
+  save_snapshot.length = 0;
+  save_snapshot.num_boards = 0;
+}
+
+/**
+ * Open the snapshot of the previous savegame for an incremental save.
+ */
+static struct zip_archive *save_world_open_snapshot(struct world *mzx_world)
+{
+  struct zip_archive *prev;
+
+  if(!save_snapshot.buffer || save_snapshot.num_boards != mzx_world->num_boards)
+    return NULL;
+
+  prev = zip_open_mem_read(save_snapshot.buffer, save_snapshot.length);
+  if(prev)
+    world_assign_file_ids(prev, true);
+
+  return prev;
+}
+
+/**
+ * Replace the snapshot with a new savegame. Every board except the current
+ * board now matches its copy in the snapshot.
+ */
+static void save_world_set_snapshot(struct world *mzx_world, void *buffer,
+ size_t length)
+{
+  struct board *cur_board;
+  int i;
+
+  free(save_snapshot.buffer);
+  save_snapshot.buffer = buffer;
+  save_snapshot.length = length;
+  save_snapshot.num_boards = mzx_world->num_boards;
+
+  for(i = 0; i < mzx_world->num_boards; i++)
+  {
+    cur_board = mzx_world->board_list[i];
+    if(cur_board && cur_board != mzx_world->current_board)
+      cur_board->modified = false;
+  }
+}
+
+/**
+ * Save a current version savegame, writing it to disk in the background if
+ * possible. Any previous background save is finished first.
+ */
+int save_world_async(struct world *mzx_world, const char *file)
+{
+  struct config_info *conf = get_config();
+  struct save_writer *w = &save_writer;
+  struct zip_archive *prev = NULL;
+  boolean incremental = conf->incremental_saves && !mzx_world->editing;
+  boolean ret;
+  int result;
+
+  save_world_async_wait();
+
+  if(!incremental)
+    save_world_clear_snapshot();
+
+  if(!conf->background_saves && !incremental)
+    return save_world(mzx_world, file, true, MZX_VERSION);
+
+  // The working directory may change before the writer opens the file.
+  if(path_is_absolute(file) > 0)
+  {
+    snprintf(w->path, MAX_PATH, "%s", file);
+  }
+  else
+
+  if(!vgetcwd(w->path, MAX_PATH) || path_append(w->path, MAX_PATH, file) < 0)
+    return save_world(mzx_world, file, true, MZX_VERSION);
+
+  if(snprintf(w->tmp_path, MAX_PATH, "%s.tmp", w->path) >= MAX_PATH)
+    return save_world(mzx_world, file, true, MZX_VERSION);
+
+  save_world_prepare(mzx_world);
+
+  if(incremental)
+    prev = save_world_open_snapshot(mzx_world);
+
+  result = save_world_zip_mem(mzx_world, prev, &(w->buffer), &(w->length));
+
+  if(prev)
+    zip_close(prev, NULL);
+
+  if(result)
+    return -1;
+
+  if(incremental)
+    save_world_set_snapshot(mzx_world, w->buffer, w->length);
+
+  if(conf->background_saves)
+  {
+    w->finished = false;
+    w->failed = false;
+    platform_mutex_init(&(w->lock));
+
+    if(platform_thread_create(&(w->thread), save_world_async_thread, w))
+    {
+      w->active = true;
+      return 0;
+    }
+
+    warn("Failed to start savegame writer thread.\n");
+    platform_mutex_destroy(&(w->lock));
+  }
+
+  ret = save_world_write_file(w);
+  save_world_free_buffer(w);
+
+  if(!ret)
+  {
+    error_message(E_WORLD_IO_SAVING, 0, NULL);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Returns true if a savegame is currently being written in the background.
+ */
+boolean save_world_async_pending(void)
+{
+  boolean finished;
+
+  if(!save_writer.active)
+    return false;
+
+  platform_mutex_lock(&(save_writer.lock));
+  finished = save_writer.finished;
+  platform_mutex_unlock(&(save_writer.lock));
+  return !finished;
+}
+
+/**
+ * Clean up the background save if it has finished, reporting any errors.
+ */
+void save_world_async_update(void)
+{
+  if(save_writer.active && !save_world_async_pending())
+    save_world_async_join();
+}
+
+/**
+ * Wait for the background save to finish. This should be used before
+ * anything that might read the savegame.
+ */
+void save_world_async_wait(void)
+{
+  if(save_writer.active)
+    save_world_async_join();
+}
+
+#else /* !SAVE_WORLD_ASYNC */
+
+int save_world_async(struct world *mzx_world, const char *file)
+{
+  return save_world(mzx_world, file, true, MZX_VERSION);
+}
+
+boolean save_world_async_pending(void)
+{
+  return false;
+}
+
+void save_world_async_update(void) {}
+void save_world_async_wait(void) {}
+static inline void save_world_clear_snapshot(void) {}
+
+#endif /* !SAVE_WORLD_ASYNC */
+
 __editor_maybe_static
 void set_update_done(struct world *mzx_world)
 {
@@ -3017,12 +3857,19 @@ static struct zip_archive *try_load_zip_world(struct world *mzx_world,
 {
   struct zip_archive *zp = NULL;
   vfile *vf;
+  int flags;
   int pr = 0;
   int v = 0;
 
   int result;
 
-  vf = vfopen_unsafe_ext(file, "rb", V_LARGE_BUFFER);
+  // Lazy board loading keeps the archive open during gameplay, so only map the
+  // file when it will be closed once the world has loaded.
+  flags = V_LARGE_BUFFER;
+  if(!load_boards_lazily(mzx_world))
+    flags |= V_MAP_FILE;
+
+  vf = vfopen_unsafe_ext(file, "rb", flags);
   if(!vf)
     return NULL;
 
@@ -3161,6 +4008,9 @@ void try_load_world(struct world *mzx_world, struct zip_archive **zp,
   int protected = 0;
   int v = 0;
 
+  // The file might be a savegame that is still being written.
+  save_world_async_wait();
+
   _zp = try_load_zip_world(mzx_world, file, savegame, &v, &protected, name);
 
   if(!_zp)
@@ -3525,6 +4375,12 @@ void clear_world(struct world *mzx_world)
 
   memset(mzx_world->status_counters_shown, 0, NUM_STATUS_COUNTERS * COUNTER_NAME_SIZE);
 
+  save_world_clear_snapshot();
+  mzm_cache_clear();
+  fread_cache_clear();
+  graphics_cache_clear();
+  reset_extram_board_prefetch();
+
   for(i = 0; i < num_boards; i++)
   {
     if(mzx_world->current_board_id != i)
@@ -3533,6 +4389,9 @@ void clear_world(struct world *mzx_world)
   }
   free(board_list);
 
+  // All boards are gone; this just joins the background store worker.
+  store_board_to_extram_wait();
+
   // Make sure we nuke the duplicate too, if it exists.
   if(mzx_world->temporary_board)
   {
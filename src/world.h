@@ -169,6 +169,10 @@ CORE_LIBSPEC int get_version_string(char buffer[16], enum mzx_version version);
 
 CORE_LIBSPEC int save_world(struct world *mzx_world, const char *file,
  boolean savegame, int file_version);
+CORE_LIBSPEC int save_world_async(struct world *mzx_world, const char *file);
+CORE_LIBSPEC boolean save_world_async_pending(void);
+CORE_LIBSPEC void save_world_async_update(void);
+CORE_LIBSPEC void save_world_async_wait(void);
 CORE_LIBSPEC boolean reload_world(struct world *mzx_world, const char *file,
  boolean *faded);
 CORE_LIBSPEC void clear_world(struct world *mzx_world);
@@ -773,8 +773,9 @@ static inline void world_assign_file_ids(struct zip_archive *zp, boolean is_a_wo
     }
   }
 
-  // Sort the archive and reset to the beginning
+  // Sort the archive, index the new IDs, and reset to the beginning
   qsort(fh_list, num_fh, sizeof(struct zip_file_header *), world_file_id_cmp);
+  zip_update_index(zp);
   zp->pos = 0;
 }
 
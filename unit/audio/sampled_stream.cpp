@@ -0,0 +1,309 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Compare the vectorized mixers against the scalar mixers. The vectorized
+ * mixers must be bit-exact with the scalar mixers for every combination of
+ * channels, volume, frequency, and buffer length. MixerBenchmark also reports
+ * the throughput of both.
+ */
+
+#include "../Unit.hpp"
+
+#include "../../src/audio/sampled_stream.cpp"
+
+#include <chrono>
+#include <vector>
+
+struct audio audio;
+
+void destruct_audio_stream(struct audio_stream *a_src) {}
+
+static constexpr size_t SOURCE_FRAMES = 8192;
+static constexpr size_t SOURCE_PADDING = 64;
+static constexpr size_t MAX_FRAMES = 1029;
+static constexpr int NUM_ITERATIONS = 8;
+static constexpr int NUM_BENCH_MIXES = 2048;
+
+static const int volumes[] =
+{
+  0, 1, 64, 127, 128, 200, 255, 256
+};
+
+static const int frequencies[] =
+{
+  3579, 8000, 11025, 22050, 31337, 44099, 44100, 44101, 48000, 96000,
+};
+
+static const size_t lengths[] =
+{
+  1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 256, 1000, MAX_FRAMES
+};
+
+static uint32_t rand_state;
+
+static int16_t next_sample()
+{
+  rand_state = rand_state * 1103515245 + 12345;
+  // Occasionally emit extreme values to test the edges of the mixers.
+  switch((rand_state >> 8) & 31)
+  {
+    case 0:
+      return INT16_MAX;
+    case 1:
+      return INT16_MIN;
+  }
+  return (int16_t)(rand_state >> 16);
+}
+
+class mixer_test_data
+{
+public:
+  std::vector<int16_t> source;
+  std::vector<int32_t> expected;
+  std::vector<int32_t> output;
+
+  mixer_test_data():
+   source((SOURCE_FRAMES + SOURCE_PADDING * 2) * 2),
+   expected(MAX_FRAMES * 2),
+   output(MAX_FRAMES * 2)
+  {
+    rand_state = 0x12345678;
+    for(int16_t &s : source)
+      s = next_sample();
+  }
+
+  const int16_t *src()
+  {
+    return source.data() + SOURCE_PADDING * 2;
+  }
+
+  void reset()
+  {
+    for(size_t i = 0; i < expected.size(); i++)
+      expected[i] = output[i] = (int32_t)(next_sample()) * 3;
+  }
+};
+
+static void init_stream(struct sampled_stream &s, int frequency,
+ size_t channels, int64_t sample_index)
+{
+  memset(&s, 0, sizeof(s));
+  s.frequency = frequency;
+  s.frequency_delta = ((int64_t)frequency << FP_SHIFT) / 44100;
+  s.sample_index = sample_index;
+  s.channels = channels;
+  s.data_window_length = 4096;
+}
+
+#ifdef MIXER_SIMD
+
+template<mixer_channels CHANNELS, mixer_volume VOLUME>
+static void test_flat(mixer_test_data &data)
+{
+  for(int volume : volumes)
+  {
+    for(size_t frames : lengths)
+    {
+      struct sampled_stream a;
+      struct sampled_stream b;
+      size_t len = frames * 2;
+
+      data.reset();
+      init_stream(a, 44100, CHANNELS, 0);
+      init_stream(b, 44100, CHANNELS, 0);
+
+      flat_mix_loop<CHANNELS, VOLUME>(&a,
+       data.expected.data(), len, data.src(), volume);
+      flat_mix_loop_simd<CHANNELS, VOLUME>(&b,
+       data.output.data(), len, data.src(), volume);
+
+      ASSERTMEM(data.expected.data(), data.output.data(),
+       len * sizeof(int32_t), "volume=%d frames=%zu", volume, frames);
+      ASSERTEQ(a.sample_index, b.sample_index, "volume=%d frames=%zu",
+       volume, frames);
+    }
+  }
+}
+
+template<mixer_channels CHANNELS, mixer_volume VOLUME>
+static void test_linear(mixer_test_data &data)
+{
+  for(int i = 0; i < NUM_ITERATIONS; i++)
+  {
+    for(int frequency : frequencies)
+    {
+      for(int volume : volumes)
+      {
+        for(size_t frames : lengths)
+        {
+          struct sampled_stream a;
+          struct sampled_stream b;
+          size_t len = frames * 2;
+          // Start from a different fractional position each iteration.
+          int64_t start = (int64_t)(next_sample() & FP_AND) - FP_ONE;
+
+          if(frames * frequency / 44100 + 2 >= SOURCE_FRAMES)
+            continue;
+
+          data.reset();
+          init_stream(a, frequency, CHANNELS, start);
+          init_stream(b, frequency, CHANNELS, start);
+
+          resample_mix_loop<CHANNELS, VOLUME, linear_mix<CHANNELS>>(&a,
+           data.expected.data(), len, data.src(), volume);
+          linear_mix_loop_simd<CHANNELS, VOLUME>(&b,
+           data.output.data(), len, data.src(), volume);
+
+          ASSERTMEM(data.expected.data(), data.output.data(),
+           len * sizeof(int32_t), "freq=%d volume=%d frames=%zu",
+           frequency, volume, frames);
+          ASSERTEQ(a.sample_index, b.sample_index,
+           "freq=%d volume=%d frames=%zu", frequency, volume, frames);
+        }
+      }
+    }
+  }
+}
+
+typedef void (*mix_loop_fn)(struct sampled_stream *s_src,
+ int32_t * RESTRICT dest, size_t write_len, const int16_t *src, int volume);
+
+/**
+ * Mix the same data repeatedly with a scalar and a vector mixer, and report
+ * the throughput of each in frames per microsecond. The final outputs must
+ * still be identical. The numbers are only meaningful in optimized builds.
+ */
+static void bench_mixer(mixer_test_data &data, const char *name,
+ int frequency, mix_loop_fn scalar, mix_loop_fn vector)
+{
+  using clock = std::chrono::steady_clock;
+  mix_loop_fn fns[2] = { scalar, vector };
+  double frames_per_us[2];
+  size_t len = MAX_FRAMES * 2;
+
+  data.reset();
+
+  for(int i = 0; i < 2; i++)
+  {
+    std::vector<int32_t> &dest = i ? data.output : data.expected;
+    struct sampled_stream s;
+
+    auto start = clock::now();
+    for(int j = 0; j < NUM_BENCH_MIXES; j++)
+    {
+      init_stream(s, frequency, STEREO, 0);
+      fns[i](&s, dest.data(), len, data.src(), 200);
+    }
+    auto end = clock::now();
+
+    double us = std::chrono::duration<double, std::micro>(end - start).count();
+    frames_per_us[i] = (double)MAX_FRAMES * NUM_BENCH_MIXES / Unit::max(us, 1.0);
+  }
+
+  Uerr("  %-8s scalar %7.1f frames/us, vector %7.1f frames/us (%.2fx)\n",
+   name, frames_per_us[0], frames_per_us[1],
+   frames_per_us[1] / frames_per_us[0]);
+
+  ASSERTMEM(data.expected.data(), data.output.data(), len * sizeof(int32_t),
+   "%s", name);
+}
+
+#endif /* MIXER_SIMD */
+
+UNITTEST(FlatMixer)
+{
+#ifdef MIXER_SIMD
+  mixer_test_data data;
+
+  SECTION(MonoFixed)      test_flat<MONO, FIXED>(data);
+  SECTION(MonoDynamic)    test_flat<MONO, DYNAMIC>(data);
+  SECTION(StereoFixed)    test_flat<STEREO, FIXED>(data);
+  SECTION(StereoDynamic)  test_flat<STEREO, DYNAMIC>(data);
+#else
+  SKIP();
+#endif
+}
+
+UNITTEST(LinearMixer)
+{
+#ifdef MIXER_SIMD
+  mixer_test_data data;
+
+  SECTION(MonoFixed)      test_linear<MONO, FIXED>(data);
+  SECTION(MonoDynamic)    test_linear<MONO, DYNAMIC>(data);
+  SECTION(StereoFixed)    test_linear<STEREO, FIXED>(data);
+  SECTION(StereoDynamic)  test_linear<STEREO, DYNAMIC>(data);
+#else
+  SKIP();
+#endif
+}
+
+UNITTEST(MixerBenchmark)
+{
+#ifdef MIXER_SIMD
+  mixer_test_data data;
+
+  Uerr("\n");
+  bench_mixer(data, "flat", 44100,
+   flat_mix_loop<STEREO, DYNAMIC>,
+   flat_mix_loop_simd<STEREO, DYNAMIC>);
+  bench_mixer(data, "linear", 31337,
+   resample_mix_loop<STEREO, DYNAMIC, linear_mix<STEREO>>,
+   linear_mix_loop_simd<STEREO, DYNAMIC>);
+#else
+  SKIP();
+#endif
+}
+
+UNITTEST(ClipBuffer)
+{
+  static const int32_t values[] =
+  {
+    0, 1, -1, 32767, 32768, -32768, -32769, 100000, -100000,
+    INT32_MAX, INT32_MIN, 12345, -12345, 65536, -65536, 32766, -32767,
+  };
+  static constexpr size_t NUM_VALUES = arraysize(values);
+  static constexpr size_t BUFFER_LEN = NUM_VALUES * 4;
+  int16_t output[BUFFER_LEN];
+  int32_t input[BUFFER_LEN];
+
+  for(size_t i = 0; i < BUFFER_LEN; i++)
+    input[i] = values[(i * 7) % NUM_VALUES];
+
+  // Test every length to cover both the vector and scalar paths.
+  for(size_t len = 0; len <= BUFFER_LEN; len++)
+  {
+    memset(output, 0xAA, sizeof(output));
+    sampled_clip_buffer(output, input, len);
+
+    for(size_t i = 0; i < len; i++)
+    {
+      int32_t expected = input[i];
+      if(expected > 32767)
+        expected = 32767;
+      if(expected < -32768)
+        expected = -32768;
+
+      ASSERTEQ(output[i], expected, "len=%zu i=%zu", len, i);
+    }
+    for(size_t i = len; i < BUFFER_LEN; i++)
+      ASSERTEQ(output[i], (int16_t)0xAAAA, "len=%zu i=%zu", len, i);
+  }
+}
@@ -595,6 +595,16 @@ UNITTEST(Settings)
     TEST_INT("max_simultaneous_samples", conf->max_simultaneous_samples, -1, INT_MAX);
   }
 
+  SECTION(vorbis_decode_ahead)
+  {
+    TEST_INT("vorbis_decode_ahead", conf->vorbis_decode_ahead, 0, 1 << 20);
+  }
+
+  SECTION(module_prefetch)
+  {
+    TEST_INT("module_prefetch", conf->module_prefetch, 0, 16);
+  }
+
   SECTION(music_volume)
   {
     TEST_INT("music_volume", conf->music_volume, 0, 10);
@@ -605,6 +615,36 @@ UNITTEST(Settings)
     TEST_INT("sample_volume", conf->sam_volume, 0, 10);
   }
 
+  SECTION(audio_render_file)
+  {
+    TEST_STRING("audio_render_file", conf->audio_render_file, string_data);
+  }
+
+  SECTION(audio_render_module)
+  {
+    TEST_STRING("audio_render_module", conf->audio_render_module, string_data);
+  }
+
+  SECTION(audio_render_sample)
+  {
+    TEST_STRING("audio_render_sample", conf->audio_render_sample, string_data);
+  }
+
+  SECTION(audio_render_sample_count)
+  {
+    TEST_INT("audio_render_sample_count", conf->audio_render_sample_count, 1, 1024);
+  }
+
+  SECTION(audio_render_sfx)
+  {
+    TEST_STRING("audio_render_sfx", conf->audio_render_sfx, string_data);
+  }
+
+  SECTION(audio_render_length)
+  {
+    TEST_INT("audio_render_length", conf->audio_render_length, 1, 86400);
+  }
+
   SECTION(pc_speaker_volume)
   {
     TEST_INT("pc_speaker_volume", conf->pc_speaker_volume, 0, 10);
@@ -753,6 +793,31 @@ UNITTEST(Settings)
     TEST_STRING("save_slots_ext", conf->save_slots_ext, string_data);
   }
 
+  SECTION(worker_threads)
+  {
+    TEST_INT("worker_threads", conf->worker_threads, 0, 64);
+  }
+
+  SECTION(lazy_board_loading)
+  {
+    TEST_ENUM("lazy_board_loading", conf->lazy_board_loading, boolean_data);
+  }
+
+  SECTION(background_saves)
+  {
+    TEST_ENUM("background_saves", conf->background_saves, boolean_data);
+  }
+
+  SECTION(incremental_saves)
+  {
+    TEST_ENUM("incremental_saves", conf->incremental_saves, boolean_data);
+  }
+
+  SECTION(board_prefetch)
+  {
+    TEST_INT("board_prefetch", conf->board_prefetch, 0, 16);
+  }
+
   // Editor options used by core.
 
   SECTION(test_mode)
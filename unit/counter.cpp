@@ -0,0 +1,190 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Unit tests for the file counters. Closed FREAD handles are cached and reused
+ * when the same file is opened again; from Robotic's point of view, reopening
+ * a file should be indistinguishable from opening it for the first time.
+ */
+
+#include "Unit.hpp"
+
+#include <string.h>
+
+#include "../src/board_struct.h"
+#include "../src/counter.h"
+#include "../src/world.h"
+#include "../src/io/vio.h"
+
+static constexpr char FREAD_FILE_A[] = "_fread_tmp_a";
+static constexpr char FREAD_FILE_B[] = "_fread_tmp_b";
+
+static struct world mzx_world;
+static struct board cur_board;
+static struct robot *robot_list[1];
+
+static void init_world()
+{
+  counter_fsg();
+
+  memset(&mzx_world, 0, sizeof(struct world));
+  memset(&cur_board, 0, sizeof(struct board));
+  cur_board.robot_list = robot_list;
+  mzx_world.current_board = &cur_board;
+  mzx_world.version = MZX_VERSION;
+}
+
+static boolean write_file(const char *path, const char *data)
+{
+  vfile *vf = vfopen_unsafe(path, "wb");
+  ASSERT(vf, "failed to open '%s'", path);
+  if(vf)
+  {
+    size_t ret = vfwrite(data, strlen(data), 1, vf);
+    ASSERT(ret == 1, "write error for '%s'", path);
+    vfclose(vf);
+    return true;
+  }
+  return false;
+}
+
+static void fread_open(const char *path)
+{
+  char buffer[MAX_PATH];
+  snprintf(buffer, MAX_PATH, "%s", path);
+
+  get_counter(&mzx_world, "FREAD_OPEN", 0);
+  set_counter_special(&mzx_world, buffer, 0, 0);
+}
+
+static void fread_close()
+{
+  fread_open("");
+}
+
+static int fread_pos()
+{
+  return get_counter(&mzx_world, "FREAD_POS", 0);
+}
+
+static int fread_byte()
+{
+  return get_counter(&mzx_world, "FREAD", 0);
+}
+
+UNITTEST(FreadCache)
+{
+  init_world();
+  fread_cache_clear();
+
+  if(!write_file(FREAD_FILE_A, "ABCDEFGH") || !write_file(FREAD_FILE_B, "xyz"))
+    FAIL("couldn't create test files");
+
+  ASSERTEQ(fread_pos(), -1, "");
+  fread_open(FREAD_FILE_A);
+  ASSERTEQ(fread_pos(), 0, "");
+  ASSERTEQ(fread_byte(), 'A', "");
+  ASSERTEQ(fread_byte(), 'B', "");
+  ASSERTEQ(fread_pos(), 2, "");
+  fread_close();
+  ASSERTEQ(fread_pos(), -1, "");
+  ASSERTEQ(fread_byte(), -1, "");
+
+  SECTION(Reopen)
+  {
+    // A reused handle should be rewound.
+    fread_open(FREAD_FILE_A);
+    ASSERTEQ(fread_pos(), 0, "");
+    ASSERTEQ(fread_byte(), 'A', "");
+    ASSERTEQ(fread_pos(), 1, "");
+    fread_close();
+    ASSERTEQ(fread_pos(), -1, "");
+  }
+
+  SECTION(Seek)
+  {
+    fread_open(FREAD_FILE_A);
+    set_counter(&mzx_world, "FREAD_POS", 5, 0);
+    ASSERTEQ(fread_pos(), 5, "");
+    ASSERTEQ(fread_byte(), 'F', "");
+
+    set_counter(&mzx_world, "FREAD_POS", -1, 0);
+    ASSERTEQ(fread_pos(), 8, "");
+    ASSERTEQ(fread_byte(), -1, "");
+    fread_close();
+
+    fread_open(FREAD_FILE_A);
+    ASSERTEQ(fread_pos(), 0, "");
+    ASSERTEQ(fread_byte(), 'A', "");
+    fread_close();
+  }
+
+  SECTION(OtherFile)
+  {
+    // Opening a file while another is cached shouldn't return the wrong one.
+    fread_open(FREAD_FILE_B);
+    ASSERTEQ(fread_byte(), 'x', "");
+    fread_close();
+
+    fread_open(FREAD_FILE_A);
+    ASSERTEQ(fread_byte(), 'A', "");
+    fread_close();
+
+    fread_open(FREAD_FILE_B);
+    ASSERTEQ(fread_byte(), 'x', "");
+    ASSERTEQ(fread_byte(), 'y', "");
+    fread_close();
+  }
+
+  SECTION(Modified)
+  {
+    // A file changed after it was closed should be read again from disk.
+    if(!write_file(FREAD_FILE_A, "0123"))
+      FAIL("couldn't rewrite test file");
+
+    fread_open(FREAD_FILE_A);
+    ASSERTEQ(fread_byte(), '0', "");
+    set_counter(&mzx_world, "FREAD_POS", -1, 0);
+    ASSERTEQ(fread_pos(), 4, "");
+    fread_close();
+  }
+
+  SECTION(Deleted)
+  {
+    vunlink(FREAD_FILE_A);
+
+    fread_open(FREAD_FILE_A);
+    ASSERTEQ(fread_pos(), -1, "");
+    ASSERTEQ(fread_byte(), -1, "");
+    fread_close();
+  }
+
+  SECTION(Cleared)
+  {
+    fread_cache_clear();
+
+    fread_open(FREAD_FILE_A);
+    ASSERTEQ(fread_byte(), 'A', "");
+    fread_close();
+  }
+
+  fread_cache_clear();
+  vunlink(FREAD_FILE_A);
+  vunlink(FREAD_FILE_B);
+}
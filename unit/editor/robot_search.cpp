@@ -0,0 +1,367 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "../Unit.hpp"
+
+#include <string.h>
+
+#include "../../src/editor/stringsearch.c"
+#include "../../src/editor/robot_search.c"
+
+#include "../../src/world_struct.h"
+
+static const char *const programs[] =
+{
+  ": \"touch\"\n* \"~fHello!\"\nend\n",
+  "cycle 1\n: \"loop\"\ngo SEEK 1\ngoto \"loop\"\n",
+  "set \"local\" to 1\nSET \"LOCAL2\" to 2\nend\n",
+  "wait 1\n",
+  "/ \"n\"\n",
+  "",
+};
+
+static uint32_t add_program(struct robot_search_index *idx, const char *str)
+{
+  size_t len = strlen(str);
+  char *text = (char *)cmalloc(len + 1);
+  memcpy(text, str, len + 1);
+  return robot_search_add_doc(idx, text, len);
+}
+
+/**
+ * Check that every document containing the string is a candidate.
+ */
+static void check_candidates(struct robot_search_index *idx,
+ const uint32_t *ids, size_t num_ids, const char *str)
+{
+  size_t str_len = strlen(str);
+  size_t i;
+
+  robot_search_candidates(idx, str, str_len);
+
+  for(i = 0; i < num_ids; i++)
+  {
+    const struct robot_search_doc *doc = &(idx->docs[ids[i]]);
+    boolean match = !!string_search(doc->text, doc->length, str, str_len,
+     nullptr, true);
+
+    if(match)
+      ASSERT(idx->candidates[ids[i]], "%s: %zu", str, i);
+  }
+}
+
+UNITTEST(Postings)
+{
+  struct robot_search_postings p{};
+  static const uint32_t add[] = { 5, 1, 9, 3, 7, 2, 8 };
+  static const uint32_t expected[] = { 1, 2, 3, 5, 7, 8, 9 };
+  static const uint32_t expected_removed[] = { 1, 3, 7, 8 };
+  uint32_t i;
+
+  for(i = 0; i < ARRAY_SIZE(add); i++)
+    robot_search_postings_add(&p, add[i]);
+
+  ASSERTEQ(p.count, ARRAY_SIZE(expected), "");
+  for(i = 0; i < p.count; i++)
+    ASSERTEQ(p.docs[i], expected[i], "%u", i);
+
+  robot_search_postings_remove(&p, 2);
+  robot_search_postings_remove(&p, 9);
+  robot_search_postings_remove(&p, 5);
+  robot_search_postings_remove(&p, 4);
+
+  ASSERTEQ(p.count, ARRAY_SIZE(expected_removed), "");
+  for(i = 0; i < p.count; i++)
+    ASSERTEQ(p.docs[i], expected_removed[i], "%u", i);
+
+  free(p.docs);
+}
+
+UNITTEST(Candidates)
+{
+  static const char *const queries[] =
+  {
+    "touch", "TOUCH", "~fHello", "end", "loop", "seek 1", "local",
+    "local2", "wait", "\"n\"", "go", "t", "not in any program",
+  };
+  struct robot_search_index *idx = construct_robot_search_index();
+  uint32_t ids[ARRAY_SIZE(programs)];
+  size_t i;
+
+  for(i = 0; i < ARRAY_SIZE(programs); i++)
+    ids[i] = add_program(idx, programs[i]);
+
+  SECTION(Superset)
+  {
+    for(const char *query : queries)
+      check_candidates(idx, ids, ARRAY_SIZE(ids), query);
+  }
+
+  SECTION(Short)
+  {
+    // Queries without trigrams check every document.
+    ASSERTEQ(robot_search_candidates(idx, "go", 2), ARRAY_SIZE(programs), "");
+  }
+
+  SECTION(Remove)
+  {
+    robot_search_candidates(idx, "touch", 5);
+    ASSERT(idx->candidates[ids[0]], "");
+
+    robot_search_remove_doc(idx, ids[0]);
+    robot_search_candidates(idx, "touch", 5);
+    ASSERT(!idx->candidates[ids[0]], "");
+    check_candidates(idx, ids + 1, ARRAY_SIZE(ids) - 1, "touch");
+
+    // Removed IDs should be reused.
+    ASSERTEQ(add_program(idx, programs[0]), ids[0], "");
+    robot_search_candidates(idx, "touch", 5);
+    ASSERT(idx->candidates[ids[0]], "");
+  }
+
+  destruct_robot_search_index(idx);
+}
+
+UNITTEST(Find)
+{
+  struct robot_search_index *idx = construct_robot_search_index();
+  struct robot_search_result *results;
+  size_t num_results;
+  int i;
+
+  // One board with a robot for each program, plus the global robot.
+  idx->global_robot.doc = add_program(idx, "set \"local\" to 3\n");
+  idx->num_boards = 1;
+  idx->boards = (struct robot_search_board *)ccalloc(1,
+   sizeof(struct robot_search_board));
+  idx->boards[0].num_robots = ARRAY_SIZE(programs);
+  idx->boards[0].robots = (struct robot_search_entry *)ccalloc(
+   ARRAY_SIZE(programs) + 1, sizeof(struct robot_search_entry));
+
+  for(i = 1; i <= (int)ARRAY_SIZE(programs); i++)
+  {
+    idx->boards[0].robots[i].doc = ROBOT_SEARCH_NO_DOC;
+    if(programs[i - 1][0])
+      idx->boards[0].robots[i].doc = add_program(idx, programs[i - 1]);
+  }
+
+  SECTION(IgnoreCase)
+  {
+    num_results = robot_search_find(idx, "local", 5, true, &results, 100);
+    ASSERTEQ(num_results, 3, "");
+    ASSERTEQ(results[0].board_id, -1, "");
+    ASSERTEQ(results[0].line, 1, "");
+    ASSERTEQ(results[1].board_id, 0, "");
+    ASSERTEQ(results[1].robot_id, 3, "");
+    ASSERTEQ(results[1].line, 1, "");
+    ASSERTEQ(results[2].robot_id, 3, "");
+    ASSERTEQ(results[2].line, 2, "");
+    ASSERTEQ(results[2].line_length, strlen("SET \"LOCAL2\" to 2"), "");
+    ASSERTNCMP(results[2].line_text, "SET \"LOCAL2\" to 2",
+     results[2].line_length, "");
+    free(results);
+  }
+
+  SECTION(CaseSensitive)
+  {
+    num_results = robot_search_find(idx, "LOCAL", 5, false, &results, 100);
+    ASSERTEQ(num_results, 1, "");
+    ASSERTEQ(results[0].robot_id, 3, "");
+    ASSERTEQ(results[0].line, 2, "");
+    free(results);
+  }
+
+  SECTION(OncePerLine)
+  {
+    // "loop" appears twice in robot 2, on lines 2 and 4.
+    num_results = robot_search_find(idx, "o", 1, true, &results, 100);
+    ASSERT(num_results > 0, "");
+    for(size_t j = 1; j < num_results; j++)
+    {
+      if(results[j].board_id == results[j - 1].board_id &&
+       results[j].robot_id == results[j - 1].robot_id)
+        ASSERT(results[j].line > results[j - 1].line, "%zu", j);
+    }
+    free(results);
+
+    num_results = robot_search_find(idx, "loop", 4, true, &results, 100);
+    ASSERTEQ(num_results, 2, "");
+    ASSERTEQ(results[0].line, 2, "");
+    ASSERTEQ(results[1].line, 4, "");
+    free(results);
+  }
+
+  SECTION(MaxResults)
+  {
+    num_results = robot_search_find(idx, "e", 1, true, &results, 2);
+    ASSERTEQ(num_results, 2, "");
+    free(results);
+  }
+
+  SECTION(NoMatch)
+  {
+    num_results = robot_search_find(idx, "teleport", 8, true, &results, 100);
+    ASSERTEQ(num_results, 0, "");
+    ASSERTEQ(results, nullptr, "");
+  }
+
+  destruct_robot_search_index(idx);
+}
+
+#ifdef CONFIG_DEBYTECODE
+#define WAIT_1 "wait for 1\n"
+#define WAIT_2 "wait for 2\n"
+#else
+#define WAIT_1 "\xff\x04\x02\x00\x01\x00\x04\x00"
+#define WAIT_2 "\xff\x04\x02\x00\x02\x00\x04\x00"
+#endif
+
+static void set_program(struct robot *cur_robot, const char *program,
+ int length)
+{
+#ifdef CONFIG_DEBYTECODE
+  cur_robot->program_source = (char *)crealloc(cur_robot->program_source,
+   length);
+  cur_robot->program_source_length = length;
+  memcpy(cur_robot->program_source, program, length);
+#else
+  cur_robot->program_bytecode = (char *)crealloc(cur_robot->program_bytecode,
+   length);
+  cur_robot->program_bytecode_length = length;
+  memcpy(cur_robot->program_bytecode, program, length);
+#endif
+}
+
+static void free_program(struct robot *cur_robot)
+{
+  free(cur_robot->program_source);
+  free(cur_robot->program_bytecode);
+}
+
+static size_t count_results(struct robot_search_index *idx, const char *str,
+ int board_id)
+{
+  struct robot_search_result *results;
+  size_t num_results;
+  size_t count = 0;
+  size_t i;
+
+  num_results = robot_search_find(idx, str, strlen(str), true, &results, 100);
+  for(i = 0; i < num_results; i++)
+    if(results[i].board_id == board_id)
+      count++;
+
+  free(results);
+  return count;
+}
+
+/**
+ * Make a different board current. The previous board is stored the same way
+ * the editor does it when changing boards.
+ */
+static void switch_board(struct world *mzx_world, int board_id)
+{
+  if(mzx_world->current_board)
+    store_board_to_extram(mzx_world->current_board);
+
+  mzx_world->current_board_id = board_id;
+  mzx_world->current_board = mzx_world->board_list[board_id];
+  retrieve_board_from_extram(mzx_world->current_board);
+}
+
+UNITTEST(Update)
+{
+#ifdef CONFIG_EXTRAM
+  // Boards this incomplete can't be stored to extram.
+  SKIP();
+#endif
+
+  static struct world mzx_world;
+  struct board board_a{};
+  struct board board_b{};
+  struct board *board_list[2] = { &board_a, &board_b };
+  struct robot robot_a{};
+  struct robot robot_b{};
+  struct robot *robots_a[2] = { nullptr, &robot_a };
+  struct robot *robots_b[2] = { nullptr, &robot_b };
+  struct robot_search_index *idx = construct_robot_search_index();
+
+  set_program(&robot_a, WAIT_1, sizeof(WAIT_1) - 1);
+  set_program(&robot_b, WAIT_1, sizeof(WAIT_1) - 1);
+  board_a.num_robots = 1;
+  board_a.robot_list = robots_a;
+  board_b.num_robots = 1;
+  board_b.robot_list = robots_b;
+
+  memset(&mzx_world, 0, sizeof(struct world));
+  mzx_world.num_boards = 2;
+  mzx_world.board_list = board_list;
+  mzx_world.current_board = &board_b;
+  switch_board(&mzx_world, 0);
+
+  robot_search_update(idx, &mzx_world);
+  ASSERTEQ(count_results(idx, "wait for 1", 0), 1, "");
+  ASSERTEQ(count_results(idx, "wait for 1", 1), 1, "");
+  ASSERTEQ(count_results(idx, "wait for 2", 0), 0, "");
+
+  SECTION(ChangedCurrentBoard)
+  {
+    set_program(&robot_a, WAIT_2, sizeof(WAIT_2) - 1);
+    robot_search_update(idx, &mzx_world);
+    ASSERTEQ(count_results(idx, "wait for 1", 0), 0, "");
+    ASSERTEQ(count_results(idx, "wait for 2", 0), 1, "");
+  }
+
+  SECTION(ChangedPreviousBoard)
+  {
+    // Same program length, then switch boards before searching again.
+    set_program(&robot_a, WAIT_2, sizeof(WAIT_2) - 1);
+    switch_board(&mzx_world, 1);
+
+    robot_search_update(idx, &mzx_world);
+    ASSERTEQ(count_results(idx, "wait for 1", 0), 0, "");
+    ASSERTEQ(count_results(idx, "wait for 2", 0), 1, "");
+    ASSERTEQ(count_results(idx, "wait for 1", 1), 1, "");
+
+    // Board A is now at rest and should be skipped, not forgotten.
+    robot_search_update(idx, &mzx_world);
+    ASSERTEQ(count_results(idx, "wait for 2", 0), 1, "");
+  }
+
+  SECTION(RemovedRobot)
+  {
+    switch_board(&mzx_world, 1);
+    robots_b[1] = nullptr;
+    robot_search_update(idx, &mzx_world);
+    ASSERTEQ(count_results(idx, "wait for 1", 0), 1, "");
+    ASSERTEQ(count_results(idx, "wait for 1", 1), 0, "");
+  }
+
+  SECTION(RemovedBoard)
+  {
+    mzx_world.num_boards = 1;
+    robot_search_update(idx, &mzx_world);
+    ASSERTEQ(count_results(idx, "wait for 1", 0), 1, "");
+    ASSERTEQ(count_results(idx, "wait for 1", 1), 0, "");
+  }
+
+  destruct_robot_search_index(idx);
+  free_program(&robot_a);
+  free_program(&robot_b);
+}
@@ -0,0 +1,207 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "../Unit.hpp"
+
+#include <string.h>
+
+#include "../../src/editor/undo.h"
+
+static constexpr int LAYER_W = 80;
+static constexpr int LAYER_H = 25;
+static constexpr int LAYER_SIZE = LAYER_W * LAYER_H;
+
+struct layer
+{
+  char chars[LAYER_SIZE];
+  char colors[LAYER_SIZE];
+
+  boolean operator==(const layer &other) const
+  {
+    return !memcmp(chars, other.chars, LAYER_SIZE) &&
+     !memcmp(colors, other.colors, LAYER_SIZE);
+  }
+};
+
+/**
+ * Fill part of the layer, like a block action would.
+ */
+static void fill(layer &l, int x, int y, int w, int h, char chr, char color)
+{
+  for(int i = y; i < y + h; i++)
+  {
+    memset(l.chars + i * LAYER_W + x, chr, w);
+    memset(l.colors + i * LAYER_W + x, color, w);
+  }
+}
+
+/**
+ * Fill the layer with data that RLE3 can't compress.
+ */
+static void scramble(layer &l, unsigned int seed)
+{
+  for(int i = 0; i < LAYER_SIZE; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    l.chars[i] = seed >> 16;
+    l.colors[i] = seed >> 24;
+  }
+}
+
+static void block_action(struct undo_history *h, layer &l, int x, int y,
+ int width, int height, char chr, char color)
+{
+  add_layer_undo_frame(h, l.chars, l.colors, LAYER_W, x + y * LAYER_W,
+   width, height);
+  fill(l, x, y, width, height, chr, color);
+  update_undo_frame(h);
+}
+
+UNITTEST(BlockFrames)
+{
+  static layer l;
+  static layer states[4];
+  struct undo_history *h = construct_layer_undo_history(10, 0);
+  int i;
+
+  fill(l, 0, 0, LAYER_W, LAYER_H, ' ', 7);
+  fill(l, 10, 5, 20, 10, 'A', 0x1F);
+  states[0] = l;
+
+  SECTION(UndoRedo)
+  {
+    block_action(h, l, 0, 0, LAYER_W, LAYER_H, 'B', 0x2E);
+    states[1] = l;
+    block_action(h, l, 15, 8, 30, 4, 'C', 0x4C);
+    states[2] = l;
+    block_action(h, l, 79, 24, 1, 1, 'D', 0x0F);
+    states[3] = l;
+
+    for(i = 2; i >= 0; i--)
+    {
+      ASSERT(apply_undo(h), "%d", i);
+      ASSERT(l == states[i], "%d", i);
+    }
+    ASSERT(!apply_undo(h), "");
+
+    for(i = 1; i <= 3; i++)
+    {
+      ASSERT(apply_redo(h), "%d", i);
+      ASSERT(l == states[i], "%d", i);
+    }
+    ASSERT(!apply_redo(h), "");
+  }
+
+  SECTION(Repack)
+  {
+    // A frame that is updated again must still undo to its original state.
+    add_layer_undo_frame(h, l.chars, l.colors, LAYER_W, 0, LAYER_W, LAYER_H);
+    fill(l, 0, 0, 40, LAYER_H, 'E', 0x3A);
+    update_undo_frame(h);
+    fill(l, 20, 0, 60, 12, 'F', 0x5B);
+    update_undo_frame(h);
+    states[1] = l;
+
+    ASSERT(apply_undo(h), "");
+    ASSERT(l == states[0], "");
+    ASSERT(apply_redo(h), "");
+    ASSERT(l == states[1], "");
+  }
+
+  SECTION(Incompressible)
+  {
+    // Planes that don't compress are stored as-is.
+    add_layer_undo_frame(h, l.chars, l.colors, LAYER_W, 0, LAYER_W, LAYER_H);
+    scramble(l, 1);
+    update_undo_frame(h);
+    states[1] = l;
+
+    add_layer_undo_frame(h, l.chars, l.colors, LAYER_W, 0, LAYER_W, LAYER_H);
+    scramble(l, 2);
+    update_undo_frame(h);
+    states[2] = l;
+
+    for(i = 1; i >= 0; i--)
+    {
+      ASSERT(apply_undo(h), "%d", i);
+      ASSERT(l == states[i], "%d", i);
+    }
+    for(i = 1; i <= 2; i++)
+    {
+      ASSERT(apply_redo(h), "%d", i);
+      ASSERT(l == states[i], "%d", i);
+    }
+  }
+
+  destruct_undo_history(h);
+}
+
+UNITTEST(MemoryLimit)
+{
+  static layer l;
+  static layer states[6];
+  // Incompressible frames store four raw copies of the area.
+  size_t frame_size = LAYER_SIZE * 4;
+  size_t max_memory = 0;
+  int expected_undos = 5;
+  struct undo_history *h;
+  int undos;
+  int i;
+
+  fill(l, 0, 0, LAYER_W, LAYER_H, ' ', 7);
+  states[0] = l;
+
+  SECTION(Trim)
+  {
+    // Room for two frames, but not three.
+    max_memory = frame_size * 2 + frame_size / 2;
+    expected_undos = 2;
+  }
+
+  SECTION(KeepCurrent)
+  {
+    // The current frame is kept even if it is over the limit on its own.
+    max_memory = 1;
+    expected_undos = 1;
+  }
+
+  h = construct_layer_undo_history(10, max_memory);
+
+  for(i = 1; i <= 5; i++)
+  {
+    add_layer_undo_frame(h, l.chars, l.colors, LAYER_W, 0, LAYER_W, LAYER_H);
+    scramble(l, i);
+    update_undo_frame(h);
+    states[i] = l;
+  }
+
+  for(undos = 0; apply_undo(h); undos++)
+    ASSERT(l == states[4 - undos], "%d", undos);
+
+  ASSERTEQ(undos, expected_undos, "");
+
+  for(i = 5 - undos + 1; i <= 5; i++)
+  {
+    ASSERT(apply_redo(h), "%d", i);
+    ASSERT(l == states[i], "%d", i);
+  }
+  ASSERT(!apply_redo(h), "");
+
+  destruct_undo_history(h);
+}
@@ -0,0 +1,179 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Unit.hpp"
+
+#include <string.h>
+
+#include "../src/file_cache.h"
+#include "../src/io/vio.h"
+
+static constexpr char FILE_A[] = "_file_cache_a";
+static constexpr char FILE_B[] = "_file_cache_b";
+static constexpr char FILE_C[] = "_file_cache_c";
+static constexpr char FILE_EMPTY[] = "_file_cache_empty";
+static constexpr unsigned int NUM_ENTRIES = 2;
+
+static int num_priv_freed;
+
+static void free_priv(void *priv)
+{
+  num_priv_freed++;
+}
+
+static boolean write_file(const char *path, const char *data)
+{
+  vfile *vf = vfopen_unsafe(path, "wb");
+  ASSERT(vf, "failed to open '%s'", path);
+  if(vf)
+  {
+    size_t len = strlen(data);
+    if(len)
+      ASSERTEQ(vfwrite(data, len, 1, vf), 1, "write error for '%s'", path);
+    vfclose(vf);
+    return true;
+  }
+  return false;
+}
+
+static unsigned int count_entries(const struct file_cache &cache)
+{
+  unsigned int count = 0;
+  for(unsigned int i = 0; i < cache.num_entries; i++)
+    if(cache.entries[i].data)
+      count++;
+  return count;
+}
+
+UNITTEST(FileCache)
+{
+  struct file_cache_entry entries[NUM_ENTRIES]{};
+  struct file_cache cache =
+  {
+    entries, NUM_ENTRIES, 16, 12, 0, free_priv, 0, 0, 0
+  };
+  struct file_cache_entry *e;
+
+  if(!write_file(FILE_A, "AAAAAA") || !write_file(FILE_B, "BBBBBBB") ||
+   !write_file(FILE_C, "CCCCCCCC") || !write_file(FILE_EMPTY, ""))
+    FAIL("couldn't create test files");
+
+  num_priv_freed = 0;
+
+  SECTION(Hit)
+  {
+    e = file_cache_get(&cache, FILE_A);
+    ASSERT(e, "");
+    ASSERTEQ(e->length, 6, "");
+    ASSERTEQ(e->file_length, 6, "");
+    ASSERTMEM(e->data, "AAAAAA", 6, "");
+    ASSERTEQ(cache.total, 6, "");
+
+    ASSERTEQ(file_cache_get(&cache, FILE_A), e, "");
+    ASSERTEQ(count_entries(cache), 1, "");
+  }
+
+  SECTION(NotCacheable)
+  {
+    write_file(FILE_C, "0123456789abcdef");
+    ASSERTEQ(file_cache_get(&cache, FILE_C), nullptr, "larger than max");
+    ASSERTEQ(file_cache_get(&cache, FILE_EMPTY), nullptr, "empty file");
+    ASSERTEQ(file_cache_get(&cache, "_file_cache_missing"), nullptr, "");
+    ASSERTEQ(file_cache_get(&cache, "."), nullptr, "directory");
+    ASSERTEQ(count_entries(cache), 0, "");
+  }
+
+  SECTION(MaxRead)
+  {
+    cache.max_read = 4;
+    e = file_cache_get(&cache, FILE_B);
+    ASSERT(e, "");
+    ASSERTEQ(e->length, 4, "");
+    ASSERTEQ(e->file_length, 7, "");
+    ASSERTMEM(e->data, "BBBB", 4, "");
+  }
+
+  SECTION(Modified)
+  {
+    e = file_cache_get(&cache, FILE_A);
+    ASSERT(e, "");
+    if(!write_file(FILE_A, "aaaaaaaaa"))
+      FAIL("couldn't rewrite test file");
+
+    e = file_cache_get(&cache, FILE_A);
+    ASSERT(e, "");
+    ASSERTEQ(e->length, 9, "");
+    ASSERTMEM(e->data, "aaaaaaaaa", 9, "");
+  }
+
+  SECTION(Evict)
+  {
+    // Only two entries; the least recently used one should be replaced.
+    e = file_cache_get(&cache, FILE_A);
+    e->priv = &cache;
+    ASSERT(file_cache_get(&cache, FILE_B), "");
+    ASSERT(file_cache_get(&cache, FILE_C), "");
+    ASSERTEQ(count_entries(cache), 2, "");
+    ASSERTEQ(num_priv_freed, 1, "");
+    ASSERTEQ(cache.total, 15, "");
+
+    // A is gone, so reading it again replaces B.
+    e = file_cache_get(&cache, FILE_A);
+    ASSERT(e, "");
+    ASSERTEQ(e->priv, nullptr, "");
+    ASSERTEQ(cache.total, 14, "");
+  }
+
+  SECTION(Resize)
+  {
+    ASSERT(file_cache_get(&cache, FILE_A), "");
+    e = file_cache_get(&cache, FILE_B);
+    ASSERT(e, "");
+
+    // Going over the limit evicts other entries, but not this one.
+    file_cache_resize(&cache, e, 12);
+    ASSERTEQ(count_entries(cache), 1, "");
+    ASSERTEQ(cache.total, 12, "");
+
+    file_cache_resize(&cache, e, 100);
+    ASSERTEQ(count_entries(cache), 1, "");
+    ASSERTEQ(cache.total, 100, "");
+  }
+
+  SECTION(Invalidate)
+  {
+    e = file_cache_get(&cache, FILE_A);
+    e->priv = &cache;
+    ASSERT(file_cache_get(&cache, FILE_B), "");
+
+    file_cache_invalidate(&cache, FILE_A);
+    ASSERTEQ(count_entries(cache), 1, "");
+    ASSERTEQ(num_priv_freed, 1, "");
+    ASSERTEQ(cache.total, 7, "");
+  }
+
+  file_cache_clear(&cache);
+  ASSERTEQ(count_entries(cache), 0, "");
+  ASSERTEQ(cache.total, 0, "");
+
+  vunlink(FILE_A);
+  vunlink(FILE_B);
+  vunlink(FILE_C);
+  vunlink(FILE_EMPTY);
+}
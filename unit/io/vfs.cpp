@@ -23,6 +23,10 @@
 #include "../../src/io/vfs.h"
 #include "../../src/io/vio.h"
 
+#ifdef VIRTUAL_FILESYSTEM_PARALLEL
+#include "../../src/platform.h"
+#endif
+
 #include <errno.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -1776,15 +1780,16 @@ UNITTEST(vfs_invalidate_at_least)
     { 0, 800, 0, 392,
      {
       { "dirA/filedel", -ENOENT },
-      { "dirA/dirB/file3", -VFS_ERR_IS_CACHED },
+      { "dirA/file2", -ENOENT },
+      { "dirA/dirB/file3", -ENOENT },
       { "dirA/dirB/file4", -ENOENT },
       { "dirA/dirC/file5", -ENOENT },
-      { "fat:/fileX", -ENOENT }}},
+      { "dirA/dirC/file6", -VFS_ERR_IS_CACHED },
+      { "fat:/fileX", -VFS_ERR_IS_CACHED }}},
     { 0, 1000, 640, fileopen_len,
      {
-      { "dirA/file2", -ENOENT },
-      { "dirA/dirB/file3", -ENOENT },
-      { "dirA/dirB/file6", -ENOENT },
+      { "dirA/dirC/file6", -ENOENT },
+      { "fat:/fileX", -ENOENT },
       { "fat:/dirX/fileY", -ENOENT }}},
     { 0, 256, 256, fileopen_len, {}},
   };
@@ -1794,10 +1799,8 @@ UNITTEST(vfs_invalidate_at_least)
   size_t sz;
   int ret;
 
-  // The sort used by this function uses timestamps to prioritize
-  // stale files for deletion. Disable them so this test is deterministic...
-  vfs_set_timestamps_enabled(vfs, false);
-
+  // Files are freed in the order they were cached, since only fileopen
+  // has been accessed since.
   /*size_t total =*/ setup_cache_testing_vfs(vfs);
   uint32_t inode = fileopen_prologue(vfs);
 
@@ -1837,6 +1840,91 @@ UNITTEST(vfs_invalidate_at_least)
   //fileopen_epilogue(vfs, inode);
 }
 
+UNITTEST(vfs_cache_lru)
+{
+#ifndef VIRTUAL_FILESYSTEM
+  SKIP();
+#endif
+
+  static const char file_buf[64]{};
+  static const char *files[] =
+  {
+    "fileA", "fileB", "fileC", "fileD",
+  };
+  ScopedVFS vfs = vfs_init();
+  ASSERT(vfs, "");
+  const unsigned char *data;
+  size_t data_length;
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+  size_t left;
+  uint32_t inode;
+  int ret;
+
+  for(const char *f : files)
+  {
+    ret = vfs_cache_file(vfs, f, file_buf, sizeof(file_buf));
+    ASSERTEQ(ret, 0, "%s", f);
+  }
+
+  // Reading fileA and fileB should make fileC the least recently used.
+  for(int i = 0; i < 2; i++)
+  {
+    ret = vfs_open_if_exists(vfs, files[i], false, &inode);
+    ASSERTEQ(ret, -VFS_ERR_IS_CACHED, "%s", files[i]);
+    ret = vfs_lock_file_read(vfs, inode, &data, &data_length);
+    ASSERTEQ(ret, 0, "%s", files[i]);
+    ASSERTEQ(data_length, sizeof(file_buf), "%s", files[i]);
+    ret = vfs_unlock_file_read(vfs, inode);
+    ASSERTEQ(ret, 0, "%s", files[i]);
+    ret = vfs_close(vfs, inode);
+    ASSERTEQ(ret, 0, "%s", files[i]);
+  }
+
+  ret = vfs_open_if_exists(vfs, "noexist", false, &inode);
+  ASSERTEQ(ret, -ENOENT, "");
+
+  left = 1;
+  ret = vfs_invalidate_at_least(vfs, &left);
+  ASSERTEQ(ret, 0, "");
+  ASSERTEQ(left, 0, "");
+  ret = vfs_access(vfs, "fileC", R_OK);
+  ASSERTEQ(ret, -ENOENT, "");
+
+  // fileA is open, so it should be skipped until it is closed.
+  ret = vfs_open_if_exists(vfs, "fileA", false, &inode);
+  ASSERTEQ(ret, -VFS_ERR_IS_CACHED, "");
+
+  left = sizeof(file_buf) + 1;
+  ret = vfs_invalidate_at_least(vfs, &left);
+  ASSERTEQ(ret, 0, "");
+  ASSERTEQ(left, 0, "");
+  ret = vfs_access(vfs, "fileA", R_OK);
+  ASSERTEQ(ret, -VFS_ERR_IS_CACHED, "");
+  ret = vfs_access(vfs, "fileB", R_OK);
+  ASSERTEQ(ret, -ENOENT, "");
+  ret = vfs_access(vfs, "fileD", R_OK);
+  ASSERTEQ(ret, -ENOENT, "");
+
+  left = 1;
+  ret = vfs_invalidate_at_least(vfs, &left);
+  ASSERTEQ(ret, 0, "");
+  ASSERTEQ(left, 1, "");
+
+  ret = vfs_close(vfs, inode);
+  ASSERTEQ(ret, 0, "");
+  ret = vfs_invalidate_at_least(vfs, &left);
+  ASSERTEQ(ret, 0, "");
+  ASSERTEQ(left, 0, "");
+  ASSERTEQ(vfs_get_cache_total_size(vfs), 0, "");
+
+  vfs_get_cache_stats(vfs, &hits, &misses, &evictions);
+  ASSERTEQ(hits, 3, "");
+  ASSERTEQ(misses, 1, "");
+  ASSERTEQ(evictions, 4, "");
+}
+
 UNITTEST(vfs_invalidate_all)
 {
 #ifndef VIRTUAL_FILESYSTEM
@@ -1862,3 +1950,265 @@ UNITTEST(vfs_invalidate_all)
    { return vfs_invalidate_all(v); };
   test_invalidate_current_dir(vfs, fn);
 }
+
+#ifdef VIRTUAL_FILESYSTEM_PARALLEL
+
+#define NUM_STRESS_THREADS 4
+#define STRESS_ITERATIONS 2000
+
+struct vfs_thread_data
+{
+  vfilesystem *vfs;
+  platform_mutex lock;
+  int id;
+  boolean done;
+  boolean failed;
+  size_t final_alloc;
+};
+
+/**
+ * Read a file and check every byte matches the first byte.
+ */
+static boolean vfs_thread_check_file(vfilesystem *vfs, const char *path,
+ size_t expected_length)
+{
+  const unsigned char *data;
+  size_t data_length;
+  uint32_t inode;
+  boolean ok = true;
+  int ret;
+
+  ret = vfs_open_if_exists(vfs, path, false, &inode);
+  if(ret != -VFS_ERR_IS_CACHED)
+    return false;
+
+  ret = vfs_lock_file_read(vfs, inode, &data, &data_length);
+  if(ret == 0)
+  {
+    if(expected_length && data_length != expected_length)
+      ok = false;
+
+    for(size_t i = 1; i < data_length; i++)
+      if(data[i] != data[0])
+        ok = false;
+
+    if(vfs_unlock_file_read(vfs, inode) != 0)
+      ok = false;
+  }
+  else
+    ok = false;
+
+  if(vfs_close(vfs, inode) != 0)
+    ok = false;
+
+  return ok;
+}
+
+/**
+ * Rewrite a file, reallocating its buffer to `new_alloc` and filling it
+ * with `value`.
+ */
+static boolean vfs_thread_write_file(vfilesystem *vfs, uint32_t inode,
+ size_t new_alloc, int value)
+{
+  unsigned char **data;
+  size_t *data_length;
+  size_t *data_alloc;
+  int ret;
+
+  ret = vfs_lock_file_write(vfs, inode, &data, &data_length, &data_alloc);
+  if(ret != 0)
+    return false;
+
+  unsigned char *tmp = (unsigned char *)realloc(*data, new_alloc);
+  if(tmp)
+  {
+    *data = tmp;
+    *data_alloc = new_alloc;
+    *data_length = new_alloc;
+    memset(*data, value, new_alloc);
+  }
+  return vfs_unlock_file_write(vfs, inode) == 0 && tmp;
+}
+
+static THREAD_RES vfs_write_other_fn(void *opaque)
+{
+  struct vfs_thread_data *d = reinterpret_cast<struct vfs_thread_data *>(opaque);
+  uint32_t inode;
+  int ret;
+
+  ret = vfs_open_if_exists(d->vfs, "fileB", true, &inode);
+  if(ret == -VFS_ERR_IS_CACHED)
+  {
+    if(!vfs_thread_write_file(d->vfs, inode, 128, 'B'))
+      d->failed = true;
+    vfs_close(d->vfs, inode);
+  }
+  else
+    d->failed = true;
+
+  platform_mutex_lock(&(d->lock));
+  d->done = true;
+  platform_mutex_unlock(&(d->lock));
+  THREAD_RETURN;
+}
+
+static THREAD_RES vfs_stress_fn(void *opaque)
+{
+  struct vfs_thread_data *d = reinterpret_cast<struct vfs_thread_data *>(opaque);
+  char path[32];
+  char tmp_path[32];
+  size_t alloc = 64;
+  uint32_t inode;
+  int ret;
+
+  snprintf(path, sizeof(path), "file%d", d->id);
+  snprintf(tmp_path, sizeof(tmp_path), "dir/tmp%d", d->id);
+
+  for(int i = 0; i < STRESS_ITERATIONS; i++)
+  {
+    // Read this thread's file and the file shared by all threads.
+    if(!vfs_thread_check_file(d->vfs, path, alloc) ||
+     !vfs_thread_check_file(d->vfs, "shared", 256))
+    {
+      d->failed = true;
+      break;
+    }
+
+    // Periodically resize and rewrite this thread's file.
+    if((i & 3) == d->id)
+    {
+      ret = vfs_open_if_exists(d->vfs, path, true, &inode);
+      if(ret != -VFS_ERR_IS_CACHED)
+      {
+        d->failed = true;
+        break;
+      }
+      alloc = 32 + ((i * 37 + d->id * 11) & 255);
+      if(!vfs_thread_write_file(d->vfs, inode, alloc, i & 0xff))
+        d->failed = true;
+      vfs_close(d->vfs, inode);
+    }
+
+    // Modify the inode table while other threads are reading.
+    if((i & 7) == 0)
+    {
+      char buf[48]{};
+      if(vfs_cache_file(d->vfs, tmp_path, buf, sizeof(buf)) != 0 ||
+       vfs_invalidate_at_path(d->vfs, tmp_path) != 0)
+      {
+        d->failed = true;
+        break;
+      }
+    }
+  }
+  d->final_alloc = alloc;
+  THREAD_RETURN;
+}
+
+#endif /* VIRTUAL_FILESYSTEM_PARALLEL */
+
+UNITTEST(vfs_parallel)
+{
+#ifndef VIRTUAL_FILESYSTEM_PARALLEL
+  SKIP();
+#else
+#ifndef VIRTUAL_FILESYSTEM
+  SKIP();
+#endif
+
+  static const unsigned char file_buf[256]{};
+  ScopedVFS vfs = vfs_init();
+  ASSERT(vfs, "");
+  int ret;
+
+  SECTION(DifferentFilesDontBlock)
+  {
+    struct vfs_thread_data d{};
+    platform_thread thread;
+    const unsigned char *data;
+    size_t data_length;
+    uint32_t inode;
+    boolean done = false;
+
+    ret = vfs_cache_file(vfs, "fileA", file_buf, 64);
+    ASSERTEQ(ret, 0, "");
+    ret = vfs_cache_file(vfs, "fileB", file_buf, 64);
+    ASSERTEQ(ret, 0, "");
+
+    d.vfs = vfs;
+    platform_mutex_init(&(d.lock));
+
+    // Writing fileB should complete while fileA is locked for reading.
+    ret = vfs_open_if_exists(vfs, "fileA", false, &inode);
+    ASSERTEQ(ret, -VFS_ERR_IS_CACHED, "");
+    ret = vfs_lock_file_read(vfs, inode, &data, &data_length);
+    ASSERTEQ(ret, 0, "");
+
+    ret = platform_thread_create(&thread, vfs_write_other_fn, &d);
+    ASSERT(ret, "");
+
+    for(int i = 0; i < 500 && !done; i++)
+    {
+      platform_mutex_lock(&(d.lock));
+      done = d.done;
+      platform_mutex_unlock(&(d.lock));
+      if(!done)
+        usleep(10000);
+    }
+
+    ret = vfs_unlock_file_read(vfs, inode);
+    ASSERTEQ(ret, 0, "");
+    platform_thread_join(&thread);
+    platform_mutex_destroy(&(d.lock));
+
+    ASSERT(done, "writing fileB was blocked by a read lock on fileA");
+    ASSERT(!d.failed, "");
+    ret = vfs_close(vfs, inode);
+    ASSERTEQ(ret, 0, "");
+    ASSERT(vfs_thread_check_file(vfs, "fileB", 128), "");
+    ASSERTEQ(vfs_get_cache_total_size(vfs), 64 + 128, "");
+  }
+
+  SECTION(Stress)
+  {
+    struct vfs_thread_data d[NUM_STRESS_THREADS]{};
+    platform_thread threads[NUM_STRESS_THREADS];
+    struct stat st{};
+    size_t expected;
+    int i;
+
+    ret = vfs_cache_directory(vfs, "dir", &st);
+    ASSERTEQ(ret, 0, "");
+    ret = vfs_cache_file(vfs, "shared", file_buf, sizeof(file_buf));
+    ASSERTEQ(ret, 0, "");
+    expected = sizeof(file_buf);
+
+    for(i = 0; i < NUM_STRESS_THREADS; i++)
+    {
+      char path[32];
+      snprintf(path, sizeof(path), "file%d", i);
+      ret = vfs_cache_file(vfs, path, file_buf, 64);
+      ASSERTEQ(ret, 0, "%s", path);
+
+      d[i].vfs = vfs;
+      d[i].id = i;
+    }
+
+    for(i = 0; i < NUM_STRESS_THREADS; i++)
+    {
+      ret = platform_thread_create(&threads[i], vfs_stress_fn, &d[i]);
+      ASSERT(ret, "%d", i);
+    }
+    for(i = 0; i < NUM_STRESS_THREADS; i++)
+      platform_thread_join(&threads[i]);
+
+    for(i = 0; i < NUM_STRESS_THREADS; i++)
+    {
+      ASSERT(!d[i].failed, "thread %d", i);
+      expected += d[i].final_alloc;
+    }
+    ASSERTEQ(vfs_get_cache_total_size(vfs), expected, "");
+  }
+#endif
+}
@@ -780,6 +780,200 @@ UNITTEST(FileRead)
   READ_TESTS(vf_in);
 }
 
+UNITTEST(FileReadMapped)
+{
+  ScopedFile<vfile, vfclose> vf_in =
+   vfopen_unsafe_ext(TEST_READ_FILENAME, "rb", V_MAP_FILE);
+  ASSERT(vf_in, "");
+  ASSERT(~vfile_get_flags(vf_in) & VF_VIRTUAL, "");
+#ifndef _WIN32
+  ASSERTEQ(vfile_get_flags(vf_in) & VF_STORAGE_MASK, VF_MEMORY, "");
+#endif
+  READ_TESTS(vf_in);
+
+  SECTION(WriteModeNotMapped)
+  {
+    ScopedFile<vfile, vfclose> vf_rw =
+     vfopen_unsafe_ext(TEST_READ_FILENAME, "r+b", V_MAP_FILE);
+    ASSERT(vf_rw, "");
+    ASSERTEQ(vfile_get_flags(vf_rw) & VF_STORAGE_MASK, VF_FILE, "");
+  }
+}
+
+/**
+ * Files opened read-only in binary mode are read through a read-ahead buffer.
+ * Make sure reads that straddle refills, and other operations mixed with
+ * buffered reads, see the same data and positions as plain stdio would.
+ */
+UNITTEST(FileReadBuffered)
+{
+  static constexpr char LONG_FILENAME[] = "VFILE_TEST_DATA_LONG";
+  static constexpr int REPEAT = 5;
+  static constexpr long len = sizeof(test_data) * REPEAT;
+  uint8_t buffer[sizeof(test_data) * 2];
+  char line[VFSAFEGETS_BUFFER];
+  long pos;
+  int ret;
+  int c;
+
+  FILE *fp = fopen_unsafe(LONG_FILENAME, "wb");
+  ASSERT(fp, "fopen_unsafe");
+  for(int i = 0; i < REPEAT; i++)
+  {
+    ret = fwrite(test_data, sizeof(test_data), 1, fp);
+    ASSERTEQ(ret, 1, "fwrite");
+  }
+  fclose(fp);
+
+  ScopedFile<vfile, vfclose> vf =
+   vfopen_unsafe_ext(LONG_FILENAME, "rb", V_SMALL_BUFFER);
+  ASSERT(vf, "");
+  ASSERTEQ(vfile_get_flags(vf) & VF_STORAGE_MASK, VF_FILE, "");
+
+  #define AT(i) (test_data[(i) % sizeof(test_data)])
+
+  SECTION(Straddle)
+  {
+    // Misalign the reads so words and dwords cross the buffer boundaries.
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(0), "");
+
+    for(long i = 1; i + 4 <= len; i += 4)
+    {
+      int expected = static_cast<int>(AT(i) | (AT(i + 1) << 8) |
+       (AT(i + 2) << 16) | ((uint32_t)AT(i + 3) << 24));
+
+      c = vfgetd(vf);
+      ASSERTEQ(c, expected, "vfgetd offset=%ld", i);
+      pos = vftell(vf);
+      ASSERTEQ(pos, i + 4, "vftell offset=%ld", i);
+    }
+
+    c = vfgetw(vf);
+    ASSERTEQ(c, AT(len - 3) | (AT(len - 2) << 8), "");
+    c = vfgetw(vf);
+    ASSERTEQ(c, EOF, "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, EOF, "");
+  }
+
+  SECTION(vfread)
+  {
+    // Part of the read comes from the buffer, the rest from the file.
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(0), "");
+    ret = vfread(buffer, sizeof(buffer), 1, vf);
+    ASSERTEQ(ret, 1, "");
+    ASSERTMEM(buffer, test_data + 1, sizeof(test_data) - 1, "");
+    pos = vftell(vf);
+    ASSERTEQ(pos, (long)sizeof(buffer) + 1, "");
+
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(sizeof(buffer) + 1), "");
+    ret = vfread(buffer, 1, 16, vf);
+    ASSERTEQ(ret, 16, "");
+    ASSERTMEM(buffer, test_data + 2, 16, "");
+    pos = vftell(vf);
+    ASSERTEQ(pos, (long)sizeof(buffer) + 18, "");
+
+    ret = vfseek(vf, -10, SEEK_END);
+    ASSERTEQ(ret, 0, "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(len - 10), "");
+    ret = vfread(buffer, 4, 4, vf);
+    ASSERTEQ(ret, 2, "");
+    ASSERTMEM(buffer, test_data + sizeof(test_data) - 9, 8, "");
+  }
+
+  SECTION(vfseek)
+  {
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(0), "");
+
+    ret = vfseek(vf, 100, SEEK_CUR);
+    ASSERTEQ(ret, 0, "");
+    pos = vftell(vf);
+    ASSERTEQ(pos, 101, "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(101), "");
+
+    ret = vfseek(vf, -50, SEEK_CUR);
+    ASSERTEQ(ret, 0, "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(52), "");
+
+    // A failed seek shouldn't move the position.
+    ret = vfseek(vf, -1000, SEEK_CUR);
+    ASSERT(ret != 0, "");
+    pos = vftell(vf);
+    ASSERTEQ(pos, 53, "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(53), "");
+
+    ret = vfseek(vf, 600, SEEK_SET);
+    ASSERTEQ(ret, 0, "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(600), "");
+
+    vrewind(vf);
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(0), "");
+
+    long length = vfilelength(vf, false);
+    ASSERTEQ(length, len, "");
+    pos = vftell(vf);
+    ASSERTEQ(pos, 1, "");
+  }
+
+  SECTION(vungetc)
+  {
+    // Unreading the byte that was just read.
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(0), "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(1), "");
+    ret = vungetc(AT(1), vf);
+    ASSERTEQ(ret, AT(1), "");
+    pos = vftell(vf);
+    ASSERTEQ(pos, 1, "");
+    c = vfgetw(vf);
+    ASSERTEQ(c, AT(1) | (AT(2) << 8), "");
+
+    // Unreading a different byte.
+    ret = vungetc(0x5A, vf);
+    ASSERTEQ(ret, 0x5A, "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, 0x5A, "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(3), "");
+    pos = vftell(vf);
+    ASSERTEQ(pos, 4, "");
+  }
+
+  SECTION(vfsafegets)
+  {
+    // The next line end after this is test_data[113].
+    ret = vfseek(vf, 100, SEEK_SET);
+    ASSERTEQ(ret, 0, "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(100), "");
+
+    char *retstr = vfsafegets(line, sizeof(line), vf);
+    ASSERT(retstr, "");
+    ASSERTMEM(line, test_data + 101, 12, "");
+    ASSERTEQ(line[12], '\0', "");
+    pos = vftell(vf);
+    ASSERTEQ(pos, 114, "");
+    c = vfgetc(vf);
+    ASSERTEQ(c, AT(114), "");
+  }
+
+  #undef AT
+
+  vf.reset();
+  vunlink(LONG_FILENAME);
+}
+
 UNITTEST(FileWrite)
 {
   ScopedFile<vfile, vfclose> vf_out = vfopen_unsafe(TEST_WRITE_FILENAME, "w+b");
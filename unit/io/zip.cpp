@@ -27,6 +27,8 @@
 
 #include "../../src/network/Scoped.hpp"
 
+#include <ctype.h>
+
 static const size_t BUFFER_SIZE = (1 << 17);
 static const char DATA_DIR[] = "../data";
 
@@ -989,6 +991,143 @@ UNITTEST(ZipRead)
     if(!has_files)
       FAIL("Add test zips with files to read!");
   }
+
+  SECTION(ReadSubset)
+  {
+    for(const zip_test_data &d : raw_zip_data)
+    {
+      if(d.num_files)
+      {
+        has_files = true;
+
+        // Read each file through a single file subset, and then read the
+        // remaining files as a subset after the first.
+        for(size_t split = 1; split <= 2; split++)
+        {
+          zp = zip_test_open(d);
+          zip_check(d, zp);
+
+          for(size_t j = 0; j < d.num_files;)
+          {
+            size_t count = (split == 1) ? 1 : (j ? d.num_files - j : 1);
+            struct zip_archive *sub = zip_open_subset_read(zp, count);
+            ASSERT(sub, "%s file %zu", d.testname, j);
+            ASSERTEQ(sub->num_files, count, "%s file %zu", d.testname, j);
+            ASSERTEQ(zp->pos, j + count, "%s file %zu", d.testname, j);
+
+            for(size_t k = 0; k < count; k++, j++)
+            {
+              const zip_test_file_data &df = d.files[j];
+              size_t real_length = 0;
+
+              result = zip_read_file(sub, buffer, BUFFER_SIZE, &real_length);
+              ASSERTEQ(result, ZIP_SUCCESS, "%s file %zu", d.testname, j);
+              ASSERTEQ(real_length, df.uncompressed_size, "%s file %zu", d.testname, j);
+
+              if(real_length)
+              {
+                const char *contents = ZIP_GET_CONTENTS(df);
+                cmp = memcmp(buffer, contents, real_length);
+                ASSERTEQ(cmp, 0, "%s file %zu", d.testname, j);
+              }
+            }
+            result = zip_close(sub, nullptr);
+            ASSERTEQ(result, ZIP_SUCCESS, "%s", d.testname);
+          }
+
+          ASSERTEQ(zip_open_subset_read(zp, 1), nullptr, "%s", d.testname);
+          result = zip_close(zp, nullptr);
+          ASSERTEQ(result, ZIP_SUCCESS, "%s", d.testname);
+        }
+      }
+    }
+    if(!has_files)
+      FAIL("Add test zips with files to read!");
+  }
+
+  SECTION(SeekToFile)
+  {
+    for(const zip_test_data &d : raw_zip_data)
+    {
+      if(d.num_files)
+      {
+        has_files = true;
+        zp = zip_test_open(d);
+        zip_check(d, zp);
+
+        // Seek in reverse order to make sure the index is actually used.
+        for(size_t j = d.num_files; j-- > 0;)
+        {
+          const zip_test_file_data &df = d.files[j];
+          size_t expected = j;
+          size_t real_length = 0;
+          char upper[256];
+          size_t k;
+
+          // Files with duplicate names should find the first.
+          for(k = 0; k < j; k++)
+          {
+            if(!strcasecmp(d.files[k].filename, df.filename))
+            {
+              expected = k;
+              break;
+            }
+          }
+
+          snprintf(upper, sizeof(upper), "%s", df.filename);
+          for(k = 0; upper[k]; k++)
+            upper[k] = toupper((unsigned char)upper[k]);
+
+          result = zip_seek_to_file(zp, upper);
+          ASSERTEQ(result, ZIP_SUCCESS, "%s file %zu", d.testname, j);
+          ASSERTEQ(zp->pos, expected, "%s file %zu", d.testname, j);
+
+          if(expected != j)
+            continue;
+
+          result = zip_read_file(zp, buffer, BUFFER_SIZE, &real_length);
+          ASSERTEQ(result, ZIP_SUCCESS, "%s file %zu", d.testname, j);
+          ASSERTEQ(real_length, df.uncompressed_size, "%s file %zu", d.testname, j);
+
+          if(real_length)
+          {
+            const char *contents = ZIP_GET_CONTENTS(df);
+            cmp = memcmp(buffer, contents, real_length);
+            ASSERTEQ(cmp, 0, "%s file %zu", d.testname, j);
+          }
+        }
+
+        zp->pos = 0;
+        result = zip_seek_to_file(zp, "not a file in any archive");
+        ASSERTEQ(result, ZIP_FILE_NOT_FOUND, "%s", d.testname);
+        ASSERTEQ(zp->pos, 0, "%s", d.testname);
+
+        // MZX IDs are assigned externally, so they need a reindex.
+        for(size_t j = 0; j < d.num_files; j++)
+        {
+          zp->files[j]->mzx_file_id = j + 1;
+          zp->files[j]->mzx_board_id = j & 0xff;
+          zp->files[j]->mzx_robot_id = 1;
+        }
+        zip_update_index(zp);
+
+        for(size_t j = d.num_files; j-- > 0;)
+        {
+          result = zip_seek_to_mzx_file(zp, j + 1, j & 0xff, 1);
+          ASSERTEQ(result, ZIP_SUCCESS, "%s file %zu", d.testname, j);
+          ASSERTEQ(zp->pos, j, "%s file %zu", d.testname, j);
+        }
+
+        result = zip_seek_to_mzx_file(zp, 1, 0, 0);
+        ASSERTEQ(result, ZIP_FILE_NOT_FOUND, "%s", d.testname);
+
+        result = zip_close(zp, nullptr);
+        ASSERTEQ(result, ZIP_SUCCESS, "%s", d.testname);
+      }
+    }
+    if(!has_files)
+      FAIL("Add test zips with files to read!");
+  }
 }
 
 static void verify_boilerplate(const zip_test_data &d, struct zip_archive *zp,
@@ -1114,6 +1253,71 @@ UNITTEST(ZipWrite)
     }
   }
 
+  SECTION(CopyFile)
+  {
+    for(int type = 0; type < 4; type++)
+    {
+      const char *label = LABEL[type];
+      for(const zip_test_data &d : raw_zip_data)
+      {
+        // Compress the files into a separate memory archive first.
+        void *src_buffer = nullptr;
+        size_t src_buffer_size = 0;
+        struct zip_archive *src;
+
+        src = zip_open_mem_write_ext(&src_buffer, &src_buffer_size, 0);
+        ASSERT(src, "%s %s", label, d.testname);
+
+        for(size_t j = 0; j < d.num_files; j++)
+        {
+          const zip_test_file_data &df = d.files[j];
+          const char *contents = ZIP_GET_CONTENTS(df);
+          result = zip_write_file(src, df.filename, (const void *)contents,
+           df.uncompressed_size, df.method);
+
+          ASSERTEQ(result, ZIP_SUCCESS, "%s %s %zu", label, d.testname, j);
+        }
+        result = zip_close(src, &final_size);
+        ASSERTEQ(result, ZIP_SUCCESS, "%s %s", label, d.testname);
+
+        src = zip_open_mem_read(src_buffer, final_size);
+        ASSERT(src || !d.num_files, "%s %s", label, d.testname);
+
+        if(type < 2)
+          zp = zip_open_file_write(OUTPUT_FILE);
+        else
+          zp = zip_open_mem_write_ext((void **)&ext_buffer, &ext_buffer_size, 0);
+
+        ASSERT(zp, "%s %s", label, d.testname);
+
+        zip_set_zip64_enabled(zp, type & 1);
+
+        for(size_t j = 0; j < d.num_files; j++)
+        {
+          result = zip_write_copy_file(zp, src);
+          ASSERTEQ(result, ZIP_SUCCESS, "%s %s %zu", label, d.testname, j);
+        }
+        if(src)
+        {
+          result = zip_write_copy_file(zp, src);
+          ASSERTEQ(result, ZIP_EOF, "%s %s", label, d.testname);
+          zip_close(src, nullptr);
+        }
+        free(src_buffer);
+
+        result = zip_close(zp, &final_size);
+        ASSERTEQ(result, ZIP_SUCCESS, "%s %s", label, d.testname);
+
+        if(type < 2)
+          zp = zip_open_file_read(OUTPUT_FILE);
+        else
+          zp = zip_open_mem_read(ext_buffer, final_size);
+
+        verify_boilerplate(d, zp, label, verify_buffer, db64_buffer);
+      }
+    }
+  }
+
   // This is a special version of streaming that allows direct write access to
   // the buffer. This only works with the STORE method and likely doesn't work
   // very well with expandable buffers right now.
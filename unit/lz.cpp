@@ -0,0 +1,282 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Unit.hpp"
+
+#include <string.h>
+#include <vector>
+
+#include "../src/lz.h"
+
+// Matches in an LZ stream can refer at most this far back.
+static constexpr size_t WINDOW = 0xFFFF;
+
+static std::vector<uint8_t> random_data(size_t len, uint32_t seed)
+{
+  std::vector<uint8_t> data(len);
+  for(size_t i = 0; i < len; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    data[i] = seed >> 24;
+  }
+  return data;
+}
+
+/**
+ * Pack and unpack a buffer. Returns the packed size.
+ */
+static size_t round_trip(const std::vector<uint8_t> &src)
+{
+  // Literals cost one extra byte per 255 in the worst case.
+  std::vector<uint8_t> packed(src.size() + src.size() / 255 + 16);
+  std::vector<uint8_t> unpacked(src.size() + 1);
+  size_t packed_len;
+
+  packed_len = lz_pack(packed.data(), packed.size(), src.data(), src.size());
+  ASSERT(packed_len > 0, "%zu", src.size());
+
+  ASSERT(lz_unpack(unpacked.data(), src.size(), packed.data(), packed_len),
+   "%zu", src.size());
+  if(src.size())
+    ASSERTMEM(unpacked.data(), src.data(), src.size(), "%zu", src.size());
+
+  // The unpacked size must match exactly.
+  ASSERT(!lz_unpack(unpacked.data(), src.size() + 1, packed.data(), packed_len),
+   "%zu", src.size());
+  if(src.size())
+  {
+    ASSERT(!lz_unpack(unpacked.data(), src.size() - 1, packed.data(),
+     packed_len), "%zu", src.size());
+  }
+  return packed_len;
+}
+
+UNITTEST(Empty)
+{
+  static const uint8_t empty_stream[] = { 0x00 };
+  uint8_t buffer[16];
+
+  ASSERTEQ(round_trip(std::vector<uint8_t>()), 1, "");
+  ASSERT(lz_unpack(buffer, 0, empty_stream, sizeof(empty_stream)), "");
+  ASSERT(!lz_unpack(buffer, 0, empty_stream, 0), "");
+  ASSERTEQ(lz_pack(buffer, 0, empty_stream, 0), 0, "");
+}
+
+UNITTEST(Short)
+{
+  // Too short to contain a match.
+  for(size_t i = 1; i <= 8; i++)
+    round_trip(std::vector<uint8_t>(i, 'A'));
+}
+
+UNITTEST(Incompressible)
+{
+  std::vector<uint8_t> src = random_data(4096, 1);
+  std::vector<uint8_t> packed(src.size());
+  size_t packed_len;
+
+  // Random data ends up as a single run of literals.
+  packed_len = round_trip(src);
+  ASSERT(packed_len > src.size(), "%zu", packed_len);
+
+  // Output that doesn't fit is a failure, not an overflow.
+  ASSERTEQ(lz_pack(packed.data(), packed.size(), src.data(), src.size()), 0, "");
+  ASSERTEQ(lz_pack(packed.data(), 1, src.data(), src.size()), 0, "");
+}
+
+UNITTEST(Runs)
+{
+  SECTION(Char)
+  {
+    size_t len = round_trip(std::vector<uint8_t>(100000, 0x20));
+    ASSERT(len < 500, "%zu", len);
+  }
+
+  SECTION(Pattern)
+  {
+    std::vector<uint8_t> src(100000);
+    for(size_t i = 0; i < src.size(); i++)
+      src[i] = "\xB2\xB1\xB0 "[i & 3];
+
+    size_t len = round_trip(src);
+    ASSERT(len < 500, "%zu", len);
+  }
+
+  SECTION(LengthBoundaries)
+  {
+    // Match and literal lengths around the extra length byte thresholds.
+    static const size_t lengths[] =
+    {
+      14, 15, 16, 18, 19, 20, 254, 255, 256, 269, 270, 271, 509, 510, 511,
+    };
+    for(size_t run : lengths)
+    {
+      for(size_t literals : lengths)
+      {
+        std::vector<uint8_t> src = random_data(literals, run);
+        src.insert(src.end(), run, 'X');
+        src.push_back('Y');
+        round_trip(src);
+      }
+    }
+  }
+
+  SECTION(Mixed)
+  {
+    std::vector<uint8_t> src;
+    for(uint32_t i = 0; i < 64; i++)
+    {
+      std::vector<uint8_t> noise = random_data(i * 7, i);
+      src.insert(src.end(), noise.begin(), noise.end());
+      src.insert(src.end(), i * 13, i);
+    }
+    round_trip(src);
+  }
+}
+
+UNITTEST(FullWindow)
+{
+  SECTION(Large)
+  {
+    // Data much larger than the window.
+    std::vector<uint8_t> block = random_data(1000, 2);
+    std::vector<uint8_t> src;
+    while(src.size() < WINDOW * 4)
+      src.insert(src.end(), block.begin(), block.end());
+
+    size_t len = round_trip(src);
+    ASSERT(len < src.size() / 20, "%zu", len);
+
+    src = random_data(WINDOW * 3 + 1, 3);
+    round_trip(src);
+  }
+
+  SECTION(Edge)
+  {
+    // A block repeated at exactly the largest offset can be matched; one
+    // byte further can't be. The filler doesn't disturb the block's entries
+    // in the match table.
+    std::vector<uint8_t> block = random_data(64, 4);
+    std::vector<uint8_t> near_src(block);
+    std::vector<uint8_t> far_src(block);
+
+    near_src.insert(near_src.end(), WINDOW - block.size(), 0);
+    near_src.insert(near_src.end(), block.begin(), block.end());
+    far_src.insert(far_src.end(), WINDOW - block.size() + 1, 0);
+    far_src.insert(far_src.end(), block.begin(), block.end());
+
+    size_t near_len = round_trip(near_src);
+    size_t far_len = round_trip(far_src);
+    ASSERT(near_len + block.size() / 2 < far_len, "%zu %zu", near_len, far_len);
+  }
+
+  SECTION(Unpack)
+  {
+    // Literals to fill the window, then a match at the largest offset.
+    std::vector<uint8_t> expected = random_data(WINDOW, 4);
+    std::vector<uint8_t> stream;
+    std::vector<uint8_t> dest(WINDOW + 4);
+    size_t len;
+
+    stream.push_back(0xF0);
+    for(len = WINDOW - 15; len >= 255; len -= 255)
+      stream.push_back(255);
+    stream.push_back(len);
+    stream.insert(stream.end(), expected.begin(), expected.end());
+    stream.push_back(WINDOW & 0xFF);
+    stream.push_back(WINDOW >> 8);
+    stream.push_back(0x00);
+    expected.insert(expected.end(), expected.begin(), expected.begin() + 4);
+
+    ASSERT(lz_unpack(dest.data(), dest.size(), stream.data(), stream.size()), "");
+    ASSERTMEM(dest.data(), expected.data(), dest.size(), "");
+  }
+}
+
+UNITTEST(Truncated)
+{
+  std::vector<uint8_t> src;
+  std::vector<uint8_t> packed(65536);
+  std::vector<uint8_t> dest;
+  size_t packed_len;
+
+  for(uint32_t i = 0; i < 32; i++)
+  {
+    std::vector<uint8_t> noise = random_data(i * 11, i);
+    src.insert(src.end(), noise.begin(), noise.end());
+    src.insert(src.end(), 300, i);
+  }
+  dest.resize(src.size());
+
+  packed_len = lz_pack(packed.data(), packed.size(), src.data(), src.size());
+  ASSERT(packed_len > 0, "");
+
+  for(size_t i = 0; i < packed_len; i++)
+  {
+    // Use a copy so reads past the end are caught by sanitizers.
+    std::vector<uint8_t> truncated(packed.begin(), packed.begin() + i);
+    ASSERT(!lz_unpack(dest.data(), dest.size(), truncated.data(), i), "%zu", i);
+  }
+}
+
+UNITTEST(Corrupt)
+{
+  uint8_t dest[64];
+
+  SECTION(ZeroOffset)
+  {
+    static const uint8_t stream[] = { 0x10, 'A', 0x00, 0x00, 0x00 };
+    ASSERT(!lz_unpack(dest, 5, stream, sizeof(stream)), "");
+  }
+
+  SECTION(OffsetBeforeStart)
+  {
+    static const uint8_t stream[] = { 0x10, 'A', 0x02, 0x00, 0x00 };
+    ASSERT(!lz_unpack(dest, 5, stream, sizeof(stream)), "");
+  }
+
+  SECTION(MatchPastEnd)
+  {
+    static const uint8_t stream[] = { 0x10, 'A', 0x01, 0x00, 0x00 };
+    ASSERT(lz_unpack(dest, 5, stream, sizeof(stream)), "");
+    ASSERT(!lz_unpack(dest, 3, stream, sizeof(stream)), "");
+  }
+
+  SECTION(LiteralsPastEnd)
+  {
+    static const uint8_t stream[] = { 0x40, 'A', 'B', 'C', 'D' };
+    ASSERT(!lz_unpack(dest, 3, stream, sizeof(stream)), "");
+  }
+
+  SECTION(MissingLength)
+  {
+    static const uint8_t stream[] = { 0xF0 };
+    ASSERT(!lz_unpack(dest, sizeof(dest), stream, sizeof(stream)), "");
+  }
+
+  SECTION(Garbage)
+  {
+    // This only needs to not crash or write out of bounds.
+    for(uint32_t i = 0; i < 1000; i++)
+    {
+      std::vector<uint8_t> stream = random_data(i % 97 + 1, i);
+      lz_unpack(dest, sizeof(dest), stream.data(), stream.size());
+    }
+  }
+}
@@ -0,0 +1,75 @@
+/* MegaZeux
+ *
+ * Copyright (C) 2026 Alice Rowan <petrifiedrowan@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Unit.hpp"
+#include "../src/robot.h"
+
+// Commands are stored as [length][command][params][length]. Numeric params
+// are a 0 byte followed by a 16-bit value; string params are their length
+// (including the terminator) followed by the string.
+#define WAIT_1 "\x04\x02\x00\x01\x00\x04"
+#define END "\x01\x00\x01"
+#define TELEPORT(len, name_len, name) \
+  len "\x6d" name_len name "\0" "\x00\x01\x00" "\x00\x02\x00" len
+
+static const char program[] =
+  "\xff"
+  WAIT_1
+  WAIT_1
+  TELEPORT("\x0e", "\x06", "board")
+  TELEPORT("\x0f", "\x07", "&name&")
+  WAIT_1
+  TELEPORT("\x0f", "\x07", "second")
+  END
+  "\x00";
+
+UNITTEST(get_program_teleports)
+{
+  const char *names[8];
+  int num;
+
+  SECTION(AfterOtherCommands)
+  {
+    num = get_program_teleports(program, sizeof(program) - 1, names, 8);
+    ASSERTEQ(num, 2, "");
+    ASSERTCMP(names[0], "board", "");
+    ASSERTCMP(names[1], "second", "");
+  }
+
+  SECTION(MaxNames)
+  {
+    num = get_program_teleports(program, sizeof(program) - 1, names, 1);
+    ASSERTEQ(num, 1, "");
+    ASSERTCMP(names[0], "board", "");
+  }
+
+  SECTION(Truncated)
+  {
+    // The second TELEPORT doesn't fit in the program.
+    num = get_program_teleports(program, sizeof(program) - 8, names, 8);
+    ASSERTEQ(num, 1, "");
+    ASSERTCMP(names[0], "board", "");
+  }
+
+  SECTION(Empty)
+  {
+    ASSERTEQ(get_program_teleports("\xff\x00", 2, names, 8), 0, "");
+    ASSERTEQ(get_program_teleports(nullptr, 0, names, 8), 0, "");
+  }
+}